@@ -0,0 +1,388 @@
+#include "aabb_tree.hpp"
+#include <algorithm>
+#include <cassert>
+
+using demo::math::Vec3;
+
+static Aabb combine(const Aabb& a, const Aabb& b)
+{
+    return Aabb{
+        Vec3(std::min(a.min.x, b.min.x), std::min(a.min.y, b.min.y), std::min(a.min.z, b.min.z)),
+        Vec3(std::max(a.max.x, b.max.x), std::max(a.max.y, b.max.y), std::max(a.max.z, b.max.z))};
+}
+
+static bool contains(const Aabb& outer, const Aabb& inner)
+{
+    return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z
+        && inner.max.x <= outer.max.x && inner.max.y <= outer.max.y && inner.max.z <= outer.max.z;
+}
+
+// The surface area of a box, which is proportional to the chance of a random ray hitting it
+static float surface_area(const Aabb& box)
+{
+    Vec3 size = box.max - box.min;
+    return 2.0f * (size.x*size.y + size.y*size.z + size.z*size.x);
+}
+
+bool intersect_ray(const Aabb& box, const Vec3& origin, const Vec3& inverse_direction, float max_t, float& t_enter)
+{
+    // Clip the ray against the slab between each pair of faces
+    float t_min = 0.0f;
+    float t_max = max_t;
+
+    const float box_min[3] = {box.min.x, box.min.y, box.min.z};
+    const float box_max[3] = {box.max.x, box.max.y, box.max.z};
+    const float o[3] = {origin.x, origin.y, origin.z};
+    const float inverse[3] = {inverse_direction.x, inverse_direction.y, inverse_direction.z};
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float t1 = (box_min[axis] - o[axis]) * inverse[axis];
+        float t2 = (box_max[axis] - o[axis]) * inverse[axis];
+        if (t1 > t2)
+        {
+            std::swap(t1, t2);
+        }
+
+        t_min = std::max(t_min, t1);
+        t_max = std::min(t_max, t2);
+        if (t_min > t_max)
+        {
+            return false;
+        }
+    }
+
+    t_enter = t_min;
+    return true;
+}
+
+AabbTree::AabbTree(float margin_)
+    : margin(margin_)
+{}
+
+int AabbTree::allocate_node()
+{
+    if (free_list == null_node)
+    {
+        nodes.emplace_back();
+        tight_boxes.emplace_back();
+        free_list = static_cast<int>(nodes.size()) - 1;
+        nodes.back().parent = null_node;
+    }
+
+    int index = free_list;
+    free_list = nodes[index].parent;
+    nodes[index] = Node();
+    nodes[index].height = 0;
+    return index;
+}
+
+void AabbTree::free_node(int node)
+{
+    nodes[node].parent = free_list;
+    nodes[node].height = -1;
+    free_list = node;
+}
+
+int AabbTree::insert(const Aabb& bounds, std::uint32_t object)
+{
+    int leaf = allocate_node();
+    Vec3 fat_margin(margin, margin, margin);
+    nodes[leaf].box = Aabb{bounds.min - fat_margin, bounds.max + fat_margin};
+    tight_boxes[leaf] = bounds;
+    nodes[leaf].object = object;
+    insert_leaf(leaf);
+    return leaf;
+}
+
+void AabbTree::remove(int proxy)
+{
+    assert(proxy >= 0 && proxy < static_cast<int>(nodes.size()) && nodes[proxy].is_leaf());
+    remove_leaf(proxy);
+    free_node(proxy);
+}
+
+bool AabbTree::move(int proxy, const Aabb& bounds)
+{
+    tight_boxes[proxy] = bounds;
+    if (contains(nodes[proxy].box, bounds))
+    {
+        return false;
+    }
+
+    remove_leaf(proxy);
+    Vec3 fat_margin(margin, margin, margin);
+    nodes[proxy].box = Aabb{bounds.min - fat_margin, bounds.max + fat_margin};
+    insert_leaf(proxy);
+    return true;
+}
+
+void AabbTree::clear()
+{
+    nodes.clear();
+    tight_boxes.clear();
+    root = null_node;
+    free_list = null_node;
+}
+
+std::uint32_t AabbTree::object(int proxy) const
+{
+    return nodes[proxy].object;
+}
+
+const Aabb& AabbTree::fat_bounds(int proxy) const
+{
+    return nodes[proxy].box;
+}
+
+int AabbTree::height() const
+{
+    return root == null_node ? 0 : nodes[root].height;
+}
+
+void AabbTree::insert_leaf(int leaf)
+{
+    if (root == null_node)
+    {
+        root = leaf;
+        nodes[root].parent = null_node;
+        return;
+    }
+
+    // Find the best sibling for the new leaf by branch and bound. Pairing the leaf with a node
+    // costs the area of their combined bounds, plus the growth of every ancestor's bounds. The
+    // cost for a node's descendants can't be lower than the leaf's own area plus that growth,
+    // so subtrees where this bound exceeds the best cost so far are skipped.
+    const Aabb leaf_box = nodes[leaf].box;
+    const float leaf_area = surface_area(leaf_box);
+    int index = root;
+    float best_cost = surface_area(combine(nodes[root].box, leaf_box));
+
+    std::vector<Candidate>& stack = insert_stack;
+    stack.clear();
+    stack.push_back(Candidate{root, 0.0f});
+    while (!stack.empty())
+    {
+        Candidate candidate = stack.back();
+        stack.pop_back();
+
+        const Node& node = nodes[candidate.node];
+        float combined_area = surface_area(combine(node.box, leaf_box));
+        float cost = combined_area + candidate.inherited_cost;
+        if (cost < best_cost)
+        {
+            best_cost = cost;
+            index = candidate.node;
+        }
+
+        float inherited_cost = candidate.inherited_cost + combined_area - surface_area(node.box);
+        if (!node.is_leaf() && leaf_area + inherited_cost < best_cost)
+        {
+            stack.push_back(Candidate{node.child1, inherited_cost});
+            stack.push_back(Candidate{node.child2, inherited_cost});
+        }
+    }
+
+    int sibling = index;
+    int old_parent = nodes[sibling].parent;
+    int new_parent = allocate_node();
+
+    Node& parent_node = nodes[new_parent];
+    parent_node.parent = old_parent;
+    parent_node.box = combine(leaf_box, nodes[sibling].box);
+    parent_node.height = nodes[sibling].height + 1;
+    parent_node.child1 = sibling;
+    parent_node.child2 = leaf;
+    nodes[sibling].parent = new_parent;
+    nodes[leaf].parent = new_parent;
+
+    if (old_parent == null_node)
+    {
+        root = new_parent;
+    }
+    else if (nodes[old_parent].child1 == sibling)
+    {
+        nodes[old_parent].child1 = new_parent;
+    }
+    else
+    {
+        nodes[old_parent].child2 = new_parent;
+    }
+
+    refit_ancestors(new_parent);
+}
+
+void AabbTree::remove_leaf(int leaf)
+{
+    if (leaf == root)
+    {
+        root = null_node;
+        return;
+    }
+
+    int parent = nodes[leaf].parent;
+    int grandparent = nodes[parent].parent;
+    int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+    // The sibling takes the parent's place
+    nodes[sibling].parent = grandparent;
+    free_node(parent);
+    if (grandparent == null_node)
+    {
+        root = sibling;
+    }
+    else
+    {
+        if (nodes[grandparent].child1 == parent)
+        {
+            nodes[grandparent].child1 = sibling;
+        }
+        else
+        {
+            nodes[grandparent].child2 = sibling;
+        }
+        refit_ancestors(grandparent);
+    }
+}
+
+void AabbTree::refit_ancestors(int index)
+{
+    while (index != null_node)
+    {
+        index = balance(index);
+
+        Node& node = nodes[index];
+        const Node& child1 = nodes[node.child1];
+        const Node& child2 = nodes[node.child2];
+        node.height = 1 + std::max(child1.height, child2.height);
+        node.box = combine(child1.box, child2.box);
+
+        index = node.parent;
+    }
+}
+
+int AabbTree::balance(int a_index)
+{
+    Node& a = nodes[a_index];
+    if (a.is_leaf() || a.height < 2)
+    {
+        return a_index;
+    }
+
+    int b_index = a.child1;
+    int c_index = a.child2;
+    Node& b = nodes[b_index];
+    Node& c = nodes[c_index];
+    int imbalance = c.height - b.height;
+    if (imbalance >= -1 && imbalance <= 1)
+    {
+        return a_index;
+    }
+
+    // Rotate the taller child up into a's place. a takes the taller of that child's children's
+    // place, and keeps the other.
+    bool rotate_c = imbalance > 1;
+    int up_index = rotate_c ? c_index : b_index;
+    int other_index = rotate_c ? b_index : c_index;
+    Node& up = nodes[up_index];
+    const Node& other = nodes[other_index];
+
+    up.parent = a.parent;
+    a.parent = up_index;
+    if (up.parent == null_node)
+    {
+        root = up_index;
+    }
+    else if (nodes[up.parent].child1 == a_index)
+    {
+        nodes[up.parent].child1 = up_index;
+    }
+    else
+    {
+        nodes[up.parent].child2 = up_index;
+    }
+
+    int f_index = up.child1;
+    int g_index = up.child2;
+    if (nodes[f_index].height < nodes[g_index].height)
+    {
+        std::swap(f_index, g_index);
+    }
+
+    // up keeps its taller child f and adopts a, while a gets up's shorter child g
+    up.child1 = a_index;
+    up.child2 = f_index;
+    if (rotate_c)
+    {
+        a.child2 = g_index;
+    }
+    else
+    {
+        a.child1 = g_index;
+    }
+    nodes[g_index].parent = a_index;
+
+    a.box = combine(other.box, nodes[g_index].box);
+    a.height = 1 + std::max(other.height, nodes[g_index].height);
+    up.box = combine(a.box, nodes[f_index].box);
+    up.height = 1 + std::max(a.height, nodes[f_index].height);
+
+    return up_index;
+}
+
+void AabbTree::find_pairs(std::vector<Pair>& pairs) const
+{
+    pairs.clear();
+    if (root == null_node)
+    {
+        return;
+    }
+
+    // Descend the tree against itself (van den Bergen, Collision Detection in Interactive 3D
+    // Environments, 5.4). Each entry is a pair of subtrees whose leaves may overlap, where equal
+    // nodes stand for the pairs of leaves within one subtree. Unlike querying the tree once per
+    // leaf, the upper levels are only visited once.
+    std::vector<std::pair<int, int>> stack;
+    stack.emplace_back(root, root);
+    while (!stack.empty())
+    {
+        auto [a_index, b_index] = stack.back();
+        stack.pop_back();
+
+        const Node& a = nodes[a_index];
+        const Node& b = nodes[b_index];
+        if (a_index == b_index)
+        {
+            if (!a.is_leaf())
+            {
+                stack.emplace_back(a.child1, a.child1);
+                stack.emplace_back(a.child2, a.child2);
+                stack.emplace_back(a.child1, a.child2);
+            }
+            continue;
+        }
+
+        if (!overlap(a.box, b.box))
+        {
+            continue;
+        }
+
+        if (a.is_leaf() && b.is_leaf())
+        {
+            if (overlap(tight_boxes[a_index], tight_boxes[b_index]))
+            {
+                pairs.emplace_back(std::min(a.object, b.object), std::max(a.object, b.object));
+            }
+        }
+        else if (b.is_leaf() || (!a.is_leaf() && a.height >= b.height))
+        {
+            // Split the taller subtree
+            stack.emplace_back(a.child1, b_index);
+            stack.emplace_back(a.child2, b_index);
+        }
+        else
+        {
+            stack.emplace_back(a_index, b.child1);
+            stack.emplace_back(a_index, b.child2);
+        }
+    }
+}
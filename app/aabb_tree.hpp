@@ -0,0 +1,252 @@
+#ifndef AABB_TREE_HPP
+#define AABB_TREE_HPP
+
+#include "math.hpp"
+#include "broad_phase.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Dynamic bounding volume tree (Catto, Dynamic Bounding Volume Hierarchies, GDC 2019). Each
+// object is a leaf, and each internal node bounds its two children. Leaves store "fat" bounds,
+// enlarged by a margin, so an object which moves a little stays inside them and the tree
+// doesn't need to change. When an object leaves its fat bounds it is reinserted, and the nodes
+// above it are rebalanced by rotations.
+//
+// Unlike sweep and prune, the cost of an update doesn't depend on how objects line up along
+// the axes, and the tree also answers ray and region queries.
+class AabbTree
+{
+public:
+    using Pair = std::pair<std::uint32_t, std::uint32_t>;
+
+    explicit AabbTree(float margin = 0.1f);
+
+    // Adds an object with the given bounds, and returns the proxy which refers to it in the tree
+    int insert(const Aabb& bounds, std::uint32_t object);
+
+    void remove(int proxy);
+
+    // Updates the bounds of an object. Returns true if the object left its fat bounds and
+    // was reinserted.
+    bool move(int proxy, const Aabb& bounds);
+
+    // Removes every object
+    void clear();
+
+    std::uint32_t object(int proxy) const;
+    const Aabb& fat_bounds(int proxy) const;
+
+    // Height of the tree, which is zero for a single leaf
+    int height() const;
+
+    // Finds the pairs of objects whose bounds overlap, as (lower, higher) object numbers
+    void find_pairs(std::vector<Pair>& pairs) const;
+
+    // Calls callback(object) for each object whose fat bounds overlap region
+    template <class Callback>
+    void query(const Aabb& region, Callback&& callback) const;
+
+    // Calls callback(object) for each object whose fat bounds are hit by the ray
+    // origin + t*direction, for 0 <= t <= max_t. The callback returns the new max_t, so it can
+    // return a hit's t to skip everything further away, or 0 to end the search.
+    template <class Callback>
+    void ray_cast(const demo::math::Vec3& origin, const demo::math::Vec3& direction, float max_t, Callback&& callback) const;
+
+    struct RayHit
+    {
+        std::uint32_t object = 0;
+
+        // The ray first meets the object at origin + fraction*direction
+        float fraction = 0.0f;
+
+        // The unit normal of the object there, or zero if the ray starts inside it
+        demo::math::Vec3 normal;
+
+        bool hit = false;
+    };
+
+    // Finds the first object hit by the ray origin + t*direction, for 0 <= t <= max_t.
+    // cast(object, max_t) casts the ray against a single object, and returns a
+    // geometry::GjkRayHit, such as geometry::ray_cast_gjk with the object's support mapping.
+    // Each hit shortens the ray, so objects further away than the first hit are skipped.
+    // ray_cast_gjk reports a cast which ran out of iterations as a miss, so such an object
+    // never becomes the first hit at an arbitrary distance.
+    template <class ObjectCast>
+    RayHit first_hit(const demo::math::Vec3& origin, const demo::math::Vec3& direction, float max_t, ObjectCast&& cast) const;
+
+private:
+    static constexpr int null_node = -1;
+
+    struct Node
+    {
+        // Fat bounds for leaves
+        Aabb box;
+
+        // The next free node, for nodes in the free list
+        int parent = null_node;
+
+        int child1 = null_node;
+        int child2 = null_node;
+
+        // Leaves have height 0, and free nodes have height -1
+        int height = -1;
+
+        std::uint32_t object = 0;
+
+        bool is_leaf() const
+        {
+            return child1 == null_node;
+        }
+    };
+
+    int allocate_node();
+    void free_node(int node);
+    void insert_leaf(int leaf);
+    void remove_leaf(int leaf);
+
+    // Refits and rebalances the nodes from node up to the root
+    void refit_ancestors(int node);
+
+    // Rotates a child of node upwards if node is unbalanced, and returns the node which
+    // takes its place
+    int balance(int node);
+
+    float margin;
+    int root = null_node;
+
+    // Scratch space for insert_leaf
+    struct Candidate
+    {
+        int node;
+        float inherited_cost;
+    };
+    std::vector<Candidate> insert_stack;
+
+    int free_list = null_node;
+    std::vector<Node> nodes;
+
+    // Exact bounds of each leaf, by node index. These are kept out of Node so that more nodes
+    // fit in the cache during traversals.
+    std::vector<Aabb> tight_boxes;
+};
+
+// Returns the t at which the ray origin + t*direction enters box, if it does so for some
+// 0 <= t <= max_t. inverse_direction is the componentwise reciprocal of direction.
+bool intersect_ray(const Aabb& box, const demo::math::Vec3& origin, const demo::math::Vec3& inverse_direction, float max_t, float& t_enter);
+
+template <class Callback>
+void AabbTree::query(const Aabb& region, Callback&& callback) const
+{
+    if (root == null_node)
+    {
+        return;
+    }
+
+    std::vector<int> stack;
+    stack.push_back(root);
+    while (!stack.empty())
+    {
+        const Node& node = nodes[stack.back()];
+        stack.pop_back();
+
+        if (!overlap(node.box, region))
+        {
+            continue;
+        }
+
+        if (node.is_leaf())
+        {
+            callback(node.object);
+        }
+        else
+        {
+            stack.push_back(node.child1);
+            stack.push_back(node.child2);
+        }
+    }
+}
+
+template <class Callback>
+void AabbTree::ray_cast(const demo::math::Vec3& origin, const demo::math::Vec3& direction, float max_t, Callback&& callback) const
+{
+    // Division by zero gives infinities, which the slab test handles
+    demo::math::Vec3 inverse_direction(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+    float t_enter;
+    if (root == null_node || !intersect_ray(nodes[root].box, origin, inverse_direction, max_t, t_enter))
+    {
+        return;
+    }
+
+    // Each node is stacked with the t at which the ray enters its box
+    std::vector<std::pair<int, float>> stack;
+    stack.emplace_back(root, t_enter);
+    while (!stack.empty())
+    {
+        auto [index, t] = stack.back();
+        stack.pop_back();
+
+        // The callback may have shortened the ray since the node was stacked
+        if (t > max_t)
+        {
+            continue;
+        }
+
+        const Node& node = nodes[index];
+        if (node.is_leaf())
+        {
+            max_t = callback(node.object);
+            if (max_t <= 0.0f)
+            {
+                return;
+            }
+            continue;
+        }
+
+        // The nearer child is visited first, so that a callback which shortens the ray to its
+        // hits skips as much of the tree as it can
+        float t1;
+        float t2;
+        bool hit1 = intersect_ray(nodes[node.child1].box, origin, inverse_direction, max_t, t1);
+        bool hit2 = intersect_ray(nodes[node.child2].box, origin, inverse_direction, max_t, t2);
+        if (hit1 && hit2 && t1 <= t2)
+        {
+            stack.emplace_back(node.child2, t2);
+            stack.emplace_back(node.child1, t1);
+        }
+        else
+        {
+            if (hit1)
+            {
+                stack.emplace_back(node.child1, t1);
+            }
+            if (hit2)
+            {
+                stack.emplace_back(node.child2, t2);
+            }
+        }
+    }
+}
+
+template <class ObjectCast>
+AabbTree::RayHit AabbTree::first_hit(const demo::math::Vec3& origin, const demo::math::Vec3& direction, float max_t, ObjectCast&& cast) const
+{
+    RayHit result;
+    ray_cast(origin, direction, max_t, [&](std::uint32_t object) {
+        auto hit = cast(object, max_t);
+        if (hit.hit && hit.fraction <= max_t)
+        {
+            result.object = object;
+            result.fraction = hit.fraction;
+            result.normal = hit.normal;
+            result.hit = true;
+            max_t = hit.fraction;
+        }
+        return max_t;
+    });
+    return result;
+}
+
+#endif
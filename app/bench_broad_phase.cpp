@@ -0,0 +1,548 @@
+#include "gjk.hpp"
+#include "math.hpp"
+#include "convex_hull.hpp"
+#include "broad_phase.hpp"
+#include "aabb_tree.hpp"
+#include "thread_pool.hpp"
+#include "benchmark.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace demo::math;
+using namespace demo::bench;
+
+namespace {
+
+struct MovingObject
+{
+    ConvexHullInstance instance;
+    Vec3 velocity;
+    Vec3 angular_velocity;
+};
+
+enum class Layout
+{
+    // Spread evenly through a cube
+    Uniform,
+
+    // Packed into a few small clusters, far apart from each other
+    Clustered
+};
+
+constexpr std::size_t cluster_count = 16;
+
+// A scene of drifting, tumbling objects inside boxes which grow with the object count, so that
+// each object has roughly the same number of neighbours at every scale.
+struct Scene
+{
+    std::vector<MovingObject> objects;
+    std::vector<Vec3> centres;
+    float half_width;
+
+    Scene(std::size_t object_count, std::size_t mesh_count, Layout layout, std::mt19937& rng)
+    {
+        // Meshes are roughly unit sized. This gives each object about 8 cubic units.
+        if (layout == Layout::Uniform)
+        {
+            half_width = std::cbrt(static_cast<float>(object_count));
+            centres.push_back(Vec3());
+        }
+        else
+        {
+            half_width = std::cbrt(static_cast<float>(object_count) / cluster_count);
+            float spread = 20.0f * half_width * std::cbrt(static_cast<float>(cluster_count));
+            for (std::size_t i = 0; i < cluster_count; ++i)
+            {
+                centres.push_back(random_position(rng, spread));
+            }
+        }
+
+        std::uniform_int_distribution<int> mesh_distribution(0, static_cast<int>(mesh_count) - 1);
+        for (std::size_t i = 0; i < object_count; ++i)
+        {
+            const Vec3& centre = centres[i % centres.size()];
+            objects.push_back({
+                ConvexHullInstance(centre + random_position(rng, half_width), random_orientation(rng), mesh_distribution(rng)),
+                random_position(rng, 0.01f),
+                random_position(rng, 0.01f)});
+        }
+    }
+
+    void step()
+    {
+        for (std::size_t i = 0; i < objects.size(); ++i)
+        {
+            MovingObject& object = objects[i];
+            object.instance.position += object.velocity;
+            object.instance.orientation = Mat3::AxisAngle(object.angular_velocity) * object.instance.orientation;
+
+            // Bounce off the walls of the object's box
+            Vec3 offset = object.instance.position - centres[i % centres.size()];
+            float* position[3] = {&offset.x, &offset.y, &offset.z};
+            float* velocity[3] = {&object.velocity.x, &object.velocity.y, &object.velocity.z};
+            for (std::size_t k = 0; k < 3; ++k)
+            {
+                if (std::abs(*position[k]) > half_width)
+                {
+                    *velocity[k] = -*velocity[k];
+                }
+            }
+        }
+    }
+};
+
+enum class Method
+{
+    SweepAndPrune,
+    Tree
+};
+
+bool narrow_phase(const Scene& scene, const std::vector<NamedMesh>& meshes, std::uint32_t i, std::uint32_t j)
+{
+    const ConvexHullInstance& a = scene.objects[i].instance;
+    const ConvexHullInstance& b = scene.objects[j].instance;
+    const auto& vertices1 = meshes[a.mesh_id].vertices;
+    const auto& vertices2 = meshes[b.mesh_id].vertices;
+    return geometry::intersect_gjk<Vec3>(
+        [&](const Vec3& d) { return general_support(d, a, vertices1); },
+        [&](const Vec3& d) { return general_support(d, b, vertices2); });
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Runs the scene with a broad phase, and, for small scenes, with the all-pairs loop it replaces.
+void bench_scene(const std::vector<NamedMesh>& meshes, Layout layout, Method method,
+                 std::size_t object_count, std::size_t frame_count, bool all_pairs)
+{
+    std::mt19937 rng(475);
+    Scene scene(object_count, meshes.size(), layout, rng);
+
+    std::vector<Aabb> local_bounds;
+    for (const NamedMesh& mesh : meshes)
+    {
+        local_bounds.push_back(compute_bounds(mesh.vertices));
+    }
+
+    SweepAndPrune sweep_and_prune;
+    AabbTree tree;
+    std::vector<int> proxies;
+    std::vector<AabbTree::Pair> tree_pairs;
+    std::vector<Aabb> boxes(object_count);
+
+    double bounds_seconds = 0.0;
+    double sort_seconds = 0.0;
+    double narrow_seconds = 0.0;
+    std::size_t candidate_pairs = 0;
+    std::size_t intersections = 0;
+    std::size_t sort_work = 0;
+
+    double all_pairs_seconds = 0.0;
+    std::size_t all_pairs_intersections = 0;
+
+    // The first frame builds the broad phase from scratch, so it is not included
+    for (std::size_t frame = 0; frame <= frame_count; ++frame)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < object_count; ++i)
+        {
+            const ConvexHullInstance& instance = scene.objects[i].instance;
+            boxes[i] = world_bounds(local_bounds[instance.mesh_id], instance);
+        }
+        double t_bounds = seconds_since(start);
+
+        start = std::chrono::steady_clock::now();
+        std::size_t frame_work = 0;
+        if (method == Method::SweepAndPrune)
+        {
+            sweep_and_prune.update(boxes);
+            frame_work = sweep_and_prune.sort_work();
+        }
+        else
+        {
+            for (std::uint32_t i = 0; i < object_count; ++i)
+            {
+                if (frame == 0)
+                {
+                    proxies.push_back(tree.insert(boxes[i], i));
+                }
+                else
+                {
+                    frame_work += tree.move(proxies[i], boxes[i]);
+                }
+            }
+            tree.find_pairs(tree_pairs);
+        }
+        const auto& pairs = method == Method::SweepAndPrune ? sweep_and_prune.pairs() : tree_pairs;
+        double t_sort = seconds_since(start);
+
+        start = std::chrono::steady_clock::now();
+        std::size_t frame_intersections = 0;
+        for (const auto& pair : pairs)
+        {
+            frame_intersections += narrow_phase(scene, meshes, pair.first, pair.second);
+        }
+        double t_narrow = seconds_since(start);
+        keep(frame_intersections);
+
+        if (frame > 0)
+        {
+            bounds_seconds += t_bounds;
+            sort_seconds += t_sort;
+            narrow_seconds += t_narrow;
+            candidate_pairs += pairs.size();
+            intersections += frame_intersections;
+            sort_work += frame_work;
+
+            if (all_pairs)
+            {
+                start = std::chrono::steady_clock::now();
+                for (std::uint32_t i = 0; i + 1 < object_count; ++i)
+                {
+                    for (std::uint32_t j = i + 1; j < object_count; ++j)
+                    {
+                        all_pairs_intersections += narrow_phase(scene, meshes, i, j);
+                    }
+                }
+                all_pairs_seconds += seconds_since(start);
+            }
+        }
+
+        scene.step();
+    }
+
+    double frames = static_cast<double>(frame_count);
+    std::cout << std::left << std::setw(11) << (layout == Layout::Uniform ? "uniform" : "clustered")
+              << std::setw(7) << (method == Method::SweepAndPrune ? "sap" : "tree")
+              << std::setw(10) << object_count
+              << std::setw(14) << candidate_pairs / frame_count
+              << std::setw(14) << intersections / frame_count
+              << std::setw(12) << sort_work / frame_count
+              << std::fixed << std::setprecision(3)
+              << std::setw(12) << 1e3 * bounds_seconds / frames
+              << std::setw(12) << 1e3 * sort_seconds / frames
+              << std::setw(12) << 1e3 * narrow_seconds / frames
+              << std::setw(12) << 1e3 * (bounds_seconds + sort_seconds + narrow_seconds) / frames;
+    if (all_pairs)
+    {
+        std::cout << std::setw(14) << 1e3 * all_pairs_seconds / frames
+                  << (all_pairs_intersections == intersections ? "yes" : "NO");
+    }
+    else
+    {
+        std::cout << std::setw(14) << "-" << "-";
+    }
+    std::cout << "\n";
+}
+
+// Runs the narrow phase over one frame's candidate pairs on a growing number of threads
+void bench_threads(const std::vector<NamedMesh>& meshes, std::size_t object_count, std::size_t repeat_count)
+{
+    std::mt19937 rng(475);
+    Scene scene(object_count, meshes.size(), Layout::Uniform, rng);
+
+    std::vector<Aabb> boxes;
+    for (const MovingObject& object : scene.objects)
+    {
+        boxes.push_back(world_bounds(compute_bounds(meshes[object.instance.mesh_id].vertices), object.instance));
+    }
+    SweepAndPrune sweep_and_prune;
+    sweep_and_prune.update(boxes);
+    const auto& pairs = sweep_and_prune.pairs();
+
+    std::vector<char> serial_results(pairs.size());
+    for (std::size_t k = 0; k < pairs.size(); ++k)
+    {
+        serial_results[k] = narrow_phase(scene, meshes, pairs[k].first, pairs[k].second);
+    }
+
+    std::cout << "\nNarrow phase on " << pairs.size() << " pairs of " << object_count
+              << " objects, per frame averages (times in ms)\n";
+    std::cout << std::left << std::setw(10) << "Threads"
+              << std::setw(12) << "Time"
+              << std::setw(10) << "Speedup"
+              << std::setw(10) << "Steals"
+              << "Agree\n";
+
+    std::size_t max_threads = std::max(4u, std::thread::hardware_concurrency());
+    double single_thread_seconds = 0.0;
+    std::vector<char> results(pairs.size());
+    for (std::size_t thread_count = 1; thread_count <= max_threads; thread_count *= 2)
+    {
+        WorkStealingPool pool(thread_count);
+        std::size_t steals = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t repeat = 0; repeat < repeat_count; ++repeat)
+        {
+            pool.parallel_for(pairs.size(), 32, [&](std::size_t begin, std::size_t end) {
+                for (std::size_t k = begin; k < end; ++k)
+                {
+                    results[k] = narrow_phase(scene, meshes, pairs[k].first, pairs[k].second);
+                }
+            });
+            steals += pool.steal_count();
+        }
+        double seconds = seconds_since(start) / static_cast<double>(repeat_count);
+        if (thread_count == 1)
+        {
+            single_thread_seconds = seconds;
+        }
+
+        std::cout << std::left << std::setw(10) << thread_count
+                  << std::fixed << std::setprecision(3)
+                  << std::setw(12) << 1e3 * seconds
+                  << std::setw(10) << single_thread_seconds / seconds
+                  << std::setw(10) << steals / repeat_count
+                  << (results == serial_results ? "yes" : "NO") << "\n";
+    }
+}
+
+
+// Runs the narrow phase over one frame's candidate pairs, with and without testing the bounding
+// spheres and oriented boxes of each pair before GJK
+void bench_bounds_rejection(const std::vector<NamedMesh>& meshes, std::size_t object_count, std::size_t repeat_count)
+{
+    std::mt19937 rng(475);
+    Scene scene(object_count, meshes.size(), Layout::Uniform, rng);
+
+    std::vector<Aabb> local_bounds;
+    std::vector<BoundingSphere> spheres;
+    for (const NamedMesh& mesh : meshes)
+    {
+        local_bounds.push_back(compute_bounds(mesh.vertices));
+        spheres.push_back(compute_bounding_sphere(mesh.vertices));
+    }
+
+    std::vector<Aabb> boxes;
+    for (const MovingObject& object : scene.objects)
+    {
+        boxes.push_back(world_bounds(local_bounds[object.instance.mesh_id], object.instance));
+    }
+    SweepAndPrune sweep_and_prune;
+    sweep_and_prune.update(boxes);
+    const auto& pairs = sweep_and_prune.pairs();
+
+    std::size_t sphere_rejections = 0;
+    std::size_t box_rejections = 0;
+    auto bounded_narrow_phase = [&](std::uint32_t i, std::uint32_t j) {
+        const ConvexHullInstance& a = scene.objects[i].instance;
+        const ConvexHullInstance& b = scene.objects[j].instance;
+        if (!overlap(spheres[a.mesh_id], a, spheres[b.mesh_id], b))
+        {
+            ++sphere_rejections;
+            return false;
+        }
+        if (!overlap(local_bounds[a.mesh_id], a, local_bounds[b.mesh_id], b))
+        {
+            ++box_rejections;
+            return false;
+        }
+        return narrow_phase(scene, meshes, i, j);
+    };
+
+    std::vector<char> results(pairs.size());
+    std::vector<char> bounded_results(pairs.size());
+    for (std::size_t k = 0; k < pairs.size(); ++k)
+    {
+        results[k] = narrow_phase(scene, meshes, pairs[k].first, pairs[k].second);
+        bounded_results[k] = bounded_narrow_phase(pairs[k].first, pairs[k].second);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t repeat = 0; repeat < repeat_count; ++repeat)
+    {
+        for (std::size_t k = 0; k < pairs.size(); ++k)
+        {
+            results[k] = narrow_phase(scene, meshes, pairs[k].first, pairs[k].second);
+        }
+    }
+    double gjk_seconds = seconds_since(start) / static_cast<double>(repeat_count);
+
+    start = std::chrono::steady_clock::now();
+    for (std::size_t repeat = 0; repeat < repeat_count; ++repeat)
+    {
+        for (std::size_t k = 0; k < pairs.size(); ++k)
+        {
+            bounded_results[k] = bounded_narrow_phase(pairs[k].first, pairs[k].second);
+        }
+    }
+    double bounded_seconds = seconds_since(start) / static_cast<double>(repeat_count);
+
+    double pair_count = static_cast<double>(pairs.size());
+    std::cout << "\nBounding volume tests before GJK on " << pairs.size() << " pairs of " << object_count
+              << " objects, per frame averages (times in ms)\n";
+    std::cout << std::fixed << std::setprecision(1)
+              << "Rejected by spheres: " << 100.0 * sphere_rejections / (repeat_count + 1) / pair_count << "%, "
+              << "by oriented boxes: " << 100.0 * box_rejections / (repeat_count + 1) / pair_count << "%\n";
+    std::cout << std::setprecision(3)
+              << "GJK only: " << 1e3 * gjk_seconds << ", with bounds tests: " << 1e3 * bounded_seconds
+              << ", speedup " << gjk_seconds / bounded_seconds << "\n";
+    std::cout << "Agree: " << (results == bounded_results ? "yes" : "NO") << "\n";
+}
+
+
+// Casts random rays through a static scene, finding the first object each one hits, with the
+// tree against testing the bounds of every object and casting against those the ray hits
+void bench_ray_cast(const std::vector<NamedMesh>& meshes, std::size_t object_count, std::size_t ray_count)
+{
+    std::mt19937 rng(475);
+    Scene scene(object_count, meshes.size(), Layout::Uniform, rng);
+
+    std::vector<Aabb> local_bounds;
+    for (const NamedMesh& mesh : meshes)
+    {
+        local_bounds.push_back(compute_bounds(mesh.vertices));
+    }
+    std::vector<Aabb> boxes;
+    AabbTree tree;
+    for (std::uint32_t i = 0; i < object_count; ++i)
+    {
+        const ConvexHullInstance& instance = scene.objects[i].instance;
+        boxes.push_back(world_bounds(local_bounds[instance.mesh_id], instance));
+        tree.insert(boxes.back(), i);
+    }
+
+    // Rays start anywhere in the scene, and cross as far as its width in a random direction
+    std::vector<std::pair<Vec3, Vec3>> rays;
+    for (std::size_t i = 0; i < ray_count; ++i)
+    {
+        Vec3 direction = random_position(rng, 1.0f);
+        direction.normalize();
+        rays.emplace_back(random_position(rng, scene.half_width), 2.0f * scene.half_width * direction);
+    }
+
+    auto cast = [&](const Vec3& origin, const Vec3& direction, std::uint32_t object, float max_t) {
+        const ConvexHullInstance& instance = scene.objects[object].instance;
+        const auto& vertices = meshes[instance.mesh_id].vertices;
+        return geometry::ray_cast_gjk<Vec3>(
+            [&](const Vec3& d) { return general_support(d, instance, vertices); },
+            origin, direction, max_t);
+    };
+
+    std::vector<AabbTree::RayHit> tree_hits(ray_count);
+    std::size_t tree_casts = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < ray_count; ++i)
+    {
+        const auto& [origin, direction] = rays[i];
+        tree_hits[i] = tree.first_hit(origin, direction, 1.0f, [&](std::uint32_t object, float max_t) {
+            ++tree_casts;
+            return cast(origin, direction, object, max_t);
+        });
+    }
+    double tree_seconds = seconds_since(start);
+
+    std::vector<AabbTree::RayHit> scan_hits(ray_count);
+    std::size_t scan_casts = 0;
+    start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < ray_count; ++i)
+    {
+        const auto& [origin, direction] = rays[i];
+        Vec3 inverse_direction(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+        AabbTree::RayHit& hit = scan_hits[i];
+        float max_t = 1.0f;
+        for (std::uint32_t object = 0; object < object_count; ++object)
+        {
+            float t_enter;
+            if (!intersect_ray(boxes[object], origin, inverse_direction, max_t, t_enter))
+            {
+                continue;
+            }
+            ++scan_casts;
+            geometry::GjkRayHit<Vec3> object_hit = cast(origin, direction, object, max_t);
+            if (object_hit.hit)
+            {
+                hit = {object, object_hit.fraction, object_hit.normal, true};
+                max_t = object_hit.fraction;
+            }
+        }
+    }
+    double scan_seconds = seconds_since(start);
+
+    std::size_t hits = 0;
+    bool agree = true;
+    for (std::size_t i = 0; i < ray_count; ++i)
+    {
+        hits += tree_hits[i].hit;
+        agree &= tree_hits[i].hit == scan_hits[i].hit
+            && (!tree_hits[i].hit || std::abs(tree_hits[i].fraction - scan_hits[i].fraction) < 1e-5f);
+    }
+
+    double count = static_cast<double>(ray_count);
+    std::cout << std::left << std::setw(10) << object_count
+              << std::setw(8) << std::fixed << std::setprecision(1) << 100.0 * hits / count
+              << std::setw(12) << tree_casts / count
+              << std::setw(14) << std::setprecision(0) << count / tree_seconds
+              << std::setw(12) << std::setprecision(1) << scan_casts / count
+              << std::setw(14) << std::setprecision(0) << count / scan_seconds
+              << std::setw(10) << std::setprecision(1) << scan_seconds / tree_seconds
+              << (agree ? "yes" : "NO") << "\n";
+}
+
+}
+
+int main(int argc, char** args)
+{
+    const char* mesh_directory = argc > 1 ? args[1] : "demo_meshes";
+
+    std::vector<NamedMesh> meshes = load_mesh_directory(mesh_directory);
+    if (meshes.empty())
+    {
+        std::cerr << "usage: bench_broad_phase [mesh_directory]\n";
+        return 1;
+    }
+
+    std::cout << "Broad phase, per frame averages (times in ms)\n";
+    std::cout << "Updates are endpoint swaps for sweep and prune, and reinsertions for the tree\n";
+    std::cout << std::left << std::setw(11) << "Layout"
+              << std::setw(7) << "Method"
+              << std::setw(10) << "Objects"
+              << std::setw(14) << "Pairs tested"
+              << std::setw(14) << "Intersecting"
+              << std::setw(12) << "Updates"
+              << std::setw(12) << "Bounds"
+              << std::setw(12) << "Broad"
+              << std::setw(12) << "GJK"
+              << std::setw(12) << "Total"
+              << std::setw(14) << "All pairs"
+              << "Agree\n";
+
+    for (Layout layout : {Layout::Uniform, Layout::Clustered})
+    {
+        for (Method method : {Method::SweepAndPrune, Method::Tree})
+        {
+            bench_scene(meshes, layout, method, 1000, 20, true);
+            bench_scene(meshes, layout, method, 10000, 20, false);
+            bench_scene(meshes, layout, method, 100000, 10, false);
+        }
+    }
+
+    bench_threads(meshes, 10000, 10);
+    bench_bounds_rejection(meshes, 10000, 10);
+
+    std::cout << "\nFirst hit of random rays crossing a static scene, with ray_cast_gjk on each object\n";
+    std::cout << "Casts are GJK ray casts per ray, for the tree and for scanning every object's bounds\n";
+    std::cout << std::left << std::setw(10) << "Objects"
+              << std::setw(8) << "Hit %"
+              << std::setw(12) << "Tree casts"
+              << std::setw(14) << "Tree rays/s"
+              << std::setw(12) << "Scan casts"
+              << std::setw(14) << "Scan rays/s"
+              << std::setw(10) << "Speedup"
+              << "Agree\n";
+    bench_ray_cast(meshes, 1000, 2000);
+    bench_ray_cast(meshes, 10000, 1000);
+    bench_ray_cast(meshes, 100000, 200);
+
+    return 0;
+}
@@ -0,0 +1,1348 @@
+#include "gjk.hpp"
+#include "epa.hpp"
+#include "gjk_batch.hpp"
+#include "mpr.hpp"
+#include "math.hpp"
+#include "convex_hull.hpp"
+#include "shapes.hpp"
+#include "toi.hpp"
+#include "benchmark.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <iomanip>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace demo::math;
+using namespace demo::bench;
+
+namespace {
+
+// Number of random relative poses tested for each pair of meshes
+constexpr std::size_t poses_per_pair = 256;
+
+struct PosedPair
+{
+    ConvexHullInstance a;
+    ConvexHullInstance b;
+};
+
+std::vector<PosedPair> make_poses(std::mt19937& rng)
+{
+    std::vector<PosedPair> poses;
+    for (std::size_t i = 0; i < poses_per_pair; ++i)
+    {
+        // Objects are roughly unit sized, so a 1.5 half-width gives a mix of hits and misses
+        poses.push_back({
+            ConvexHullInstance(Vec3(), random_orientation(rng), 0),
+            ConvexHullInstance(random_position(rng, 1.5f), random_orientation(rng), 1)});
+    }
+    return poses;
+}
+
+// Compares the templated intersect_gjk overload against the std::function adapter.
+void bench_support_interface(const std::vector<NamedMesh>& meshes)
+{
+    std::mt19937 rng(475);
+    const std::vector<PosedPair> poses = make_poses(rng);
+
+    std::cout << "intersect_gjk: templated support vs std::function support (ns per query)\n";
+    std::cout << std::left << std::setw(34) << "Pair"
+              << std::setw(10) << "Hits"
+              << std::setw(12) << "Template"
+              << std::setw(16) << "std::function"
+              << std::setw(10) << "Speedup"
+              << "Agree\n";
+
+    for (std::size_t m1 = 0; m1 < meshes.size(); ++m1)
+    {
+        for (std::size_t m2 = m1; m2 < meshes.size(); ++m2)
+        {
+            const auto& vertices1 = meshes[m1].vertices;
+            const auto& vertices2 = meshes[m2].vertices;
+
+            std::size_t template_hits = 0;
+            std::size_t function_hits = 0;
+
+            auto run_template = [&] {
+                template_hits = 0;
+                for (const PosedPair& pose : poses)
+                {
+                    template_hits += geometry::intersect_gjk<Vec3>(
+                        [&](const Vec3& d) { return general_support(d, pose.a, vertices1); },
+                        [&](const Vec3& d) { return general_support(d, pose.b, vertices2); });
+                }
+                keep(template_hits);
+            };
+
+            auto run_function = [&] {
+                function_hits = 0;
+                for (const PosedPair& pose : poses)
+                {
+                    function_hits += geometry::intersect_gjk<Vec3>(
+                        std::function<Vec3(const Vec3&)>([&](const Vec3& d) { return general_support(d, pose.a, vertices1); }),
+                        std::function<Vec3(const Vec3&)>([&](const Vec3& d) { return general_support(d, pose.b, vertices2); }));
+                }
+                keep(function_hits);
+            };
+
+            double template_ns = 1e9 * seconds_per_call(run_template) / poses.size();
+            double function_ns = 1e9 * seconds_per_call(run_function) / poses.size();
+
+            std::cout << std::left << std::setw(34) << (meshes[m1].filename + " / " + meshes[m2].filename)
+                      << std::setw(10) << template_hits
+                      << std::setw(12) << std::fixed << std::setprecision(1) << template_ns
+                      << std::setw(16) << function_ns
+                      << std::setw(10) << std::setprecision(2) << function_ns / template_ns
+                      << (template_hits == function_hits ? "yes" : "NO") << "\n";
+        }
+    }
+}
+
+// Measures distance_gjk, and checks that it agrees with intersect_gjk about which pairs intersect.
+void bench_distance(const std::vector<NamedMesh>& meshes)
+{
+    std::mt19937 rng(475);
+    const std::vector<PosedPair> poses = make_poses(rng);
+
+    std::cout << "distance_gjk (ns per query)\n";
+    std::cout << std::left << std::setw(34) << "Pair"
+              << std::setw(10) << "Hits"
+              << std::setw(16) << "intersect_gjk"
+              << std::setw(16) << "distance_gjk"
+              << std::setw(12) << "Iterations"
+              << "Agree\n";
+
+    for (std::size_t m1 = 0; m1 < meshes.size(); ++m1)
+    {
+        for (std::size_t m2 = m1; m2 < meshes.size(); ++m2)
+        {
+            const auto& vertices1 = meshes[m1].vertices;
+            const auto& vertices2 = meshes[m2].vertices;
+
+            std::size_t hits = 0;
+            std::size_t disagreements = 0;
+            std::size_t total_iterations = 0;
+            for (const PosedPair& pose : poses)
+            {
+                auto support1 = [&](const Vec3& d) { return general_support(d, pose.a, vertices1); };
+                auto support2 = [&](const Vec3& d) { return general_support(d, pose.b, vertices2); };
+
+                geometry::GjkStats stats;
+                bool intersection = geometry::intersect_gjk<Vec3>(support1, support2);
+                auto distance = geometry::distance_gjk<Vec3>(support1, support2, geometry::default_relative_tolerance<float>(), 100, &stats);
+
+                hits += intersection;
+                total_iterations += stats.iteration_count;
+
+                // Pairs which are touching to within rounding may legitimately disagree
+                disagreements += intersection != distance.intersecting && distance.distance > 1e-4f;
+            }
+
+            auto run_intersect = [&] {
+                for (const PosedPair& pose : poses)
+                {
+                    keep(geometry::intersect_gjk<Vec3>(
+                        [&](const Vec3& d) { return general_support(d, pose.a, vertices1); },
+                        [&](const Vec3& d) { return general_support(d, pose.b, vertices2); }));
+                }
+            };
+
+            auto run_distance = [&] {
+                for (const PosedPair& pose : poses)
+                {
+                    keep(geometry::distance_gjk<Vec3>(
+                        [&](const Vec3& d) { return general_support(d, pose.a, vertices1); },
+                        [&](const Vec3& d) { return general_support(d, pose.b, vertices2); }).distance);
+                }
+            };
+
+            double intersect_ns = 1e9 * seconds_per_call(run_intersect) / poses.size();
+            double distance_ns = 1e9 * seconds_per_call(run_distance) / poses.size();
+
+            std::cout << std::left << std::setw(34) << (meshes[m1].filename + " / " + meshes[m2].filename)
+                      << std::setw(10) << hits
+                      << std::setw(16) << std::fixed << std::setprecision(1) << intersect_ns
+                      << std::setw(16) << distance_ns
+                      << std::setw(12) << std::setprecision(2) << double(total_iterations) / poses.size()
+                      << (disagreements == 0 ? "yes" : "NO") << "\n";
+        }
+    }
+}
+
+// Measures the cost of penetration_epa on top of intersect_gjk for intersecting pairs. Each
+// result is checked by moving the second shape along the normal by slightly less and slightly
+// more than the depth, which should leave the shapes intersecting and separated respectively.
+void bench_penetration(const std::vector<NamedMesh>& meshes)
+{
+    std::mt19937 rng(475);
+    const std::vector<PosedPair> poses = make_poses(rng);
+
+    // Meshes are roughly unit sized and stored as floats
+    const float check_margin = 1e-3f;
+
+    std::cout << "penetration_epa (ns per intersecting query)\n";
+    std::cout << std::left << std::setw(34) << "Pair"
+              << std::setw(10) << "Hits"
+              << std::setw(16) << "intersect_gjk"
+              << std::setw(16) << "gjk + epa"
+              << std::setw(12) << "Iterations"
+              << std::setw(12) << "Converged"
+              << "Valid\n";
+
+    for (std::size_t m1 = 0; m1 < meshes.size(); ++m1)
+    {
+        for (std::size_t m2 = m1; m2 < meshes.size(); ++m2)
+        {
+            const auto& vertices1 = meshes[m1].vertices;
+            const auto& vertices2 = meshes[m2].vertices;
+
+            std::vector<PosedPair> hits;
+            std::size_t total_iterations = 0;
+            std::size_t converged = 0;
+            std::size_t valid = 0;
+            for (const PosedPair& pose : poses)
+            {
+                auto support1 = [&](const Vec3& d) { return general_support(d, pose.a, vertices1); };
+                auto support2 = [&](const Vec3& d) { return general_support(d, pose.b, vertices2); };
+
+                geometry::EpaResult<Vec3> result;
+                geometry::GjkStats stats;
+                if (!geometry::penetration_gjk_epa<Vec3>(support1, support2, result, nullptr, &stats))
+                {
+                    continue;
+                }
+                hits.push_back(pose);
+                total_iterations += stats.iteration_count;
+                converged += result.converged;
+
+                auto moved_support = [&](float distance) {
+                    ConvexHullInstance moved = pose.b;
+                    moved.position = moved.position + distance * result.normal;
+                    return [&vertices2, moved](const Vec3& d) { return general_support(d, moved, vertices2); };
+                };
+                valid += geometry::intersect_gjk<Vec3>(support1, moved_support(result.depth - check_margin))
+                    && !geometry::intersect_gjk<Vec3>(support1, moved_support(result.depth + check_margin));
+            }
+
+            if (hits.empty())
+            {
+                continue;
+            }
+
+            auto run_intersect = [&] {
+                for (const PosedPair& pose : hits)
+                {
+                    keep(geometry::intersect_gjk<Vec3>(
+                        [&](const Vec3& d) { return general_support(d, pose.a, vertices1); },
+                        [&](const Vec3& d) { return general_support(d, pose.b, vertices2); }));
+                }
+            };
+
+            auto run_penetration = [&] {
+                for (const PosedPair& pose : hits)
+                {
+                    geometry::EpaResult<Vec3> result;
+                    geometry::penetration_gjk_epa<Vec3>(
+                        [&](const Vec3& d) { return general_support(d, pose.a, vertices1); },
+                        [&](const Vec3& d) { return general_support(d, pose.b, vertices2); },
+                        result);
+                    keep(result.depth);
+                }
+            };
+
+            double intersect_ns = 1e9 * seconds_per_call(run_intersect) / hits.size();
+            double penetration_ns = 1e9 * seconds_per_call(run_penetration) / hits.size();
+
+            std::cout << std::left << std::setw(34) << (meshes[m1].filename + " / " + meshes[m2].filename)
+                      << std::setw(10) << hits.size()
+                      << std::setw(16) << std::fixed << std::setprecision(1) << intersect_ns
+                      << std::setw(16) << penetration_ns
+                      << std::setw(12) << std::setprecision(2) << double(total_iterations) / hits.size()
+                      << std::setw(12) << converged
+                      << valid << "/" << hits.size() << "\n";
+        }
+    }
+}
+
+// A scene of objects drifting and tumbling slowly, as in the demo. Every pair is tested in
+// every frame, once from scratch and once starting from the direction cached for the pair
+// in the previous frame.
+// A few slowly moving objects in a box, like a scene in the demo. The poses of every frame
+// are precomputed so that only collision detection is timed.
+struct MovingScene
+{
+    static constexpr std::size_t object_count = 24;
+    static constexpr std::size_t frame_count = 240;
+    static constexpr std::size_t pair_count = object_count * (object_count - 1) / 2;
+
+    // The mesh of each object
+    std::vector<std::size_t> object_meshes;
+
+    // The pose of each object in each frame
+    std::vector<std::vector<ConvexHullInstance>> frames;
+};
+
+MovingScene make_moving_scene(const std::vector<NamedMesh>& meshes)
+{
+    constexpr float half_width = 3.0f;
+
+    std::mt19937 rng(475);
+    std::uniform_int_distribution<std::size_t> mesh_distribution(0, meshes.size() - 1);
+
+    struct MovingObject
+    {
+        ConvexHullInstance instance;
+        Vec3 velocity;
+        Vec3 angular_velocity;
+    };
+
+    MovingScene scene;
+    std::vector<MovingObject> objects;
+    for (std::size_t i = 0; i < MovingScene::object_count; ++i)
+    {
+        // At 60 frames per second, about half a unit and half a radian per second
+        objects.push_back({
+            ConvexHullInstance(random_position(rng, half_width), random_orientation(rng), 0),
+            random_position(rng, 0.01f),
+            random_position(rng, 0.01f)});
+        scene.object_meshes.push_back(mesh_distribution(rng));
+    }
+
+    scene.frames.resize(MovingScene::frame_count);
+    for (auto& frame : scene.frames)
+    {
+        for (MovingObject& object : objects)
+        {
+            frame.push_back(object.instance);
+
+            object.instance.position += object.velocity;
+            object.instance.orientation = Mat3::AxisAngle(object.angular_velocity) * object.instance.orientation;
+
+            // Bounce off the walls of the box
+            float* position[3] = {&object.instance.position.x, &object.instance.position.y, &object.instance.position.z};
+            float* velocity[3] = {&object.velocity.x, &object.velocity.y, &object.velocity.z};
+            for (std::size_t k = 0; k < 3; ++k)
+            {
+                if (std::abs(*position[k]) > half_width)
+                {
+                    *velocity[k] = -*velocity[k];
+                }
+            }
+        }
+    }
+
+    return scene;
+}
+
+// Compares GJK started from scratch against GJK started from each pair's cached direction
+void bench_warm_start(const std::vector<NamedMesh>& meshes)
+{
+    const MovingScene scene = make_moving_scene(meshes);
+    const auto& frames = scene.frames;
+    constexpr std::size_t object_count = MovingScene::object_count;
+    constexpr std::size_t frame_count = MovingScene::frame_count;
+    constexpr std::size_t pair_count = MovingScene::pair_count;
+
+    std::vector<geometry::GjkCache<Vec3>> caches(pair_count);
+
+    // Runs every frame, returning the number of intersections found
+    auto run_scene = [&](bool warm, std::size_t* iterations, std::size_t* cache_hits, std::size_t* warm_starts) {
+        std::fill(caches.begin(), caches.end(), geometry::GjkCache<Vec3>());
+        std::size_t hits = 0;
+        for (const auto& frame : frames)
+        {
+            std::size_t pair = 0;
+            for (std::size_t i = 0; i < object_count; ++i)
+            {
+                for (std::size_t j = i + 1; j < object_count; ++j, ++pair)
+                {
+                    const auto& vertices1 = meshes[scene.object_meshes[i]].vertices;
+                    const auto& vertices2 = meshes[scene.object_meshes[j]].vertices;
+                    auto support1 = [&](const Vec3& d) { return general_support(d, frame[i], vertices1); };
+                    auto support2 = [&](const Vec3& d) { return general_support(d, frame[j], vertices2); };
+
+                    geometry::GjkStats stats;
+                    if (warm)
+                    {
+                        hits += geometry::intersect_gjk<Vec3>(support1, support2, caches[pair], 100, &stats);
+                    }
+                    else
+                    {
+                        hits += geometry::intersect_gjk<Vec3>(support1, support2, 100, &stats);
+                    }
+
+                    if (iterations)
+                    {
+                        *iterations += stats.iteration_count;
+                        *cache_hits += stats.cache_hit;
+                        *warm_starts += stats.warm_started;
+                    }
+                }
+            }
+        }
+        return hits;
+    };
+
+    std::size_t queries = frame_count * pair_count;
+    std::size_t cold_iterations = 0;
+    std::size_t warm_iterations = 0;
+    std::size_t cache_hits = 0;
+    std::size_t warm_starts = 0;
+    std::size_t unused = 0;
+    std::size_t cold_hits = run_scene(false, &cold_iterations, &unused, &unused);
+    std::size_t warm_hits = run_scene(true, &warm_iterations, &cache_hits, &warm_starts);
+
+    double cold_ns = 1e9 * seconds_per_call([&] { keep(run_scene(false, nullptr, nullptr, nullptr)); }) / queries;
+    double warm_ns = 1e9 * seconds_per_call([&] { keep(run_scene(true, nullptr, nullptr, nullptr)); }) / queries;
+
+    std::cout << "intersect_gjk warm start: " << object_count << " slowly moving objects, "
+              << frame_count << " frames, " << queries << " queries, "
+              << cold_hits << " intersecting\n";
+    std::cout << std::left << std::setw(12) << "Start"
+              << std::setw(12) << "ns/query"
+              << std::setw(12) << "Iterations"
+              << "Cache hits\n";
+    std::cout << std::left << std::setw(12) << "cold"
+              << std::setw(12) << std::fixed << std::setprecision(1) << cold_ns
+              << std::setw(12) << std::setprecision(3) << double(cold_iterations) / queries
+              << "-\n";
+    std::cout << std::left << std::setw(12) << "warm"
+              << std::setw(12) << std::setprecision(1) << warm_ns
+              << std::setw(12) << std::setprecision(3) << double(warm_iterations) / queries
+              << std::setprecision(1) << 100.0 * cache_hits / warm_starts << "% of " << warm_starts << "\n";
+    std::cout << "Agree: " << (cold_hits == warm_hits ? "yes" : "NO") << "\n";
+}
+
+// A policy without the progress test, so that queries only stop at the iteration limit
+struct NoProgressTest
+{
+    using Real = float;
+    static constexpr Real relative_tolerance = -std::numeric_limits<Real>::infinity();
+    static constexpr Real absolute_tolerance = 0.0f;
+};
+
+// Pairs moved into contact along the direction between their closest points, then pushed
+// together or apart by a random amount of up to offset. These are the queries which rounding
+// error makes hard, so this compares how the precision policies cope with them.
+void bench_near_contact(const std::vector<NamedMesh>& meshes)
+{
+    constexpr std::size_t max_iterations = 100;
+
+    std::cout << "intersect_gjk near contact: " << poses_per_pair << " poses of each pair of meshes\n";
+    std::cout << std::left << std::setw(10) << "Offset"
+              << std::setw(16) << "Policy"
+              << std::setw(12) << "ns/query"
+              << std::setw(12) << "Iterations"
+              << std::setw(16) << "Not converged"
+              << "Repeated\n";
+
+    for (float offset : {1e-3f, 1e-5f, 1e-6f})
+    {
+        std::mt19937 rng(17);
+        std::vector<PosedPair> poses;
+        std::vector<std::pair<std::size_t, std::size_t>> pose_meshes;
+        for (std::size_t m1 = 0; m1 < meshes.size(); ++m1)
+        {
+            for (std::size_t m2 = m1; m2 < meshes.size(); ++m2)
+            {
+                for (PosedPair pose : make_poses(rng))
+                {
+                    auto support1 = [&](const Vec3& d) { return general_support(d, pose.a, meshes[m1].vertices); };
+                    auto support2 = [&](const Vec3& d) { return general_support(d, pose.b, meshes[m2].vertices); };
+                    auto result = geometry::distance_gjk<Vec3>(support1, support2);
+                    if (result.intersecting)
+                    {
+                        continue;
+                    }
+
+                    Vec3 normal = result.point2 - result.point1;
+                    normal.normalize();
+                    float push = std::uniform_real_distribution<float>(-offset, offset)(rng);
+                    pose.b.position -= (result.distance + push) * normal;
+                    poses.push_back(pose);
+                    pose_meshes.emplace_back(m1, m2);
+                }
+            }
+        }
+
+        // Runs every pose with query, adding up the stats
+        auto run_poses = [&](const auto& query, geometry::GjkStats* totals, std::size_t* not_converged, std::size_t* repeated) {
+            std::size_t hits = 0;
+            for (std::size_t i = 0; i < poses.size(); ++i)
+            {
+                const auto& vertices1 = meshes[pose_meshes[i].first].vertices;
+                const auto& vertices2 = meshes[pose_meshes[i].second].vertices;
+                const PosedPair& pose = poses[i];
+                auto support1 = [&](const Vec3& d) { return general_support(d, pose.a, vertices1); };
+                auto support2 = [&](const Vec3& d) { return general_support(d, pose.b, vertices2); };
+
+                geometry::GjkStats stats;
+                hits += query(support1, support2, stats);
+                if (totals)
+                {
+                    totals->iteration_count += stats.iteration_count;
+                    *not_converged += !stats.converged;
+                    *repeated += stats.precision_fallback;
+                }
+            }
+            return hits;
+        };
+
+        auto report = [&](const char* name, const auto& query) {
+            geometry::GjkStats totals;
+            totals.iteration_count = 0;
+            std::size_t not_converged = 0;
+            std::size_t repeated = 0;
+            run_poses(query, &totals, &not_converged, &repeated);
+            double ns = 1e9 * seconds_per_call([&] { keep(run_poses(query, nullptr, nullptr, nullptr)); }) / poses.size();
+
+            std::cout << std::left << std::setw(10) << std::scientific << std::setprecision(0) << offset
+                      << std::setw(16) << name
+                      << std::setw(12) << std::fixed << std::setprecision(1) << ns
+                      << std::setw(12) << std::setprecision(3) << double(totals.iteration_count) / poses.size()
+                      << std::setw(16) << not_converged
+                      << std::setprecision(2) << 100.0 * repeated / poses.size() << "%\n";
+        };
+
+        report("float, no test", [&](const auto& support1, const auto& support2, geometry::GjkStats& stats) {
+            return geometry::intersect_gjk<Vec3, NoProgressTest>(support1, support2, max_iterations, &stats);
+        });
+        report("float", [&](const auto& support1, const auto& support2, geometry::GjkStats& stats) {
+            return geometry::intersect_gjk<Vec3>(support1, support2, max_iterations, &stats);
+        });
+        report("double", [&](const auto& support1, const auto& support2, geometry::GjkStats& stats) {
+            return geometry::intersect_gjk<Vec3, geometry::GjkPolicy<double>>(support1, support2, max_iterations, &stats);
+        });
+        report("mixed", [&](const auto& support1, const auto& support2, geometry::GjkStats& stats) {
+            geometry::GjkCache<Vec3> cache;
+            return geometry::intersect_gjk_mixed<Vec3>(support1, support2, cache, max_iterations, &stats);
+        });
+    }
+}
+
+#if defined(__SSE2__)
+// The vertex scan of general_support, for any vector and matrix types
+template <class V, class M>
+V scan_support(const V& dir, const V& position, const M& orientation, const std::vector<V>& vertices)
+{
+    V local_dir = orientation.transpose() * dir;
+
+    float max_dot = -std::numeric_limits<float>::infinity();
+    std::size_t max_dot_index = 0;
+    for (std::size_t i = 0; i < vertices.size(); ++i)
+    {
+        float vertex_dot = dot(local_dir, vertices[i]);
+        if (vertex_dot > max_dot)
+        {
+            max_dot = vertex_dot;
+            max_dot_index = i;
+        }
+    }
+
+    return position + orientation * vertices[max_dot_index];
+}
+
+// Runs the demo's collision loop, warm started GJK on every pair of objects in every frame, with
+// V and M as the vector and matrix types of the vertices, the poses and GJK itself. Returns the
+// average time per frame in seconds, and sets the result of every query in intersections.
+template <class V, class M>
+double run_collision_loop(const std::vector<NamedMesh>& meshes, const MovingScene& scene, std::vector<char>& intersections)
+{
+    std::vector<std::vector<V>> vertices;
+    for (const NamedMesh& mesh : meshes)
+    {
+        vertices.emplace_back();
+        for (const Vec3& v : mesh.vertices)
+        {
+            vertices.back().push_back(V(v));
+        }
+    }
+
+    struct Pose
+    {
+        V position;
+        M orientation;
+    };
+
+    std::vector<std::vector<Pose>> frames;
+    for (const auto& frame : scene.frames)
+    {
+        frames.emplace_back();
+        for (const ConvexHullInstance& instance : frame)
+        {
+            frames.back().push_back({V(instance.position), M(instance.orientation)});
+        }
+    }
+
+    std::vector<geometry::GjkCache<V>> caches(MovingScene::pair_count);
+    auto run_scene = [&] {
+        std::fill(caches.begin(), caches.end(), geometry::GjkCache<V>());
+        std::size_t query = 0;
+        for (const auto& frame : frames)
+        {
+            std::size_t pair = 0;
+            for (std::size_t i = 0; i < MovingScene::object_count; ++i)
+            {
+                for (std::size_t j = i + 1; j < MovingScene::object_count; ++j, ++pair, ++query)
+                {
+                    const auto& vertices1 = vertices[scene.object_meshes[i]];
+                    const auto& vertices2 = vertices[scene.object_meshes[j]];
+                    const Pose& a = frame[i];
+                    const Pose& b = frame[j];
+                    intersections[query] = geometry::intersect_gjk<V>(
+                        [&](const V& d) { return scan_support(d, a.position, a.orientation, vertices1); },
+                        [&](const V& d) { return scan_support(d, b.position, b.orientation, vertices2); },
+                        caches[pair]);
+                }
+            }
+        }
+    };
+
+    intersections.resize(MovingScene::frame_count * MovingScene::pair_count);
+    return seconds_per_call(run_scene) / MovingScene::frame_count;
+}
+
+// Compares the collision loop with the scalar Vec3 and Mat3 against the SSE Vec3A and Mat3A
+void bench_vector_types(const std::vector<NamedMesh>& meshes)
+{
+    const MovingScene scene = make_moving_scene(meshes);
+
+    std::vector<char> scalar_intersections, simd_intersections;
+    double scalar_seconds = run_collision_loop<Vec3, Mat3>(meshes, scene, scalar_intersections);
+    double simd_seconds = run_collision_loop<Vec3A, Mat3A>(meshes, scene, simd_intersections);
+
+    std::size_t hits = 0;
+    for (char hit : scalar_intersections)
+    {
+        hits += hit;
+    }
+
+    std::cout << "Collision loop: " << MovingScene::object_count << " slowly moving objects, "
+              << MovingScene::pair_count << " pairs per frame, " << hits / MovingScene::frame_count
+              << " intersecting on average (ms per frame)\n";
+    std::cout << std::left << std::setw(14) << "Types"
+              << std::setw(12) << "ms/frame"
+              << "Speedup\n";
+    std::cout << std::left << std::setw(14) << "Vec3/Mat3"
+              << std::setw(12) << std::fixed << std::setprecision(3) << 1e3 * scalar_seconds
+              << "-\n";
+    std::cout << std::left << std::setw(14) << "Vec3A/Mat3A"
+              << std::setw(12) << 1e3 * simd_seconds
+              << std::setprecision(2) << scalar_seconds / simd_seconds << "\n";
+    std::cout << "Agree: " << (scalar_intersections == simd_intersections ? "yes" : "NO") << "\n";
+}
+#endif
+
+// A lane support mapping for intersect_gjk_batch, for pairs whose object (a or b) all have the
+// mesh vertices. The busy lanes are packed together and found with one call of batch_support.
+template <std::size_t Width>
+void lane_mesh_support(const std::vector<Vec3>& vertices,
+                       const std::vector<PosedPair>& poses,
+                       ConvexHullInstance PosedPair::* object,
+                       const std::size_t* pairs,
+                       const geometry::LaneVec3<float, Width>& d,
+                       geometry::LaneVec3<float, Width>& points)
+{
+    static_assert(Width <= 8, "batch_support finds at most 8 points at a time");
+
+    Vec3 dirs[Width];
+    const ConvexHullInstance* data[Width];
+    std::size_t lanes[Width];
+    std::size_t count = 0;
+    for (std::size_t lane = 0; lane < Width; ++lane)
+    {
+        if (pairs[lane] != geometry::gjk_batch_idle_lane)
+        {
+            dirs[count] = Vec3(d.x[lane], d.y[lane], d.z[lane]);
+            data[count] = &(poses[pairs[lane]].*object);
+            lanes[count] = lane;
+            ++count;
+        }
+    }
+
+    Vec3 found[Width];
+    batch_support(dirs, data, count, vertices, found);
+    for (std::size_t k = 0; k < count; ++k)
+    {
+        points.x[lanes[k]] = found[k].x;
+        points.y[lanes[k]] = found[k].y;
+        points.z[lanes[k]] = found[k].z;
+    }
+}
+
+// Compares intersect_gjk_batch at 4 and 8 lanes, with batch_support scanning each mesh for all
+// lanes at once, against calling intersect_gjk on each pair with general_support and with
+// simd_support.
+void bench_batch(const std::vector<NamedMesh>& meshes)
+{
+    std::mt19937 rng(475);
+    const std::vector<PosedPair> poses = make_poses(rng);
+
+    std::cout << "intersect_gjk_batch with batch_support (ns per query, default width " << geometry::default_gjk_batch_width << ")\n";
+    std::cout << std::left << std::setw(34) << "Pair"
+              << std::setw(10) << "Hits"
+              << std::setw(12) << "Scan"
+              << std::setw(12) << "SIMD scan"
+              << std::setw(12) << "4 lanes"
+              << std::setw(12) << "8 lanes"
+              << std::setw(10) << "Speedup"
+              << "Agree\n";
+
+    std::unique_ptr<bool[]> scalar_results(new bool[poses.size()]);
+    std::unique_ptr<bool[]> results(new bool[poses.size()]);
+    for (std::size_t m1 = 0; m1 < meshes.size(); ++m1)
+    {
+        for (std::size_t m2 = m1; m2 < meshes.size(); ++m2)
+        {
+            const auto& vertices1 = meshes[m1].vertices;
+            const auto& vertices2 = meshes[m2].vertices;
+            const SoaVertices soa1 = make_soa_vertices(vertices1);
+            const SoaVertices soa2 = make_soa_vertices(vertices2);
+
+            auto run_scalar = [&] {
+                for (std::size_t i = 0; i < poses.size(); ++i)
+                {
+                    scalar_results[i] = geometry::intersect_gjk<Vec3>(
+                        [&](const Vec3& d) { return general_support(d, poses[i].a, vertices1); },
+                        [&](const Vec3& d) { return general_support(d, poses[i].b, vertices2); });
+                }
+                keep(scalar_results[0]);
+            };
+
+            auto run_simd = [&] {
+                for (std::size_t i = 0; i < poses.size(); ++i)
+                {
+                    results[i] = geometry::intersect_gjk<Vec3>(
+                        [&](const Vec3& d) { return simd_support(d, poses[i].a, soa1); },
+                        [&](const Vec3& d) { return simd_support(d, poses[i].b, soa2); });
+                }
+                keep(results[0]);
+            };
+
+            auto support1 = [&](const std::size_t* pairs, const auto& d, auto& points) {
+                lane_mesh_support(vertices1, poses, &PosedPair::a, pairs, d, points);
+            };
+            auto support2 = [&](const std::size_t* pairs, const auto& d, auto& points) {
+                lane_mesh_support(vertices2, poses, &PosedPair::b, pairs, d, points);
+            };
+
+            auto run_batch4 = [&] {
+                geometry::intersect_gjk_batch<Vec3, 4>(poses.size(), support1, support2, results.get());
+                keep(results[0]);
+            };
+
+            auto run_batch8 = [&] {
+                geometry::intersect_gjk_batch<Vec3, 8>(poses.size(), support1, support2, results.get());
+                keep(results[0]);
+            };
+
+            bool agree = true;
+            auto compare = [&] {
+                for (std::size_t i = 0; i < poses.size(); ++i)
+                {
+                    agree &= results[i] == scalar_results[i];
+                }
+            };
+
+            double scalar_ns = 1e9 * seconds_per_call(run_scalar) / poses.size();
+            double simd_ns = 1e9 * seconds_per_call(run_simd) / poses.size();
+            compare();
+            double batch4_ns = 1e9 * seconds_per_call(run_batch4) / poses.size();
+            compare();
+            double batch8_ns = 1e9 * seconds_per_call(run_batch8) / poses.size();
+            compare();
+
+            std::size_t hits = 0;
+            for (std::size_t i = 0; i < poses.size(); ++i)
+            {
+                hits += scalar_results[i];
+            }
+
+            double best_ns = geometry::default_gjk_batch_width == 8 ? batch8_ns : batch4_ns;
+            std::cout << std::left << std::setw(34) << (meshes[m1].filename + " / " + meshes[m2].filename)
+                      << std::setw(10) << hits
+                      << std::setw(12) << std::fixed << std::setprecision(1) << scalar_ns
+                      << std::setw(12) << simd_ns
+                      << std::setw(12) << batch4_ns
+                      << std::setw(12) << batch8_ns
+                      << std::setw(10) << std::setprecision(2) << scalar_ns / best_ns
+                      << (agree ? "yes" : "NO") << "\n";
+        }
+    }
+}
+
+}
+
+// Compares GJK on meshes of a box, a cone and a sphere against the same shapes as primitives,
+// whose support mappings take constant time. The cone and sphere meshes only approximate the
+// primitives, so the number of hits may differ slightly.
+void bench_primitives(const std::vector<NamedMesh>& meshes)
+{
+    struct Comparison
+    {
+        std::string name;
+        std::vector<Vec3> vertices;
+        geometry::Primitive<Vec3> primitive;
+    };
+
+    std::vector<Comparison> comparisons;
+    for (const NamedMesh& mesh : meshes)
+    {
+        if (mesh.filename == "cube.off")
+        {
+            comparisons.push_back({mesh.filename, mesh.vertices, geometry::Box<Vec3>{Vec3(0.5f, 0.5f, 0.5f)}});
+        }
+        else if (mesh.filename == "cone.off")
+        {
+            comparisons.push_back({mesh.filename, mesh.vertices, geometry::Cone<Vec3>{1.0f, 1.0f}});
+        }
+    }
+    std::vector<std::uint32_t> indices;
+    for (unsigned int subdivisions : {2, 4})
+    {
+        Comparison sphere{"", {}, geometry::Sphere<Vec3>{1.0f}};
+        demo::mesh::make_icosphere(subdivisions, sphere.vertices, indices);
+        sphere.name = "sphere (" + std::to_string(sphere.vertices.size()) + " vertices)";
+        comparisons.push_back(std::move(sphere));
+    }
+
+    std::mt19937 rng(475);
+    const std::vector<PosedPair> poses = make_poses(rng);
+
+    std::cout << "intersect_gjk: mesh vs primitive of the same shape, paired with itself (ns per query)\n";
+    std::cout << std::left << std::setw(30) << "Shape"
+              << std::setw(12) << "Mesh hits"
+              << std::setw(12) << "Mesh"
+              << std::setw(16) << "Primitive hits"
+              << std::setw(12) << "Primitive"
+              << "Speedup\n";
+
+    for (const Comparison& c : comparisons)
+    {
+        std::size_t mesh_hits = 0;
+        std::size_t primitive_hits = 0;
+
+        auto run_mesh = [&] {
+            mesh_hits = 0;
+            for (const PosedPair& pose : poses)
+            {
+                mesh_hits += geometry::intersect_gjk<Vec3>(
+                    [&](const Vec3& d) { return general_support(d, pose.a, c.vertices); },
+                    [&](const Vec3& d) { return general_support(d, pose.b, c.vertices); });
+            }
+            keep(mesh_hits);
+        };
+
+        auto run_primitive = [&] {
+            primitive_hits = 0;
+            for (const PosedPair& pose : poses)
+            {
+                primitive_hits += geometry::intersect_gjk<Vec3>(
+                    [&](const Vec3& d) { return primitive_support(d, pose.a, c.primitive); },
+                    [&](const Vec3& d) { return primitive_support(d, pose.b, c.primitive); });
+            }
+            keep(primitive_hits);
+        };
+
+        double mesh_ns = 1e9 * seconds_per_call(run_mesh) / poses.size();
+        double primitive_ns = 1e9 * seconds_per_call(run_primitive) / poses.size();
+
+        std::cout << std::left << std::setw(30) << c.name
+                  << std::setw(12) << mesh_hits
+                  << std::setw(12) << std::fixed << std::setprecision(1) << mesh_ns
+                  << std::setw(16) << primitive_hits
+                  << std::setw(12) << primitive_ns
+                  << std::setprecision(2) << mesh_ns / primitive_ns << "\n";
+    }
+}
+
+// Moves pairs of rounded shapes into contact, give or take a small random offset, and compares
+// intersect_gjk on meshes of them, tessellated as in the demo, and on their exact support
+// mappings, against intersect_gjk_margins on their cores
+void bench_margins()
+{
+    constexpr std::size_t max_iterations = 100;
+
+    struct Shape
+    {
+        geometry::Primitive<Vec3> primitive;
+        std::vector<Vec3> vertices;
+    };
+    std::vector<Shape> shapes = {
+        {geometry::Sphere<Vec3>{0.5f}, {}},
+        {geometry::Capsule<Vec3>{0.5f, 0.25f}, {}},
+        {geometry::RoundedBox<Vec3>{Vec3(0.4f, 0.3f, 0.2f), 0.1f}, {}}};
+    std::vector<Vec3> directions;
+    std::vector<std::uint32_t> indices;
+    demo::mesh::make_icosphere(3, directions, indices);
+    for (Shape& shape : shapes)
+    {
+        for (const Vec3& d : directions)
+        {
+            shape.vertices.push_back(geometry::support(shape.primitive, d));
+        }
+    }
+
+    std::cout << "Rounded shapes near contact: spheres, capsules and rounded boxes, meshes with "
+              << directions.size() << " vertices\n";
+    std::cout << std::left << std::setw(10) << "Offset"
+              << std::setw(20) << "Method"
+              << std::setw(12) << "ns/query"
+              << std::setw(12) << "Iterations"
+              << std::setw(16) << "Not converged"
+              << "Hits\n";
+
+    for (float offset : {1e-3f, 1e-5f})
+    {
+        std::mt19937 rng(18);
+        std::vector<PosedPair> poses;
+        std::vector<std::pair<std::size_t, std::size_t>> pose_shapes;
+        for (std::size_t s1 = 0; s1 < shapes.size(); ++s1)
+        {
+            for (std::size_t s2 = s1; s2 < shapes.size(); ++s2)
+            {
+                for (PosedPair pose : make_poses(rng))
+                {
+                    auto support1 = [&](const Vec3& d) { return primitive_support(d, pose.a, shapes[s1].primitive); };
+                    auto support2 = [&](const Vec3& d) { return primitive_support(d, pose.b, shapes[s2].primitive); };
+                    auto result = geometry::distance_gjk<Vec3>(support1, support2);
+                    if (result.intersecting)
+                    {
+                        continue;
+                    }
+
+                    Vec3 normal = result.point2 - result.point1;
+                    normal.normalize();
+                    float push = std::uniform_real_distribution<float>(-offset, offset)(rng);
+                    pose.b.position -= (result.distance + push) * normal;
+                    poses.push_back(pose);
+                    pose_shapes.emplace_back(s1, s2);
+                }
+            }
+        }
+
+        // Runs every pose with query, adding up the stats
+        auto run_poses = [&](const auto& query, geometry::GjkStats* totals, std::size_t* not_converged) {
+            std::size_t hits = 0;
+            for (std::size_t i = 0; i < poses.size(); ++i)
+            {
+                geometry::GjkStats stats;
+                hits += query(poses[i], shapes[pose_shapes[i].first], shapes[pose_shapes[i].second], stats);
+                if (totals)
+                {
+                    totals->iteration_count += stats.iteration_count;
+                    *not_converged += !stats.converged;
+                }
+            }
+            return hits;
+        };
+
+        auto report = [&](const char* name, const auto& query) {
+            geometry::GjkStats totals;
+            totals.iteration_count = 0;
+            std::size_t not_converged = 0;
+            std::size_t hits = run_poses(query, &totals, &not_converged);
+            double ns = 1e9 * seconds_per_call([&] { keep(run_poses(query, nullptr, nullptr)); }) / poses.size();
+
+            std::cout << std::left << std::setw(10) << std::scientific << std::setprecision(0) << offset
+                      << std::setw(20) << name
+                      << std::setw(12) << std::fixed << std::setprecision(1) << ns
+                      << std::setw(12) << std::setprecision(3) << double(totals.iteration_count) / poses.size()
+                      << std::setw(16) << not_converged
+                      << hits << "/" << poses.size() << "\n";
+        };
+
+        report("mesh", [&](const PosedPair& pose, const Shape& shape1, const Shape& shape2, geometry::GjkStats& stats) {
+            return geometry::intersect_gjk<Vec3>(
+                [&](const Vec3& d) { return general_support(d, pose.a, shape1.vertices); },
+                [&](const Vec3& d) { return general_support(d, pose.b, shape2.vertices); },
+                max_iterations, &stats);
+        });
+        report("primitive", [&](const PosedPair& pose, const Shape& shape1, const Shape& shape2, geometry::GjkStats& stats) {
+            return geometry::intersect_gjk<Vec3>(
+                [&](const Vec3& d) { return primitive_support(d, pose.a, shape1.primitive); },
+                [&](const Vec3& d) { return primitive_support(d, pose.b, shape2.primitive); },
+                max_iterations, &stats);
+        });
+        report("core and margin", [&](const PosedPair& pose, const Shape& shape1, const Shape& shape2, geometry::GjkStats& stats) {
+            geometry::GjkCache<Vec3> cache;
+            return geometry::intersect_gjk_margins<Vec3>(
+                [&](const Vec3& d) { return primitive_core_support(d, pose.a, shape1.primitive); },
+                geometry::margin(shape1.primitive),
+                [&](const Vec3& d) { return primitive_core_support(d, pose.b, shape2.primitive); },
+                geometry::margin(shape2.primitive),
+                cache, max_iterations, &stats);
+        });
+    }
+}
+
+// Each mesh flies through a thin plate in one step, turning as it goes, as a fast object does in
+// the demo between frames. Conservative advancement finds when it first touches the plate,
+// against sub-stepping, which tests for intersection at evenly spaced times and reports the first
+// which intersects. Both are compared against conservative advancement with a much tighter
+// tolerance. Sub-stepping misses contacts which start and end between samples, and is only as
+// accurate as its spacing, so the last row uses as many steps as it takes to match the accuracy
+// of conservative advancement.
+void bench_time_of_impact(const std::vector<NamedMesh>& meshes)
+{
+    constexpr std::size_t scene_count = 64;
+    constexpr float tolerance = 1e-3f;
+    constexpr float reference_tolerance = 1e-5f;
+
+    struct Scene
+    {
+        const NamedMesh* mesh;
+        ConvexHullInstance start;
+        Vec3 displacement;
+        Vec3 rotation;
+        geometry::MotionBound<Vec3> motion;
+
+        // Whether and when the mesh touches the plate, with the tighter tolerance
+        bool hit;
+        float time;
+    };
+
+    const geometry::Primitive<Vec3> plate = geometry::Box<Vec3>{Vec3(0.02f, 1.5f, 1.5f)};
+    const ConvexHullInstance plate_pose(Vec3(), Mat3::Identity(), 0);
+    const geometry::MotionBound<Vec3> at_rest{Vec3(), 0.0f};
+    auto plate_at = [&](float) {
+        return [&](const Vec3& d) { return primitive_support(d, plate_pose, plate); };
+    };
+    auto mesh_at = [](const Scene& scene) {
+        return [&scene](float t) {
+            ConvexHullInstance pose = pose_at(scene.start, scene.displacement, scene.rotation, t);
+            return [&scene, pose](const Vec3& d) { return general_support(d, pose, scene.mesh->vertices); };
+        };
+    };
+
+    std::mt19937 rng(24);
+    std::uniform_real_distribution<float> offset(-2.0f, 2.0f);
+    std::vector<Scene> scenes;
+    for (const NamedMesh& mesh : meshes)
+    {
+        float reach = 0.0f;
+        for (const Vec3& v : mesh.vertices)
+        {
+            reach = std::max(reach, v.mag());
+        }
+
+        for (std::size_t i = 0; i < scene_count; ++i)
+        {
+            Scene scene{&mesh, ConvexHullInstance(Vec3(-6.0f, offset(rng), offset(rng)), random_orientation(rng), 0),
+                        Vec3(12.0f, offset(rng), offset(rng)), random_position(rng, 2.0f), {}, false, 1.0f};
+            scene.motion = geometry::MotionBound<Vec3>{scene.displacement, scene.rotation.mag() * reach};
+            geometry::TimeOfImpact<Vec3> impact = geometry::time_of_impact<Vec3>(
+                mesh_at(scene), scene.motion, plate_at, at_rest, reference_tolerance, 1000);
+            scene.hit = impact.hit;
+            scene.time = impact.time;
+            scenes.push_back(scene);
+        }
+    }
+    std::size_t reference_hits = static_cast<std::size_t>(std::count_if(scenes.begin(), scenes.end(), [](const Scene& scene) { return scene.hit; }));
+
+    std::cout << "Time of impact of meshes flying through a thin plate, " << scenes.size() << " motions of which "
+              << reference_hits << " touch it\n";
+    std::cout << std::left << std::setw(28) << "Method"
+              << std::setw(12) << "ns/query"
+              << std::setw(14) << "GJK queries"
+              << std::setw(12) << "Tunnelled"
+              << "Max time error\n";
+
+    // Runs every scene with query, which returns the time of impact, or a negative time for a
+    // miss, and counts its GJK queries
+    auto report = [&](const std::string& name, const auto& query) {
+        std::size_t gjk_queries = 0;
+        std::size_t tunnelled = 0;
+        float max_error = 0.0f;
+        for (const Scene& scene : scenes)
+        {
+            float time = query(scene, gjk_queries);
+            if (scene.hit && time < 0.0f)
+            {
+                ++tunnelled;
+            }
+            else if (scene.hit)
+            {
+                max_error = std::max(max_error, std::abs(time - scene.time));
+            }
+        }
+        double ns = 1e9 * seconds_per_call([&] {
+            std::size_t count = 0;
+            for (const Scene& scene : scenes)
+            {
+                keep(query(scene, count));
+            }
+        }) / scenes.size();
+
+        std::cout << std::left << std::setw(28) << name
+                  << std::setw(12) << std::fixed << std::setprecision(1) << ns
+                  << std::setw(14) << std::setprecision(2) << double(gjk_queries) / scenes.size()
+                  << std::setw(12) << tunnelled
+                  << std::scientific << std::setprecision(2) << max_error << std::fixed << "\n";
+        return max_error;
+    };
+
+    float advancement_error = report("conservative advancement", [&](const Scene& scene, std::size_t& gjk_queries) {
+        geometry::GjkStats stats;
+        geometry::TimeOfImpact<Vec3> impact = geometry::time_of_impact<Vec3>(
+            mesh_at(scene), scene.motion, plate_at, at_rest, tolerance, 100, &stats);
+        gjk_queries += stats.iteration_count;
+        return impact.hit ? impact.time : -1.0f;
+    });
+
+    auto sub_step = [&](std::size_t step_count) {
+        return [&, step_count](const Scene& scene, std::size_t& gjk_queries) {
+            auto support_at = mesh_at(scene);
+            for (std::size_t k = 0; k <= step_count; ++k)
+            {
+                float t = static_cast<float>(k) / static_cast<float>(step_count);
+                ++gjk_queries;
+                if (geometry::intersect_gjk<Vec3>(support_at(t), plate_at(t)))
+                {
+                    return t;
+                }
+            }
+            return -1.0f;
+        };
+    };
+    for (std::size_t step_count : {8, 64, 512})
+    {
+        report("sub-stepping, " + std::to_string(step_count) + " steps", sub_step(step_count));
+    }
+
+    // The first intersecting sample is up to a step after the contact
+    std::size_t matching_step_count = static_cast<std::size_t>(std::ceil(1.0f / std::max(advancement_error, 1e-6f)));
+    report("sub-stepping, " + std::to_string(matching_step_count) + " steps", sub_step(matching_step_count));
+}
+
+// Compares MPR against GJK for each pair of meshes, at the same random poses as the sections
+// above: for whether the shapes intersect, and for the penetration normal and depth of those
+// which do, against GJK followed by EPA. Support calls are counted for each shape, and MPR is
+// started from the centroids of the hull vertices, or from interior_point where no centres
+// are given. Pairs within 1e-4 of touching may legitimately disagree, so they aren't counted.
+void bench_mpr(const std::vector<NamedMesh>& meshes)
+{
+    std::mt19937 rng(475);
+    const std::vector<PosedPair> poses = make_poses(rng);
+
+    std::vector<Vec3> centroids;
+    for (const NamedMesh& mesh : meshes)
+    {
+        Vec3 sum;
+        for (const Vec3& v : mesh.vertices)
+        {
+            sum += v;
+        }
+        centroids.push_back((1.0f / static_cast<float>(mesh.vertices.size())) * sum);
+    }
+
+    std::cout << "MPR against GJK: intersection (support calls and ns per query)\n";
+    std::cout << std::left << std::setw(34) << "Pair"
+              << std::setw(8) << "Hits"
+              << std::setw(10) << "GJK"
+              << std::setw(10) << "MPR"
+              << std::setw(14) << "No centres"
+              << std::setw(12) << "GJK ns"
+              << std::setw(12) << "MPR ns"
+              << std::setw(10) << "Speedup"
+              << "Agree\n";
+
+    struct PenetrationRow
+    {
+        std::string pair;
+        std::size_t hits;
+        double epa_calls, mpr_calls, epa_ns, mpr_ns, depth_ratio;
+    };
+    std::vector<PenetrationRow> penetration_rows;
+
+    for (std::size_t m1 = 0; m1 < meshes.size(); ++m1)
+    {
+        for (std::size_t m2 = m1; m2 < meshes.size(); ++m2)
+        {
+            const auto& vertices1 = meshes[m1].vertices;
+            const auto& vertices2 = meshes[m2].vertices;
+            auto interior1 = [&](const PosedPair& pose) { return pose.a.position + pose.a.orientation * centroids[m1]; };
+            auto interior2 = [&](const PosedPair& pose) { return pose.b.position + pose.b.orientation * centroids[m2]; };
+
+            std::size_t hits = 0;
+            std::size_t disagreements = 0;
+            std::size_t gjk_calls = 0, mpr_calls = 0, free_calls = 0, epa_calls = 0, mpr_penetration_calls = 0;
+            double depth_ratio = 0.0;
+            std::vector<PosedPair> hit_poses;
+            for (const PosedPair& pose : poses)
+            {
+                std::size_t* calls = nullptr;
+                auto support1 = [&](const Vec3& d) { ++*calls; return general_support(d, pose.a, vertices1); };
+                auto support2 = [&](const Vec3& d) { ++*calls; return general_support(d, pose.b, vertices2); };
+
+                calls = &gjk_calls;
+                bool gjk = geometry::intersect_gjk<Vec3>(support1, support2);
+                calls = &mpr_calls;
+                bool mpr = geometry::intersect_mpr<Vec3>(support1, interior1(pose), support2, interior2(pose));
+                calls = &free_calls;
+                bool mpr_free = geometry::intersect_mpr<Vec3>(support1, support2);
+
+                std::size_t uncounted = 0;
+                calls = &uncounted;
+                geometry::EpaResult<Vec3> epa;
+                bool near_contact = geometry::penetration_gjk_epa<Vec3>(support1, support2, epa)
+                    ? epa.depth < 1e-4f
+                    : geometry::distance_gjk<Vec3>(support1, support2).distance < 1e-4f;
+                disagreements += !near_contact && (gjk != mpr || gjk != mpr_free);
+
+                if (gjk)
+                {
+                    ++hits;
+                    hit_poses.push_back(pose);
+
+                    calls = &epa_calls;
+                    geometry::penetration_gjk_epa<Vec3>(support1, support2, epa);
+                    calls = &mpr_penetration_calls;
+                    geometry::EpaResult<Vec3> mpr_result;
+                    geometry::penetration_mpr<Vec3>(support1, interior1(pose), support2, interior2(pose), mpr_result);
+                    depth_ratio += epa.depth > 0.0f ? mpr_result.depth / epa.depth : 1.0;
+                }
+            }
+
+            auto run_gjk = [&] {
+                for (const PosedPair& pose : poses)
+                {
+                    keep(geometry::intersect_gjk<Vec3>(
+                        [&](const Vec3& d) { return general_support(d, pose.a, vertices1); },
+                        [&](const Vec3& d) { return general_support(d, pose.b, vertices2); }));
+                }
+            };
+            auto run_mpr = [&] {
+                for (const PosedPair& pose : poses)
+                {
+                    keep(geometry::intersect_mpr<Vec3>(
+                        [&](const Vec3& d) { return general_support(d, pose.a, vertices1); }, interior1(pose),
+                        [&](const Vec3& d) { return general_support(d, pose.b, vertices2); }, interior2(pose)));
+                }
+            };
+            double gjk_ns = 1e9 * seconds_per_call(run_gjk) / poses.size();
+            double mpr_ns = 1e9 * seconds_per_call(run_mpr) / poses.size();
+
+            std::string pair = meshes[m1].filename + " / " + meshes[m2].filename;
+            std::cout << std::left << std::setw(34) << pair
+                      << std::setw(8) << hits
+                      << std::setw(10) << std::fixed << std::setprecision(2) << double(gjk_calls) / poses.size()
+                      << std::setw(10) << double(mpr_calls) / poses.size()
+                      << std::setw(14) << double(free_calls) / poses.size()
+                      << std::setw(12) << std::setprecision(1) << gjk_ns
+                      << std::setw(12) << mpr_ns
+                      << std::setw(10) << std::setprecision(2) << gjk_ns / mpr_ns
+                      << (disagreements == 0 ? "yes" : "NO") << "\n";
+
+            if (hit_poses.empty())
+            {
+                continue;
+            }
+
+            auto run_epa = [&] {
+                for (const PosedPair& pose : hit_poses)
+                {
+                    geometry::EpaResult<Vec3> result;
+                    geometry::penetration_gjk_epa<Vec3>(
+                        [&](const Vec3& d) { return general_support(d, pose.a, vertices1); },
+                        [&](const Vec3& d) { return general_support(d, pose.b, vertices2); },
+                        result);
+                    keep(result.depth);
+                }
+            };
+            auto run_mpr_penetration = [&] {
+                for (const PosedPair& pose : hit_poses)
+                {
+                    geometry::EpaResult<Vec3> result;
+                    geometry::penetration_mpr<Vec3>(
+                        [&](const Vec3& d) { return general_support(d, pose.a, vertices1); }, interior1(pose),
+                        [&](const Vec3& d) { return general_support(d, pose.b, vertices2); }, interior2(pose),
+                        result);
+                    keep(result.depth);
+                }
+            };
+            penetration_rows.push_back({pair, hits,
+                double(epa_calls) / hits, double(mpr_penetration_calls) / hits,
+                1e9 * seconds_per_call(run_epa) / hits, 1e9 * seconds_per_call(run_mpr_penetration) / hits,
+                depth_ratio / hits});
+        }
+    }
+
+    // MPR's normal is where the line between the centres leaves the Minkowski difference, so
+    // its depth is never less than EPA's, which is the least
+    std::cout << "\nMPR against GJK + EPA: penetration of the intersecting poses (support calls and ns per query)\n";
+    std::cout << std::left << std::setw(34) << "Pair"
+              << std::setw(8) << "Hits"
+              << std::setw(12) << "GJK + EPA"
+              << std::setw(10) << "MPR"
+              << std::setw(16) << "GJK + EPA ns"
+              << std::setw(12) << "MPR ns"
+              << std::setw(10) << "Speedup"
+              << "Depth ratio\n";
+    for (const PenetrationRow& row : penetration_rows)
+    {
+        std::cout << std::left << std::setw(34) << row.pair
+                  << std::setw(8) << row.hits
+                  << std::setw(12) << std::fixed << std::setprecision(2) << row.epa_calls
+                  << std::setw(10) << row.mpr_calls
+                  << std::setw(16) << std::setprecision(1) << row.epa_ns
+                  << std::setw(12) << row.mpr_ns
+                  << std::setw(10) << std::setprecision(2) << row.epa_ns / row.mpr_ns
+                  << std::setprecision(3) << row.depth_ratio << "\n";
+    }
+}
+
+int main(int argc, char** args)
+{
+    const char* mesh_directory = argc > 1 ? args[1] : "demo_meshes";
+
+    std::vector<NamedMesh> meshes = load_mesh_directory(mesh_directory);
+    if (meshes.empty())
+    {
+        std::cerr << "usage: bench_gjk [mesh_directory]\n";
+        return 1;
+    }
+
+    bench_support_interface(meshes);
+    std::cout << "\n";
+
+    bench_distance(meshes);
+    std::cout << "\n";
+
+    bench_penetration(meshes);
+    std::cout << "\n";
+
+    bench_mpr(meshes);
+    std::cout << "\n";
+
+    bench_warm_start(meshes);
+    std::cout << "\n";
+
+    bench_batch(meshes);
+    std::cout << "\n";
+
+    bench_near_contact(meshes);
+    std::cout << "\n";
+
+    bench_primitives(meshes);
+    std::cout << "\n";
+
+    bench_margins();
+    std::cout << "\n";
+
+    bench_time_of_impact(meshes);
+
+#if defined(__SSE2__)
+    std::cout << "\n";
+    bench_vector_types(meshes);
+#endif
+
+    return 0;
+}
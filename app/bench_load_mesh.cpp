@@ -0,0 +1,462 @@
+#include "math.hpp"
+#include "load_mesh.hpp"
+#include "mesh_tools.hpp"
+#include "mesh_cache.hpp"
+#include "benchmark.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+using namespace demo::math;
+using namespace demo::bench;
+
+namespace {
+
+// Returns index of first non-whitespace character
+std::size_t skip_whitespace(const char* str)
+{
+    std::size_t idx = 0;
+
+    // Skip to the first non-whitespace character in the line
+    while (isspace(str[idx]))
+    {
+        ++idx;
+    }
+
+    return idx;
+}
+
+// Returns false for blank lines or comments.
+// If either vertex_count or face_count is set to zero, the line couldn't be parsed (or it is zero).
+// This ambiguity is irrelevant since both are failure cases.
+bool off_parse_counts(const std::string& line, std::size_t& vertex_count, std::size_t& face_count)
+{
+    std::size_t line_idx = skip_whitespace(line.c_str());
+
+    // Only parse a number if a non-comment character was found
+    if (line[line_idx] && line[line_idx] != '#')
+    {
+        char* end;
+
+        const char* vertex_count_start = line.c_str() + line_idx;
+        vertex_count = strtoul(vertex_count_start, &end, 10);
+
+        const char* face_count_start = end;
+        face_count = strtoul(face_count_start, &end, 10);
+
+        // Skip the edge count because it is not needed.
+        return true;
+    }
+
+    return false;
+}
+
+// Returns false if the line is not valid
+bool off_parse_vertex(const std::string& line, std::vector<Vec3>& vertices)
+{
+    std::size_t line_idx = skip_whitespace(line.c_str());
+
+    // Only parse a number if a non-comment character was found
+    if (line[line_idx] && line[line_idx] != '#')
+    {
+        char* end;
+
+        const char* x_start = line.c_str() + line_idx;
+        float x = strtof(x_start, &end);
+        if (end == x_start)
+        {
+            // This means no conversion could be performed
+            return false;
+        }
+
+        const char* y_start = end;
+        float y = strtof(y_start, &end);
+        if (end == y_start)
+        {
+            // This means no conversion could be performed
+            return false;
+        }
+
+        const char* z_start = end;
+        float z = strtof(z_start, &end);
+        if (end == z_start)
+        {
+            // This means no conversion could be performed
+            return false;
+        }
+
+        vertices.emplace_back(x, y, z);
+    }
+
+    return true;
+}
+
+// Returns false if the line is not valid
+bool off_parse_face(const std::string& line,
+                    const std::vector<Vec3>& vertices,
+                    std::vector<Vec3>& triangles,
+                    std::vector<std::uint32_t>& indices)
+{
+    std::size_t line_idx = skip_whitespace(line.c_str());
+
+    // Only parse a number if a non-comment character was found
+    if (line[line_idx] && line[line_idx] != '#')
+    {
+        char* end;
+
+        const char* vertex_count_start = line.c_str() + line_idx;
+        std::size_t vertex_count = strtoul(vertex_count_start, &end, 10);
+
+        // Only triangle-faces are supported
+        if (vertex_count != 3)
+        {
+            std::cerr << "Only faces with 3 vertices are supported.\n";
+            return false;
+        }
+
+        std::uint32_t indices_to_add[3];
+
+        for (std::size_t i = 0; i < 3; ++i)
+        {
+            const char* v_start = end;
+            std::size_t v_idx = strtoul(v_start, &end, 10);
+            if (end == v_start)
+            {
+                // This means no conversion could be performed
+                std::cerr << "Unable to read vertex number.\n";
+                return false;
+            }
+            if (v_idx >= vertices.size())
+            {
+                // This means v_idx doesn't represent a valid vertex
+                std::cerr << "Vertex " << v_idx << " is not a valid vertex.\n";
+                return false;
+            }
+
+            indices_to_add[i] = v_idx;
+        }
+
+        // If control reaches here, parsing was successful
+        for (std::size_t i = 0; i < 3; ++i)
+        {
+            triangles.push_back(vertices[indices_to_add[i]]);
+            indices.push_back(indices_to_add[i]);
+        }
+    }
+
+    return true;
+}
+
+enum class OffParseState
+{
+    FirstLine,
+    Counts,
+    Vertices,
+    Faces,
+    Done
+};
+
+// The original OFF loader, which reads the file a line at a time into a std::string and parses
+// it with strtof and strtoul using the functions above, and copies each triangle's vertices out with three copies of its
+// normal, as they were uploaded for rendering. It is kept here as the baseline for comparison.
+void load_off_getline(const char* filename,
+                      std::vector<Vec3>& vertices,
+                      std::vector<Vec3>& triangles,
+                      std::vector<Vec3>& normals,
+                      std::vector<std::uint32_t>& indices)
+{
+    vertices.clear();
+    triangles.clear();
+    normals.clear();
+    indices.clear();
+
+    std::ifstream file(filename);
+    if (!file)
+    {
+        std::cerr << "Could not open file " << filename << ".\n";
+        return;
+    }
+
+    std::string line;
+    std::size_t vertex_count = 0;
+    std::size_t face_count = 0;
+    OffParseState parse_state = OffParseState::FirstLine;
+    bool error = false;
+
+    while (getline(file, line) && parse_state != OffParseState::Done)
+    {
+        switch (parse_state)
+        {
+            case OffParseState::FirstLine:
+                error = line != "OFF";
+                parse_state = OffParseState::Counts;
+                break;
+            case OffParseState::Counts:
+                if (off_parse_counts(line, vertex_count, face_count))
+                {
+                    error = vertex_count == 0 || face_count == 0;
+                    vertices.reserve(vertex_count);
+                    triangles.reserve(3*face_count);
+                    indices.reserve(3*face_count);
+                    parse_state = OffParseState::Vertices;
+                }
+                break;
+            case OffParseState::Vertices:
+                error = !off_parse_vertex(line, vertices);
+                if (vertices.size() == vertex_count)
+                {
+                    parse_state = OffParseState::Faces;
+                }
+                break;
+            case OffParseState::Faces:
+                error = !off_parse_face(line, vertices, triangles, indices);
+                if (triangles.size() == 3*face_count)
+                {
+                    parse_state = OffParseState::Done;
+                }
+                break;
+            case OffParseState::Done:
+            default:
+                break;
+        }
+
+        if (error)
+        {
+            break;
+        }
+    }
+
+    if (error || vertices.size() != vertex_count || triangles.size() != 3*face_count)
+    {
+        vertices.clear();
+        triangles.clear();
+        indices.clear();
+    }
+    else
+    {
+        demo::mesh::compute_normals(triangles, normals);
+    }
+}
+
+// Writes an icosphere as an OFF file, as most modelling tools would, with 6 decimal places
+void write_off(const std::filesystem::path& path, unsigned int subdivisions)
+{
+    std::vector<Vec3> vertices;
+    std::vector<std::uint32_t> indices;
+    demo::mesh::make_icosphere(subdivisions, vertices, indices);
+
+    std::FILE* file = std::fopen(path.c_str(), "w");
+    std::fprintf(file, "OFF\n%zu %zu 0\n", vertices.size(), indices.size() / 3);
+    for (const Vec3& v : vertices)
+    {
+        std::fprintf(file, "%f %f %f\n", v.x, v.y, v.z);
+    }
+    for (std::size_t i = 0; i < indices.size(); i += 3)
+    {
+        std::fprintf(file, "3 %u %u %u\n", indices[i], indices[i + 1], indices[i + 2]);
+    }
+    std::fclose(file);
+}
+
+bool same_mesh(const std::vector<Vec3>& vertices1, const std::vector<std::uint32_t>& indices1,
+               const std::vector<Vec3>& vertices2, const std::vector<std::uint32_t>& indices2)
+{
+    if (vertices1.size() != vertices2.size() || indices1 != indices2)
+    {
+        return false;
+    }
+    for (std::size_t i = 0; i < vertices1.size(); ++i)
+    {
+        if (vertices1[i].x != vertices2[i].x || vertices1[i].y != vertices2[i].y || vertices1[i].z != vertices2[i].z)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <class T>
+double megabytes_of(const std::vector<T>& v)
+{
+    return static_cast<double>(v.size() * sizeof(T)) / (1024.0 * 1024.0);
+}
+
+// Loads each file with the getline loader and load_off, and parses it with parse_off from a
+// copy already in memory, which leaves out reading the file.
+void bench_load(const std::vector<std::filesystem::path>& files)
+{
+    std::cout << "OFF loading throughput (MB/s)\n";
+    std::cout << std::left << std::setw(22) << "File"
+              << std::setw(10) << "MB"
+              << std::setw(12) << "Vertices"
+              << std::setw(12) << "getline"
+              << std::setw(12) << "load_off"
+              << std::setw(12) << "parse_off"
+              << std::setw(10) << "Speedup"
+              << "Agree\n";
+
+    // The memory held by each loader's output, and how much of it is uploaded for rendering
+    std::vector<std::string> names;
+    std::vector<double> soup_resident, soup_upload, indexed_upload;
+
+    demo::mesh::IndexedMesh mesh;
+    std::vector<Vec3> baseline_vertices, baseline_triangles, baseline_normals;
+    std::vector<std::uint32_t> baseline_indices;
+    for (const std::filesystem::path& file : files)
+    {
+        double megabytes = static_cast<double>(std::filesystem::file_size(file)) / (1024.0 * 1024.0);
+
+        std::ifstream stream(file, std::ios::binary);
+        std::string contents((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+
+        double getline_seconds = seconds_per_call([&] {
+            load_off_getline(file.c_str(), baseline_vertices, baseline_triangles, baseline_normals, baseline_indices);
+        }, 1.0);
+        double load_seconds = seconds_per_call([&] {
+            demo::mesh::load_off(file.c_str(), mesh);
+        }, 1.0);
+
+        std::vector<Vec3> parsed_vertices;
+        std::vector<std::uint32_t> parsed_indices;
+        double parse_seconds = seconds_per_call([&] {
+            demo::mesh::parse_off(contents.data(), contents.size(), parsed_vertices, parsed_indices);
+        }, 1.0);
+
+        bool agree = !mesh.vertices.empty()
+            && same_mesh(mesh.vertices, mesh.indices, baseline_vertices, baseline_indices)
+            && same_mesh(mesh.vertices, mesh.indices, parsed_vertices, parsed_indices);
+
+        names.push_back(file.filename().string());
+        soup_upload.push_back(megabytes_of(baseline_triangles) + megabytes_of(baseline_normals));
+        soup_resident.push_back(soup_upload.back() + megabytes_of(baseline_vertices) + megabytes_of(baseline_indices));
+        indexed_upload.push_back(megabytes_of(mesh.vertices) + megabytes_of(mesh.indices));
+
+        std::cout << std::left << std::setw(22) << file.filename().string()
+                  << std::setw(10) << std::fixed << std::setprecision(2) << megabytes
+                  << std::setw(12) << mesh.vertices.size()
+                  << std::setw(12) << std::setprecision(1) << megabytes / getline_seconds
+                  << std::setw(12) << megabytes / load_seconds
+                  << std::setw(12) << megabytes / parse_seconds
+                  << std::setw(10) << std::setprecision(2) << getline_seconds / load_seconds
+                  << (agree ? "yes" : "NO") << "\n";
+    }
+
+    std::cout << "\nLoaded mesh size (MB): triangle soup with normals against indexed\n";
+    std::cout << std::left << std::setw(22) << "File"
+              << std::setw(14) << "Soup held"
+              << std::setw(14) << "Soup upload"
+              << std::setw(14) << "Indexed"
+              << "Reduction\n";
+    for (std::size_t i = 0; i < names.size(); ++i)
+    {
+        std::cout << std::left << std::setw(22) << names[i]
+                  << std::setw(14) << std::setprecision(3) << soup_resident[i]
+                  << std::setw(14) << soup_upload[i]
+                  << std::setw(14) << indexed_upload[i]
+                  << std::setprecision(2) << soup_upload[i] / indexed_upload[i] << "x\n";
+    }
+}
+
+// Compares preparing each mesh from its OFF file, as the demo did at startup before it kept a
+// cache, against opening its cache and copying out the hull and adjacency, as the demo now does.
+// The files are already in the page cache for both.
+void bench_startup(const std::vector<std::filesystem::path>& files)
+{
+    std::cout << "\nMesh startup time (ms): OFF file against cache\n";
+    std::cout << std::left << std::setw(22) << "File"
+              << std::setw(12) << "Vertices"
+              << std::setw(12) << "Hull"
+              << std::setw(12) << "Cache MB"
+              << std::setw(12) << "OFF"
+              << std::setw(12) << "Cached"
+              << "Speedup\n";
+
+    std::vector<char> image;
+    std::vector<Vec3> hull_vertices;
+    demo::mesh::VertexAdjacency adjacency;
+    for (const std::filesystem::path& file : files)
+    {
+        // Writes the cache
+        demo::mesh::MeshCache cache;
+        if (!cache.open(file))
+        {
+            continue;
+        }
+        std::size_t vertex_count = cache.render_vertex_count();
+        std::size_t hull_vertex_count = cache.hull_vertex_count();
+        double megabytes = static_cast<double>(std::filesystem::file_size(demo::mesh::mesh_cache_path(file))) / (1024.0 * 1024.0);
+
+        double off_seconds = seconds_per_call([&] {
+            demo::mesh::build_mesh_cache(file, 0, 0, image);
+            keep(image.size());
+        }, 1.0);
+        double cached_seconds = seconds_per_call([&] {
+            demo::mesh::MeshCache cache;
+            cache.open(file);
+            hull_vertices.assign(cache.hull_vertices(), cache.hull_vertices() + cache.hull_vertex_count());
+            adjacency.offsets.assign(cache.adjacency_offsets(), cache.adjacency_offsets() + cache.hull_vertex_count() + 1);
+            adjacency.neighbours.assign(cache.adjacency_neighbours(), cache.adjacency_neighbours() + cache.adjacency_neighbour_count());
+            keep(cache.render_vertices()[cache.render_vertex_count() - 1].x);
+        }, 1.0);
+
+        std::cout << std::left << std::setw(22) << file.filename().string()
+                  << std::setw(12) << vertex_count
+                  << std::setw(12) << hull_vertex_count
+                  << std::setw(12) << std::fixed << std::setprecision(2) << megabytes
+                  << std::setw(12) << std::setprecision(3) << 1000.0 * off_seconds
+                  << std::setw(12) << 1000.0 * cached_seconds
+                  << std::setprecision(1) << off_seconds / cached_seconds << "x\n";
+
+        std::filesystem::remove(demo::mesh::mesh_cache_path(file));
+    }
+}
+
+}
+
+int main(int argc, char** args)
+{
+    const char* mesh_directory = argc > 1 ? args[1] : "demo_meshes";
+
+    std::vector<std::filesystem::path> files;
+    for (const auto& p : std::filesystem::directory_iterator(mesh_directory))
+    {
+        if (p.path().extension() == ".off")
+        {
+            files.push_back(p.path());
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    // Large generated meshes, and copies of the mesh directory for the caches to be written
+    // next to, in the temporary directory, and removed afterwards
+    std::filesystem::path temporary_directory = std::filesystem::temp_directory_path() / "bench_load_mesh";
+    std::filesystem::create_directories(temporary_directory);
+    std::vector<std::filesystem::path> copies;
+    for (const std::filesystem::path& file : files)
+    {
+        copies.push_back(temporary_directory / file.filename());
+        std::filesystem::copy_file(file, copies.back(), std::filesystem::copy_options::overwrite_existing);
+    }
+    for (unsigned int subdivisions : {5, 7, 8})
+    {
+        files.push_back(temporary_directory / ("bench_icosphere" + std::to_string(subdivisions) + ".off"));
+        write_off(files.back(), subdivisions);
+        copies.push_back(files.back());
+    }
+
+    bench_load(files);
+    bench_startup(copies);
+
+    std::filesystem::remove_all(temporary_directory);
+
+    return 0;
+}
@@ -0,0 +1,408 @@
+#include "math.hpp"
+#include "convex_hull.hpp"
+#include "benchmark.hpp"
+
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace demo::math;
+using namespace demo::bench;
+
+namespace {
+
+// Number of random query directions per mesh
+constexpr std::size_t query_count = 1024;
+
+// The original support mapping, which transforms every vertex into world space
+// before testing it. It is kept here as the baseline for comparison.
+Vec3 world_space_support(Vec3 dir, const ConvexHullInstance& data, const std::vector<Vec3>& vertices)
+{
+    float max_dot = -std::numeric_limits<float>::infinity();
+    Vec3 max_dot_v = Vec3(0.0f, 0.0f, 0.0f);
+
+    for (const Vec3& vertex : vertices)
+    {
+        Vec3 v = data.position + data.orientation * vertex;
+
+        if (dot(dir, v) > max_dot)
+        {
+            max_dot = dot(dir, v);
+            max_dot_v = v;
+        }
+    }
+
+    return max_dot_v;
+}
+
+std::vector<Vec3> random_directions(std::mt19937& rng, std::size_t count)
+{
+    std::vector<Vec3> directions;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        Vec3 d;
+        do
+        {
+            d = random_position(rng, 1.0f);
+        } while (d.sq_mag() < 1e-4f);
+        directions.push_back(d);
+    }
+    return directions;
+}
+
+// Compares the world-space scan against the local-space scan used by general_support.
+void bench_local_space(const std::vector<NamedMesh>& meshes)
+{
+    std::mt19937 rng(475);
+    const std::vector<Vec3> directions = random_directions(rng, query_count);
+    const ConvexHullInstance instance(random_position(rng, 5.0f), random_orientation(rng), 0);
+
+    std::cout << "Support mapping: world-space scan vs local-space scan (ns per query)\n";
+    std::cout << std::left << std::setw(18) << "Mesh"
+              << std::setw(10) << "Vertices"
+              << std::setw(14) << "World space"
+              << std::setw(14) << "Local space"
+              << std::setw(10) << "Speedup"
+              << "Agree\n";
+
+    for (const NamedMesh& mesh : meshes)
+    {
+        auto run_world = [&] {
+            for (const Vec3& d : directions)
+            {
+                keep(world_space_support(d, instance, mesh.vertices).x);
+            }
+        };
+
+        auto run_local = [&] {
+            for (const Vec3& d : directions)
+            {
+                keep(general_support(d, instance, mesh.vertices).x);
+            }
+        };
+
+        // Both must find a point equally far along every direction. The points
+        // themselves may differ when several vertices are equally far.
+        bool agree = true;
+        for (const Vec3& d : directions)
+        {
+            float world_dot = dot(d, world_space_support(d, instance, mesh.vertices));
+            float local_dot = dot(d, general_support(d, instance, mesh.vertices));
+            agree &= std::abs(world_dot - local_dot) <= 1e-4f * (1.0f + std::abs(world_dot));
+        }
+
+        double world_ns = 1e9 * seconds_per_call(run_world) / directions.size();
+        double local_ns = 1e9 * seconds_per_call(run_local) / directions.size();
+
+        std::cout << std::left << std::setw(18) << mesh.filename
+                  << std::setw(10) << mesh.vertices.size()
+                  << std::setw(14) << std::fixed << std::setprecision(1) << world_ns
+                  << std::setw(14) << local_ns
+                  << std::setw(10) << std::setprecision(2) << world_ns / local_ns
+                  << (agree ? "yes" : "NO") << "\n";
+    }
+}
+
+// Compares the vertex scan of general_support against the SIMD scan of simd_support, which must
+// return exactly the same vertex.
+void bench_simd_scan(const std::vector<NamedMesh>& meshes)
+{
+    std::mt19937 rng(475);
+    const std::vector<Vec3> directions = random_directions(rng, query_count);
+    const ConvexHullInstance instance(random_position(rng, 5.0f), random_orientation(rng), 0);
+
+    std::cout << "Support mapping: scalar scan vs SIMD scan (ns per query)\n";
+    std::cout << std::left << std::setw(18) << "Mesh"
+              << std::setw(10) << "Vertices"
+              << std::setw(14) << "Scan"
+              << std::setw(14) << "SIMD"
+              << std::setw(10) << "Speedup"
+              << "Agree\n";
+
+    for (const NamedMesh& mesh : meshes)
+    {
+        const SoaVertices soa = make_soa_vertices(mesh.vertices);
+
+        auto run_scan = [&] {
+            for (const Vec3& d : directions)
+            {
+                keep(general_support(d, instance, mesh.vertices).x);
+            }
+        };
+
+        auto run_simd = [&] {
+            for (const Vec3& d : directions)
+            {
+                keep(simd_support(d, instance, soa).x);
+            }
+        };
+
+        bool agree = true;
+        for (const Vec3& d : directions)
+        {
+            Vec3 scan = general_support(d, instance, mesh.vertices);
+            Vec3 simd = simd_support(d, instance, soa);
+            agree &= scan.x == simd.x && scan.y == simd.y && scan.z == simd.z;
+        }
+
+        double scan_ns = 1e9 * seconds_per_call(run_scan) / directions.size();
+        double simd_ns = 1e9 * seconds_per_call(run_simd) / directions.size();
+
+        std::cout << std::left << std::setw(18) << mesh.filename
+                  << std::setw(10) << mesh.vertices.size()
+                  << std::setw(14) << std::fixed << std::setprecision(1) << scan_ns
+                  << std::setw(14) << simd_ns
+                  << std::setw(10) << std::setprecision(2) << scan_ns / simd_ns
+                  << (agree ? "yes" : "NO") << "\n";
+    }
+}
+
+// Measures Quickhull on point clouds, most of whose points are inside their hull, and on
+// icospheres, all of whose vertices are on it, and how much scanning only the hull saves.
+void bench_quickhull()
+{
+    std::mt19937 rng(475);
+    const std::vector<Vec3> directions = random_directions(rng, query_count);
+    const ConvexHullInstance instance(random_position(rng, 5.0f), random_orientation(rng), 0);
+
+    std::vector<NamedMesh> clouds;
+    for (std::size_t count : {1000, 10000, 100000})
+    {
+        NamedMesh cloud;
+        cloud.filename = "ball" + std::to_string(count);
+        while (cloud.vertices.size() < count)
+        {
+            Vec3 p = random_position(rng, 1.0f);
+            if (p.sq_mag() <= 1.0f)
+            {
+                cloud.vertices.push_back(p);
+            }
+        }
+        clouds.push_back(std::move(cloud));
+    }
+    add_icospheres(clouds, 4, 6);
+
+    std::cout << "Quickhull, and the support mapping scan before and after it (ns per query)\n";
+    std::cout << std::left << std::setw(18) << "Mesh"
+              << std::setw(10) << "Points"
+              << std::setw(10) << "On hull"
+              << std::setw(12) << "Build ms"
+              << std::setw(14) << "Scan all"
+              << std::setw(14) << "Scan hull"
+              << std::setw(10) << "Speedup"
+              << "Agree\n";
+
+    for (const NamedMesh& cloud : clouds)
+    {
+        std::vector<Vec3> hull_vertices;
+        std::vector<std::uint32_t> hull_indices;
+        double build_seconds = seconds_per_call([&] {
+            demo::mesh::compute_convex_hull(cloud.vertices, hull_vertices, hull_indices);
+        });
+
+        auto run_scan = [&](const std::vector<Vec3>& vertices) {
+            return [&] {
+                for (const Vec3& d : directions)
+                {
+                    keep(general_support(d, instance, vertices).x);
+                }
+            };
+        };
+
+        bool agree = true;
+        for (const Vec3& d : directions)
+        {
+            Vec3 all = general_support(d, instance, cloud.vertices);
+            Vec3 hull = general_support(d, instance, hull_vertices);
+            agree &= all.x == hull.x && all.y == hull.y && all.z == hull.z;
+        }
+
+        double all_ns = 1e9 * seconds_per_call(run_scan(cloud.vertices)) / directions.size();
+        double hull_ns = 1e9 * seconds_per_call(run_scan(hull_vertices)) / directions.size();
+
+        std::cout << std::left << std::setw(18) << cloud.filename
+                  << std::setw(10) << cloud.vertices.size()
+                  << std::setw(10) << hull_vertices.size()
+                  << std::setw(12) << std::fixed << std::setprecision(2) << 1e3 * build_seconds
+                  << std::setw(14) << std::setprecision(1) << all_ns
+                  << std::setw(14) << hull_ns
+                  << std::setw(10) << std::setprecision(2) << all_ns / hull_ns
+                  << (agree ? "yes" : "NO") << "\n";
+    }
+}
+
+// Directions which rotate slightly between consecutive queries, as they do between
+// GJK iterations and between frames for slowly moving objects.
+std::vector<Vec3> coherent_directions(std::mt19937& rng, std::size_t count)
+{
+    const Mat3 step = Mat3::AxisAngle(0.02f * random_orientation(rng).col(0));
+
+    std::vector<Vec3> directions;
+    Vec3 d = random_orientation(rng).col(0);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        directions.push_back(d);
+        d = step * d;
+    }
+    return directions;
+}
+
+// Returns true if both support mappings find equally far points along every direction
+template <class Support1, class Support2>
+bool supports_agree(const std::vector<Vec3>& directions, Support1 support1, Support2 support2)
+{
+    for (const Vec3& d : directions)
+    {
+        float dot1 = dot(d, support1(d));
+        float dot2 = dot(d, support2(d));
+        if (std::abs(dot1 - dot2) > 1e-4f * (1.0f + std::abs(dot1)))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Compares scanning every vertex against hill climbing, with and without temporal coherence.
+void bench_hill_climb(const std::vector<NamedMesh>& meshes)
+{
+    std::mt19937 rng(475);
+    const std::vector<Vec3> random = random_directions(rng, query_count);
+    const std::vector<Vec3> coherent = coherent_directions(rng, query_count);
+    const ConvexHullInstance instance(random_position(rng, 5.0f), random_orientation(rng), 0);
+
+    std::cout << "Support mapping: scan vs hill climbing (ns per query)\n";
+    std::cout << std::left << std::setw(18) << "Mesh"
+              << std::setw(10) << "Vertices"
+              << std::setw(10) << "Scan"
+              << std::setw(14) << "Climb random"
+              << std::setw(16) << "Climb coherent"
+              << "Agree\n";
+
+    for (const NamedMesh& mesh : meshes)
+    {
+        demo::mesh::VertexAdjacency adjacency;
+        demo::mesh::compute_adjacency(mesh.vertices.size(), mesh.indices, adjacency);
+
+        std::uint32_t start_vertex = 0;
+        auto scan = [&](const Vec3& d) { return general_support(d, instance, mesh.vertices); };
+        auto climb = [&](const Vec3& d) { return hill_climb_support(d, instance, mesh.vertices, adjacency, start_vertex); };
+
+        auto run = [&](const std::vector<Vec3>& directions, auto support) {
+            return [&directions, support] {
+                for (const Vec3& d : directions)
+                {
+                    keep(support(d).x);
+                }
+            };
+        };
+
+        bool agree = supports_agree(random, scan, climb) && supports_agree(coherent, scan, climb);
+
+        double scan_ns = 1e9 * seconds_per_call(run(random, scan)) / query_count;
+        double random_ns = 1e9 * seconds_per_call(run(random, climb)) / query_count;
+        double coherent_ns = 1e9 * seconds_per_call(run(coherent, climb)) / query_count;
+
+        std::cout << std::left << std::setw(18) << mesh.filename
+                  << std::setw(10) << mesh.vertices.size()
+                  << std::setw(10) << std::fixed << std::setprecision(1) << scan_ns
+                  << std::setw(14) << random_ns
+                  << std::setw(16) << coherent_ns
+                  << (agree ? "yes" : "NO") << "\n";
+    }
+}
+
+// Measures the Dobkin-Kirkpatrick hierarchy on queries with no coherence, against scanning and hill climbing.
+void bench_dk_hierarchy(const std::vector<NamedMesh>& meshes)
+{
+    std::mt19937 rng(475);
+    const std::vector<Vec3> random = random_directions(rng, query_count);
+    const ConvexHullInstance instance(random_position(rng, 5.0f), random_orientation(rng), 0);
+
+    std::cout << "Support mapping: Dobkin-Kirkpatrick hierarchy, random directions (ns per query)\n";
+    std::cout << std::left << std::setw(18) << "Mesh"
+              << std::setw(10) << "Vertices"
+              << std::setw(8) << "Levels"
+              << std::setw(8) << "Edges"
+              << std::setw(12) << "Build (ms)"
+              << std::setw(12) << "Scan"
+              << std::setw(10) << "Climb"
+              << std::setw(10) << "DK"
+              << "Agree\n";
+
+    for (const NamedMesh& mesh : meshes)
+    {
+        demo::mesh::VertexAdjacency adjacency;
+        demo::mesh::compute_adjacency(mesh.vertices.size(), mesh.indices, adjacency);
+
+        DkHierarchy hierarchy;
+        DkBuildReport report = build_dk_hierarchy(mesh.vertices, adjacency, hierarchy);
+
+        std::uint32_t start_vertex = 0;
+        auto scan = [&](const Vec3& d) { return general_support(d, instance, mesh.vertices); };
+        auto climb = [&](const Vec3& d) { return hill_climb_support(d, instance, mesh.vertices, adjacency, start_vertex); };
+        auto dk = [&](const Vec3& d) { return dk_support(d, instance, hierarchy); };
+
+        auto run = [&random](auto support) {
+            return [&random, support] {
+                for (const Vec3& d : random)
+                {
+                    keep(support(d).x);
+                }
+            };
+        };
+
+        bool agree = supports_agree(random, scan, dk);
+
+        double scan_ns = 1e9 * seconds_per_call(run(scan)) / query_count;
+        double climb_ns = 1e9 * seconds_per_call(run(climb)) / query_count;
+        double dk_ns = 1e9 * seconds_per_call(run(dk)) / query_count;
+
+        std::cout << std::left << std::setw(18) << mesh.filename
+                  << std::setw(10) << mesh.vertices.size()
+                  << std::setw(8) << report.level_count
+                  << std::setw(8) << report.total_edge_count
+                  << std::setw(12) << std::fixed << std::setprecision(2) << 1e3 * report.build_seconds
+                  << std::setw(12) << std::setprecision(1) << scan_ns
+                  << std::setw(10) << climb_ns
+                  << std::setw(10) << dk_ns
+                  << (agree ? "yes" : "NO") << "\n";
+    }
+}
+
+}
+
+int main(int argc, char** args)
+{
+    const char* mesh_directory = argc > 1 ? args[1] : "demo_meshes";
+
+    std::vector<NamedMesh> meshes = load_mesh_directory(mesh_directory);
+    if (meshes.empty())
+    {
+        std::cerr << "usage: bench_support [mesh_directory]\n";
+        return 1;
+    }
+
+    bench_local_space(meshes);
+    std::cout << "\n";
+
+    add_icospheres(meshes);
+    bench_simd_scan(meshes);
+    std::cout << "\n";
+
+    bench_hill_climb(meshes);
+    std::cout << "\n";
+
+    std::vector<NamedMesh> spheres;
+    add_icospheres(spheres);
+    bench_dk_hierarchy(spheres);
+    std::cout << "\n";
+
+    bench_quickhull();
+
+    return 0;
+}
@@ -0,0 +1,135 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include "math.hpp"
+#include "load_mesh.hpp"
+#include "mesh_tools.hpp"
+#include "quickhull.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+// Helpers shared by the benchmark programs. These are not used by the demo.
+namespace demo::bench {
+
+// Stores a value somewhere the optimizer can't see, so computations whose
+// results are otherwise unused don't get removed.
+template <class T>
+void keep(const T& value)
+{
+    static volatile T sink;
+    sink = value;
+    static_cast<void>(sink);
+}
+
+// Calls f repeatedly for at least min_seconds and returns the average time per call in seconds.
+// f is called in batches that double in size, so the clock is read rarely for cheap functions.
+template <class F>
+double seconds_per_call(F&& f, double min_seconds = 0.25)
+{
+    using clock = std::chrono::steady_clock;
+
+    std::size_t batch_size = 1;
+    while (true)
+    {
+        auto start = clock::now();
+        for (std::size_t i = 0; i < batch_size; ++i)
+        {
+            f();
+        }
+        double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+        if (elapsed >= min_seconds)
+        {
+            return elapsed / batch_size;
+        }
+        batch_size *= 2;
+    }
+}
+
+struct NamedMesh
+{
+    std::string filename;
+    std::vector<demo::math::Vec3> vertices;
+    std::vector<std::uint32_t> indices;
+};
+
+// Loads every .off mesh in a directory, sorted by filename so results are in a stable order.
+// As in the demo, each mesh is reduced to its convex hull, unless the hull is flat.
+inline std::vector<NamedMesh> load_mesh_directory(const std::filesystem::path& path)
+{
+    std::vector<NamedMesh> meshes;
+
+    demo::mesh::IndexedMesh file_mesh;
+
+    for (const auto& p : std::filesystem::directory_iterator(path))
+    {
+        if (p.path().extension() != ".off")
+        {
+            continue;
+        }
+
+        if (demo::mesh::load_off(p.path().c_str(), file_mesh))
+        {
+            NamedMesh mesh{p.path().filename().string(), {}, {}};
+            if (!demo::mesh::compute_convex_hull(file_mesh.vertices, mesh.vertices, mesh.indices))
+            {
+                mesh.vertices = std::move(file_mesh.vertices);
+                mesh.indices = std::move(file_mesh.indices);
+            }
+            meshes.push_back(std::move(mesh));
+        }
+    }
+
+    std::sort(meshes.begin(), meshes.end(), [](const NamedMesh& l, const NamedMesh& r) {
+        return l.filename < r.filename;
+    });
+
+    return meshes;
+}
+
+// Appends unit icospheres with roughly 1k to 100k vertices, for benchmarking large hulls.
+// These are convex, and every vertex is extreme.
+inline void add_icospheres(std::vector<NamedMesh>& meshes, unsigned int min_subdivisions = 4, unsigned int max_subdivisions = 7)
+{
+    for (unsigned int s = min_subdivisions; s <= max_subdivisions; ++s)
+    {
+        NamedMesh mesh;
+        demo::mesh::make_icosphere(s, mesh.vertices, mesh.indices);
+        mesh.filename = "icosphere" + std::to_string(mesh.vertices.size());
+        meshes.push_back(std::move(mesh));
+    }
+}
+
+// Returns a rotation matrix with a uniformly distributed axis and angle
+inline demo::math::Mat3 random_orientation(std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> axis_component(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> angle(0.0f, 2.0f * demo::math::pi);
+
+    demo::math::Vec3 axis;
+    do
+    {
+        axis = demo::math::Vec3(axis_component(rng), axis_component(rng), axis_component(rng));
+    } while (axis.sq_mag() > 1.0f || axis.sq_mag() < 1e-4f);
+
+    axis.normalize();
+    return demo::math::Mat3::AxisAngle(angle(rng) * axis);
+}
+
+// Returns a point uniformly distributed in a cube of the given half-width, centred at the origin
+inline demo::math::Vec3 random_position(std::mt19937& rng, float half_width)
+{
+    std::uniform_real_distribution<float> component(-half_width, half_width);
+    return demo::math::Vec3(component(rng), component(rng), component(rng));
+}
+
+}
+
+#endif
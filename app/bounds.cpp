@@ -0,0 +1,128 @@
+#include "bounds.hpp"
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+#include <variant>
+
+using demo::math::Vec3;
+
+Aabb compute_bounds(const std::vector<Vec3>& vertices)
+{
+    if (vertices.empty())
+    {
+        return Aabb{Vec3(), Vec3()};
+    }
+
+    Aabb bounds{vertices[0], vertices[0]};
+    for (const Vec3& v : vertices)
+    {
+        bounds.min = Vec3(std::min(bounds.min.x, v.x), std::min(bounds.min.y, v.y), std::min(bounds.min.z, v.z));
+        bounds.max = Vec3(std::max(bounds.max.x, v.x), std::max(bounds.max.y, v.y), std::max(bounds.max.z, v.z));
+    }
+    return bounds;
+}
+
+BoundingSphere compute_bounding_sphere(const std::vector<Vec3>& vertices)
+{
+    if (vertices.empty())
+    {
+        return BoundingSphere{Vec3(), 0.0f};
+    }
+
+    // Start from the two vertices furthest apart along a coordinate axis, approximately
+    // found from the vertices which are furthest along each axis
+    std::size_t min_index[3] = {0, 0, 0};
+    std::size_t max_index[3] = {0, 0, 0};
+    for (std::size_t i = 0; i < vertices.size(); ++i)
+    {
+        const float v[3] = {vertices[i].x, vertices[i].y, vertices[i].z};
+        const float min[3] = {vertices[min_index[0]].x, vertices[min_index[1]].y, vertices[min_index[2]].z};
+        const float max[3] = {vertices[max_index[0]].x, vertices[max_index[1]].y, vertices[max_index[2]].z};
+        for (unsigned int axis = 0; axis < 3; ++axis)
+        {
+            if (v[axis] < min[axis])
+            {
+                min_index[axis] = i;
+            }
+            if (v[axis] > max[axis])
+            {
+                max_index[axis] = i;
+            }
+        }
+    }
+
+    unsigned int widest = 0;
+    for (unsigned int axis = 1; axis < 3; ++axis)
+    {
+        if ((vertices[max_index[axis]] - vertices[min_index[axis]]).sq_mag() > (vertices[max_index[widest]] - vertices[min_index[widest]]).sq_mag())
+        {
+            widest = axis;
+        }
+    }
+
+    const Vec3& p = vertices[min_index[widest]];
+    const Vec3& q = vertices[max_index[widest]];
+    Vec3 centre = 0.5f * (p + q);
+    float radius = 0.5f * (q - p).mag();
+
+    // Grow the sphere just enough to take in each vertex outside it
+    for (const Vec3& v : vertices)
+    {
+        float distance = (v - centre).mag();
+        if (distance > radius)
+        {
+            float new_radius = 0.5f * (radius + distance);
+            centre = centre + ((new_radius - radius) / distance) * (v - centre);
+            radius = new_radius;
+        }
+    }
+
+    // Growing rounds the centre, so make sure every vertex ended up inside
+    for (const Vec3& v : vertices)
+    {
+        radius = std::max(radius, (v - centre).mag());
+    }
+    return BoundingSphere{centre, radius * (1.0f + 1e-5f)};
+}
+
+Aabb compute_bounds(const geometry::Primitive<Vec3>& primitive)
+{
+    // Each of the shapes reaches furthest along an axis at its support point along that axis
+    return Aabb{
+        Vec3(geometry::support(primitive, Vec3(-1.0f, 0.0f, 0.0f)).x,
+             geometry::support(primitive, Vec3(0.0f, -1.0f, 0.0f)).y,
+             geometry::support(primitive, Vec3(0.0f, 0.0f, -1.0f)).z),
+        Vec3(geometry::support(primitive, Vec3(1.0f, 0.0f, 0.0f)).x,
+             geometry::support(primitive, Vec3(0.0f, 1.0f, 0.0f)).y,
+             geometry::support(primitive, Vec3(0.0f, 0.0f, 1.0f)).z)};
+}
+
+BoundingSphere compute_bounding_sphere(const geometry::Primitive<Vec3>& primitive)
+{
+    // The furthest points from the centre are a corner of the box, a pole of the capsule,
+    // and a point on the rim of the cylinder and of the cone's base
+    float radius = std::visit([](const auto& shape) {
+        using Shape = std::decay_t<decltype(shape)>;
+        if constexpr (std::is_same_v<Shape, geometry::Sphere<Vec3>>)
+        {
+            return shape.radius;
+        }
+        else if constexpr (std::is_same_v<Shape, geometry::Box<Vec3>>)
+        {
+            return shape.half_extents.mag();
+        }
+        else if constexpr (std::is_same_v<Shape, geometry::RoundedBox<Vec3>>)
+        {
+            return shape.half_extents.mag() + shape.radius;
+        }
+        else if constexpr (std::is_same_v<Shape, geometry::Capsule<Vec3>>)
+        {
+            return shape.half_height + shape.radius;
+        }
+        else
+        {
+            return std::sqrt(shape.half_height * shape.half_height + shape.radius * shape.radius);
+        }
+    }, primitive);
+    return BoundingSphere{Vec3(0.0f, 0.0f, 0.0f), radius * (1.0f + 1e-5f)};
+}
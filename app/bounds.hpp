@@ -0,0 +1,35 @@
+#ifndef BOUNDS_HPP
+#define BOUNDS_HPP
+
+#include "math.hpp"
+#include "shapes.hpp"
+#include <vector>
+
+// Axis-aligned bounding box
+struct Aabb
+{
+    demo::math::Vec3 min;
+    demo::math::Vec3 max;
+};
+
+// Returns the bounds of a set of points, or an empty box at the origin if there are none
+Aabb compute_bounds(const std::vector<demo::math::Vec3>& vertices);
+
+// Sphere containing a mesh, in the mesh's own coordinates
+struct BoundingSphere
+{
+    demo::math::Vec3 centre;
+    float radius = 0.0f;
+};
+
+// Returns a sphere containing every vertex, which is close to, but not always, the smallest
+// (Ritter, An Efficient Bounding Sphere, Graphics Gems, 1990). The radius is padded slightly,
+// so that rounding when the sphere is moved to world space can't leave a vertex outside it.
+BoundingSphere compute_bounding_sphere(const std::vector<demo::math::Vec3>& vertices);
+
+// The bounds and bounding sphere of a primitive shape, in its own coordinates. The bounds are
+// exact, and the sphere is the smallest about the shape's centre, padded as above.
+Aabb compute_bounds(const geometry::Primitive<demo::math::Vec3>& primitive);
+BoundingSphere compute_bounding_sphere(const geometry::Primitive<demo::math::Vec3>& primitive);
+
+#endif
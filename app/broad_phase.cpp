@@ -0,0 +1,242 @@
+#include "broad_phase.hpp"
+#include <algorithm>
+#include <cmath>
+
+using demo::math::Vec3;
+
+Aabb world_bounds(const Aabb& local_bounds, const ConvexHullInstance& instance)
+{
+    // Rotating a box gives a box whose half extent along each world axis is the sum of the
+    // rotated half extents' absolute components (Ericson, Real-Time Collision Detection, 4.2.6)
+    Vec3 centre = 0.5f * (local_bounds.min + local_bounds.max);
+    Vec3 half_extent = 0.5f * (local_bounds.max - local_bounds.min);
+
+    const demo::math::Mat3& r = instance.orientation;
+    Vec3 world_centre = instance.position + r * centre;
+    Vec3 world_half_extent(
+        std::abs(r[0][0])*half_extent.x + std::abs(r[0][1])*half_extent.y + std::abs(r[0][2])*half_extent.z,
+        std::abs(r[1][0])*half_extent.x + std::abs(r[1][1])*half_extent.y + std::abs(r[1][2])*half_extent.z,
+        std::abs(r[2][0])*half_extent.x + std::abs(r[2][1])*half_extent.y + std::abs(r[2][2])*half_extent.z);
+
+    return Aabb{world_centre - world_half_extent, world_centre + world_half_extent};
+}
+
+bool overlap(const Aabb& a, const Aabb& b)
+{
+    return a.min.x <= b.max.x && b.min.x <= a.max.x
+        && a.min.y <= b.max.y && b.min.y <= a.max.y
+        && a.min.z <= b.max.z && b.min.z <= a.max.z;
+}
+
+bool overlap(const BoundingSphere& a, const ConvexHullInstance& instance_a,
+             const BoundingSphere& b, const ConvexHullInstance& instance_b)
+{
+    Vec3 offset = (instance_b.position + instance_b.orientation * b.centre)
+                - (instance_a.position + instance_a.orientation * a.centre);
+    float radii = a.radius + b.radius;
+    return offset.sq_mag() <= radii * radii;
+}
+
+bool overlap(const Aabb& a, const ConvexHullInstance& instance_a,
+             const Aabb& b, const ConvexHullInstance& instance_b)
+{
+    // Separating axis test on the face normals of both boxes and the cross products of their
+    // edges, in a's frame (Ericson, Real-Time Collision Detection, 4.4.1)
+    Vec3 a_half = 0.5f * (a.max - a.min);
+    Vec3 b_half = 0.5f * (b.max - b.min);
+    const float ea[3] = {a_half.x, a_half.y, a_half.z};
+    const float eb[3] = {b_half.x, b_half.y, b_half.z};
+
+    // Rotation of b in a's frame, and the absolute values of its entries, padded so that
+    // nearly parallel edges, whose cross product is close to zero, can't give a false result
+    const demo::math::Mat3 a_transpose = instance_a.orientation.transpose();
+    const demo::math::Mat3 r = a_transpose * instance_b.orientation;
+    float abs_r[3][3];
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        for (unsigned int j = 0; j < 3; ++j)
+        {
+            abs_r[i][j] = std::abs(r[i][j]) + 1e-6f;
+        }
+    }
+
+    Vec3 a_centre = instance_a.position + instance_a.orientation * (0.5f * (a.min + a.max));
+    Vec3 b_centre = instance_b.position + instance_b.orientation * (0.5f * (b.min + b.max));
+    Vec3 offset = a_transpose * (b_centre - a_centre);
+    const float t[3] = {offset.x, offset.y, offset.z};
+
+    // Face normals of a
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        float rb = eb[0]*abs_r[i][0] + eb[1]*abs_r[i][1] + eb[2]*abs_r[i][2];
+        if (std::abs(t[i]) > ea[i] + rb)
+        {
+            return false;
+        }
+    }
+
+    // Face normals of b
+    for (unsigned int j = 0; j < 3; ++j)
+    {
+        float ra = ea[0]*abs_r[0][j] + ea[1]*abs_r[1][j] + ea[2]*abs_r[2][j];
+        if (std::abs(t[0]*r[0][j] + t[1]*r[1][j] + t[2]*r[2][j]) > ra + eb[j])
+        {
+            return false;
+        }
+    }
+
+    // Cross products of edge i of a and edge j of b
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        unsigned int i1 = (i + 1) % 3;
+        unsigned int i2 = (i + 2) % 3;
+        for (unsigned int j = 0; j < 3; ++j)
+        {
+            unsigned int j1 = (j + 1) % 3;
+            unsigned int j2 = (j + 2) % 3;
+            float ra = ea[i1]*abs_r[i2][j] + ea[i2]*abs_r[i1][j];
+            float rb = eb[j1]*abs_r[i][j2] + eb[j2]*abs_r[i][j1];
+            if (std::abs(t[i2]*r[i1][j] - t[i1]*r[i2][j]) > ra + rb)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static float component(const Vec3& v, int axis)
+{
+    return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+static std::uint64_t pair_key(std::uint32_t a, std::uint32_t b)
+{
+    return a < b ? (static_cast<std::uint64_t>(a) << 32) | b : (static_cast<std::uint64_t>(b) << 32) | a;
+}
+
+// Endpoints are ordered by value. Where values are equal, minimum ends come first, so that
+// touching boxes count as overlapping, as in overlap().
+template <class Endpoint>
+static bool endpoint_less(const Endpoint& l, const Endpoint& r)
+{
+    return l.value < r.value || (l.value == r.value && (l.id_and_end & 1u) < (r.id_and_end & 1u));
+}
+
+void SweepAndPrune::rebuild(const std::vector<Aabb>& boxes)
+{
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        std::vector<Endpoint>& axis_endpoints = endpoints[axis];
+        axis_endpoints.resize(2 * boxes.size());
+        for (std::uint32_t i = 0; i < boxes.size(); ++i)
+        {
+            axis_endpoints[2*i] = Endpoint{component(boxes[i].min, axis), i << 1};
+            axis_endpoints[2*i + 1] = Endpoint{component(boxes[i].max, axis), (i << 1) | 1u};
+        }
+        std::sort(axis_endpoints.begin(), axis_endpoints.end(), endpoint_less<Endpoint>);
+    }
+
+    // Sweep along x, testing each box against the boxes which are open when it starts
+    pair_set.clear();
+    std::vector<std::uint32_t> open;
+    std::vector<std::size_t> open_position(boxes.size());
+    for (const Endpoint& endpoint : endpoints[0])
+    {
+        std::uint32_t id = endpoint.id_and_end >> 1;
+        if (endpoint.id_and_end & 1u)
+        {
+            // Remove the box, moving the last open box into its place
+            std::size_t position = open_position[id];
+            open[position] = open.back();
+            open_position[open[position]] = position;
+            open.pop_back();
+        }
+        else
+        {
+            for (std::uint32_t other : open)
+            {
+                if (overlap(boxes[id], boxes[other]))
+                {
+                    pair_set.insert(pair_key(id, other));
+                }
+            }
+            open_position[id] = open.size();
+            open.push_back(id);
+        }
+    }
+}
+
+void SweepAndPrune::update(const std::vector<Aabb>& boxes)
+{
+    last_sort_work = 0;
+    if (endpoints[0].size() != 2 * boxes.size())
+    {
+        rebuild(boxes);
+    }
+    else
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            std::vector<Endpoint>& axis_endpoints = endpoints[axis];
+            for (Endpoint& endpoint : axis_endpoints)
+            {
+                const Aabb& box = boxes[endpoint.id_and_end >> 1];
+                endpoint.value = component((endpoint.id_and_end & 1u) ? box.max : box.min, axis);
+            }
+
+            for (std::size_t i = 1; i < axis_endpoints.size(); ++i)
+            {
+                Endpoint endpoint = axis_endpoints[i];
+                std::uint32_t id = endpoint.id_and_end >> 1;
+                bool is_max = endpoint.id_and_end & 1u;
+
+                std::size_t j = i;
+                while (j > 0 && endpoint_less(endpoint, axis_endpoints[j - 1]))
+                {
+                    const Endpoint& passed = axis_endpoints[j - 1];
+                    std::uint32_t passed_id = passed.id_and_end >> 1;
+                    bool passed_is_max = passed.id_and_end & 1u;
+
+                    if (!is_max && passed_is_max)
+                    {
+                        // This box now starts before the other ends, so they overlap along this
+                        // axis. The other axes may not be sorted yet, so the boxes are checked.
+                        if (overlap(boxes[id], boxes[passed_id]))
+                        {
+                            pair_set.insert(pair_key(id, passed_id));
+                        }
+                    }
+                    else if (is_max && !passed_is_max)
+                    {
+                        // This box now ends before the other starts
+                        pair_set.erase(pair_key(id, passed_id));
+                    }
+
+                    axis_endpoints[j] = passed;
+                    --j;
+                }
+                axis_endpoints[j] = endpoint;
+                last_sort_work += i - j;
+            }
+        }
+    }
+
+    overlapping_pairs.clear();
+    overlapping_pairs.reserve(pair_set.size());
+    for (std::uint64_t key : pair_set)
+    {
+        overlapping_pairs.emplace_back(static_cast<std::uint32_t>(key >> 32), static_cast<std::uint32_t>(key));
+    }
+}
+
+const std::vector<SweepAndPrune::Pair>& SweepAndPrune::pairs() const
+{
+    return overlapping_pairs;
+}
+
+std::size_t SweepAndPrune::sort_work() const
+{
+    return last_sort_work;
+}
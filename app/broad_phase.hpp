@@ -0,0 +1,72 @@
+#ifndef BROAD_PHASE_HPP
+#define BROAD_PHASE_HPP
+
+#include "math.hpp"
+#include "bounds.hpp"
+#include "convex_hull.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Returns the world space bounds of an object, given the bounds of its mesh. The result
+// contains the rotated box, so it may be somewhat larger than the object's tightest bounds.
+Aabb world_bounds(const Aabb& local_bounds, const ConvexHullInstance& instance);
+
+// Returns true iff the boxes overlap or touch
+bool overlap(const Aabb& a, const Aabb& b);
+
+// Returns true iff the spheres of two objects overlap or touch, given the spheres of their meshes
+bool overlap(const BoundingSphere& a, const ConvexHullInstance& instance_a,
+             const BoundingSphere& b, const ConvexHullInstance& instance_b);
+
+// Returns true iff the boxes of two objects overlap or touch, given the bounds of their meshes.
+// Each box is oriented with its object, so this is tighter than testing their world_bounds.
+bool overlap(const Aabb& a, const ConvexHullInstance& instance_a,
+             const Aabb& b, const ConvexHullInstance& instance_b);
+
+// Incremental sort and sweep broad phase (Baraff, Dynamic Simulation of Non-Penetrating Rigid
+// Bodies, 1992). The ends of the boxes are kept sorted along each axis. Objects move little
+// between frames, so the order from the previous frame is nearly sorted, and insertion sort
+// restores it in close to linear time. Each swap of a box's start with another box's end means
+// the pair has started or stopped overlapping along that axis, so the set of overlapping pairs
+// is updated from the swaps alone, without sweeping over every box.
+class SweepAndPrune
+{
+public:
+    using Pair = std::pair<std::uint32_t, std::uint32_t>;
+
+    // Finds the overlapping pairs of boxes, where boxes[i] is the world bounds of object i.
+    // If the number of objects changed since the last update, everything is rebuilt from scratch.
+    void update(const std::vector<Aabb>& boxes);
+
+    // The pairs found by the last update, as object indices with first < second
+    const std::vector<Pair>& pairs() const;
+
+    // Number of swaps made by insertion sort in the last update, over all axes, or zero if
+    // everything was rebuilt
+    std::size_t sort_work() const;
+
+private:
+    // One end of a box along an axis
+    struct Endpoint
+    {
+        float value;
+
+        // The object index shifted left by one, with the low bit set for the maximum end
+        std::uint32_t id_and_end;
+    };
+
+    void rebuild(const std::vector<Aabb>& boxes);
+
+    std::vector<Endpoint> endpoints[3];
+
+    // Keys of the overlapping pairs, with the lower object index in the high 32 bits
+    std::unordered_set<std::uint64_t> pair_set;
+
+    std::vector<Pair> overlapping_pairs;
+    std::size_t last_sort_work = 0;
+};
+
+#endif
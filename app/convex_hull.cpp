@@ -1,25 +1,413 @@
 #include "convex_hull.hpp"
+#include <cassert>
+#include <cstdint>
 #include <limits>
 
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
 ConvexHullInstance::ConvexHullInstance(demo::math::Vec3 pos, demo::math::Mat3 orient, int mesh_id_)
     : position(pos), orientation(orient), mesh_id(mesh_id_)
 {}
 
-demo::math::Vec3 general_support(demo::math::Vec3 dir, const ConvexHullInstance& data, const std::vector<demo::math::Vec3>& vertices)
+ConvexHullInstance pose_at(const ConvexHullInstance& start, demo::math::Vec3 displacement, demo::math::Vec3 rotation, float t)
+{
+    ConvexHullInstance pose = start;
+    pose.position = start.position + t * displacement;
+    pose.orientation = demo::math::Mat3::AxisAngle(t * rotation) * start.orientation;
+    return pose;
+}
+
+// Returns the index of the vertex furthest along local_dir, or count if there are no vertices
+static std::size_t scan_support_index(const demo::math::Vec3& local_dir, const demo::math::Vec3* vertices, std::size_t count)
 {
     float max_dot = -std::numeric_limits<float>::infinity();
-    demo::math::Vec3 max_dot_v = demo::math::Vec3(0.0f, 0.0f, 0.0f);
+    std::size_t max_dot_index = count;
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        float vertex_dot = dot(local_dir, vertices[i]);
+
+        if (vertex_dot > max_dot)
+        {
+            max_dot = vertex_dot;
+            max_dot_index = i;
+        }
+    }
+
+    return max_dot_index;
+}
+
+// Walks from start to neighbouring vertices which are further along local_dir, until no neighbour
+// is further, and returns the index of that vertex. plateau is set if the vertex has a neighbour which
+// is equally far, or if the walk took too many steps. In either case the vertex may not be the furthest.
+static std::uint32_t climb_support_index(const demo::math::Vec3& local_dir,
+                                         const demo::math::Vec3* vertices,
+                                         const demo::mesh::VertexAdjacency& adjacency,
+                                         std::uint32_t start,
+                                         bool& plateau)
+{
+    std::uint32_t current = start;
+    float current_dot = dot(local_dir, vertices[current]);
+
+    // On a convex mesh every step strictly increases the dot product, so no vertex is visited
+    // twice. The step limit only guards against meshes that aren't convex.
+    for (std::size_t step = 0; step < adjacency.vertex_count(); ++step)
+    {
+        std::uint32_t best = current;
+        float best_dot = current_dot;
+        plateau = false;
+
+        for (const std::uint32_t* n = adjacency.begin(current); n != adjacency.end(current); ++n)
+        {
+            float neighbour_dot = dot(local_dir, vertices[*n]);
+            if (neighbour_dot > best_dot)
+            {
+                best = *n;
+                best_dot = neighbour_dot;
+            }
+            else if (neighbour_dot == current_dot)
+            {
+                plateau = true;
+            }
+        }
+
+        if (best == current)
+        {
+            return current;
+        }
+
+        current = best;
+        current_dot = best_dot;
+    }
+
+    plateau = true;
+    return current;
+}
+
+demo::math::Vec3 general_support(demo::math::Vec3 dir, const ConvexHullInstance& data, const std::vector<demo::math::Vec3>& vertices)
+{
+    // The orientation is a rotation, so its transpose rotates dir into the hull's local frame.
+    // This way only the furthest vertex needs to be transformed, rather than every vertex.
+    demo::math::Vec3 local_dir = data.orientation.transpose() * dir;
+
+    std::size_t max_dot_index = scan_support_index(local_dir, vertices.data(), vertices.size());
+    if (max_dot_index == vertices.size())
+    {
+        // There are no vertices
+        return demo::math::Vec3(0.0f, 0.0f, 0.0f);
+    }
+
+    return data.position + data.orientation * vertices[max_dot_index];
+}
+
+demo::math::Vec3 hill_climb_support(demo::math::Vec3 dir,
+                                    const ConvexHullInstance& data,
+                                    const std::vector<demo::math::Vec3>& vertices,
+                                    const demo::mesh::VertexAdjacency& adjacency,
+                                    std::uint32_t& start_vertex)
+{
+    if (adjacency.vertex_count() != vertices.size() || vertices.empty())
+    {
+        // The adjacency doesn't belong to these vertices (or there are no vertices)
+        return general_support(dir, data, vertices);
+    }
+
+    demo::math::Vec3 local_dir = data.orientation.transpose() * dir;
+
+    // The start vertex may belong to a different mesh, if the object's mesh was changed
+    std::uint32_t start = start_vertex < vertices.size() ? start_vertex : 0;
+
+    bool plateau = false;
+    std::uint32_t max_dot_index = climb_support_index(local_dir, vertices.data(), adjacency, start, plateau);
+    if (plateau)
+    {
+        max_dot_index = scan_support_index(local_dir, vertices.data(), vertices.size());
+    }
+
+    start_vertex = max_dot_index;
+    return data.position + data.orientation * vertices[max_dot_index];
+}
+
+demo::math::Vec3 dk_support(demo::math::Vec3 dir, const ConvexHullInstance& data, const DkHierarchy& hierarchy)
+{
+    if (hierarchy.levels.empty() || hierarchy.vertices.empty())
+    {
+        return demo::math::Vec3(0.0f, 0.0f, 0.0f);
+    }
+
+    demo::math::Vec3 local_dir = data.orientation.transpose() * dir;
+    const demo::math::Vec3* vertices = hierarchy.vertices.data();
+
+    std::uint32_t max_dot_index = scan_support_index(local_dir, vertices, hierarchy.levels.back().vertex_count());
+
+    // Refine the answer on each finer level. Plateaus only matter on the finest level, since
+    // the coarser levels just provide a good starting point.
+    bool plateau = false;
+    for (std::size_t level = hierarchy.levels.size() - 1; level-- > 0; )
+    {
+        max_dot_index = climb_support_index(local_dir, vertices, hierarchy.levels[level], max_dot_index, plateau);
+    }
+
+    if (plateau)
+    {
+        max_dot_index = scan_support_index(local_dir, vertices, hierarchy.vertices.size());
+    }
+
+    return data.position + data.orientation * vertices[max_dot_index];
+}
+
+SoaVertices make_soa_vertices(const std::vector<demo::math::Vec3>& vertices)
+{
+    SoaVertices soa;
+    soa.count = vertices.size();
+    soa.blocks.resize((vertices.size() + 7) / 8);
+    for (std::size_t i = 0; i < 8 * soa.blocks.size(); ++i)
+    {
+        const demo::math::Vec3& vertex = vertices[i < vertices.size() ? i : 0];
+        SoaVertices::Block& block = soa.blocks[i / 8];
+        block.x[i % 8] = vertex.x;
+        block.y[i % 8] = vertex.y;
+        block.z[i % 8] = vertex.z;
+    }
+    return soa;
+}
+
+// Returns the index of the vertex furthest along local_dir. Like scan_support_index, this finds the
+// first vertex with the largest dot product. The dot products are evaluated in the same order as
+// dot, so the results are identical.
+static std::size_t simd_support_index(const demo::math::Vec3& local_dir, const SoaVertices& vertices)
+{
+    // Each lane keeps the largest dot product it has seen, and the index of the first vertex
+    // which had it
+    alignas(32) float lane_max[8];
+    alignas(32) std::int32_t lane_index[8];
+
+#if defined(__AVX2__)
+    const __m256 dx = _mm256_set1_ps(local_dir.x);
+    const __m256 dy = _mm256_set1_ps(local_dir.y);
+    const __m256 dz = _mm256_set1_ps(local_dir.z);
+    __m256 max_dot = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+    __m256i max_index = _mm256_setzero_si256();
+    __m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i step = _mm256_set1_epi32(8);
 
-    for (const demo::math::Vec3& vertex : vertices)
+    for (const SoaVertices::Block& block : vertices.blocks)
     {
-        demo::math::Vec3 v = data.position + data.orientation * vertex;
+        __m256 xy = _mm256_add_ps(_mm256_mul_ps(dx, _mm256_load_ps(block.x)), _mm256_mul_ps(dy, _mm256_load_ps(block.y)));
+        __m256 vertex_dot = _mm256_add_ps(xy, _mm256_mul_ps(dz, _mm256_load_ps(block.z)));
 
-        if (dot(dir, v) > max_dot)
+        __m256 greater = _mm256_cmp_ps(vertex_dot, max_dot, _CMP_GT_OQ);
+        max_dot = _mm256_blendv_ps(max_dot, vertex_dot, greater);
+        max_index = _mm256_blendv_epi8(max_index, index, _mm256_castps_si256(greater));
+        index = _mm256_add_epi32(index, step);
+    }
+
+    _mm256_store_ps(lane_max, max_dot);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lane_index), max_index);
+#elif defined(__SSE2__)
+    // Each block is two groups of 4 lanes. SSE2 has no blend instruction, so lanes are
+    // selected with and/andnot/or.
+    const __m128 dx = _mm_set1_ps(local_dir.x);
+    const __m128 dy = _mm_set1_ps(local_dir.y);
+    const __m128 dz = _mm_set1_ps(local_dir.z);
+    __m128 max_dot[2];
+    __m128i max_index[2];
+    __m128i index[2] = {_mm_setr_epi32(0, 1, 2, 3), _mm_setr_epi32(4, 5, 6, 7)};
+    const __m128i step = _mm_set1_epi32(8);
+    for (int half = 0; half < 2; ++half)
+    {
+        max_dot[half] = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+        max_index[half] = _mm_setzero_si128();
+    }
+
+    for (const SoaVertices::Block& block : vertices.blocks)
+    {
+        for (int half = 0; half < 2; ++half)
+        {
+            __m128 xy = _mm_add_ps(_mm_mul_ps(dx, _mm_load_ps(block.x + 4*half)), _mm_mul_ps(dy, _mm_load_ps(block.y + 4*half)));
+            __m128 vertex_dot = _mm_add_ps(xy, _mm_mul_ps(dz, _mm_load_ps(block.z + 4*half)));
+
+            __m128 greater = _mm_cmpgt_ps(vertex_dot, max_dot[half]);
+            __m128i greater_mask = _mm_castps_si128(greater);
+            max_dot[half] = _mm_or_ps(_mm_and_ps(greater, vertex_dot), _mm_andnot_ps(greater, max_dot[half]));
+            max_index[half] = _mm_or_si128(_mm_and_si128(greater_mask, index[half]), _mm_andnot_si128(greater_mask, max_index[half]));
+            index[half] = _mm_add_epi32(index[half], step);
+        }
+    }
+
+    for (int half = 0; half < 2; ++half)
+    {
+        _mm_store_ps(lane_max + 4*half, max_dot[half]);
+        _mm_store_si128(reinterpret_cast<__m128i*>(lane_index + 4*half), max_index[half]);
+    }
+#else
+    for (int lane = 0; lane < 8; ++lane)
+    {
+        lane_max[lane] = -std::numeric_limits<float>::infinity();
+        lane_index[lane] = 0;
+    }
+
+    std::int32_t base = 0;
+    for (const SoaVertices::Block& block : vertices.blocks)
+    {
+        for (int lane = 0; lane < 8; ++lane)
+        {
+            float vertex_dot = local_dir.x*block.x[lane] + local_dir.y*block.y[lane] + local_dir.z*block.z[lane];
+            if (vertex_dot > lane_max[lane])
+            {
+                lane_max[lane] = vertex_dot;
+                lane_index[lane] = base + lane;
+            }
+        }
+        base += 8;
+    }
+#endif
+
+    // Combine the lanes, preferring the lowest index among equally far vertices
+    std::size_t best = 0;
+    for (std::size_t lane = 1; lane < 8; ++lane)
+    {
+        if (lane_max[lane] > lane_max[best] || (lane_max[lane] == lane_max[best] && lane_index[lane] < lane_index[best]))
+        {
+            best = lane;
+        }
+    }
+    return static_cast<std::size_t>(lane_index[best]);
+}
+
+demo::math::Vec3 simd_support(demo::math::Vec3 dir, const ConvexHullInstance& data, const SoaVertices& vertices)
+{
+    if (vertices.count == 0)
+    {
+        return demo::math::Vec3(0.0f, 0.0f, 0.0f);
+    }
+
+    demo::math::Vec3 local_dir = data.orientation.transpose() * dir;
+    std::size_t i = simd_support_index(local_dir, vertices);
+
+    const SoaVertices::Block& block = vertices.blocks[i / 8];
+    demo::math::Vec3 vertex(block.x[i % 8], block.y[i % 8], block.z[i % 8]);
+    return data.position + data.orientation * vertex;
+}
+
+void batch_support(const demo::math::Vec3* dirs,
+                   const ConvexHullInstance* const* data,
+                   std::size_t count,
+                   const std::vector<demo::math::Vec3>& vertices,
+                   demo::math::Vec3* points)
+{
+    assert(count <= 8);
+    if (vertices.empty())
+    {
+        for (std::size_t k = 0; k < count; ++k)
+        {
+            points[k] = demo::math::Vec3(0.0f, 0.0f, 0.0f);
+        }
+        return;
+    }
+
+    // Each object's direction in the mesh's frame, as general_support computes it, one object
+    // per lane. Unused lanes search along zero, and their results are ignored.
+    alignas(32) float local_x[8] = {};
+    alignas(32) float local_y[8] = {};
+    alignas(32) float local_z[8] = {};
+    for (std::size_t k = 0; k < count; ++k)
+    {
+        demo::math::Vec3 local_dir = data[k]->orientation.transpose() * dirs[k];
+        local_x[k] = local_dir.x;
+        local_y[k] = local_dir.y;
+        local_z[k] = local_dir.z;
+    }
+
+    // Each lane keeps the largest dot product along its direction, and the index of the first
+    // vertex which had it, like scan_support_index. The dot products are evaluated in the same
+    // order as dot, so the results are identical.
+    alignas(32) std::int32_t lane_index[8];
+    const std::int32_t vertex_count = static_cast<std::int32_t>(vertices.size());
+
+#if defined(__AVX2__)
+    const __m256 dx = _mm256_load_ps(local_x);
+    const __m256 dy = _mm256_load_ps(local_y);
+    const __m256 dz = _mm256_load_ps(local_z);
+    __m256 max_dot = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+    __m256i max_index = _mm256_setzero_si256();
+
+    for (std::int32_t i = 0; i < vertex_count; ++i)
+    {
+        const demo::math::Vec3& vertex = vertices[i];
+        __m256 xy = _mm256_add_ps(_mm256_mul_ps(dx, _mm256_broadcast_ss(&vertex.x)), _mm256_mul_ps(dy, _mm256_broadcast_ss(&vertex.y)));
+        __m256 vertex_dot = _mm256_add_ps(xy, _mm256_mul_ps(dz, _mm256_broadcast_ss(&vertex.z)));
+
+        __m256 greater = _mm256_cmp_ps(vertex_dot, max_dot, _CMP_GT_OQ);
+        max_dot = _mm256_blendv_ps(max_dot, vertex_dot, greater);
+        max_index = _mm256_blendv_epi8(max_index, _mm256_set1_epi32(i), _mm256_castps_si256(greater));
+    }
+
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lane_index), max_index);
+#elif defined(__SSE2__)
+    // Two groups of 4 lanes, the second only if there are more than 4 objects
+    const int halves = count > 4 ? 2 : 1;
+    for (int half = 0; half < halves; ++half)
+    {
+        const __m128 dx = _mm_load_ps(local_x + 4*half);
+        const __m128 dy = _mm_load_ps(local_y + 4*half);
+        const __m128 dz = _mm_load_ps(local_z + 4*half);
+        __m128 max_dot = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+        __m128i max_index = _mm_setzero_si128();
+
+        for (std::int32_t i = 0; i < vertex_count; ++i)
         {
-            max_dot = dot(dir, v);
-            max_dot_v = v;
+            const demo::math::Vec3& vertex = vertices[i];
+            __m128 xy = _mm_add_ps(_mm_mul_ps(dx, _mm_set1_ps(vertex.x)), _mm_mul_ps(dy, _mm_set1_ps(vertex.y)));
+            __m128 vertex_dot = _mm_add_ps(xy, _mm_mul_ps(dz, _mm_set1_ps(vertex.z)));
+
+            __m128 greater = _mm_cmpgt_ps(vertex_dot, max_dot);
+            __m128i greater_mask = _mm_castps_si128(greater);
+            max_dot = _mm_or_ps(_mm_and_ps(greater, vertex_dot), _mm_andnot_ps(greater, max_dot));
+            max_index = _mm_or_si128(_mm_and_si128(greater_mask, _mm_set1_epi32(i)), _mm_andnot_si128(greater_mask, max_index));
+        }
+
+        _mm_store_si128(reinterpret_cast<__m128i*>(lane_index + 4*half), max_index);
+    }
+#else
+    float lane_max[8];
+    for (std::size_t k = 0; k < count; ++k)
+    {
+        lane_max[k] = -std::numeric_limits<float>::infinity();
+        lane_index[k] = 0;
+    }
+
+    for (std::int32_t i = 0; i < vertex_count; ++i)
+    {
+        const demo::math::Vec3& vertex = vertices[i];
+        for (std::size_t k = 0; k < count; ++k)
+        {
+            float vertex_dot = local_x[k]*vertex.x + local_y[k]*vertex.y + local_z[k]*vertex.z;
+            if (vertex_dot > lane_max[k])
+            {
+                lane_max[k] = vertex_dot;
+                lane_index[k] = i;
+            }
         }
     }
+#endif
 
-    return max_dot_v;
+    for (std::size_t k = 0; k < count; ++k)
+    {
+        points[k] = data[k]->position + data[k]->orientation * vertices[lane_index[k]];
+    }
+}
+
+demo::math::Vec3 primitive_support(demo::math::Vec3 dir, const ConvexHullInstance& data, const geometry::Primitive<demo::math::Vec3>& primitive)
+{
+    demo::math::Vec3 local_dir = data.orientation.transpose() * dir;
+    return data.position + data.orientation * geometry::support(primitive, local_dir);
+}
+
+demo::math::Vec3 primitive_core_support(demo::math::Vec3 dir, const ConvexHullInstance& data, const geometry::Primitive<demo::math::Vec3>& primitive)
+{
+    demo::math::Vec3 local_dir = data.orientation.transpose() * dir;
+    return data.position + data.orientation * geometry::core_support(primitive, local_dir);
 }
@@ -2,6 +2,10 @@
 #define CONVEX_HULL_HPP
 
 #include "math.hpp"
+#include "mesh_tools.hpp"
+#include "dk_hierarchy.hpp"
+#include "shapes.hpp"
+#include <cstdint>
 #include <vector>
 
 struct ConvexHullInstance
@@ -17,6 +21,86 @@ struct ConvexHullInstance
     ConvexHullInstance(demo::math::Vec3 pos, demo::math::Mat3 orient, int mesh_id_);
 };
 
+// Returns the pose of an object at time t in [0, 1] of a step over which it moves by
+// displacement and turns by rotation (an axis scaled by the angle), about its position, from
+// the pose start. The object is moved as the demo moves it each frame.
+ConvexHullInstance pose_at(const ConvexHullInstance& start, demo::math::Vec3 displacement, demo::math::Vec3 rotation, float t);
+
+// How the support mapping of a mesh is evaluated
+enum class SupportMethod
+{
+    // Test every vertex. Works for any mesh.
+    Scan,
+
+    // Walk the vertex adjacency graph from the previous result. Only correct for convex meshes.
+    HillClimb,
+
+    // Walk down a Dobkin-Kirkpatrick hierarchy. Only correct for convex meshes.
+    Hierarchy,
+
+    // Test every vertex like Scan, several at a time with SIMD instructions. Works for any mesh.
+    SimdScan
+};
+
+// A copy of a mesh's vertices for simd_support. The vertices are grouped into blocks of 8, and
+// each block stores the x, y and z coordinates as separate arrays, so a vector register can be
+// loaded with one coordinate of several vertices. The last block is padded with copies of the
+// first vertex, which never changes which vertex is found.
+struct SoaVertices
+{
+    struct alignas(32) Block
+    {
+        float x[8];
+        float y[8];
+        float z[8];
+    };
+
+    std::vector<Block> blocks;
+    std::size_t count = 0;
+};
+
+SoaVertices make_soa_vertices(const std::vector<demo::math::Vec3>& vertices);
+
 demo::math::Vec3 general_support(demo::math::Vec3 dir, const ConvexHullInstance& data, const std::vector<demo::math::Vec3>& vertices);
 
+// Returns the same point as general_support, by walking from start_vertex to neighbouring vertices
+// which are further along dir until no neighbour is further. start_vertex is set to the index of the
+// returned vertex, so passing it to the next query for the same object makes the walk short when
+// the direction changes little between queries. If the walk reaches a vertex whose neighbours are
+// no further but some are equally far (which happens for non-extreme vertices on a flat face), this
+// falls back to testing every vertex.
+demo::math::Vec3 hill_climb_support(demo::math::Vec3 dir,
+                                    const ConvexHullInstance& data,
+                                    const std::vector<demo::math::Vec3>& vertices,
+                                    const demo::mesh::VertexAdjacency& adjacency,
+                                    std::uint32_t& start_vertex);
+
+// Returns the same point as general_support in O(log n) time, using a hierarchy built by
+// build_dk_hierarchy. This needs no starting point, so it is suited to queries with no
+// coherence between them.
+demo::math::Vec3 dk_support(demo::math::Vec3 dir, const ConvexHullInstance& data, const DkHierarchy& hierarchy);
+
+// Returns the same point as general_support, computing the dot products of 8 vertices at a time
+// with AVX2 if it is enabled, or 4 at a time with SSE2.
+demo::math::Vec3 simd_support(demo::math::Vec3 dir, const ConvexHullInstance& data, const SoaVertices& vertices);
+
+// Sets points[k] to the same point as general_support(dirs[k], *data[k], vertices), for count
+// objects of up to 8 which share a mesh. The vertices are scanned once for all of them, with
+// the dot products along every object's direction computed at once: 8 with AVX2, or 4 at a
+// time with SSE2. This suits many queries against one mesh, such as the pairs in a lane of
+// intersect_gjk_batch.
+void batch_support(const demo::math::Vec3* dirs,
+                   const ConvexHullInstance* const* data,
+                   std::size_t count,
+                   const std::vector<demo::math::Vec3>& vertices,
+                   demo::math::Vec3* points);
+
+// Returns the support point of a primitive shape in the object's pose. This takes the same
+// time whatever the shape, and is exact, where a mesh would only approximate round shapes.
+demo::math::Vec3 primitive_support(demo::math::Vec3 dir, const ConvexHullInstance& data, const geometry::Primitive<demo::math::Vec3>& primitive);
+
+// Returns the support point of the core of a primitive shape in the object's pose, for
+// intersect_gjk_margins with geometry::margin(primitive)
+demo::math::Vec3 primitive_core_support(demo::math::Vec3 dir, const ConvexHullInstance& data, const geometry::Primitive<demo::math::Vec3>& primitive);
+
 #endif
@@ -1,11 +1,23 @@
 #include "gjk.hpp"
+#include "mpr.hpp"
+#include "toi.hpp"
 #include "math.hpp"
 #include "rendering.hpp"
 #include "load_mesh.hpp"
 #include "input.hpp"
 #include "convex_hull.hpp"
-
+#include "mesh_cache.hpp"
+#include "quickhull.hpp"
+#include "shapes.hpp"
+#include "broad_phase.hpp"
+#include "aabb_tree.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
 #include <array>
+#include <optional>
+#include <cstdint>
+#include <unordered_map>
 #include <thread>    // sleep_for needed to enforce framerate
 #include <iostream>
 #include <iomanip>
@@ -28,7 +40,28 @@ using namespace demo::rendering;
 struct Mesh
 {
     std::size_t render_id;
+
+    // The vertices of the mesh's convex hull, which is what collision detection uses. The
+    // mesh is rendered from the triangles of the file it was loaded from, which are only kept
+    // on the GPU.
     std::vector<Vec3> vertices;
+    Aabb bounds;
+    BoundingSphere sphere;
+    demo::mesh::VertexAdjacency adjacency;
+    SupportMethod support_method = SupportMethod::Scan;
+
+    // Pairs with this mesh use MPR if either mesh is set to it, starting from the centroid of
+    // the hull vertices, which is inside the hull
+    geometry::IntersectionAlgorithm algorithm = geometry::IntersectionAlgorithm::Gjk;
+    Vec3 centroid;
+
+    // Set for primitive shapes, which use their exact support mapping rather than the vertices.
+    // The mesh they are drawn with is only an approximation, and vertices is left empty.
+    std::optional<geometry::Primitive<Vec3>> primitive;
+
+    // Only built once the hierarchy or simd support method is selected for the mesh
+    DkHierarchy dk_hierarchy;
+    SoaVertices soa_vertices;
     std::string filename;
 
     Mesh(std::size_t render_id_, std::string&& filename_)
@@ -36,75 +69,171 @@ struct Mesh
     {}
 };
 
+// Loads an OFF file into a new mesh, and prints whether it succeeded.
+void load_mesh_file(const fs::path& path, RenderContext& render_ctxt, std::vector<Mesh>& meshes)
+{
+    // The hull, adjacency and bounds are read from the mesh's cache, which is only rebuilt
+    // from the OFF file when that has changed. The triangles are uploaded straight from it.
+    demo::mesh::MeshCache cache;
+    if (!cache.open(path))
+    {
+        std::cerr << "Unable to load mesh " << path << ".\n";
+    }
+    else if (cache.hull_vertex_count() == 0)
+    {
+        // Support mappings and the centroid need at least one vertex
+        std::cerr << "Mesh " << path << " has no vertices.\n";
+    }
+    else
+    {
+        meshes.emplace_back(
+            render_ctxt.load_object(
+                cache.render_vertices(),
+                cache.render_vertex_count(),
+                cache.render_indices(),
+                cache.render_index_count()),
+            path.string());
+
+        Mesh& mesh = meshes.back();
+        mesh.vertices.assign(cache.hull_vertices(), cache.hull_vertices() + cache.hull_vertex_count());
+        mesh.adjacency.offsets.assign(cache.adjacency_offsets(), cache.adjacency_offsets() + cache.hull_vertex_count() + 1);
+        mesh.adjacency.neighbours.assign(cache.adjacency_neighbours(), cache.adjacency_neighbours() + cache.adjacency_neighbour_count());
+        mesh.bounds = cache.bounds();
+        mesh.sphere = cache.sphere();
+        for (const Vec3& v : mesh.vertices)
+        {
+            mesh.centroid += v;
+        }
+        mesh.centroid = (1.0f / static_cast<float>(mesh.vertices.size())) * mesh.centroid;
+        std::cout << "Loaded mesh " << path << ", with " << mesh.vertices.size() << " of its "
+                  << cache.render_vertex_count() << " vertices on its convex hull"
+                  << (cache.rebuilt() ? ", and rebuilt its cache.\n" : ".\n");
+    }
+}
+
+// Adds a primitive shape as a new mesh, and prints its ID. It is drawn as the hull of its support
+// points in the directions of the vertices of an icosphere.
+void add_primitive(const geometry::Primitive<Vec3>& primitive, std::string&& name, RenderContext& render_ctxt, std::vector<Mesh>& meshes)
+{
+    std::vector<Vec3> directions;
+    std::vector<std::uint32_t> sphere_indices;
+    demo::mesh::make_icosphere(3, directions, sphere_indices);
+
+    std::vector<Vec3> points;
+    points.reserve(directions.size());
+    for (const Vec3& d : directions)
+    {
+        points.push_back(geometry::support(primitive, d));
+    }
+
+    demo::mesh::IndexedMesh render_mesh;
+    demo::mesh::compute_convex_hull(points, render_mesh.vertices, render_mesh.indices);
+
+    meshes.emplace_back(render_ctxt.load_object(render_mesh), std::move(name));
+    meshes.back().primitive = primitive;
+    meshes.back().bounds = compute_bounds(primitive);
+    meshes.back().sphere = compute_bounding_sphere(primitive);
+    std::cout << "Added " << meshes.back().filename << " as mesh " << meshes.size() - 1 << ".\n";
+}
+
+const char* support_method_name(SupportMethod method)
+{
+    switch (method)
+    {
+    case SupportMethod::HillClimb:
+        return "climb";
+    case SupportMethod::Hierarchy:
+        return "dk";
+    case SupportMethod::SimdScan:
+        return "simd";
+    case SupportMethod::Scan:
+    default:
+        return "scan";
+    }
+}
+
+enum class BroadPhaseMethod
+{
+    SweepAndPrune,
+    Tree
+};
+
+const char* algorithm_name(geometry::IntersectionAlgorithm algorithm)
+{
+    return algorithm == geometry::IntersectionAlgorithm::Mpr ? "mpr" : "gjk";
+}
+
+const char* broad_phase_name(BroadPhaseMethod method)
+{
+    return method == BroadPhaseMethod::Tree ? "tree" : "sap";
+}
+
+// Counts of narrow phase queries, reported by the "stats" command
+struct CollisionStats
+{
+    std::size_t query_count = 0;
+    std::size_t iteration_count = 0;
+    std::size_t warm_start_count = 0;
+    std::size_t cache_hit_count = 0;
+    std::size_t fallback_count = 0;
+    std::size_t bounds_rejection_count = 0;
+    std::size_t swept_query_count = 0;
+    std::size_t swept_hit_count = 0;
+    std::size_t frame_count = 0;
+};
+
 struct InputCommands
 {
-    void handle_commands(RenderContext& render_ctxt, std::vector<Mesh>& meshes, int& currently_selected_mesh)
+    void handle_commands(RenderContext& render_ctxt, std::vector<Mesh>& meshes, int& currently_selected_mesh,
+                         BroadPhaseMethod& current_broad_phase, CollisionStats& collision_stats)
     {
         // Handle input from the input thread
         if (load_mesh)
         {
-            std::vector<Vec3> vertices;
-            std::vector<Vec3> triangles;
-            std::vector<Vec3> normals;
-
             // Check if the filename is a directory
             fs::path path(mesh_filename);
             if (fs::is_directory(path))
             {
                 std::cout << "Loading meshes in directory " << path << ":\n";
 
+                // The caches written next to the OFF files are skipped, along with anything else
                 for (const auto& p : fs::directory_iterator(path))
                 {
-                    demo::mesh::load_off(p.path().c_str(), vertices, triangles, normals);
-                    if (vertices.size() && triangles.size() && normals.size())
+                    if (p.path().extension() == ".off")
                     {
-                        meshes.emplace_back(
-                            render_ctxt.load_object(
-                                triangles.data(),
-                                normals.data(),
-                                triangles.size()),
-                            p.path());
-                        meshes.back().vertices = std::move(vertices);
-                        std::cout << "Loaded mesh " << p.path() << ".\n";
-                    }
-                    else
-                    {
-                        std::cerr << "Unable to load mesh " << p.path() << ".\n";
+                        load_mesh_file(p.path(), render_ctxt, meshes);
                     }
                 }
             }
             else
             {
-                demo::mesh::load_off(path.c_str(), vertices, triangles, normals);
-                if (vertices.size() && triangles.size() && normals.size())
-                {
-                    meshes.emplace_back(
-                        render_ctxt.load_object(
-                            triangles.data(),
-                            normals.data(),
-                            triangles.size()),
-                        path);
-                    meshes.back().vertices = std::move(vertices);
-                    std::cout << "Loaded mesh " << path << ".\n";
-                }
-                else
-                {
-                    std::cerr << "Unable to load mesh: " << path << ".\n";
-                }
+                load_mesh_file(path, render_ctxt, meshes);
             }
 
             std::scoped_lock lock(mutex);
             load_mesh = false;
             cv.notify_one();
         }
+        if (add_shape)
+        {
+            std::scoped_lock lock(mutex);
+
+            add_primitive(shape, std::move(shape_name), render_ctxt, meshes);
+
+            add_shape = false;
+            cv.notify_one();
+        }
         if (list_mesh)
         {
             std::scoped_lock lock(mutex);
 
-            std::cout << "Mesh ID   Number of Vertices   Filename\n";
+            std::cout << "Mesh ID   Number of Vertices   Support   Narrow   Filename\n";
             for (std::size_t i = 0; i < meshes.size(); ++i)
             {
-                std::cout << std::left << std::setw(10) << i << std::setw(21) << meshes[i].vertices.size() << meshes[i].filename << "\n";
+                std::cout << std::left << std::setw(10) << i << std::setw(21) << meshes[i].vertices.size()
+                          << std::setw(10) << (meshes[i].primitive ? "exact" : support_method_name(meshes[i].support_method))
+                          << std::setw(9) << algorithm_name(meshes[i].algorithm)
+                          << meshes[i].filename << "\n";
             }
 
             list_mesh = false;
@@ -127,16 +256,114 @@ struct InputCommands
             select_mesh = false;
             cv.notify_one();
         }
+        if (set_support)
+        {
+            std::scoped_lock lock(mutex);
+
+            if (static_cast<std::size_t>(currently_selected_mesh) < meshes.size() && meshes[currently_selected_mesh].primitive)
+            {
+                std::cout << "Mesh " << currently_selected_mesh << " is a primitive shape, whose support mapping is exact.\n";
+            }
+            else if (static_cast<std::size_t>(currently_selected_mesh) < meshes.size())
+            {
+                Mesh& mesh = meshes[currently_selected_mesh];
+                if (support_method == SupportMethod::Hierarchy && mesh.dk_hierarchy.levels.empty())
+                {
+                    DkBuildReport report = build_dk_hierarchy(mesh.vertices, mesh.adjacency, mesh.dk_hierarchy);
+                    std::cout << "Built hierarchy with " << report.level_count << " levels, "
+                              << report.total_edge_count << " edges and " << report.top_level_vertex_count
+                              << " vertices in the top level, in " << 1e3 * report.build_seconds << " ms.\n";
+                }
+                if (support_method == SupportMethod::SimdScan && mesh.soa_vertices.count != mesh.vertices.size())
+                {
+                    mesh.soa_vertices = make_soa_vertices(mesh.vertices);
+                }
+
+                mesh.support_method = support_method;
+                std::cout << "Mesh " << currently_selected_mesh << " uses support method "
+                          << support_method_name(support_method) << ".\n";
+            }
+            else
+            {
+                std::cout << "Error: No mesh is selected.\n";
+            }
+
+            set_support = false;
+            cv.notify_one();
+        }
+        if (set_algorithm)
+        {
+            std::scoped_lock lock(mutex);
+
+            if (static_cast<std::size_t>(currently_selected_mesh) < meshes.size())
+            {
+                meshes[currently_selected_mesh].algorithm = algorithm;
+                std::cout << "Mesh " << currently_selected_mesh << " uses narrow phase "
+                          << algorithm_name(algorithm) << ".\n";
+            }
+            else
+            {
+                std::cout << "Error: No mesh is selected.\n";
+            }
+
+            set_algorithm = false;
+            cv.notify_one();
+        }
+        if (set_broad_phase)
+        {
+            std::scoped_lock lock(mutex);
+
+            current_broad_phase = broad_phase_method;
+            std::cout << "Using broad phase " << broad_phase_name(current_broad_phase) << ".\n";
+
+            set_broad_phase = false;
+            cv.notify_one();
+        }
+        if (print_stats)
+        {
+            std::scoped_lock lock(mutex);
+
+            const CollisionStats& c = collision_stats;
+            std::cout << "Broad phase " << broad_phase_name(current_broad_phase) << ". "
+                      << c.query_count << " GJK queries since the last report, averaging "
+                      << (c.query_count ? double(c.iteration_count) / c.query_count : 0.0) << " iterations.\n";
+            std::cout << c.warm_start_count << " started from a cached direction, of which "
+                      << c.cache_hit_count << " were separated by it immediately.\n";
+            std::cout << c.fallback_count << " were repeated in double precision.\n";
+            std::cout << c.bounds_rejection_count << " pairs were separated by their bounding spheres or boxes without running GJK, "
+                      << (c.frame_count ? double(c.bounds_rejection_count) / c.frame_count : 0.0) << " per frame.\n";
+            std::cout << c.swept_query_count << " time of impact queries checked the motion of the selected object, and "
+                      << c.swept_hit_count << " found it touching another object during the frame.\n";
+            collision_stats = CollisionStats();
+
+            print_stats = false;
+            cv.notify_one();
+        }
     }
 
     std::atomic_bool load_mesh = false;
     std::string mesh_filename;
 
+    std::atomic_bool add_shape = false;
+    geometry::Primitive<Vec3> shape;
+    std::string shape_name;
+
     std::atomic_bool list_mesh = false;
 
     std::atomic_bool select_mesh = false;
     std::size_t selected_mesh = 0;
 
+    std::atomic_bool set_support = false;
+    SupportMethod support_method = SupportMethod::Scan;
+
+    std::atomic_bool set_algorithm = false;
+    geometry::IntersectionAlgorithm algorithm = geometry::IntersectionAlgorithm::Gjk;
+
+    std::atomic_bool set_broad_phase = false;
+    BroadPhaseMethod broad_phase_method = BroadPhaseMethod::SweepAndPrune;
+
+    std::atomic_bool print_stats = false;
+
     std::atomic_bool quit = false;
 
     std::mutex mutex;
@@ -148,7 +375,7 @@ void input_thread_func(InputCommands& io_data)
     // Wait for the previous command to finish
     {
         std::unique_lock lock(io_data.mutex);
-        while ((io_data.load_mesh || io_data.list_mesh || io_data.select_mesh) && !io_data.quit)
+        while ((io_data.load_mesh || io_data.add_shape || io_data.list_mesh || io_data.select_mesh || io_data.set_support || io_data.set_algorithm || io_data.set_broad_phase || io_data.print_stats) && !io_data.quit)
         {
             io_data.cv.wait(lock);
         }
@@ -184,6 +411,63 @@ void input_thread_func(InputCommands& io_data)
 
             io_data.load_mesh = true;
         }
+        else if (word == "shape")
+        {
+            // Command to add a primitive shape, followed by its sizes
+
+            std::string kind;
+            command_sstream >> kind;
+
+            std::vector<float> sizes;
+            float size;
+            while (command_sstream >> size)
+            {
+                sizes.push_back(size);
+            }
+            bool positive = std::all_of(sizes.begin(), sizes.end(), [](float s) { return s > 0.0f; });
+
+            if (kind == "sphere" && sizes.size() == 1 && positive)
+            {
+                io_data.shape = geometry::Sphere<Vec3>{sizes[0]};
+            }
+            else if (kind == "box" && sizes.size() == 3 && positive)
+            {
+                io_data.shape = geometry::Box<Vec3>{Vec3(sizes[0], sizes[1], sizes[2])};
+            }
+            else if (kind == "roundbox" && sizes.size() == 4 && positive)
+            {
+                io_data.shape = geometry::RoundedBox<Vec3>{Vec3(sizes[0], sizes[1], sizes[2]), sizes[3]};
+            }
+            else if (kind == "capsule" && sizes.size() == 2 && positive)
+            {
+                io_data.shape = geometry::Capsule<Vec3>{sizes[0], sizes[1]};
+            }
+            else if (kind == "cylinder" && sizes.size() == 2 && positive)
+            {
+                io_data.shape = geometry::Cylinder<Vec3>{sizes[0], sizes[1]};
+            }
+            else if (kind == "cone" && sizes.size() == 2 && positive)
+            {
+                io_data.shape = geometry::Cone<Vec3>{sizes[0], sizes[1]};
+            }
+            else
+            {
+                std::cerr << "Unknown shape, or wrong number of sizes\n";
+                kind.clear();
+            }
+
+            if (!kind.empty())
+            {
+                std::ostringstream name;
+                name << kind;
+                for (float s : sizes)
+                {
+                    name << " " << s;
+                }
+                io_data.shape_name = name.str();
+                io_data.add_shape = true;
+            }
+        }
         else if (word == "list")
         {
             command_sstream >> word;
@@ -202,6 +486,77 @@ void input_thread_func(InputCommands& io_data)
             command_sstream >> io_data.selected_mesh;
             io_data.select_mesh = true;
         }
+        else if (word == "support")
+        {
+            command_sstream >> word;
+
+            if (word == "scan")
+            {
+                io_data.support_method = SupportMethod::Scan;
+                io_data.set_support = true;
+            }
+            else if (word == "climb")
+            {
+                io_data.support_method = SupportMethod::HillClimb;
+                io_data.set_support = true;
+            }
+            else if (word == "dk")
+            {
+                io_data.support_method = SupportMethod::Hierarchy;
+                io_data.set_support = true;
+            }
+            else if (word == "simd")
+            {
+                io_data.support_method = SupportMethod::SimdScan;
+                io_data.set_support = true;
+            }
+            else
+            {
+                std::cerr << "Unknown support method\n";
+            }
+        }
+        else if (word == "narrowphase")
+        {
+            command_sstream >> word;
+
+            if (word == "gjk")
+            {
+                io_data.algorithm = geometry::IntersectionAlgorithm::Gjk;
+                io_data.set_algorithm = true;
+            }
+            else if (word == "mpr")
+            {
+                io_data.algorithm = geometry::IntersectionAlgorithm::Mpr;
+                io_data.set_algorithm = true;
+            }
+            else
+            {
+                std::cerr << "Unknown narrow phase\n";
+            }
+        }
+        else if (word == "broadphase")
+        {
+            command_sstream >> word;
+
+            if (word == "sap")
+            {
+                io_data.broad_phase_method = BroadPhaseMethod::SweepAndPrune;
+                io_data.set_broad_phase = true;
+            }
+            else if (word == "tree")
+            {
+                io_data.broad_phase_method = BroadPhaseMethod::Tree;
+                io_data.set_broad_phase = true;
+            }
+            else
+            {
+                std::cerr << "Unknown broad phase\n";
+            }
+        }
+        else if (word == "stats")
+        {
+            io_data.print_stats = true;
+        }
         else if (word == "exit" || word == "quit")
         {
             io_data.quit = true;
@@ -218,7 +573,7 @@ void input_thread_func(InputCommands& io_data)
         // Wait for previous command to finish
         {
             std::unique_lock lock(io_data.mutex);
-            while ((io_data.load_mesh || io_data.list_mesh || io_data.select_mesh) && !io_data.quit)
+            while ((io_data.load_mesh || io_data.add_shape || io_data.list_mesh || io_data.select_mesh || io_data.set_support || io_data.set_algorithm || io_data.set_broad_phase || io_data.print_stats) && !io_data.quit)
             {
                 io_data.cv.wait(lock);
             }
@@ -226,6 +581,81 @@ void input_thread_func(InputCommands& io_data)
     }
 }
 
+// Evaluates the support mapping of an object, using the method selected for its mesh.
+// start_vertex is the hill climbing starting point, which is updated for the next query.
+Vec3 mesh_support(const Vec3& d, const ConvexHullInstance& object, const Mesh& mesh, std::uint32_t& start_vertex)
+{
+    if (mesh.primitive)
+    {
+        return primitive_support(d, object, *mesh.primitive);
+    }
+
+    switch (mesh.support_method)
+    {
+    case SupportMethod::HillClimb:
+        return hill_climb_support(d, object, mesh.vertices, mesh.adjacency, start_vertex);
+    case SupportMethod::Hierarchy:
+        return dk_support(d, object, mesh.dk_hierarchy);
+    case SupportMethod::SimdScan:
+        return simd_support(d, object, mesh.soa_vertices);
+    case SupportMethod::Scan:
+    default:
+        return general_support(d, object, mesh.vertices);
+    }
+}
+
+// The radius the core of an object's shape is swept by. Only primitive shapes have one.
+float mesh_margin(const Mesh& mesh)
+{
+    return mesh.primitive ? geometry::margin(*mesh.primitive) : 0.0f;
+}
+
+// Evaluates the support mapping of the core of an object, which is the whole shape for meshes
+Vec3 mesh_core_support(const Vec3& d, const ConvexHullInstance& object, const Mesh& mesh, std::uint32_t& start_vertex)
+{
+    if (mesh.primitive)
+    {
+        return primitive_core_support(d, object, *mesh.primitive);
+    }
+    return mesh_support(d, object, mesh, start_vertex);
+}
+
+// Returns the distance from p to the segment from a to b
+float distance_to_segment(const Vec3& p, const Vec3& a, const Vec3& b)
+{
+    Vec3 ab = b - a;
+    float length_sq = dot(ab, ab);
+    float s = length_sq > 0.0f ? std::clamp(dot(p - a, ab) / length_sq, 0.0f, 1.0f) : 0.0f;
+    return (p - (a + s * ab)).mag();
+}
+
+// State carried between frames for a pair of objects
+struct PairCache
+{
+    // Hill climbing starting points for the first and second object
+    std::uint32_t start_vertex[2] = {0, 0};
+
+    // Starting direction for GJK
+    geometry::GjkCache<Vec3> gjk;
+};
+
+// Output of the narrow phase for a pair of objects
+struct PairResult
+{
+    bool intersection = false;
+    geometry::GjkStats stats;
+
+    // The query which ran, for reporting ones which didn't converge
+    geometry::IntersectionAlgorithm algorithm = geometry::IntersectionAlgorithm::Gjk;
+    bool margins = false;
+};
+
+// Key for a pair of object indices, with i < j
+std::uint64_t pair_key(int i, int j)
+{
+    return (static_cast<std::uint64_t>(i) << 32) | static_cast<std::uint32_t>(j);
+}
+
 // Returns the unique representative of the a mod b equivalence class in the range [0, b),
 // or returns zero if b is zero.
 int modulo(int a, unsigned int b)
@@ -268,6 +698,25 @@ int main(int argc, char** args)
     std::vector<ConvexHullInstance> objects;
     int selected_object = 0;
 
+    // Per-pair state, keyed by object indices. Deleting an object moves another
+    // object to its index, so the cache is cleared then.
+    std::unordered_map<std::uint64_t, PairCache> pair_caches;
+    CollisionStats collision_stats;
+
+    BroadPhaseMethod broad_phase = BroadPhaseMethod::SweepAndPrune;
+    SweepAndPrune sweep_and_prune;
+    std::vector<Aabb> object_bounds;
+
+    // The tree refers to object i by tree_proxies[i]
+    AabbTree tree;
+    std::vector<int> tree_proxies;
+    std::vector<AabbTree::Pair> tree_pairs;
+
+    // The narrow phase runs on every hardware thread
+    WorkStealingPool narrow_phase_pool;
+    std::vector<PairCache*> pair_cache_list;
+    std::vector<PairResult> pair_results;
+
     Vec3 global_position(0.0f, 0.0f, -10.0f);
     Mat3 global_orientation;
 
@@ -317,9 +766,11 @@ int main(int argc, char** args)
         }
     });
 
-    input.register_action(GLFW_KEY_DOWN, true, [&objects, &selected_object, &selected_mesh] {
+    input.register_action(GLFW_KEY_DOWN, true, [&objects, &selected_object, &selected_mesh, &pair_caches] {
         if (objects.size())
         {
+            pair_caches.clear();
+
             // Remove the selected object, and replace it with the object at the back.
             objects[selected_object] = objects.back();
             objects.pop_back();
@@ -339,10 +790,15 @@ int main(int argc, char** args)
 
     while (!input.window_should_close() && !io_data.quit)
     {
-        io_data.handle_commands(render_ctxt, meshes, selected_mesh);
+        io_data.handle_commands(render_ctxt, meshes, selected_mesh, broad_phase, collision_stats);
 
         input.do_actions();
 
+        // How the selected object moves this frame, from start_pose
+        ConvexHullInstance start_pose(Vec3(), Mat3::Identity(), 0);
+        Vec3 displacement;
+        Vec3 rotation;
+
         if (objects.size() != 0)
         {
             auto& object = objects[selected_object];
@@ -357,7 +813,9 @@ int main(int argc, char** args)
             // Rotate the applied velocity into the camera reference frame
             velocity_vector = global_orientation.transpose() * velocity_vector;
 
-            object.position += last_frame_time * velocity_vector;
+            start_pose = object;
+            displacement = static_cast<float>(last_frame_time) * velocity_vector;
+            object.position += displacement;
 
             float angular_speed = 1.0f; // radians per second
             Vec3 angular_velocity = angular_speed * input.get_ijkluo_vector();
@@ -371,7 +829,8 @@ int main(int argc, char** args)
             {
                 // Rotate the applied angular velocity into the camera reference frame
                 angular_velocity = global_orientation.transpose() * angular_velocity;
-                object.orientation = Mat3::AxisAngle(last_frame_time * angular_velocity) * object.orientation;
+                rotation = static_cast<float>(last_frame_time) * angular_velocity;
+                object.orientation = Mat3::AxisAngle(rotation) * object.orientation;
             }
         }
 
@@ -381,25 +840,174 @@ int main(int argc, char** args)
             object.colliding = false;
         }
 
-        // Check for intersections between every pair of objects.
-        for (int i = 0; i < static_cast<int>(objects.size() - 1); ++i)
+        // Find the pairs of objects whose bounding boxes overlap
+        object_bounds.resize(objects.size());
+        for (std::size_t i = 0; i < objects.size(); ++i)
+        {
+            object_bounds[i] = world_bounds(meshes[objects[i].mesh_id].bounds, objects[i]);
+        }
+        if (broad_phase == BroadPhaseMethod::SweepAndPrune)
         {
-            // Start at 1 past i so that each intersection is only checked
-            // once, and never with itself.
-            for (int j = i + 1; j < static_cast<int>(objects.size()); ++j)
+            sweep_and_prune.update(object_bounds);
+        }
+        else
+        {
+            // Deleting an object moves another into its place, so the tree is rebuilt then
+            if (tree_proxies.size() > objects.size())
             {
-                geometry::GjkStats stats;
-                bool intersection = geometry::intersect_gjk<Vec3>(
-                    [&objects, &meshes, i](const Vec3& d) { return general_support(d, objects[i], meshes[objects[i].mesh_id].vertices); },
-                    [&objects, &meshes, j](const Vec3& d) { return general_support(d, objects[j], meshes[objects[j].mesh_id].vertices); },
-                    100, &stats);
+                tree.clear();
+                tree_proxies.clear();
+            }
 
-                objects[i].colliding |= intersection;
-                objects[j].colliding |= intersection;
+            for (std::size_t i = 0; i < tree_proxies.size(); ++i)
+            {
+                tree.move(tree_proxies[i], object_bounds[i]);
+            }
+            for (std::size_t i = tree_proxies.size(); i < objects.size(); ++i)
+            {
+                tree_proxies.push_back(tree.insert(object_bounds[i], static_cast<std::uint32_t>(i)));
+            }
+            tree.find_pairs(tree_pairs);
+        }
+        const auto& pairs = broad_phase == BroadPhaseMethod::SweepAndPrune ? sweep_and_prune.pairs() : tree_pairs;
+
+        // Look up the state of each pair first, since the map can't be modified by several
+        // threads at once. Pointers to its elements stay valid as it grows.
+        pair_cache_list.resize(pairs.size());
+        for (std::size_t k = 0; k < pairs.size(); ++k)
+        {
+            pair_cache_list[k] = &pair_caches[pair_key(pairs[k].first, pairs[k].second)];
+        }
+
+        // Check for intersections between each of those pairs in parallel. Each pair's result
+        // has its own slot, so the threads never write to the same place.
+        pair_results.resize(pairs.size());
+        narrow_phase_pool.parallel_for(pairs.size(), 32, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t k = begin; k < end; ++k)
+            {
+                int i = static_cast<int>(pairs[k].first);
+                int j = static_cast<int>(pairs[k].second);
+                PairCache& cache = *pair_cache_list[k];
+                const Mesh& mesh_i = meshes[objects[i].mesh_id];
+                const Mesh& mesh_j = meshes[objects[j].mesh_id];
+
+                // Only run GJK if the bounding spheres, and then the oriented bounding boxes,
+                // of the objects overlap
+                PairResult& result = pair_results[k];
+                if (!overlap(mesh_i.sphere, objects[i], mesh_j.sphere, objects[j])
+                    || !overlap(mesh_i.bounds, objects[i], mesh_j.bounds, objects[j]))
+                {
+                    result.intersection = false;
+                    result.stats = geometry::GjkStats{};
+                    result.stats.bounds_rejected = true;
+                    continue;
+                }
+
+                // Rounded shapes only need GJK on their cores
+                result.margins = mesh_margin(mesh_i) + mesh_margin(mesh_j) > 0.0f;
+                if (result.margins)
+                {
+                    result.algorithm = geometry::IntersectionAlgorithm::Gjk;
+                    result.intersection = geometry::intersect_gjk_margins<Vec3>(
+                        [&objects, &mesh_i, &cache, i](const Vec3& d) { return mesh_core_support(d, objects[i], mesh_i, cache.start_vertex[0]); },
+                        mesh_margin(mesh_i),
+                        [&objects, &mesh_j, &cache, j](const Vec3& d) { return mesh_core_support(d, objects[j], mesh_j, cache.start_vertex[1]); },
+                        mesh_margin(mesh_j),
+                        cache.gjk, 100, &result.stats);
+                    continue;
+                }
+
+                result.algorithm = mesh_i.algorithm == geometry::IntersectionAlgorithm::Mpr
+                    ? mesh_i.algorithm : mesh_j.algorithm;
+                result.intersection = geometry::intersect_convex<Vec3>(
+                    result.algorithm,
+                    [&objects, &mesh_i, &cache, i](const Vec3& d) { return mesh_support(d, objects[i], mesh_i, cache.start_vertex[0]); },
+                    objects[i].position + objects[i].orientation * mesh_i.centroid,
+                    [&objects, &mesh_j, &cache, j](const Vec3& d) { return mesh_support(d, objects[j], mesh_j, cache.start_vertex[1]); },
+                    objects[j].position + objects[j].orientation * mesh_j.centroid,
+                    cache.gjk, 100, &result.stats);
+            }
+        });
+
+        // Combine the results in pair order, so they don't depend on how the work was scheduled
+        ++collision_stats.frame_count;
+        for (std::size_t k = 0; k < pairs.size(); ++k)
+        {
+            const PairResult& result = pair_results[k];
+
+            if (result.stats.bounds_rejected)
+            {
+                ++collision_stats.bounds_rejection_count;
+                continue;
+            }
+
+            ++collision_stats.query_count;
+            collision_stats.iteration_count += result.stats.iteration_count;
+            collision_stats.warm_start_count += result.stats.warm_started;
+            collision_stats.cache_hit_count += result.stats.cache_hit;
+            collision_stats.fallback_count += result.stats.precision_fallback;
+
+            objects[pairs[k].first].colliding |= result.intersection;
+            objects[pairs[k].second].colliding |= result.intersection;
+
+            if (!result.stats.converged)
+            {
+                if (result.margins)
+                {
+                    std::cerr << "GJK on the cores of rounded shapes did not converge" << std::endl;
+                }
+                else if (result.algorithm == geometry::IntersectionAlgorithm::Mpr)
+                {
+                    std::cerr << "MPR did not converge" << std::endl;
+                }
+                else
+                {
+                    std::cerr << "GJK did not converge, even in double precision" << std::endl;
+                }
+            }
+        }
+
+        // The pairs above are only tested where the objects end up, so a fast object can pass
+        // through a thin one between frames. The whole motion of the selected object is checked
+        // against the objects its swept bounding sphere reaches, by conservative advancement.
+        if (objects.size() != 0 && (displacement.mag() > 0.0f || rotation.mag() > 0.0f))
+        {
+            const Mesh& mesh_i = meshes[start_pose.mesh_id];
+
+            // No point of the object is further than this from its position, which it turns about
+            float reach = mesh_i.sphere.centre.mag() + mesh_i.sphere.radius;
+            geometry::MotionBound<Vec3> motion_i{displacement, rotation.mag() * reach};
+            geometry::MotionBound<Vec3> at_rest{Vec3(), 0.0f};
+
+            for (int j = 0; j < static_cast<int>(objects.size()); ++j)
+            {
+                const Mesh& mesh_j = meshes[objects[j].mesh_id];
+                Vec3 centre_j = objects[j].position + objects[j].orientation * mesh_j.sphere.centre;
+                if (j == selected_object
+                    || distance_to_segment(centre_j, start_pose.position, start_pose.position + displacement) > reach + mesh_j.sphere.radius)
+                {
+                    continue;
+                }
 
-                if (stats.iteration_count == 100)
+                std::uint32_t start_vertex[2] = {0, 0};
+                geometry::TimeOfImpact<Vec3> impact = geometry::time_of_impact<Vec3>(
+                    [&](float t) {
+                        ConvexHullInstance pose = pose_at(start_pose, displacement, rotation, t);
+                        return [&mesh_i, &start_vertex, pose](const Vec3& d) { return mesh_support(d, pose, mesh_i, start_vertex[0]); };
+                    },
+                    motion_i,
+                    [&](float) {
+                        return [&objects, &mesh_j, &start_vertex, j](const Vec3& d) { return mesh_support(d, objects[j], mesh_j, start_vertex[1]); };
+                    },
+                    at_rest,
+                    1e-3f);
+
+                ++collision_stats.swept_query_count;
+                if (impact.hit)
                 {
-                    std::cerr << "GJK did not terminate after 100 iterations" << std::endl;
+                    ++collision_stats.swept_hit_count;
+                    objects[selected_object].colliding = true;
+                    objects[j].colliding = true;
                 }
             }
         }
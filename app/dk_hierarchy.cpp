@@ -0,0 +1,269 @@
+#include "dk_hierarchy.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+using demo::math::Vec3;
+
+namespace {
+
+// Only vertices with at most this many neighbours are removed. This bounds the cost of
+// re-triangulating the hole left by a vertex, and the number of steps taken on each level.
+constexpr std::size_t max_removal_degree = 8;
+
+// The coarsest level has at most this many vertices, and is searched exhaustively.
+constexpr std::size_t max_top_level_size = 16;
+
+using Edge = std::pair<std::uint32_t, std::uint32_t>;
+
+// Adds the edges needed to close the hole left by removing vertex v, whose neighbours are link.
+// The new faces are the faces of the hull of the link which v can see. Faces are found by brute force,
+// which is cheap since the link is small. Coplanar link vertices produce extra diagonals, which is
+// harmless since any edge between hull vertices can be walked along.
+void close_hole(const std::vector<Vec3>& vertices, std::uint32_t v, const std::vector<std::uint32_t>& link, std::vector<Edge>& edges)
+{
+    struct Point { double x, y, z; };
+    auto to_point = [&vertices](std::uint32_t i) { return Point{vertices[i].x, vertices[i].y, vertices[i].z}; };
+    auto sub = [](Point a, Point b) { return Point{a.x - b.x, a.y - b.y, a.z - b.z}; };
+    auto dot = [](Point a, Point b) { return a.x*b.x + a.y*b.y + a.z*b.z; };
+    auto cross = [](Point a, Point b) { return Point{a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x}; };
+
+    const std::size_t k = link.size();
+    const Point apex = to_point(v);
+
+    double extent = 0.0;
+    for (std::uint32_t n : link)
+    {
+        Point offset = sub(to_point(n), apex);
+        extent = std::max(extent, std::sqrt(dot(offset, offset)));
+    }
+    const double epsilon = 1e-6 * extent;
+
+    std::size_t edges_before = edges.size();
+
+    for (std::size_t a = 0; a < k; ++a)
+    {
+        for (std::size_t b = a + 1; b < k; ++b)
+        {
+            for (std::size_t c = b + 1; c < k; ++c)
+            {
+                Point pa = to_point(link[a]);
+                Point normal = cross(sub(to_point(link[b]), pa), sub(to_point(link[c]), pa));
+                double length = std::sqrt(dot(normal, normal));
+                if (length <= epsilon * epsilon)
+                {
+                    // The points are collinear
+                    continue;
+                }
+                normal = Point{normal.x / length, normal.y / length, normal.z / length};
+
+                // The triangle is on the hull if every other link vertex is on one side of it
+                int side = 0;
+                bool on_hull = true;
+                for (std::size_t i = 0; i < k && on_hull; ++i)
+                {
+                    double distance = dot(normal, sub(to_point(link[i]), pa));
+                    int point_side = distance > epsilon ? 1 : (distance < -epsilon ? -1 : 0);
+                    on_hull = point_side == 0 || side == 0 || point_side == side;
+                    side = point_side ? point_side : side;
+                }
+                if (!on_hull)
+                {
+                    continue;
+                }
+
+                // Make the normal point away from the rest of the link. If the link is flat, any
+                // face facing v will do.
+                double apex_distance = dot(normal, sub(apex, pa));
+                if (side > 0 || (side == 0 && apex_distance < 0.0))
+                {
+                    apex_distance = -apex_distance;
+                }
+
+                if (apex_distance > epsilon)
+                {
+                    edges.emplace_back(link[a], link[b]);
+                    edges.emplace_back(link[b], link[c]);
+                    edges.emplace_back(link[c], link[a]);
+                }
+            }
+        }
+    }
+
+    if (edges.size() == edges_before)
+    {
+        // v doesn't stick out of its neighbours, so the geometry gives no guidance.
+        // Connecting every pair of neighbours is always safe.
+        for (std::size_t a = 0; a < k; ++a)
+        {
+            for (std::size_t b = a + 1; b < k; ++b)
+            {
+                edges.emplace_back(link[a], link[b]);
+            }
+        }
+    }
+}
+
+// Builds the adjacency of the first vertex_count vertices from directed edges, renumbering
+// each vertex i to new_index[i].
+void make_level(const std::vector<Edge>& edges, const std::vector<std::uint32_t>& new_index,
+                std::size_t vertex_count, demo::mesh::VertexAdjacency& level)
+{
+    std::vector<Edge> renumbered;
+    renumbered.reserve(edges.size());
+    for (const Edge& e : edges)
+    {
+        renumbered.emplace_back(new_index[e.first], new_index[e.second]);
+    }
+    std::sort(renumbered.begin(), renumbered.end());
+
+    level.offsets.assign(vertex_count + 1, 0);
+    level.neighbours.clear();
+    level.neighbours.reserve(renumbered.size());
+    for (const Edge& e : renumbered)
+    {
+        ++level.offsets[e.first + 1];
+        level.neighbours.push_back(e.second);
+    }
+
+    for (std::size_t i = 0; i < vertex_count; ++i)
+    {
+        level.offsets[i + 1] += level.offsets[i];
+    }
+}
+
+}
+
+DkBuildReport build_dk_hierarchy(const std::vector<Vec3>& vertices,
+                                 const demo::mesh::VertexAdjacency& adjacency,
+                                 DkHierarchy& hierarchy)
+{
+    auto start_time = std::chrono::steady_clock::now();
+
+    const std::size_t n = vertices.size();
+
+    // Adjacency lists which are edited as vertices are removed
+    std::vector<std::vector<std::uint32_t>> neighbours(n);
+    for (std::uint32_t v = 0; v < n; ++v)
+    {
+        neighbours[v].assign(adjacency.begin(v), adjacency.end(v));
+    }
+
+    std::vector<std::uint32_t> remaining(n);
+    for (std::uint32_t v = 0; v < n; ++v)
+    {
+        remaining[v] = v;
+    }
+
+    // The directed edges of each level, and the vertices removed to make each level from the one below
+    auto snapshot = [&neighbours, &remaining] {
+        std::vector<Edge> edges;
+        for (std::uint32_t v : remaining)
+        {
+            for (std::uint32_t w : neighbours[v])
+            {
+                edges.emplace_back(v, w);
+            }
+        }
+        return edges;
+    };
+    std::vector<std::vector<Edge>> level_edges = {snapshot()};
+    std::vector<std::vector<std::uint32_t>> removed_sets;
+
+    std::vector<char> blocked(n);
+    std::vector<char> is_removed(n, 0);
+    std::vector<Edge> new_edges;
+
+    while (remaining.size() > max_top_level_size)
+    {
+        // Greedily pick an independent set of low-degree vertices
+        std::fill(blocked.begin(), blocked.end(), 0);
+        std::vector<std::uint32_t> removed;
+        for (std::uint32_t v : remaining)
+        {
+            if (!blocked[v] && neighbours[v].size() <= max_removal_degree)
+            {
+                removed.push_back(v);
+                blocked[v] = 1;
+                for (std::uint32_t w : neighbours[v])
+                {
+                    blocked[w] = 1;
+                }
+            }
+        }
+
+        if (removed.empty())
+        {
+            break;
+        }
+
+        for (std::uint32_t v : removed)
+        {
+            for (std::uint32_t w : neighbours[v])
+            {
+                auto& list = neighbours[w];
+                list.erase(std::find(list.begin(), list.end(), v));
+            }
+
+            new_edges.clear();
+            close_hole(vertices, v, neighbours[v], new_edges);
+            for (const Edge& e : new_edges)
+            {
+                auto& list = neighbours[e.first];
+                if (std::find(list.begin(), list.end(), e.second) == list.end())
+                {
+                    list.push_back(e.second);
+                    neighbours[e.second].push_back(e.first);
+                }
+            }
+
+            neighbours[v].clear();
+            is_removed[v] = 1;
+        }
+
+        remaining.erase(std::remove_if(remaining.begin(), remaining.end(),
+                                       [&is_removed](std::uint32_t v) { return is_removed[v]; }),
+                        remaining.end());
+
+        removed_sets.push_back(std::move(removed));
+        level_edges.push_back(snapshot());
+    }
+
+    // Order the vertices coarsest level first, so each level is a prefix
+    std::vector<std::uint32_t> order = remaining;
+    for (auto it = removed_sets.rbegin(); it != removed_sets.rend(); ++it)
+    {
+        order.insert(order.end(), it->begin(), it->end());
+    }
+
+    std::vector<std::uint32_t> new_index(n);
+    hierarchy.vertices.resize(n);
+    for (std::uint32_t i = 0; i < n; ++i)
+    {
+        new_index[order[i]] = i;
+        hierarchy.vertices[i] = vertices[order[i]];
+    }
+
+    DkBuildReport report;
+
+    hierarchy.levels.resize(level_edges.size());
+    std::size_t level_vertex_count = n;
+    for (std::size_t i = 0; i < level_edges.size(); ++i)
+    {
+        make_level(level_edges[i], new_index, level_vertex_count, hierarchy.levels[i]);
+        report.total_edge_count += level_edges[i].size() / 2;
+
+        if (i < removed_sets.size())
+        {
+            level_vertex_count -= removed_sets[i].size();
+        }
+    }
+
+    report.level_count = hierarchy.levels.size();
+    report.top_level_vertex_count = remaining.size();
+    report.build_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+    return report;
+}
@@ -0,0 +1,43 @@
+#ifndef DK_HIERARCHY_HPP
+#define DK_HIERARCHY_HPP
+
+#include "math.hpp"
+#include "mesh_tools.hpp"
+#include <cstddef>
+#include <vector>
+
+// A Dobkin-Kirkpatrick hierarchy of a convex mesh. Each level is the convex hull of a subset of the
+// vertices of the level below it, made by removing an independent set of low-degree vertices. The
+// extreme vertex of a level is at most a few steps away from the extreme vertex of the level above,
+// so walking down the levels finds the extreme vertex of the mesh in O(log n) time.
+struct DkHierarchy
+{
+    // The mesh's vertices, ordered so that the vertices of every level are a prefix of this list.
+    std::vector<demo::math::Vec3> vertices;
+
+    // levels[0] is the whole mesh, and each following level is coarser. The vertices of level i
+    // are the first levels[i].vertex_count() entries of vertices.
+    std::vector<demo::mesh::VertexAdjacency> levels;
+};
+
+// Summary of the work done to build a hierarchy
+struct DkBuildReport
+{
+    std::size_t level_count = 0;
+
+    // Number of vertices in the coarsest level, which is searched exhaustively
+    std::size_t top_level_vertex_count = 0;
+
+    // Number of edges in all levels together
+    std::size_t total_edge_count = 0;
+
+    double build_seconds = 0.0;
+};
+
+// Builds the hierarchy for a convex mesh whose vertices are all extreme points, given its
+// vertex adjacency. The result is undefined for other meshes.
+DkBuildReport build_dk_hierarchy(const std::vector<demo::math::Vec3>& vertices,
+                                 const demo::mesh::VertexAdjacency& adjacency,
+                                 DkHierarchy& hierarchy);
+
+#endif
@@ -1,262 +1,344 @@
 #include "load_mesh.hpp"
 #include "mesh_tools.hpp"
+#include <charconv>
 #include <fstream>
 #include <iostream>
-#include <string>
-#include <cstdlib>  // using strtoul instead of stoul, since no exceptions
-#include <cctype>
+#include <iterator>
+#include <system_error>
 #include <cstring>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace demo::mesh {
 
-enum class OffParseState
+namespace {
+
+// The text of one line, without its line break
+struct OffLine
 {
-    FirstLine,
-    Counts,
-    Vertices,
-    Faces,
-    Done
+    const char* begin;
+    const char* end;
 };
 
-// Returns index of first non-whitespace character
-std::size_t skip_whitespace(const char* str)
+// Reads the line starting at cursor, and moves cursor to the start of the next one
+bool next_line(const char*& cursor, const char* end, OffLine& line)
+{
+    if (cursor == end)
+    {
+        return false;
+    }
+
+    const char* newline = static_cast<const char*>(std::memchr(cursor, '\n', end - cursor));
+    line.begin = cursor;
+    line.end = newline ? newline : end;
+    cursor = newline ? newline + 1 : end;
+    return true;
+}
+
+// Like isspace in the C locale, without a call per character
+bool is_space(char c)
 {
-    std::size_t idx = 0;
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
 
-    // Skip to the first non-whitespace character in the line
-    while (isspace(str[idx]))
+const char* skip_spaces(const char* p, const char* end)
+{
+    while (p != end && is_space(*p))
     {
-        ++idx;
+        ++p;
     }
+    return p;
+}
 
-    return idx;
+// Returns true for blank lines or comments
+bool off_is_blank(const OffLine& line)
+{
+    const char* p = skip_spaces(line.begin, line.end);
+    return p == line.end || *p == '#';
 }
 
-// Returns false for blank lines or comments.
-// If either vertex_count or face_count is set to zero, the line couldn't be parsed (or it is zero).
-// This ambiguity is irrelevant since both are failure cases.
-bool off_parse_counts(const std::string& line, std::size_t& vertex_count, std::size_t& face_count)
+// Reads a number after any whitespace at p, and moves p past it. Returns false if there is none.
+template <class T>
+bool off_read_number(const char*& p, const char* end, T& value)
 {
-    std::size_t line_idx = skip_whitespace(line.c_str());
+    p = skip_spaces(p, end);
 
-    // Only parse a number if a non-comment character was found
-    if (line[line_idx] && line[line_idx] != '#')
+    // Unlike strtof and strtoul, from_chars doesn't accept a leading plus
+    if (p != end && *p == '+')
     {
-        char* end;
+        ++p;
+    }
 
-        const char* vertex_count_start = line.c_str() + line_idx;
-        vertex_count = strtoul(vertex_count_start, &end, 10);
+    std::from_chars_result result = std::from_chars(p, end, value);
+    if (result.ec != std::errc())
+    {
+        return false;
+    }
+    p = result.ptr;
+    return true;
+}
 
-        const char* face_count_start = end;
-        face_count = strtoul(face_count_start, &end, 10);
+// Reads a float like off_read_number. Most files are written with a fixed number of decimal
+// places and no exponent, and when such a number has few enough digits, both its digits and
+// the power of ten it is divided by are exact floats, so a single division rounds it correctly
+// (Clinger's fast path). That is much faster than from_chars, which reads everything else.
+bool off_read_float(const char*& p, const char* end, float& value)
+{
+    static constexpr float powers_of_ten[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
 
-        // Skip the edge count because it is not needed.
+    p = skip_spaces(p, end);
+    if (p != end && *p == '+')
+    {
+        ++p;
+    }
+
+    const char* q = p;
+    bool negative = q != end && *q == '-';
+    if (negative)
+    {
+        ++q;
+    }
+
+    std::uint32_t digits = 0;
+    int digit_count = 0;
+    int fraction_digit_count = 0;
+    while (q != end && *q >= '0' && *q <= '9' && digit_count < 9)
+    {
+        digits = 10*digits + static_cast<std::uint32_t>(*q - '0');
+        ++digit_count;
+        ++q;
+    }
+    if (q != end && *q == '.')
+    {
+        ++q;
+        while (q != end && *q >= '0' && *q <= '9' && digit_count < 9)
+        {
+            digits = 10*digits + static_cast<std::uint32_t>(*q - '0');
+            ++digit_count;
+            ++fraction_digit_count;
+            ++q;
+        }
+    }
+
+    bool more = q != end && ((*q >= '0' && *q <= '9') || *q == '.' || *q == 'e' || *q == 'E');
+    if (digit_count > 0 && !more && digits <= (1u << 24) && fraction_digit_count <= 10)
+    {
+        value = static_cast<float>(digits) / powers_of_ten[fraction_digit_count];
+        value = negative ? -value : value;
+        p = q;
         return true;
     }
 
-    return false;
+    return off_read_number(p, end, value);
 }
 
-// Returns false if the line is not valid
-bool off_parse_vertex(const std::string& line, std::vector<demo::math::Vec3>& vertices)
+}
+
+bool parse_off(const char* data, std::size_t size,
+               std::vector<demo::math::Vec3>& vertices,
+               std::vector<std::uint32_t>& indices)
 {
-    std::size_t line_idx = skip_whitespace(line.c_str());
+    vertices.clear();
+    indices.clear();
+
+    const char* cursor = data;
+    const char* end = data + size;
+    OffLine line;
+    std::size_t line_num = 0;
 
-    // Only parse a number if a non-comment character was found
-    if (line[line_idx] && line[line_idx] != '#')
+    auto fail = [&](const char* message) {
+        std::cerr << "Line " << line_num << ": " << message << "\n";
+        std::cerr << "Error reading OFF file.\n";
+        vertices.clear();
+        indices.clear();
+        return false;
+    };
+
+    // Files without the optional OFF are not supported
+    ++line_num;
+    if (!next_line(cursor, end, line) || line.end - line.begin < 3 || std::memcmp(line.begin, "OFF", 3) != 0
+        || skip_spaces(line.begin + 3, line.end) != line.end)
     {
-        char* end;
+        return fail("The first line must contain the characters OFF.");
+    }
 
-        const char* x_start = line.c_str() + line_idx;
-        float x = strtof(x_start, &end);
-        if (end == x_start)
+    std::size_t vertex_count = 0;
+    std::size_t face_count = 0;
+    while (vertex_count == 0)
+    {
+        ++line_num;
+        if (!next_line(cursor, end, line))
         {
-            // This means no conversion could be performed
-            return false;
+            return fail("Unexpected end of file.");
         }
-
-        const char* y_start = end;
-        float y = strtof(y_start, &end);
-        if (end == y_start)
+        if (off_is_blank(line))
         {
-            // This means no conversion could be performed
-            return false;
+            continue;
         }
 
-        const char* z_start = end;
-        float z = strtof(z_start, &end);
-        if (end == z_start)
+        // The edge count is skipped because it is not needed
+        const char* p = line.begin;
+        if (!off_read_number(p, line.end, vertex_count) || !off_read_number(p, line.end, face_count)
+            || vertex_count == 0 || face_count == 0)
         {
-            // This means no conversion could be performed
-            return false;
+            return fail("Unable to read vertex count or face count.");
         }
-
-        vertices.emplace_back(x, y, z);
     }
 
-    return true;
-}
-
-// Returns false if the line is not valid
-bool off_parse_face(const std::string& line,
-                    const std::vector<demo::math::Vec3>& vertices,
-                    std::vector<demo::math::Vec3>& triangles)
-{
-    std::size_t line_idx = skip_whitespace(line.c_str());
+    vertices.reserve(vertex_count);
+    indices.reserve(3*face_count); // explicitly only support 3 vertices per face
 
-    // Only parse a number if a non-comment character was found
-    if (line[line_idx] && line[line_idx] != '#')
+    while (vertices.size() < vertex_count)
     {
-        char* end;
+        ++line_num;
+        if (!next_line(cursor, end, line))
+        {
+            return fail("Unexpected end of file.");
+        }
+        if (off_is_blank(line))
+        {
+            continue;
+        }
 
-        const char* vertex_count_start = line.c_str() + line_idx;
-        std::size_t vertex_count = strtoul(vertex_count_start, &end, 10);
+        const char* p = line.begin;
+        float x, y, z;
+        if (!off_read_float(p, line.end, x) || !off_read_float(p, line.end, y) || !off_read_float(p, line.end, z))
+        {
+            return fail("Unable to read vertex.");
+        }
+        vertices.emplace_back(x, y, z);
+    }
 
-        // Only triangle-faces are supported
-        if (vertex_count != 3)
+    while (indices.size() < 3*face_count)
+    {
+        ++line_num;
+        if (!next_line(cursor, end, line))
+        {
+            return fail("Unexpected end of file.");
+        }
+        if (off_is_blank(line))
         {
-            std::cerr << "Only faces with 3 vertices are supported.\n";
-            return false;
+            continue;
         }
 
-        demo::math::Vec3 vertices_to_add[3];
+        const char* p = line.begin;
+        std::size_t face_vertex_count = 0;
+        if (!off_read_number(p, line.end, face_vertex_count) || face_vertex_count != 3)
+        {
+            return fail("Only faces with 3 vertices are supported.");
+        }
 
+        std::size_t face[3];
         for (std::size_t i = 0; i < 3; ++i)
         {
-            const char* v_start = end;
-            std::size_t v_idx = strtoul(v_start, &end, 10);
-            if (end == v_start)
+            if (!off_read_number(p, line.end, face[i]))
             {
-                // This means no conversion could be performed
-                std::cerr << "Unable to read vertex number.\n";
-                return false;
+                return fail("Unable to read vertex number.");
             }
-            if (v_idx >= vertices.size())
+            if (face[i] >= vertex_count)
             {
-                // This means v_idx doesn't represent a valid vertex
-                std::cerr << "Vertex " << v_idx << " is not a valid vertex.\n";
-                return false;
+                return fail("Face refers to a vertex which doesn't exist.");
             }
-
-            vertices_to_add[i] = vertices[v_idx];
         }
 
-        // If control reaches here, parsing was successful
         for (std::size_t i = 0; i < 3; ++i)
         {
-            triangles.push_back(vertices_to_add[i]);
+            indices.push_back(static_cast<std::uint32_t>(face[i]));
         }
     }
 
     return true;
 }
 
-void load_off(const char* filename,
-    std::vector<demo::math::Vec3>& vertices,
-    std::vector<demo::math::Vec3>& triangles,
-    std::vector<demo::math::Vec3>& normals)
+FileView::FileView(const char* filename)
 {
-    vertices.clear();
-    triangles.clear();
-    normals.clear();
-
-    std::ifstream file(filename);
-    if (!file)
+#if defined(__unix__) || defined(__APPLE__)
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
     {
-        std::cerr << "Could not open file " << filename << ".\n";
         return;
     }
 
-    std::string line;
-
-    std::size_t line_num = 1;
-
-    std::size_t vertex_count = 0;
-    std::size_t face_count = 0;
-    OffParseState parse_state = OffParseState::FirstLine;
-
-    bool error = false;
-    
-    while (getline(file, line) && parse_state != OffParseState::Done)
+    struct stat info;
+    if (fstat(fd, &info) == 0)
     {
-        switch (parse_state)
-        {
-            case OffParseState::FirstLine:
-                if (line == "OFF")
-                {
-                    parse_state = OffParseState::Counts;
-                }
-                else
-                {
-                    // Files without the optional OFF are not supported
-                    std::cerr << "Line " << line_num << ": The first line must contain the characters OFF.\n";
-                    error = true;
-                }
-                break;
-            case OffParseState::Counts:
-                if (off_parse_counts(line, vertex_count, face_count))
-                {
-                    if (vertex_count == 0 || face_count == 0)
-                    {
-                        // This means the line couldn't be parsed
-                        std::cerr << "Line " << line_num << ": Unable to read vertex count or face count.\n";
-                        error = true;
-                    }
-                    else
-                    {
-                        vertices.reserve(vertex_count);
-                        triangles.reserve(3*face_count); // explicitly only support 3 vertices per face
-                        parse_state = OffParseState::Vertices;
-                    }
-                }
-                break;
-            case OffParseState::Vertices:
-                if (!off_parse_vertex(line, vertices))
-                {
-                    std::cerr << "Line " << line_num << ": Unable to read vertex.\n";
-                    error = true;
-                }
-                if (vertices.size() == vertex_count)
-                {
-                    parse_state = OffParseState::Faces;
-                }
-                break;
-            case OffParseState::Faces:
-                if (!off_parse_face(line, vertices, triangles))
-                {
-                    std::cerr << "Line " << line_num << ": Unable to read face.\n";
-                    error = true;
-                }
-                if (triangles.size() == 3*face_count)
-                {
-                    parse_state = OffParseState::Done;
-                }
-                break;
-            case OffParseState::Done:
-            default:
-                break;
-        }
-
-        if (error)
+        opened = true;
+        view_size = static_cast<std::size_t>(info.st_size);
+        if (view_size > 0)
         {
-            std::cerr << "Error reading OFF file.\n";
-            break;
+            void* mapping = mmap(nullptr, view_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED)
+            {
+                madvise(mapping, view_size, MADV_SEQUENTIAL);
+                mapped = static_cast<const char*>(mapping);
+            }
+            else
+            {
+                opened = false;
+            }
         }
+    }
+    close(fd);
+    if (opened)
+    {
+        return;
+    }
+#endif
 
-        ++line_num;
+    // Fall back on reading the whole file
+    std::ifstream file(filename, std::ios::binary);
+    if (file)
+    {
+        buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        opened = !file.bad();
+        view_size = buffer.size();
     }
+}
 
-    if (vertices.size() != vertex_count || triangles.size() != 3*face_count)
+FileView::~FileView()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    if (mapped)
     {
-        // This means the file wasn't parsed properly, so return failure
-        vertices.clear();
-        triangles.clear();
+        munmap(const_cast<char*>(mapped), view_size);
     }
-    else
+#endif
+}
+
+bool FileView::is_open() const
+{
+    return opened;
+}
+
+const char* FileView::data() const
+{
+    return mapped ? mapped : buffer.data();
+}
+
+std::size_t FileView::size() const
+{
+    return view_size;
+}
+
+bool load_off(const char* filename, IndexedMesh& mesh)
+{
+    mesh.face_normals.clear();
+
+    FileView file(filename);
+    if (!file.is_open())
     {
-        // Compute normals
-        compute_normals(triangles, normals);
+        mesh.vertices.clear();
+        mesh.indices.clear();
+        std::cerr << "Could not open file " << filename << ".\n";
+        return false;
     }
+
+    return parse_off(file.data(), file.size(), mesh.vertices, mesh.indices);
 }
 
 }
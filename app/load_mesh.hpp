@@ -2,24 +2,45 @@
 #define LOAD_MESH_HPP
 
 #include <vector>
-#include <string>
 #include <cstddef>
+#include <cstdint>
 #include "math.hpp"
+#include "mesh_tools.hpp"
 
 namespace demo::mesh {
 
-void load_off(const char* filename,
-              std::vector<demo::math::Vec3>& vertices,
-              std::vector<demo::math::Vec3>& triangles,
-              std::vector<demo::math::Vec3>& normals);
-
-// These are internal, but the declarations are here for testing
-bool off_parse_counts(const std::string& line, std::size_t& vertex_count, std::size_t& face_count);
-bool off_parse_vertex(const std::string& line, std::vector<demo::math::Vec3>& vertices);
-bool off_parse_face(const std::string& line,
-                    const std::vector<demo::math::Vec3>& vertices,
-                    std::vector<demo::math::Vec3>& triangles);
-// End internal
+// Loads an OFF file into an indexed mesh, without face normals. The file is memory mapped and
+// parsed in place, so the mesh is the only allocation.
+// Returns false, leaving the mesh empty, if the file can't be read or is not valid.
+bool load_off(const char* filename, IndexedMesh& mesh);
+
+// Parses the contents of an OFF file into its vertices and three indices per triangle.
+// Returns false, printing the reason and leaving the outputs empty, if it is not valid.
+bool parse_off(const char* data, std::size_t size,
+               std::vector<demo::math::Vec3>& vertices,
+               std::vector<std::uint32_t>& indices);
+
+// A read-only view of the contents of a file. Where possible, the file is memory mapped rather
+// than copied.
+class FileView
+{
+public:
+    explicit FileView(const char* filename);
+    ~FileView();
+
+    FileView(const FileView&) = delete;
+    FileView& operator=(const FileView&) = delete;
+
+    bool is_open() const;
+    const char* data() const;
+    std::size_t size() const;
+
+private:
+    bool opened = false;
+    const char* mapped = nullptr;
+    std::size_t view_size = 0;
+    std::vector<char> buffer;
+};
 
 }
 
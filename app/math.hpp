@@ -1,8 +1,14 @@
 #ifndef MATH_HPP
 #define MATH_HPP
 
+#include <cassert>
+#include <cmath>
 #include <cstddef>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace demo::math
 {
 
@@ -16,73 +22,480 @@ struct Vec3
     float y = 0.0f;
     float z = 0.0f;
 
-    Vec3() = default;
-    Vec3(float x_, float y_, float z_);
+    constexpr Vec3() = default;
+    constexpr Vec3(float x_, float y_, float z_);
 
     // Unary +, -
-    Vec3 operator-() const;
-    Vec3 operator+() const;
+    constexpr Vec3 operator-() const;
+    constexpr Vec3 operator+() const;
 
-    Vec3 operator+(const Vec3& rhs) const;
-    Vec3 operator-(const Vec3& rhs) const;
-    Vec3 operator+=(const Vec3& rhs);
-    Vec3 operator-=(const Vec3& rhs);
+    constexpr Vec3 operator+(const Vec3& rhs) const;
+    constexpr Vec3 operator-(const Vec3& rhs) const;
+    constexpr Vec3 operator+=(const Vec3& rhs);
+    constexpr Vec3 operator-=(const Vec3& rhs);
 
     // square magnitude
-    float sq_mag() const;
+    constexpr float sq_mag() const;
 
     // magnitude
     float mag() const;
 
     void normalize();
 
-    static Vec3 X(float x);
-    static Vec3 Y(float y);
-    static Vec3 Z(float z);
+    static constexpr Vec3 X(float x);
+    static constexpr Vec3 Y(float y);
+    static constexpr Vec3 Z(float z);
 };
 
 // Scalar multiples
-Vec3 operator*(float lhs, const Vec3& rhs);
-Vec3 operator*(const Vec3& lhs, float rhs);
+constexpr Vec3 operator*(float lhs, const Vec3& rhs);
+constexpr Vec3 operator*(const Vec3& lhs, float rhs);
 
-float dot(const Vec3& v1, const Vec3& v2);
-Vec3 cross(const Vec3& v1, const Vec3& v2);
+constexpr float dot(const Vec3& v1, const Vec3& v2);
+constexpr Vec3 cross(const Vec3& v1, const Vec3& v2);
 
 struct Mat3
 {
     float m[3][3];
 
-    Mat3();
-    Mat3(float m00, float m01, float m02,
-         float m10, float m11, float m12,
-         float m20, float m21, float m22);
+    // The identity
+    constexpr Mat3();
+    constexpr Mat3(float m00, float m01, float m02,
+                   float m10, float m11, float m12,
+                   float m20, float m21, float m22);
 
-    static Mat3 Identity();
-    static Mat3 Zero();
+    static constexpr Mat3 Identity();
+    static constexpr Mat3 Zero();
 
-    static Mat3 FromColumns(const Vec3& c0, const Vec3& c1, const Vec3& c2);
+    static constexpr Mat3 FromColumns(const Vec3& c0, const Vec3& c1, const Vec3& c2);
 
+    // These need sin and cos, which aren't constexpr, so they are defined in math.cpp
     static Mat3 RotateX(float angle);
     static Mat3 RotateY(float angle);
     static Mat3 RotateZ(float angle);
 
     static Mat3 AxisAngle(Vec3 axis_angle);
 
-    float* operator[](std::size_t index);
-    const float* operator[](std::size_t index) const;
+    constexpr float* operator[](std::size_t index);
+    constexpr const float* operator[](std::size_t index) const;
+
+    constexpr Vec3 row(unsigned int n) const;
+    constexpr Vec3 col(unsigned int n) const;
+
+    constexpr Mat3 transpose() const;
+
+    constexpr void set_row(unsigned int n, const Vec3& r);
+    constexpr void set_col(unsigned int n, const Vec3& c);
+
+    constexpr Vec3 operator*(const Vec3& rhs) const;
+    constexpr Mat3 operator*(const Mat3& rhs) const;
+};
+
+// The operations below are defined here rather than in math.cpp so that they can be inlined
+// into the GJK and support mapping loops, which call them many times per query.
+
+constexpr Vec3::Vec3(float x_, float y_, float z_)
+    :x(x_), y(y_), z(z_)
+{}
+
+// Unary -
+constexpr Vec3 Vec3::operator-() const
+{
+    return Vec3(-x, -y, -z);
+}
+
+// Unary +
+constexpr Vec3 Vec3::operator+() const
+{
+    return *this;
+}
+
+constexpr Vec3 Vec3::operator+(const Vec3& rhs) const
+{
+    return Vec3(x + rhs.x, y + rhs.y, z + rhs.z);
+}
+
+constexpr Vec3 Vec3::operator-(const Vec3& rhs) const
+{
+    return Vec3(x - rhs.x, y - rhs.y, z - rhs.z);
+}
+
+constexpr Vec3 Vec3::operator+=(const Vec3& rhs)
+{
+    *this = *this + rhs;
+    return *this;
+}
+
+constexpr Vec3 Vec3::operator-=(const Vec3& rhs)
+{
+    *this = *this - rhs;
+    return *this;
+}
+
+constexpr float Vec3::sq_mag() const
+{
+    return x*x + y*y + z*z;
+}
+
+inline float Vec3::mag() const
+{
+    return std::sqrt(sq_mag());
+}
+
+inline void Vec3::normalize()
+{
+    float magnitude = mag();
+    x /= magnitude;
+    y /= magnitude;
+    z /= magnitude;
+}
+
+constexpr Vec3 Vec3::X(float x)
+{
+    return Vec3(x, 0.0f, 0.0f);
+}
+
+constexpr Vec3 Vec3::Y(float y)
+{
+    return Vec3(0.0f, y, 0.0f);
+}
+
+constexpr Vec3 Vec3::Z(float z)
+{
+    return Vec3(0.0f, 0.0f, z);
+}
+
+constexpr Vec3 operator*(float lhs, const Vec3& rhs)
+{
+    return Vec3(lhs*rhs.x, lhs*rhs.y, lhs*rhs.z);
+}
+
+constexpr Vec3 operator*(const Vec3& lhs, float rhs)
+{
+    return rhs * lhs;
+}
+
+constexpr float dot(const Vec3& v1, const Vec3& v2)
+{
+    return v1.x*v2.x + v1.y*v2.y + v1.z*v2.z;
+}
+
+constexpr Vec3 cross(const Vec3& v1, const Vec3& v2)
+{
+    return Vec3(v1.y*v2.z - v1.z*v2.y,
+                v1.z*v2.x - v1.x*v2.z,
+                v1.x*v2.y - v1.y*v2.x);
+}
+
+constexpr Mat3::Mat3()
+    : m{1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f}
+{}
+
+constexpr Mat3::Mat3(float m00, float m01, float m02,
+                     float m10, float m11, float m12,
+                     float m20, float m21, float m22)
+    : m{m00, m01, m02, m10, m11, m12, m20, m21, m22}
+{}
+
+constexpr Mat3 Mat3::Identity()
+{
+    return Mat3(1.0f, 0.0f, 0.0f,
+                0.0f, 1.0f, 0.0f,
+                0.0f, 0.0f, 1.0f);
+}
+
+constexpr Mat3 Mat3::Zero()
+{
+    return Mat3(0.0f, 0.0f, 0.0f,
+                0.0f, 0.0f, 0.0f,
+                0.0f, 0.0f, 0.0f);
+}
+
+constexpr Mat3 Mat3::FromColumns(const Vec3& c0, const Vec3& c1, const Vec3& c2)
+{
+    return Mat3(c0.x, c1.x, c2.x,
+                c0.y, c1.y, c2.y,
+                c0.z, c1.z, c2.z);
+}
+
+constexpr float* Mat3::operator[](std::size_t index)
+{
+    return m[index];
+}
+
+constexpr const float* Mat3::operator[](std::size_t index) const
+{
+    return m[index];
+}
+
+constexpr Vec3 Mat3::row(unsigned int n) const
+{
+    assert(n <= 2);
+    return Vec3(m[n][0], m[n][1], m[n][2]);
+}
+
+constexpr Vec3 Mat3::col(unsigned int n) const
+{
+    assert(n <= 2);
+    return Vec3(m[0][n], m[1][n], m[2][n]);
+}
+
+constexpr Mat3 Mat3::transpose() const
+{
+    return Mat3(m[0][0], m[1][0], m[2][0],
+                m[0][1], m[1][1], m[2][1],
+                m[0][2], m[1][2], m[2][2]);
+}
+
+constexpr void Mat3::set_row(unsigned int n, const Vec3& r)
+{
+    assert(n <= 2);
+    m[n][0] = r.x;
+    m[n][1] = r.y;
+    m[n][2] = r.z;
+}
+
+constexpr void Mat3::set_col(unsigned int n, const Vec3& c)
+{
+    assert(n <= 2);
+    m[0][n] = c.x;
+    m[1][n] = c.y;
+    m[2][n] = c.z;
+}
+
+constexpr Vec3 Mat3::operator*(const Vec3& rhs) const
+{
+    return Vec3(dot(row(0), rhs), dot(row(1), rhs), dot(row(2), rhs));
+}
+
+constexpr Mat3 Mat3::operator*(const Mat3& rhs) const
+{
+    return Mat3::FromColumns((*this) * rhs.col(0), (*this) * rhs.col(1), (*this) * rhs.col(2));
+}
+
+#if defined(__SSE2__)
+
+// A Vec3 held in an SSE register, whose fourth lane is unused and kept at zero. It has the same
+// interface as Vec3, so it can be used as the Vec3 of intersect_gjk. Every operation rounds
+// exactly as the Vec3 version does, so results are identical.
+struct alignas(16) Vec3A
+{
+    using real_type = float;
+
+    // The coordinates alias the register, which GCC and Clang allow
+    union
+    {
+        __m128 v;
+        __extension__ struct
+        {
+            float x;
+            float y;
+            float z;
+            float w;
+        };
+    };
+
+    Vec3A();
+    Vec3A(float x_, float y_, float z_);
+    explicit Vec3A(__m128 v_);
+    explicit Vec3A(const Vec3& v_);
+
+    Vec3 to_vec3() const;
+
+    // Unary +, -
+    Vec3A operator-() const;
+    Vec3A operator+() const;
 
-    Vec3 row(unsigned int n) const;
-    Vec3 col(unsigned int n) const;
+    Vec3A operator+(const Vec3A& rhs) const;
+    Vec3A operator-(const Vec3A& rhs) const;
+    Vec3A operator+=(const Vec3A& rhs);
+    Vec3A operator-=(const Vec3A& rhs);
 
-    Mat3 transpose() const;
+    // square magnitude
+    float sq_mag() const;
 
-    void set_row(unsigned int n, const Vec3& r);
-    void set_col(unsigned int n, const Vec3& c);
+    // magnitude
+    float mag() const;
 
-    Vec3 operator*(const Vec3& rhs) const;
-    Mat3 operator*(const Mat3& rhs) const;
+    void normalize();
 };
 
+// Scalar multiples
+Vec3A operator*(float lhs, const Vec3A& rhs);
+Vec3A operator*(const Vec3A& lhs, float rhs);
+
+float dot(const Vec3A& v1, const Vec3A& v2);
+Vec3A cross(const Vec3A& v1, const Vec3A& v2);
+
+// A Mat3 stored as three Vec3A columns, so that a product with a vector is a weighted sum of the
+// columns.
+struct Mat3A
+{
+    Vec3A c[3];
+
+    // The identity
+    Mat3A();
+    explicit Mat3A(const Mat3& m);
+
+    static Mat3A FromColumns(const Vec3A& c0, const Vec3A& c1, const Vec3A& c2);
+
+    Vec3A col(unsigned int n) const;
+
+    Mat3A transpose() const;
+
+    Vec3A operator*(const Vec3A& rhs) const;
+    Mat3A operator*(const Mat3A& rhs) const;
+};
+
+inline Vec3A::Vec3A()
+    : v(_mm_setzero_ps())
+{}
+
+inline Vec3A::Vec3A(float x_, float y_, float z_)
+    : v(_mm_setr_ps(x_, y_, z_, 0.0f))
+{}
+
+inline Vec3A::Vec3A(__m128 v_)
+    : v(v_)
+{}
+
+inline Vec3A::Vec3A(const Vec3& v_)
+    : Vec3A(v_.x, v_.y, v_.z)
+{}
+
+inline Vec3 Vec3A::to_vec3() const
+{
+    return Vec3(x, y, z);
+}
+
+// Unary -
+inline Vec3A Vec3A::operator-() const
+{
+    return Vec3A(_mm_xor_ps(v, _mm_set1_ps(-0.0f)));
+}
+
+// Unary +
+inline Vec3A Vec3A::operator+() const
+{
+    return *this;
+}
+
+inline Vec3A Vec3A::operator+(const Vec3A& rhs) const
+{
+    return Vec3A(_mm_add_ps(v, rhs.v));
+}
+
+inline Vec3A Vec3A::operator-(const Vec3A& rhs) const
+{
+    return Vec3A(_mm_sub_ps(v, rhs.v));
+}
+
+inline Vec3A Vec3A::operator+=(const Vec3A& rhs)
+{
+    v = _mm_add_ps(v, rhs.v);
+    return *this;
+}
+
+inline Vec3A Vec3A::operator-=(const Vec3A& rhs)
+{
+    v = _mm_sub_ps(v, rhs.v);
+    return *this;
+}
+
+inline float Vec3A::sq_mag() const
+{
+    return dot(*this, *this);
+}
+
+inline float Vec3A::mag() const
+{
+    return std::sqrt(sq_mag());
+}
+
+inline void Vec3A::normalize()
+{
+    v = _mm_div_ps(v, _mm_set1_ps(mag()));
+}
+
+inline Vec3A operator*(float lhs, const Vec3A& rhs)
+{
+    return Vec3A(_mm_mul_ps(_mm_set1_ps(lhs), rhs.v));
+}
+
+inline Vec3A operator*(const Vec3A& lhs, float rhs)
+{
+    return rhs * lhs;
+}
+
+inline float dot(const Vec3A& v1, const Vec3A& v2)
+{
+    // Sum the products in the same order as the Vec3 version
+    __m128 products = _mm_mul_ps(v1.v, v2.v);
+    __m128 y = _mm_shuffle_ps(products, products, _MM_SHUFFLE(1, 1, 1, 1));
+    __m128 z = _mm_shuffle_ps(products, products, _MM_SHUFFLE(2, 2, 2, 2));
+    return _mm_cvtss_f32(_mm_add_ss(_mm_add_ss(products, y), z));
+}
+
+inline Vec3A cross(const Vec3A& v1, const Vec3A& v2)
+{
+    // (y, z, x) and (z, x, y) rotations of each vector, with the fourth lane left in place
+    __m128 v1_yzx = _mm_shuffle_ps(v1.v, v1.v, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 v1_zxy = _mm_shuffle_ps(v1.v, v1.v, _MM_SHUFFLE(3, 1, 0, 2));
+    __m128 v2_yzx = _mm_shuffle_ps(v2.v, v2.v, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 v2_zxy = _mm_shuffle_ps(v2.v, v2.v, _MM_SHUFFLE(3, 1, 0, 2));
+    return Vec3A(_mm_sub_ps(_mm_mul_ps(v1_yzx, v2_zxy), _mm_mul_ps(v1_zxy, v2_yzx)));
+}
+
+inline Mat3A::Mat3A()
+    : c{Vec3A(1.0f, 0.0f, 0.0f), Vec3A(0.0f, 1.0f, 0.0f), Vec3A(0.0f, 0.0f, 1.0f)}
+{}
+
+inline Mat3A::Mat3A(const Mat3& m)
+    : c{Vec3A(m.col(0)), Vec3A(m.col(1)), Vec3A(m.col(2))}
+{}
+
+inline Mat3A Mat3A::FromColumns(const Vec3A& c0, const Vec3A& c1, const Vec3A& c2)
+{
+    Mat3A result;
+    result.c[0] = c0;
+    result.c[1] = c1;
+    result.c[2] = c2;
+    return result;
+}
+
+inline Vec3A Mat3A::col(unsigned int n) const
+{
+    assert(n <= 2);
+    return c[n];
+}
+
+inline Mat3A Mat3A::transpose() const
+{
+    __m128 c0 = c[0].v;
+    __m128 c1 = c[1].v;
+    __m128 c2 = c[2].v;
+    __m128 c3 = _mm_setzero_ps();
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    return FromColumns(Vec3A(c0), Vec3A(c1), Vec3A(c2));
+}
+
+inline Vec3A Mat3A::operator*(const Vec3A& rhs) const
+{
+    // Each lane sums its row's products in the same order as dot
+    __m128 x = _mm_shuffle_ps(rhs.v, rhs.v, _MM_SHUFFLE(0, 0, 0, 0));
+    __m128 y = _mm_shuffle_ps(rhs.v, rhs.v, _MM_SHUFFLE(1, 1, 1, 1));
+    __m128 z = _mm_shuffle_ps(rhs.v, rhs.v, _MM_SHUFFLE(2, 2, 2, 2));
+    __m128 xy = _mm_add_ps(_mm_mul_ps(c[0].v, x), _mm_mul_ps(c[1].v, y));
+    return Vec3A(_mm_add_ps(xy, _mm_mul_ps(c[2].v, z)));
+}
+
+inline Mat3A Mat3A::operator*(const Mat3A& rhs) const
+{
+    return FromColumns((*this) * rhs.c[0], (*this) * rhs.c[1], (*this) * rhs.c[2]);
+}
+
+#endif
+
 }
 
 #endif
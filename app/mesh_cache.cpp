@@ -0,0 +1,331 @@
+#include "mesh_cache.hpp"
+#include "quickhull.hpp"
+#include <cstring>
+#include <fstream>
+#include <system_error>
+#include <type_traits>
+
+using demo::math::Vec3;
+
+namespace demo::mesh {
+
+namespace {
+
+constexpr char cache_magic[8] = {'G', 'J', 'K', 'M', 'E', 'S', 'H', '\0'};
+
+// Increase this whenever the layout changes, so that old caches are rebuilt
+constexpr std::uint32_t cache_version = 1;
+
+// Reads back differently on a machine of the other byte order
+constexpr std::uint32_t cache_byte_order = 0x01020304;
+
+// Arrays start at multiples of this, which suits SIMD loads as well as their elements
+constexpr std::size_t cache_alignment = 16;
+
+static_assert(std::is_trivially_copyable_v<Vec3> && sizeof(Vec3) == 3 * sizeof(float));
+static_assert(std::is_trivially_copyable_v<Aabb> && std::is_trivially_copyable_v<BoundingSphere>);
+
+// Appends an array to the image at the next aligned offset, and returns the offset
+template <class T>
+std::uint64_t append_array(std::vector<char>& image, const T* data, std::size_t count)
+{
+    image.resize((image.size() + cache_alignment - 1) / cache_alignment * cache_alignment, 0);
+    std::uint64_t offset = image.size();
+    image.resize(image.size() + count * sizeof(T));
+    if (count > 0)
+    {
+        std::memcpy(image.data() + offset, data, count * sizeof(T));
+    }
+    return offset;
+}
+
+// Returns true iff count elements of type T at offset are aligned and inside the image
+template <class T>
+bool valid_array(std::uint64_t offset, std::uint64_t count, std::size_t size)
+{
+    return offset % alignof(T) == 0 && offset <= size && count <= (size - offset) / sizeof(T);
+}
+
+// Returns true iff each of the count indices at data is less than limit
+bool valid_indices(const char* data, std::uint64_t count, std::uint64_t limit)
+{
+    const std::uint32_t* indices = reinterpret_cast<const std::uint32_t*>(data);
+    for (std::uint64_t i = 0; i < count; ++i)
+    {
+        if (indices[i] >= limit)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+struct MeshCache::Header
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+
+    // The size and modification time of the OFF file the cache was made from
+    std::uint64_t source_size;
+    std::int64_t source_time;
+
+    Aabb bounds;
+    BoundingSphere sphere;
+
+    std::uint64_t render_vertex_count;
+    std::uint64_t render_index_count;
+    std::uint64_t hull_vertex_count;
+    std::uint64_t neighbour_count;
+
+    // Offsets of the arrays from the start of the file
+    std::uint64_t render_vertices_offset;
+    std::uint64_t render_indices_offset;
+    std::uint64_t hull_vertices_offset;
+    std::uint64_t adjacency_offsets_offset;
+    std::uint64_t neighbours_offset;
+};
+
+// There is no padding, so the header is written exactly as it is in memory
+static_assert(sizeof(MeshCache::Header) == 144);
+
+bool MeshCache::open(const std::filesystem::path& off_path)
+{
+    header = nullptr;
+    was_rebuilt = false;
+    file.reset();
+    image.clear();
+
+    std::error_code error;
+    std::uint64_t source_size = std::filesystem::file_size(off_path, error);
+    if (error)
+    {
+        return false;
+    }
+    std::int64_t source_time = static_cast<std::int64_t>(
+        std::filesystem::last_write_time(off_path, error).time_since_epoch().count());
+    if (error)
+    {
+        return false;
+    }
+
+    std::filesystem::path cache_path = mesh_cache_path(off_path);
+    if (open_file(cache_path) && header->source_size == source_size && header->source_time == source_time)
+    {
+        return true;
+    }
+
+    header = nullptr;
+    file.reset();
+    if (!build_mesh_cache(off_path, source_size, source_time, image))
+    {
+        return false;
+    }
+
+    // The cache is written to a temporary file and renamed over the old one, so it is never
+    // read half written. The image is used either way, so failing to write it is not an error.
+    std::filesystem::path temporary_path = cache_path;
+    temporary_path += ".tmp";
+    std::ofstream out(temporary_path, std::ios::binary | std::ios::trunc);
+    out.write(image.data(), static_cast<std::streamsize>(image.size()));
+    out.close();
+    if (out)
+    {
+        std::filesystem::rename(temporary_path, cache_path, error);
+    }
+    if (!out || error)
+    {
+        std::filesystem::remove(temporary_path, error);
+    }
+
+    was_rebuilt = true;
+    return attach(image.data(), image.size());
+}
+
+bool MeshCache::open_file(const std::filesystem::path& cache_path)
+{
+    header = nullptr;
+    was_rebuilt = false;
+    image.clear();
+    file.emplace(cache_path.c_str());
+    if (file->is_open() && attach(file->data(), file->size()))
+    {
+        return true;
+    }
+    file.reset();
+    return false;
+}
+
+bool MeshCache::attach(const char* data, std::size_t size)
+{
+    if (size < sizeof(Header))
+    {
+        return false;
+    }
+
+    const Header* h = reinterpret_cast<const Header*>(data);
+    if (std::memcmp(h->magic, cache_magic, sizeof(cache_magic)) != 0
+        || h->version != cache_version
+        || h->byte_order != cache_byte_order)
+    {
+        return false;
+    }
+
+    // A truncated file fails these checks
+    if (!valid_array<Vec3>(h->render_vertices_offset, h->render_vertex_count, size)
+        || !valid_array<std::uint32_t>(h->render_indices_offset, h->render_index_count, size)
+        || !valid_array<Vec3>(h->hull_vertices_offset, h->hull_vertex_count, size)
+        || !valid_array<std::uint32_t>(h->adjacency_offsets_offset, h->hull_vertex_count + 1, size)
+        || !valid_array<std::uint32_t>(h->neighbours_offset, h->neighbour_count, size))
+    {
+        return false;
+    }
+
+    // A damaged file can still have a plausible header, so every index is checked as well.
+    // Otherwise the support mappings or the renderer could read past the end of an array.
+    const std::uint32_t* offsets = reinterpret_cast<const std::uint32_t*>(data + h->adjacency_offsets_offset);
+    if (offsets[0] != 0 || offsets[h->hull_vertex_count] != h->neighbour_count)
+    {
+        return false;
+    }
+    for (std::uint64_t i = 0; i < h->hull_vertex_count; ++i)
+    {
+        if (offsets[i] > offsets[i + 1])
+        {
+            return false;
+        }
+    }
+    if (!valid_indices(data + h->neighbours_offset, h->neighbour_count, h->hull_vertex_count)
+        || !valid_indices(data + h->render_indices_offset, h->render_index_count, h->render_vertex_count))
+    {
+        return false;
+    }
+
+    header = h;
+    return true;
+}
+
+template <class T>
+const T* MeshCache::at(std::uint64_t offset) const
+{
+    return reinterpret_cast<const T*>(reinterpret_cast<const char*>(header) + offset);
+}
+
+bool MeshCache::rebuilt() const
+{
+    return was_rebuilt;
+}
+
+const Vec3* MeshCache::render_vertices() const
+{
+    return at<Vec3>(header->render_vertices_offset);
+}
+
+std::size_t MeshCache::render_vertex_count() const
+{
+    return header->render_vertex_count;
+}
+
+const std::uint32_t* MeshCache::render_indices() const
+{
+    return at<std::uint32_t>(header->render_indices_offset);
+}
+
+std::size_t MeshCache::render_index_count() const
+{
+    return header->render_index_count;
+}
+
+const Vec3* MeshCache::hull_vertices() const
+{
+    return at<Vec3>(header->hull_vertices_offset);
+}
+
+std::size_t MeshCache::hull_vertex_count() const
+{
+    return header->hull_vertex_count;
+}
+
+const std::uint32_t* MeshCache::adjacency_offsets() const
+{
+    return at<std::uint32_t>(header->adjacency_offsets_offset);
+}
+
+const std::uint32_t* MeshCache::adjacency_neighbours() const
+{
+    return at<std::uint32_t>(header->neighbours_offset);
+}
+
+std::size_t MeshCache::adjacency_neighbour_count() const
+{
+    return header->neighbour_count;
+}
+
+const Aabb& MeshCache::bounds() const
+{
+    return header->bounds;
+}
+
+const BoundingSphere& MeshCache::sphere() const
+{
+    return header->sphere;
+}
+
+std::filesystem::path mesh_cache_path(const std::filesystem::path& off_path)
+{
+    std::filesystem::path cache_path = off_path;
+    cache_path += ".cache";
+    return cache_path;
+}
+
+bool build_mesh_cache(const std::filesystem::path& off_path,
+                      std::uint64_t source_size, std::int64_t source_time,
+                      std::vector<char>& image)
+{
+    image.clear();
+
+    IndexedMesh mesh;
+    if (!load_off(off_path.c_str(), mesh))
+    {
+        return false;
+    }
+
+    // Points inside the hull can never be support points, so only the hull is kept. If the
+    // mesh is flat, it has no hull, and all of its vertices are used.
+    std::vector<Vec3> hull_vertices;
+    std::vector<std::uint32_t> hull_indices;
+    if (!compute_convex_hull(mesh.vertices, hull_vertices, hull_indices))
+    {
+        hull_vertices = mesh.vertices;
+        hull_indices = mesh.indices;
+    }
+    VertexAdjacency adjacency;
+    compute_adjacency(hull_vertices.size(), hull_indices, adjacency);
+
+    MeshCache::Header header;
+    std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+    header.version = cache_version;
+    header.byte_order = cache_byte_order;
+    header.source_size = source_size;
+    header.source_time = source_time;
+    header.bounds = compute_bounds(hull_vertices);
+    header.sphere = compute_bounding_sphere(hull_vertices);
+    header.render_vertex_count = mesh.vertices.size();
+    header.render_index_count = mesh.indices.size();
+    header.hull_vertex_count = hull_vertices.size();
+    header.neighbour_count = adjacency.neighbours.size();
+
+    image.resize(sizeof(MeshCache::Header));
+    header.render_vertices_offset = append_array(image, mesh.vertices.data(), mesh.vertices.size());
+    header.render_indices_offset = append_array(image, mesh.indices.data(), mesh.indices.size());
+    header.hull_vertices_offset = append_array(image, hull_vertices.data(), hull_vertices.size());
+    header.adjacency_offsets_offset = append_array(image, adjacency.offsets.data(), adjacency.offsets.size());
+    header.neighbours_offset = append_array(image, adjacency.neighbours.data(), adjacency.neighbours.size());
+    std::memcpy(image.data(), &header, sizeof(header));
+
+    return true;
+}
+
+}
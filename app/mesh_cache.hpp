@@ -0,0 +1,86 @@
+#ifndef MESH_CACHE_HPP
+#define MESH_CACHE_HPP
+
+#include "math.hpp"
+#include "mesh_tools.hpp"
+#include "load_mesh.hpp"
+#include "bounds.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+namespace demo::mesh {
+
+// Everything needed to use a mesh, prepared from an OFF file: the triangles it is rendered with,
+// and the convex hull, adjacency and bounds used for collision detection. The hull is the whole
+// mesh if the mesh is flat.
+//
+// A cache file stores this in a binary form that is used in place once the file is mapped, so
+// opening a cache costs little more than the mapping itself. The file starts with a versioned
+// header, followed by each array at an offset aligned for its elements, in the native byte order.
+// The header also records the size and modification time of the OFF file it was made from, so a
+// cache that no longer matches is rebuilt.
+class MeshCache
+{
+public:
+    // Opens the cache of an OFF file, which is stored next to it, first rebuilding it if it is
+    // missing, from another version of the format, or made from a different OFF file. If the
+    // rebuilt cache can't be written, it is kept in memory instead.
+    // Returns false if the OFF file can't be loaded.
+    bool open(const std::filesystem::path& off_path);
+
+    // Opens a cache file without checking it against its OFF file.
+    // Returns false if the file can't be read, or is not a complete cache of this version.
+    bool open_file(const std::filesystem::path& cache_path);
+
+    // Whether the last successful open had to rebuild the cache from the OFF file
+    bool rebuilt() const;
+
+    const demo::math::Vec3* render_vertices() const;
+    std::size_t render_vertex_count() const;
+    const std::uint32_t* render_indices() const;
+    std::size_t render_index_count() const;
+
+    const demo::math::Vec3* hull_vertices() const;
+    std::size_t hull_vertex_count() const;
+
+    // The hull's adjacency, in the same form as VertexAdjacency: hull_vertex_count() + 1 offsets
+    // into the neighbours
+    const std::uint32_t* adjacency_offsets() const;
+    const std::uint32_t* adjacency_neighbours() const;
+    std::size_t adjacency_neighbour_count() const;
+
+    const Aabb& bounds() const;
+    const BoundingSphere& sphere() const;
+
+    // The start of a cache file, defined in mesh_cache.cpp
+    struct Header;
+
+private:
+    // Checks the contents at data, and points header at them if they are a valid cache
+    bool attach(const char* data, std::size_t size);
+
+    template <class T>
+    const T* at(std::uint64_t offset) const;
+
+    std::optional<FileView> file;
+    std::vector<char> image;
+    const Header* header = nullptr;
+    bool was_rebuilt = false;
+};
+
+// Returns the path of the cache of an OFF file: the same path with ".cache" appended
+std::filesystem::path mesh_cache_path(const std::filesystem::path& off_path);
+
+// Loads an OFF file and prepares it as a cache, in the form it is stored in a file. The cache
+// records source_size and source_time as the size and modification time of its OFF file.
+// Returns false, leaving image empty, if the file can't be loaded.
+bool build_mesh_cache(const std::filesystem::path& off_path,
+                      std::uint64_t source_size, std::int64_t source_time,
+                      std::vector<char>& image);
+
+}
+
+#endif
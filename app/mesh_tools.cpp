@@ -1,6 +1,10 @@
 #include "mesh_tools.hpp"
 #include "math.hpp"
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
+#include <map>
+#include <utility>
 #include <vector>
 
 namespace demo::mesh {
@@ -18,4 +22,150 @@ void compute_normals(const std::vector<demo::math::Vec3>& triangles,
     }
 }
 
+std::size_t IndexedMesh::triangle_count() const
+{
+    return indices.size() / 3;
+}
+
+void compute_face_normals(IndexedMesh& mesh)
+{
+    mesh.face_normals.resize(mesh.triangle_count());
+    for (std::size_t i = 0; i < mesh.face_normals.size(); ++i)
+    {
+        const demo::math::Vec3& a = mesh.vertices[mesh.indices[3*i]];
+        const demo::math::Vec3& b = mesh.vertices[mesh.indices[3*i + 1]];
+        const demo::math::Vec3& c = mesh.vertices[mesh.indices[3*i + 2]];
+        mesh.face_normals[i] = demo::math::cross(b - a, c - a);
+        mesh.face_normals[i].normalize();
+    }
+}
+
+std::size_t VertexAdjacency::vertex_count() const
+{
+    return offsets.empty() ? 0 : offsets.size() - 1;
+}
+
+const std::uint32_t* VertexAdjacency::begin(std::uint32_t vertex) const
+{
+    return neighbours.data() + offsets[vertex];
+}
+
+const std::uint32_t* VertexAdjacency::end(std::uint32_t vertex) const
+{
+    return neighbours.data() + offsets[vertex + 1];
+}
+
+void compute_adjacency(std::size_t vertex_count,
+                       const std::vector<std::uint32_t>& indices,
+                       VertexAdjacency& adjacency)
+{
+    // List every directed edge, then sort them so that the edges leaving each vertex
+    // are contiguous, and duplicates (from edges shared between triangles) are adjacent.
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> edges;
+    edges.reserve(2 * indices.size());
+
+    for (std::size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        for (std::size_t j = 0; j < 3; ++j)
+        {
+            std::uint32_t v0 = indices[i + j];
+            std::uint32_t v1 = indices[i + (j + 1) % 3];
+            edges.emplace_back(v0, v1);
+            edges.emplace_back(v1, v0);
+        }
+    }
+
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    adjacency.offsets.assign(vertex_count + 1, 0);
+    adjacency.neighbours.clear();
+    adjacency.neighbours.reserve(edges.size());
+
+    for (const auto& edge : edges)
+    {
+        ++adjacency.offsets[edge.first + 1];
+        adjacency.neighbours.push_back(edge.second);
+    }
+
+    // Convert the counts into offsets
+    for (std::size_t i = 0; i < vertex_count; ++i)
+    {
+        adjacency.offsets[i + 1] += adjacency.offsets[i];
+    }
+}
+
+void make_icosphere(unsigned int subdivisions,
+                    std::vector<demo::math::Vec3>& vertices,
+                    std::vector<std::uint32_t>& indices)
+{
+    using demo::math::Vec3;
+
+    const float t = (1.0f + std::sqrt(5.0f)) / 2.0f;
+
+    vertices = {
+        Vec3(-1.0f, t, 0.0f), Vec3(1.0f, t, 0.0f), Vec3(-1.0f, -t, 0.0f), Vec3(1.0f, -t, 0.0f),
+        Vec3(0.0f, -1.0f, t), Vec3(0.0f, 1.0f, t), Vec3(0.0f, -1.0f, -t), Vec3(0.0f, 1.0f, -t),
+        Vec3(t, 0.0f, -1.0f), Vec3(t, 0.0f, 1.0f), Vec3(-t, 0.0f, -1.0f), Vec3(-t, 0.0f, 1.0f)
+    };
+
+    indices = {
+        0, 11, 5,   0, 5, 1,    0, 1, 7,    0, 7, 10,   0, 10, 11,
+        1, 5, 9,    5, 11, 4,   11, 10, 2,  10, 7, 6,   7, 1, 8,
+        3, 9, 4,    3, 4, 2,    3, 2, 6,    3, 6, 8,    3, 8, 9,
+        4, 9, 5,    2, 4, 11,   6, 2, 10,   8, 6, 7,    9, 8, 1
+    };
+
+    for (Vec3& v : vertices)
+    {
+        v.normalize();
+    }
+
+    for (unsigned int s = 0; s < subdivisions; ++s)
+    {
+        // Each edge is split once, even though it is shared by two triangles
+        std::map<std::pair<std::uint32_t, std::uint32_t>, std::uint32_t> midpoints;
+
+        auto midpoint = [&vertices, &midpoints](std::uint32_t a, std::uint32_t b) {
+            auto key = std::minmax(a, b);
+            auto it = midpoints.find(key);
+            if (it != midpoints.end())
+            {
+                return it->second;
+            }
+
+            Vec3 m = vertices[a] + vertices[b];
+            m.normalize();
+
+            std::uint32_t index = vertices.size();
+            vertices.push_back(m);
+            midpoints.emplace(key, index);
+            return index;
+        };
+
+        std::vector<std::uint32_t> subdivided;
+        subdivided.reserve(4 * indices.size());
+
+        for (std::size_t i = 0; i < indices.size(); i += 3)
+        {
+            std::uint32_t a = indices[i];
+            std::uint32_t b = indices[i + 1];
+            std::uint32_t c = indices[i + 2];
+
+            std::uint32_t ab = midpoint(a, b);
+            std::uint32_t bc = midpoint(b, c);
+            std::uint32_t ca = midpoint(c, a);
+
+            subdivided.insert(subdivided.end(), {
+                a, ab, ca,
+                b, bc, ab,
+                c, ca, bc,
+                ab, bc, ca
+            });
+        }
+
+        indices = std::move(subdivided);
+    }
+}
+
 }
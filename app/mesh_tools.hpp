@@ -2,6 +2,8 @@
 #define MESH_TOOLS
 
 #include <vector>
+#include <cstddef>
+#include <cstdint>
 #include "math.hpp"
 
 namespace demo::mesh {
@@ -13,6 +15,47 @@ namespace demo::mesh {
 void compute_normals(const std::vector<demo::math::Vec3>& triangles,
                      std::vector<demo::math::Vec3>& normals);
 
+// A triangle mesh whose vertices are shared between the triangles that use them.
+// Each triangle is three indices into vertices, counter-clockwise when viewed from outside.
+// face_normals is optional: it is empty unless filled by compute_face_normals, and then
+// holds one unit normal per triangle.
+struct IndexedMesh
+{
+    std::vector<demo::math::Vec3> vertices;
+    std::vector<std::uint32_t> indices;
+    std::vector<demo::math::Vec3> face_normals;
+
+    std::size_t triangle_count() const;
+};
+
+// Computes the outward unit normal of each triangle of the mesh.
+void compute_face_normals(IndexedMesh& mesh);
+
+// The vertices connected to each vertex of a mesh by an edge, in compressed form.
+// The neighbours of vertex i are neighbours[offsets[i]] to neighbours[offsets[i+1] - 1].
+struct VertexAdjacency
+{
+    std::vector<std::uint32_t> offsets;
+    std::vector<std::uint32_t> neighbours;
+
+    std::size_t vertex_count() const;
+    const std::uint32_t* begin(std::uint32_t vertex) const;
+    const std::uint32_t* end(std::uint32_t vertex) const;
+};
+
+// Computes the adjacency of vertex_count vertices from triangle indices (three per triangle).
+// Each edge is listed once in each direction, even if it is shared by several triangles.
+void compute_adjacency(std::size_t vertex_count,
+                       const std::vector<std::uint32_t>& indices,
+                       VertexAdjacency& adjacency);
+
+// Generates a unit sphere by subdividing an icosahedron. Each subdivision splits every
+// triangle into 4, giving 10*4^subdivisions + 2 vertices. Triangles are counter-clockwise
+// when viewed from outside.
+void make_icosphere(unsigned int subdivisions,
+                    std::vector<demo::math::Vec3>& vertices,
+                    std::vector<std::uint32_t>& indices);
+
 }
 
 #endif
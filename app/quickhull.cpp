@@ -0,0 +1,458 @@
+#include "quickhull.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+using demo::math::Vec3;
+
+namespace demo::mesh {
+
+namespace {
+
+// The hull is built in double precision, so that the only rounding which matters is that of
+// the input points themselves
+struct Point
+{
+    double x, y, z;
+};
+
+Point sub(const Point& a, const Point& b)
+{
+    return Point{a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+double dot(const Point& a, const Point& b)
+{
+    return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+Point cross(const Point& a, const Point& b)
+{
+    return Point{a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x};
+}
+
+constexpr std::uint32_t no_face = ~std::uint32_t(0);
+
+// A triangle of the hull, counter-clockwise from outside. Edge k runs from v[k] to v[(k + 1) % 3],
+// and neighbour[k] is the face on the other side of it.
+struct Face
+{
+    std::uint32_t v[3];
+    std::uint32_t neighbour[3] = {no_face, no_face, no_face};
+    Point normal;
+    double offset = 0.0;
+
+    // Points which are outside this face, and were not outside any face tested before it
+    std::vector<std::uint32_t> outside;
+
+    // Set once the face is no longer part of the hull
+    bool removed = false;
+};
+
+// An edge on the boundary of the faces visible from a new point, with the face beyond it
+struct HorizonEdge
+{
+    std::uint32_t a;
+    std::uint32_t b;
+    std::uint32_t face;
+};
+
+class HullBuilder
+{
+public:
+    explicit HullBuilder(const std::vector<Vec3>& input)
+    {
+        points.reserve(input.size());
+        double extent[3] = {0.0, 0.0, 0.0};
+        for (const Vec3& v : input)
+        {
+            points.push_back(Point{v.x, v.y, v.z});
+            extent[0] = std::max(extent[0], std::abs(double(v.x)));
+            extent[1] = std::max(extent[1], std::abs(double(v.y)));
+            extent[2] = std::max(extent[2], std::abs(double(v.z)));
+        }
+
+        // The input is only accurate to float precision, so points within a few float rounding
+        // errors of a face are taken to be on it
+        tolerance = 3.0 * std::numeric_limits<float>::epsilon() * (extent[0] + extent[1] + extent[2]);
+    }
+
+    bool build()
+    {
+        if (!build_tetrahedron())
+        {
+            return false;
+        }
+
+        while (!pending.empty())
+        {
+            std::uint32_t f = pending.back();
+            pending.pop_back();
+            if (faces[f].removed || faces[f].outside.empty())
+            {
+                continue;
+            }
+
+            // Add the point furthest outside the face
+            const std::vector<std::uint32_t>& outside = faces[f].outside;
+            std::uint32_t eye = outside[0];
+            double eye_distance = distance(faces[f], points[eye]);
+            for (std::uint32_t i : outside)
+            {
+                double d = distance(faces[f], points[i]);
+                if (d > eye_distance)
+                {
+                    eye = i;
+                    eye_distance = d;
+                }
+            }
+            add_point(f, eye);
+        }
+        return true;
+    }
+
+    void extract(std::vector<Vec3>& hull_vertices, std::vector<std::uint32_t>& hull_indices) const
+    {
+        // Number the vertices which are still used in their input order
+        std::vector<std::uint32_t> new_index(points.size(), no_face);
+        for (const Face& face : faces)
+        {
+            if (!face.removed)
+            {
+                for (std::uint32_t v : face.v)
+                {
+                    new_index[v] = 0;
+                }
+            }
+        }
+
+        hull_vertices.clear();
+        for (std::size_t i = 0; i < points.size(); ++i)
+        {
+            if (new_index[i] != no_face)
+            {
+                new_index[i] = static_cast<std::uint32_t>(hull_vertices.size());
+                hull_vertices.push_back(Vec3(float(points[i].x), float(points[i].y), float(points[i].z)));
+            }
+        }
+
+        hull_indices.clear();
+        for (const Face& face : faces)
+        {
+            if (!face.removed)
+            {
+                for (std::uint32_t v : face.v)
+                {
+                    hull_indices.push_back(new_index[v]);
+                }
+            }
+        }
+    }
+
+private:
+    static double distance(const Face& face, const Point& p)
+    {
+        return dot(face.normal, p) - face.offset;
+    }
+
+    std::uint32_t add_face(std::uint32_t a, std::uint32_t b, std::uint32_t c)
+    {
+        Face face;
+        face.v[0] = a;
+        face.v[1] = b;
+        face.v[2] = c;
+
+        const Point& pa = points[a];
+        const Point& pb = points[b];
+        const Point& pc = points[c];
+        Point normal = cross(sub(pb, pa), sub(pc, pa));
+        double length = std::sqrt(dot(normal, normal));
+        if (length > 0.0)
+        {
+            face.normal = Point{normal.x / length, normal.y / length, normal.z / length};
+            Point centroid{(pa.x + pb.x + pc.x) / 3.0, (pa.y + pb.y + pc.y) / 3.0, (pa.z + pb.z + pc.z) / 3.0};
+            face.offset = dot(face.normal, centroid);
+        }
+        else
+        {
+            // A degenerate face, which no point is outside of
+            face.normal = Point{0.0, 0.0, 0.0};
+        }
+
+        faces.push_back(std::move(face));
+        return static_cast<std::uint32_t>(faces.size() - 1);
+    }
+
+    // Index of the edge of face f which runs from a to b
+    std::size_t find_edge(std::uint32_t f, std::uint32_t a, std::uint32_t b) const
+    {
+        const Face& face = faces[f];
+        for (std::size_t k = 0; k < 3; ++k)
+        {
+            if (face.v[k] == a && face.v[(k + 1) % 3] == b)
+            {
+                return k;
+            }
+        }
+        assert(false);
+        return 0;
+    }
+
+    // Hands each point to the first of faces it is outside of, and queues those faces
+    void assign_points(const std::vector<std::uint32_t>& candidates, const std::vector<std::uint32_t>& new_faces)
+    {
+        for (std::uint32_t i : candidates)
+        {
+            for (std::uint32_t f : new_faces)
+            {
+                if (distance(faces[f], points[i]) > tolerance)
+                {
+                    faces[f].outside.push_back(i);
+                    break;
+                }
+            }
+        }
+
+        for (std::uint32_t f : new_faces)
+        {
+            if (!faces[f].outside.empty())
+            {
+                pending.push_back(f);
+            }
+        }
+    }
+
+    bool build_tetrahedron()
+    {
+        if (points.size() < 4)
+        {
+            return false;
+        }
+
+        // The two points furthest apart along a coordinate axis
+        std::uint32_t min_index[3] = {0, 0, 0};
+        std::uint32_t max_index[3] = {0, 0, 0};
+        for (std::uint32_t i = 0; i < points.size(); ++i)
+        {
+            const double p[3] = {points[i].x, points[i].y, points[i].z};
+            const double min[3] = {points[min_index[0]].x, points[min_index[1]].y, points[min_index[2]].z};
+            const double max[3] = {points[max_index[0]].x, points[max_index[1]].y, points[max_index[2]].z};
+            for (unsigned int axis = 0; axis < 3; ++axis)
+            {
+                if (p[axis] < min[axis])
+                {
+                    min_index[axis] = i;
+                }
+                if (p[axis] > max[axis])
+                {
+                    max_index[axis] = i;
+                }
+            }
+        }
+
+        std::uint32_t v0 = 0;
+        std::uint32_t v1 = 0;
+        double best = 0.0;
+        for (unsigned int axis = 0; axis < 3; ++axis)
+        {
+            Point span = sub(points[max_index[axis]], points[min_index[axis]]);
+            double length = std::sqrt(dot(span, span));
+            if (length > best)
+            {
+                v0 = min_index[axis];
+                v1 = max_index[axis];
+                best = length;
+            }
+        }
+        if (best <= tolerance)
+        {
+            return false;
+        }
+
+        // The point furthest from the line through them
+        Point line = sub(points[v1], points[v0]);
+        std::uint32_t v2 = 0;
+        best = 0.0;
+        for (std::uint32_t i = 0; i < points.size(); ++i)
+        {
+            Point c = cross(sub(points[i], points[v0]), line);
+            double d = dot(c, c);
+            if (d > best)
+            {
+                v2 = i;
+                best = d;
+            }
+        }
+        if (std::sqrt(best) / std::sqrt(dot(line, line)) <= tolerance)
+        {
+            return false;
+        }
+
+        // The point furthest from the plane through all three
+        Point normal = cross(line, sub(points[v2], points[v0]));
+        double normal_length = std::sqrt(dot(normal, normal));
+        std::uint32_t v3 = 0;
+        double v3_distance = 0.0;
+        for (std::uint32_t i = 0; i < points.size(); ++i)
+        {
+            double d = dot(normal, sub(points[i], points[v0])) / normal_length;
+            if (std::abs(d) > std::abs(v3_distance))
+            {
+                v3 = i;
+                v3_distance = d;
+            }
+        }
+        if (std::abs(v3_distance) <= tolerance)
+        {
+            return false;
+        }
+
+        // The base faces away from the fourth point, and the other faces are each built on a
+        // reversed edge of the base
+        if (v3_distance > 0.0)
+        {
+            std::swap(v1, v2);
+        }
+        std::vector<std::uint32_t> tetrahedron = {
+            add_face(v0, v1, v2),
+            add_face(v1, v0, v3),
+            add_face(v2, v1, v3),
+            add_face(v0, v2, v3)};
+
+        for (std::uint32_t f : tetrahedron)
+        {
+            for (std::size_t k = 0; k < 3; ++k)
+            {
+                std::uint32_t a = faces[f].v[k];
+                std::uint32_t b = faces[f].v[(k + 1) % 3];
+                for (std::uint32_t g : tetrahedron)
+                {
+                    const Face& other = faces[g];
+                    if (g != f && std::find(std::begin(other.v), std::end(other.v), a) != std::end(other.v)
+                        && std::find(std::begin(other.v), std::end(other.v), b) != std::end(other.v))
+                    {
+                        faces[f].neighbour[k] = g;
+                    }
+                }
+            }
+        }
+
+        std::vector<std::uint32_t> candidates;
+        for (std::uint32_t i = 0; i < points.size(); ++i)
+        {
+            if (i != v0 && i != v1 && i != v2 && i != v3)
+            {
+                candidates.push_back(i);
+            }
+        }
+        assign_points(candidates, tetrahedron);
+        return true;
+    }
+
+    // Removes face f, which was entered across its edge entry_edge, and the faces beyond it
+    // which are visible from eye. The edges where that region ends are appended to horizon in
+    // order, so that they form a loop running counter-clockwise when viewed from eye.
+    void find_horizon(const Point& eye, std::uint32_t f, std::size_t entry_edge, bool first)
+    {
+        faces[f].removed = true;
+        visible.push_back(f);
+
+        for (std::size_t k = first ? 0 : 1; k < 3; ++k)
+        {
+            std::size_t edge = (entry_edge + k) % 3;
+            std::uint32_t n = faces[f].neighbour[edge];
+            if (faces[n].removed)
+            {
+                continue;
+            }
+
+            std::uint32_t a = faces[f].v[edge];
+            std::uint32_t b = faces[f].v[(edge + 1) % 3];
+            if (distance(faces[n], eye) > tolerance)
+            {
+                find_horizon(eye, n, find_edge(n, b, a), false);
+            }
+            else
+            {
+                horizon.push_back(HorizonEdge{a, b, n});
+            }
+        }
+    }
+
+    void add_point(std::uint32_t f, std::uint32_t eye)
+    {
+        visible.clear();
+        horizon.clear();
+        find_horizon(points[eye], f, 0, true);
+
+        // Join each horizon edge to the new point. Consecutive new faces share the edges
+        // leading to the point.
+        std::vector<std::uint32_t> new_faces;
+        for (const HorizonEdge& edge : horizon)
+        {
+            std::uint32_t g = add_face(edge.a, edge.b, eye);
+            faces[g].neighbour[0] = edge.face;
+            faces[edge.face].neighbour[find_edge(edge.face, edge.b, edge.a)] = g;
+            new_faces.push_back(g);
+        }
+        for (std::size_t i = 0; i < new_faces.size(); ++i)
+        {
+            std::uint32_t g = new_faces[i];
+            std::uint32_t next = new_faces[(i + 1) % new_faces.size()];
+            assert(faces[g].v[1] == faces[next].v[0]);
+            faces[g].neighbour[1] = next;
+            faces[next].neighbour[2] = g;
+        }
+
+        // The points outside the removed faces are either outside a new face, or now inside
+        std::vector<std::uint32_t> candidates;
+        for (std::uint32_t v : visible)
+        {
+            for (std::uint32_t i : faces[v].outside)
+            {
+                if (i != eye)
+                {
+                    candidates.push_back(i);
+                }
+            }
+            faces[v].outside.clear();
+            faces[v].outside.shrink_to_fit();
+        }
+        assign_points(candidates, new_faces);
+    }
+
+    std::vector<Point> points;
+    double tolerance = 0.0;
+
+    std::vector<Face> faces;
+
+    // Faces which may have points outside them
+    std::vector<std::uint32_t> pending;
+
+    // Scratch space for add_point
+    std::vector<std::uint32_t> visible;
+    std::vector<HorizonEdge> horizon;
+};
+
+}
+
+bool compute_convex_hull(const std::vector<Vec3>& points,
+                         std::vector<Vec3>& hull_vertices,
+                         std::vector<std::uint32_t>& hull_indices)
+{
+    hull_vertices.clear();
+    hull_indices.clear();
+
+    HullBuilder builder(points);
+    if (!builder.build())
+    {
+        return false;
+    }
+
+    builder.extract(hull_vertices, hull_indices);
+    return true;
+}
+
+}
@@ -0,0 +1,26 @@
+#ifndef QUICKHULL_HPP
+#define QUICKHULL_HPP
+
+#include "math.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace demo::mesh {
+
+// Computes the convex hull of a set of points by Quickhull (Barber, Dobkin and Huhdanpaa, The
+// Quickhull Algorithm for Convex Hulls, 1996). hull_vertices receives the extreme points, in the
+// order they first appear in points, and hull_indices three indices into hull_vertices for each
+// triangle of the hull, counter-clockwise when viewed from outside. Faces with more than three
+// vertices are split into triangles.
+//
+// Points closer to the hull than a tolerance scaled to the size of the input are treated as
+// inside it, so points in the middle of flat faces are dropped.
+// Returns false, leaving the outputs empty, if the points all lie close to a plane.
+bool compute_convex_hull(const std::vector<demo::math::Vec3>& points,
+                         std::vector<demo::math::Vec3>& hull_vertices,
+                         std::vector<std::uint32_t>& hull_indices);
+
+}
+
+#endif
@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <cmath>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -35,20 +36,17 @@ RenderContext::RenderContext(unsigned int w, unsigned int h, const char* title)
     glCullFace(GL_BACK);
 
     // Vertex shader description:
-    // Computes camera-relative normals and perspective-transformed vertex coordinates
+    // Computes camera-relative and perspective-transformed vertex coordinates
     const char* vshader_string =
         "#version 140\n"
         "in vec3 vpos;\n"
-        "in vec3 normal;\n"
         "uniform mat4 perspective;\n"
         "uniform mat3 orientation;\n"
         "uniform vec3 position;\n"
         "uniform vec3 global_position;\n"
         "uniform mat3 global_orientation;\n"
-        "out vec3 camera_relative_normal;\n"
         "out vec3 camera_relative_position;\n"
         "void main() {\n"
-        "    camera_relative_normal = global_orientation * orientation * normal;\n"
         "    camera_relative_position = global_position + global_orientation * (position + orientation * vpos);\n"
         "    gl_Position = perspective * vec4(camera_relative_position, 1.0f);\n"
         "}\n";
@@ -56,13 +54,15 @@ RenderContext::RenderContext(unsigned int w, unsigned int h, const char* title)
     // Fragment shader description:
     // Draws colour based on colour mask.
     // Faces directly facing the camera are drawn brighter than those that are barely facing the camera.
+    // The face normal is the cross product of the screen space derivatives of the position, which
+    // lie in the plane of the face, so vertices shared between faces don't need normals of their own.
     const char* fshader_string =
         "#version 140\n"
         "uniform vec3 colour_mask;\n"
-        "in vec3 camera_relative_normal;\n"
         "in vec3 camera_relative_position;\n"
         "out vec4 colour;\n"
         "void main() {\n"
+        "    vec3 camera_relative_normal = cross(dFdx(camera_relative_position), dFdy(camera_relative_position));\n"
         "    float angular_component = -dot(normalize(camera_relative_position), normalize(camera_relative_normal));\n"
         "    float intensity = 0.5f + 0.5f * angular_component;\n"
         "    colour = vec4(intensity * colour_mask, 1.0f);\n"
@@ -80,39 +80,42 @@ RenderContext::~RenderContext()
     glfwTerminate();
 }
 
-std::size_t RenderContext::load_object(const Vec3* positions, const Vec3* normals, std::size_t count)
+std::size_t RenderContext::load_object(const demo::mesh::IndexedMesh& mesh)
+{
+    return load_object(mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), mesh.indices.size());
+}
+
+std::size_t RenderContext::load_object(const Vec3* vertices, std::size_t vertex_count,
+                                       const std::uint32_t* indices, std::size_t index_count)
 {
     // Create VAO
     GLuint vao;
     glGenVertexArrays(1, &vao);
     glBindVertexArray(vao);
 
-    // Create and fill VBO with position and normal data
+    // Create and fill VBO with position data
     GLuint pos_vbo;
     glGenBuffers(1, &pos_vbo);
     glBindBuffer(GL_ARRAY_BUFFER, pos_vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Vec3) * count, positions, GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(Vec3) * vertex_count, vertices, GL_STATIC_DRAW);
 
     glEnableVertexAttribArray(0);   // Location for position in shader program
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vec3), 0);
 
-    // Create and fill VBO for normal data
-    GLuint normal_vbo;
-    glGenBuffers(1, &normal_vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, normal_vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Vec3) * count, normals, GL_STATIC_DRAW);
-
-    glEnableVertexAttribArray(1);   // Location for normal in shader program
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vec3), 0);
+    // Create and fill the element buffer, which stays bound to the VAO
+    GLuint index_buffer;
+    glGenBuffers(1, &index_buffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(std::uint32_t) * index_count, indices, GL_STATIC_DRAW);
 
     // Keep track of the newly created object.
     std::size_t object_id = objects.size();
     objects.emplace_back();
 
     objects.back().pos_vbo = pos_vbo;
-    objects.back().normal_vbo = normal_vbo;
+    objects.back().index_buffer = index_buffer;
     objects.back().vao = vao;
-    objects.back().num_vertices = count;
+    objects.back().num_indices = static_cast<GLsizei>(index_count);
 
     return object_id;
 }
@@ -164,7 +167,7 @@ void RenderContext::draw_object(std::size_t object_id, const Vec3& position, con
     glUniformMatrix3fv(location, 1, GL_TRUE, global_orientation);
 
     // Draw the object
-    glDrawArrays(GL_TRIANGLES, 0, object.num_vertices);
+    glDrawElements(GL_TRIANGLES, object.num_indices, GL_UNSIGNED_INT, nullptr);
 }
 
 // The GLFW window is needed for event handling
@@ -2,9 +2,11 @@
 #define RENDERING_HPP
 
 #include "math.hpp"
+#include "mesh_tools.hpp"
 
 #include <vector>
 #include <cstddef>
+#include <cstdint>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -18,7 +20,14 @@ namespace demo::rendering {
 
         ~RenderContext();
 
-        std::size_t load_object(const demo::math::Vec3* positions, const demo::math::Vec3* normals, std::size_t count);
+        // Uploads the vertices of the mesh once each, with an element buffer of its indices.
+        // Faces are shaded flat with normals derived in the fragment shader, so no normals are
+        // uploaded, and the mesh can be freed afterwards.
+        std::size_t load_object(const demo::mesh::IndexedMesh& mesh);
+
+        // The same, for a mesh stored elsewhere, such as a mapped mesh cache
+        std::size_t load_object(const demo::math::Vec3* vertices, std::size_t vertex_count,
+                                const std::uint32_t* indices, std::size_t index_count);
 
         void draw_object(std::size_t object_id, const demo::math::Vec3& position, const float* orientation, bool selected, bool colliding, const demo::math::Vec3& global_position, const float* global_orientation);
 
@@ -42,9 +51,9 @@ namespace demo::rendering {
         struct RenderObject
         {
             GLuint pos_vbo;
-            GLuint normal_vbo;
+            GLuint index_buffer;
             GLuint vao;
-            GLsizei num_vertices;
+            GLsizei num_indices;
         };
 
         GLFWwindow* window;
@@ -0,0 +1,339 @@
+#include "broad_phase.hpp"
+#include "aabb_tree.hpp"
+#include "gjk.hpp"
+#include "math.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace demo::math;
+
+void test_world_bounds()
+{
+    Aabb local{Vec3(-1.0f, -2.0f, -3.0f), Vec3(1.0f, 2.0f, 3.0f)};
+
+    // A quarter turn about z swaps the x and y extents
+    ConvexHullInstance instance(Vec3(10.0f, 0.0f, 0.0f), Mat3::RotateZ(pi / 2.0f), 0);
+    Aabb world = world_bounds(local, instance);
+    assert(std::abs(world.min.x - 8.0f) < 1e-5f && std::abs(world.max.x - 12.0f) < 1e-5f);
+    assert(std::abs(world.min.y + 1.0f) < 1e-5f && std::abs(world.max.y - 1.0f) < 1e-5f);
+    assert(std::abs(world.min.z + 3.0f) < 1e-5f && std::abs(world.max.z - 3.0f) < 1e-5f);
+}
+
+// The bounding volume tests may only reject pairs which really are separated
+void test_bounding_volumes()
+{
+    std::mt19937 rng(475);
+    std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> angle(-pi, pi);
+
+    std::vector<std::vector<Vec3>> meshes(8);
+    for (std::size_t m = 0; m < meshes.size(); ++m)
+    {
+        // Stretched point clouds, so that the boxes are a poor fit for the spheres
+        Vec3 scale(1.0f, 0.5f + 0.25f * m, 0.2f + 0.1f * m);
+        for (int i = 0; i < 50; ++i)
+        {
+            meshes[m].push_back(Vec3(scale.x * coordinate(rng), scale.y * coordinate(rng), scale.z * coordinate(rng)));
+        }
+    }
+
+    std::vector<Aabb> boxes;
+    std::vector<BoundingSphere> spheres;
+    for (const auto& vertices : meshes)
+    {
+        boxes.push_back(compute_bounds(vertices));
+        spheres.push_back(compute_bounding_sphere(vertices));
+        for (const Vec3& v : vertices)
+        {
+            assert((v - spheres.back().centre).mag() <= spheres.back().radius);
+        }
+    }
+
+    std::size_t intersections = 0;
+    std::size_t sphere_rejections = 0;
+    std::size_t box_rejections = 0;
+    for (int k = 0; k < 2000; ++k)
+    {
+        int m1 = k % 8;
+        int m2 = (k / 8) % 8;
+        ConvexHullInstance a(Vec3(), Mat3::AxisAngle(Vec3(angle(rng), angle(rng), angle(rng))), m1);
+        ConvexHullInstance b(3.0f * Vec3(coordinate(rng), coordinate(rng), coordinate(rng)),
+                             Mat3::AxisAngle(Vec3(angle(rng), angle(rng), angle(rng))), m2);
+        bool intersection = geometry::intersect_gjk<Vec3>(
+            [&](const Vec3& d) { return general_support(d, a, meshes[m1]); },
+            [&](const Vec3& d) { return general_support(d, b, meshes[m2]); });
+
+        bool spheres_overlap = overlap(spheres[m1], a, spheres[m2], b);
+        bool boxes_overlap = overlap(boxes[m1], a, boxes[m2], b);
+        assert(!intersection || (spheres_overlap && boxes_overlap));
+
+        intersections += intersection;
+        sphere_rejections += !spheres_overlap;
+        box_rejections += spheres_overlap && !boxes_overlap;
+    }
+    assert(intersections > 0 && sphere_rejections > 0 && box_rejections > 0);
+
+    // Two thin rods side by side along a diagonal. Their world bounds overlap, but their
+    // oriented boxes don't.
+    Aabb rod{Vec3(-2.0f, -0.1f, -0.1f), Vec3(2.0f, 0.1f, 0.1f)};
+    Mat3 diagonal = Mat3::RotateZ(pi / 4.0f);
+    ConvexHullInstance rod1(Vec3(0.0f, 0.0f, 0.0f), diagonal, 0);
+    ConvexHullInstance rod2(Vec3(-0.5f, 0.5f, 0.0f), diagonal, 0);
+    assert(overlap(world_bounds(rod, rod1), world_bounds(rod, rod2)));
+    assert(!overlap(rod, rod1, rod, rod2));
+    assert(overlap(rod, rod1, rod, ConvexHullInstance(Vec3(-0.1f, 0.1f, 0.0f), diagonal, 0)));
+}
+
+void test_sweep_and_prune()
+{
+    std::mt19937 rng(475);
+    std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> size(0.1f, 2.0f);
+    std::uniform_real_distribution<float> step(-0.2f, 0.2f);
+
+    std::vector<Aabb> boxes;
+    for (int i = 0; i < 300; ++i)
+    {
+        Vec3 min(position(rng), position(rng), position(rng));
+        boxes.push_back(Aabb{min, min + Vec3(size(rng), size(rng), size(rng))});
+    }
+
+    // The pairs must match a brute force search as the boxes move
+    SweepAndPrune sweep_and_prune;
+    for (int frame = 0; frame < 20; ++frame)
+    {
+        sweep_and_prune.update(boxes);
+
+        std::vector<SweepAndPrune::Pair> expected;
+        for (std::uint32_t i = 0; i < boxes.size(); ++i)
+        {
+            for (std::uint32_t j = i + 1; j < boxes.size(); ++j)
+            {
+                if (overlap(boxes[i], boxes[j]))
+                {
+                    expected.emplace_back(i, j);
+                }
+            }
+        }
+
+        std::vector<SweepAndPrune::Pair> found = sweep_and_prune.pairs();
+        std::sort(found.begin(), found.end());
+        assert(found == expected);
+
+        // The first frame is built from scratch, and later ones are patched up
+        assert((frame == 0) == (sweep_and_prune.sort_work() == 0));
+
+        for (Aabb& box : boxes)
+        {
+            Vec3 offset(step(rng), step(rng), step(rng));
+            box.min += offset;
+            box.max += offset;
+        }
+    }
+
+    // Removing objects rebuilds everything
+    boxes.resize(100);
+    sweep_and_prune.update(boxes);
+    assert(sweep_and_prune.sort_work() == 0);
+    for (const auto& pair : sweep_and_prune.pairs())
+    {
+        assert(pair.first < pair.second && pair.second < boxes.size());
+    }
+}
+
+// Finds the overlapping pairs of boxes by testing every pair
+std::vector<AabbTree::Pair> brute_force_pairs(const std::vector<Aabb>& boxes, const std::vector<bool>& alive)
+{
+    std::vector<AabbTree::Pair> pairs;
+    for (std::uint32_t i = 0; i < boxes.size(); ++i)
+    {
+        for (std::uint32_t j = i + 1; j < boxes.size(); ++j)
+        {
+            if (alive[i] && alive[j] && overlap(boxes[i], boxes[j]))
+            {
+                pairs.emplace_back(i, j);
+            }
+        }
+    }
+    return pairs;
+}
+
+void test_aabb_tree()
+{
+    std::mt19937 rng(475);
+    std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> size(0.1f, 2.0f);
+    std::uniform_real_distribution<float> step(-0.05f, 0.05f);
+
+    // Insert boxes sorted along x, which would give a degenerate tree without rotations
+    std::vector<Aabb> boxes;
+    for (int i = 0; i < 500; ++i)
+    {
+        Vec3 min(-10.0f + 0.04f * i, position(rng), position(rng));
+        boxes.push_back(Aabb{min, min + Vec3(size(rng), size(rng), size(rng))});
+    }
+
+    AabbTree tree(0.1f);
+    std::vector<int> proxies;
+    std::vector<bool> alive(boxes.size(), true);
+    for (std::uint32_t i = 0; i < boxes.size(); ++i)
+    {
+        proxies.push_back(tree.insert(boxes[i], i));
+        assert(tree.object(proxies.back()) == i);
+    }
+    assert(tree.height() <= 2 * 9);
+
+    std::size_t reinserted = 0;
+    for (int frame = 0; frame < 20; ++frame)
+    {
+        std::vector<AabbTree::Pair> found;
+        tree.find_pairs(found);
+        std::sort(found.begin(), found.end());
+        assert(found == brute_force_pairs(boxes, alive));
+
+        for (std::uint32_t i = 0; i < boxes.size(); ++i)
+        {
+            Vec3 offset(step(rng), step(rng), step(rng));
+            boxes[i].min += offset;
+            boxes[i].max += offset;
+            reinserted += tree.move(proxies[i], boxes[i]);
+        }
+    }
+
+    // Most small moves stay inside the fat bounds
+    assert(reinserted < boxes.size() * 20 / 2);
+
+    // Remove every other box
+    for (std::uint32_t i = 0; i < boxes.size(); i += 2)
+    {
+        tree.remove(proxies[i]);
+        alive[i] = false;
+    }
+    std::vector<AabbTree::Pair> found;
+    tree.find_pairs(found);
+    std::sort(found.begin(), found.end());
+    assert(found == brute_force_pairs(boxes, alive));
+
+    // Region queries find every box whose fat bounds overlap the region
+    Aabb region{Vec3(-2.0f, -2.0f, -2.0f), Vec3(3.0f, 1.0f, 2.0f)};
+    std::vector<std::uint32_t> in_region;
+    tree.query(region, [&in_region](std::uint32_t object) { in_region.push_back(object); });
+    std::sort(in_region.begin(), in_region.end());
+    std::vector<std::uint32_t> expected_in_region;
+    for (std::uint32_t i = 0; i < boxes.size(); ++i)
+    {
+        if (alive[i] && overlap(tree.fat_bounds(proxies[i]), region))
+        {
+            expected_in_region.push_back(i);
+        }
+    }
+    assert(in_region == expected_in_region);
+
+    // Ray casts find every box whose fat bounds the ray hits. The ray aims at one of the boxes.
+    Vec3 origin(-12.0f, 0.5f, -0.3f);
+    Vec3 direction = 0.5f * (boxes[101].min + boxes[101].max) - origin;
+    std::vector<std::uint32_t> hit;
+    tree.ray_cast(origin, direction, 1.0f, [&hit](std::uint32_t object) { hit.push_back(object); return 1.0f; });
+    std::sort(hit.begin(), hit.end());
+    std::vector<std::uint32_t> expected_hit;
+    Vec3 inverse_direction(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+    for (std::uint32_t i = 0; i < boxes.size(); ++i)
+    {
+        float t;
+        if (alive[i] && intersect_ray(tree.fat_bounds(proxies[i]), origin, inverse_direction, 1.0f, t))
+        {
+            expected_hit.push_back(i);
+        }
+    }
+    assert(std::find(expected_hit.begin(), expected_hit.end(), 101u) != expected_hit.end());
+    assert(hit == expected_hit);
+
+    // Returning 0 from the callback ends the cast after the first hit
+    std::size_t hit_count = 0;
+    tree.ray_cast(origin, direction, 1.0f, [&hit_count](std::uint32_t) { ++hit_count; return 0.0f; });
+    assert(hit_count == 1);
+
+    tree.clear();
+    assert(tree.height() == 0);
+    tree.find_pairs(found);
+    assert(found.empty());
+}
+
+// first_hit finds the same object as casting the ray against every object
+void test_first_hit()
+{
+    std::mt19937 rng(478);
+    std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> size(0.2f, 1.0f);
+
+    std::vector<geometry::Primitive<Vec3>> shapes;
+    std::vector<ConvexHullInstance> instances;
+    AabbTree tree(0.1f);
+    for (std::uint32_t i = 0; i < 300; ++i)
+    {
+        if (i % 2 == 0)
+        {
+            shapes.push_back(geometry::Sphere<Vec3>{size(rng)});
+        }
+        else
+        {
+            shapes.push_back(geometry::Box<Vec3>{Vec3(size(rng), size(rng), size(rng))});
+        }
+        instances.emplace_back(Vec3(position(rng), position(rng), position(rng)), Mat3::RotateZ(size(rng)), i);
+        tree.insert(world_bounds(compute_bounds(shapes.back()), instances.back()), i);
+    }
+
+    auto cast = [&](const Vec3& origin, const Vec3& direction, std::uint32_t object, float max_t) {
+        return geometry::ray_cast_gjk<Vec3>(
+            [&](const Vec3& d) { return primitive_support(d, instances[object], shapes[object]); },
+            origin, direction, max_t);
+    };
+
+    int hit_count = 0;
+    for (int i = 0; i < 200; ++i)
+    {
+        Vec3 origin(position(rng), position(rng), position(rng));
+        Vec3 direction = Vec3(position(rng), position(rng), position(rng)) - origin;
+
+        AabbTree::RayHit hit = tree.first_hit(origin, direction, 1.0f, [&](std::uint32_t object, float max_t) {
+            return cast(origin, direction, object, max_t);
+        });
+
+        AabbTree::RayHit expected;
+        expected.fraction = 1.0f;
+        for (std::uint32_t object = 0; object < shapes.size(); ++object)
+        {
+            geometry::GjkRayHit<Vec3> object_hit = cast(origin, direction, object, 1.0f);
+            if (object_hit.hit && object_hit.fraction <= expected.fraction)
+            {
+                expected.object = object;
+                expected.fraction = object_hit.fraction;
+                expected.hit = true;
+            }
+        }
+
+        assert(hit.hit == expected.hit);
+        if (hit.hit)
+        {
+            ++hit_count;
+            assert(std::abs(hit.fraction - expected.fraction) < 1e-5f);
+            assert(hit.object == expected.object || hit.fraction == 0.0f);
+            assert(std::abs(hit.normal.mag() - 1.0f) < 1e-4f || hit.fraction == 0.0f);
+        }
+    }
+    assert(hit_count > 50);
+}
+
+int main()
+{
+    test_world_bounds();
+    test_bounding_volumes();
+    test_sweep_and_prune();
+    test_aabb_tree();
+    test_first_hit();
+
+    return 0;
+}
@@ -1,8 +1,16 @@
 #include "gjk.hpp"
+#include "epa.hpp"
+#include "gjk_batch.hpp"
+#include "mpr.hpp"
 #include "math.hpp"
+#include "shapes.hpp"
+#include "toi.hpp"
 #include <cassert>
 #include <cmath>
 #include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
 
 using namespace demo::math;
 
@@ -85,6 +93,34 @@ void test_simplex3_dir()
 
 }
 
+void test_simplex2_closest()
+{
+    geometry::Simplex<Vec3> result;
+    geometry::SimplexVertex<Vec3> a{Vec3(-1.0f, -1.0f, 1.0f), Vec3(), Vec3()};
+    geometry::SimplexVertex<Vec3> b{Vec3(1.0f, -1.0f, 1.0f), Vec3(), Vec3()};
+    geometry::SimplexVertex<Vec3> c{Vec3(0.0f, 1.0f, 1.0f), Vec3(), Vec3()};
+
+    // Closest to the inside of the triangle
+    geometry::simplex2_closest(a, b, c, result);
+    assert(result.size == 3);
+    assert_equal(result.closest_point(), Vec3(0.0f, 0.0f, 1.0f));
+    assert_equal(result.barycentric[0] + result.barycentric[1] + result.barycentric[2], 1.0f);
+
+    // Closest to edge ab
+    a.point = Vec3(-1.0f, 1.0f, 1.0f);
+    b.point = Vec3(1.0f, 1.0f, 1.0f);
+    c.point = Vec3(0.0f, 3.0f, 1.0f);
+    geometry::simplex2_closest(a, b, c, result);
+    assert(result.size == 2);
+    assert_equal(result.closest_point(), Vec3(0.0f, 1.0f, 1.0f));
+
+    // Closest to vertex c
+    c.point = Vec3(0.1f, 0.1f, 0.1f);
+    geometry::simplex2_closest(a, b, c, result);
+    assert(result.size == 1);
+    assert_equal(result.closest_point(), c.point);
+}
+
 // This tests functions that aren't part of the interface.
 void test_gjk_internals()
 {
@@ -92,12 +128,631 @@ void test_gjk_internals()
     test_simplex1_dir();
     test_simplex2_dir();
     test_simplex3_dir();
+    test_simplex2_closest();
+}
+
+// Support mapping of an axis-aligned box
+auto box_support(Vec3 centre, Vec3 half_extents)
+{
+    return [centre, half_extents](const Vec3& d) {
+        return centre + Vec3(d.x >= 0.0f ? half_extents.x : -half_extents.x,
+                             d.y >= 0.0f ? half_extents.y : -half_extents.y,
+                             d.z >= 0.0f ? half_extents.z : -half_extents.z);
+    };
+}
+
+// Support mapping of a sphere
+auto sphere_support(Vec3 centre, float radius)
+{
+    return [centre, radius](const Vec3& d) {
+        return centre + (radius / d.mag()) * d;
+    };
 }
 
+void test_distance_gjk()
+{
+    // Separated boxes
+    auto boxes = geometry::distance_gjk<Vec3>(
+        box_support(Vec3(0.0f, 0.0f, 0.0f), Vec3(0.5f, 0.5f, 0.5f)),
+        box_support(Vec3(3.0f, 0.2f, 0.0f), Vec3(0.5f, 0.5f, 0.5f)));
+    assert(!boxes.intersecting);
+    assert_equal(boxes.distance, 2.0f);
+    assert_equal(boxes.point1.x, 0.5f);
+    assert_equal(boxes.point2.x, 2.5f);
+    assert_equal(boxes.point1.y, boxes.point2.y);
+
+    // Separated spheres
+    auto spheres = geometry::distance_gjk<Vec3>(
+        sphere_support(Vec3(0.0f, 0.0f, 0.0f), 1.0f),
+        sphere_support(Vec3(3.0f, 4.0f, 0.0f), 2.0f));
+    assert(!spheres.intersecting);
+    assert_equal(spheres.distance, 2.0f);
+    assert_equal(spheres.point1, Vec3(0.6f, 0.8f, 0.0f));
+    assert_equal(spheres.point2, Vec3(1.8f, 2.4f, 0.0f));
+
+    // The stats report whether the query finished, and are overwritten by each query
+    geometry::GjkStats stats;
+    stats.converged = false;
+    geometry::distance_gjk<Vec3>(
+        sphere_support(Vec3(0.0f, 0.0f, 0.0f), 1.0f),
+        sphere_support(Vec3(3.0f, 4.0f, 0.0f), 2.0f),
+        geometry::default_relative_tolerance<float>(), 100, &stats);
+    assert(stats.converged);
+    auto unfinished = geometry::distance_gjk<Vec3>(
+        sphere_support(Vec3(0.0f, 0.0f, 0.0f), 1.0f),
+        sphere_support(Vec3(3.0f, 4.0f, 0.0f), 2.0f),
+        geometry::default_relative_tolerance<float>(), 1, &stats);
+    assert(!stats.converged && stats.iteration_count == 1);
+    assert(unfinished.distance > 2.0f);
+
+    // Intersecting boxes
+    auto overlapping = geometry::distance_gjk<Vec3>(
+        box_support(Vec3(0.0f, 0.0f, 0.0f), Vec3(0.5f, 0.5f, 0.5f)),
+        box_support(Vec3(0.7f, 0.3f, -0.2f), Vec3(0.5f, 0.5f, 0.5f)));
+    assert(overlapping.intersecting);
+    assert(overlapping.distance == 0.0f);
+}
+
+void test_warm_start()
+{
+    auto box1 = box_support(Vec3(0.0f, 0.0f, 0.0f), Vec3(0.5f, 0.5f, 0.5f));
+    auto box2 = box_support(Vec3(0.3f, 2.0f, 0.0f), Vec3(0.5f, 0.5f, 0.5f));
+    geometry::GjkCache<Vec3> cache;
+    geometry::GjkStats stats;
+
+    assert(!geometry::intersect_gjk<Vec3>(box1, box2, cache, 100, &stats));
+    assert(cache.valid);
+    assert(!stats.warm_started);
+    assert(stats.iteration_count > 0);
+
+    // The cached direction separates the boxes straight away after a small move
+    auto moved = box_support(Vec3(0.35f, 1.95f, 0.0f), Vec3(0.5f, 0.5f, 0.5f));
+    assert(!geometry::intersect_gjk<Vec3>(box1, moved, cache, 100, &stats));
+    assert(stats.warm_started);
+    assert(stats.cache_hit);
+    assert(stats.iteration_count == 0);
+
+    // Once the boxes intersect, the cache doesn't change the answer
+    auto overlapping = box_support(Vec3(0.35f, 0.9f, 0.0f), Vec3(0.5f, 0.5f, 0.5f));
+    assert(geometry::intersect_gjk<Vec3>(box1, overlapping, cache, 100, &stats));
+    assert(stats.warm_started);
+    assert(!stats.cache_hit);
+}
+
+void test_precision_policy()
+{
+    using DoublePolicy = geometry::GjkPolicy<double>;
+    auto box1 = box_support(Vec3(0.0f, 0.0f, 0.0f), Vec3(0.5f, 0.5f, 0.5f));
+    auto separated = box_support(Vec3(0.3f, 2.0f, 0.0f), Vec3(0.5f, 0.5f, 0.5f));
+    auto overlapping = box_support(Vec3(0.8f, 0.1f, 0.0f), Vec3(0.5f, 0.5f, 0.5f));
+    geometry::GjkStats stats;
+
+    // Away from contact, both precisions agree and converge
+    bool intersection = geometry::intersect_gjk<Vec3, DoublePolicy>(box1, separated, 100, &stats);
+    assert(!intersection);
+    assert(stats.converged);
+    geometry::Simplex<Vec3> simplex;
+    intersection = geometry::intersect_gjk<Vec3, DoublePolicy>(box1, overlapping, 100, &stats, &simplex);
+    assert(intersection);
+    assert(stats.converged);
+    assert(simplex.size == 4);
+    auto boxes = geometry::penetration_epa<Vec3>(box1, overlapping, simplex);
+    assert(boxes.converged);
+    assert_equal(boxes.depth, 0.2f);
+
+    // Touching spheres have no separating plane which GJK can find exactly. The search must
+    // still stop long before the iteration limit.
+    auto sphere1 = sphere_support(Vec3(0.0f, 0.0f, 0.0f), 1.0f);
+    auto sphere2 = sphere_support(Vec3(1.2f, 1.6f, 0.0f), 1.0f);
+    geometry::GjkCache<Vec3> cache;
+    geometry::intersect_gjk<Vec3>(sphere1, sphere2, cache, 100, &stats);
+    assert(stats.iteration_count < 100);
+    std::size_t float_iterations = stats.iteration_count;
+    bool float_converged = stats.converged;
+
+    // The mixed query only repeats the queries which didn't converge
+    cache = geometry::GjkCache<Vec3>();
+    geometry::intersect_gjk_mixed<Vec3>(sphere1, sphere2, cache, 100, &stats);
+    assert(stats.precision_fallback == !float_converged);
+    assert(stats.iteration_count >= float_iterations);
+    assert(cache.valid);
+
+    assert(!geometry::intersect_gjk_mixed<Vec3>(box1, separated, cache, 100, &stats));
+    assert(!stats.precision_fallback);
+}
+
+void test_penetration_epa()
+{
+    // Boxes overlapping by 0.2 along x
+    auto box1 = box_support(Vec3(0.0f, 0.0f, 0.0f), Vec3(0.5f, 0.5f, 0.5f));
+    auto box2 = box_support(Vec3(0.8f, 0.1f, 0.0f), Vec3(0.5f, 0.5f, 0.5f));
+    geometry::Simplex<Vec3> simplex;
+    assert(geometry::intersect_gjk<Vec3>(box1, box2, 100, nullptr, &simplex));
+    assert(simplex.size == 4);
+    auto boxes = geometry::penetration_epa<Vec3>(box1, box2, simplex);
+    assert(boxes.converged);
+    assert_equal(boxes.depth, 0.2f);
+    assert_equal(boxes.normal, Vec3(1.0f, 0.0f, 0.0f));
+    assert_equal(boxes.point1.x, 0.5f);
+    assert_equal(boxes.point2.x, 0.3f);
+
+    // Spheres overlapping by 0.5. The polytope can only approximate them.
+    geometry::EpaResult<Vec3> spheres;
+    assert(geometry::penetration_gjk_epa<Vec3>(
+        sphere_support(Vec3(0.0f, 0.0f, 0.0f), 1.0f),
+        sphere_support(Vec3(0.0f, 1.5f, 0.0f), 1.0f),
+        spheres));
+    assert(abs(spheres.depth - 0.5f) < 0.01f);
+    assert(abs(spheres.normal.y - 1.0f) < 0.01f);
+
+    // Separated shapes have no penetration
+    geometry::EpaResult<Vec3> separated;
+    assert(!geometry::penetration_gjk_epa<Vec3>(box1, box_support(Vec3(2.0f, 0.0f, 0.0f), Vec3(0.5f, 0.5f, 0.5f)), separated));
+}
+
+// Checks each primitive's support point against its support function, the furthest distance
+// of the shape along a direction, worked out independently for each shape
+// The batched query must give exactly the same answers as intersect_gjk, pair by pair
+template <std::size_t Width>
+void test_gjk_batch()
+{
+    std::mt19937 rng(475);
+    std::uniform_real_distribution<float> position(-2.0f, 2.0f);
+    std::uniform_real_distribution<float> size(0.1f, 1.5f);
+
+    // Boxes against spheres, so pairs take anywhere from one to many iterations. The pair
+    // count is not a multiple of the width.
+    const std::size_t pair_count = 1003;
+    std::vector<Vec3> box_centres, box_extents, sphere_centres;
+    std::vector<float> sphere_radii;
+    for (std::size_t i = 0; i < pair_count; ++i)
+    {
+        box_centres.emplace_back(position(rng), position(rng), position(rng));
+        box_extents.emplace_back(size(rng), size(rng), size(rng));
+        sphere_centres.emplace_back(position(rng), position(rng), position(rng));
+        sphere_radii.push_back(size(rng));
+    }
+
+    auto support1 = [&](std::size_t i, const Vec3& d) { return box_support(box_centres[i], box_extents[i])(d); };
+    auto support2 = [&](std::size_t i, const Vec3& d) { return sphere_support(sphere_centres[i], sphere_radii[i])(d); };
+
+    // The same sphere support mapping, called for all lanes at once
+    auto lane_support2 = [&](const std::size_t* pairs, const geometry::LaneVec3<float, Width>& d, geometry::LaneVec3<float, Width>& points) {
+        for (std::size_t lane = 0; lane < Width; ++lane)
+        {
+            if (pairs[lane] != geometry::gjk_batch_idle_lane)
+            {
+                Vec3 point = support2(pairs[lane], Vec3(d.x[lane], d.y[lane], d.z[lane]));
+                points.x[lane] = point.x;
+                points.y[lane] = point.y;
+                points.z[lane] = point.z;
+            }
+        }
+    };
+
+    std::vector<geometry::GjkCache<Vec3>> caches(pair_count), batch_caches(pair_count);
+    std::vector<geometry::GjkStats> batch_stats(pair_count);
+    std::unique_ptr<bool[]> batch_results(new bool[pair_count]);
+
+    // The second round starts from the directions cached in the first, and uses the lane
+    // support mapping
+    for (int round = 0; round < 2; ++round)
+    {
+        if (round == 0)
+        {
+            geometry::intersect_gjk_batch<Vec3, Width>(pair_count, support1, support2, batch_results.get(), batch_caches.data(), 100, batch_stats.data());
+        }
+        else
+        {
+            geometry::intersect_gjk_batch<Vec3, Width>(pair_count, support1, lane_support2, batch_results.get(), batch_caches.data(), 100, batch_stats.data());
+        }
+
+        std::size_t hits = 0;
+        for (std::size_t i = 0; i < pair_count; ++i)
+        {
+            geometry::GjkStats stats;
+            bool result = geometry::intersect_gjk<Vec3>(
+                [&](const Vec3& d) { return support1(i, d); },
+                [&](const Vec3& d) { return support2(i, d); },
+                caches[i], 100, &stats);
+
+            assert(batch_results[i] == result);
+            assert(batch_stats[i].iteration_count == stats.iteration_count);
+            assert(batch_stats[i].warm_started == stats.warm_started);
+            assert(batch_stats[i].cache_hit == stats.cache_hit);
+            assert(batch_stats[i].converged == stats.converged);
+            assert(batch_caches[i].direction.x == caches[i].direction.x);
+            assert(batch_caches[i].direction.y == caches[i].direction.y);
+            assert(batch_caches[i].direction.z == caches[i].direction.z);
+            hits += result;
+
+            sphere_centres[i] += Vec3(0.01f, 0.0f, 0.0f);
+        }
+
+        // Make sure both outcomes are covered
+        assert(hits > 0 && hits < pair_count);
+    }
+}
+
+void test_primitive_support()
+{
+    geometry::Sphere<Vec3> sphere{0.75f};
+    geometry::Box<Vec3> box{Vec3(0.5f, 1.0f, 2.0f)};
+    geometry::Capsule<Vec3> capsule{1.0f, 0.5f};
+    geometry::Cylinder<Vec3> cylinder{0.5f, 1.5f};
+    geometry::Cone<Vec3> cone{1.0f, 0.5f};
+
+    std::mt19937 rng(475);
+    std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f);
+    for (int i = 0; i < 1000; ++i)
+    {
+        Vec3 d(coordinate(rng), coordinate(rng), coordinate(rng));
+        float length = d.mag();
+        float radial = std::sqrt(d.x * d.x + d.y * d.y);
+
+        assert_equal(dot(geometry::support(sphere, d), d), 0.75f * length);
+        assert_equal(dot(geometry::support(box, d), d), 0.5f * std::abs(d.x) + std::abs(d.y) + 2.0f * std::abs(d.z));
+        assert_equal(dot(geometry::support(capsule, d), d), std::abs(d.z) + 0.5f * length);
+        assert_equal(dot(geometry::support(cylinder, d), d), 0.5f * std::abs(d.z) + 1.5f * radial);
+        assert_equal(dot(geometry::support(cone, d), d), std::max(d.z, 0.5f * radial - d.z));
+
+        // Through the variant
+        geometry::Primitive<Vec3> primitive = cone;
+        Vec3 p = geometry::support(primitive, d);
+        Vec3 q = geometry::support(cone, d);
+        assert(p.x == q.x && p.y == q.y && p.z == q.z);
+    }
+
+    // Directions along the axes, and zero, still give points of the shapes
+    assert_equal(geometry::support(cone, Vec3(0.0f, 0.0f, -1.0f)), Vec3(0.0f, 0.0f, -1.0f));
+    assert_equal(geometry::support(cylinder, Vec3(0.0f, 0.0f, 1.0f)), Vec3(0.0f, 0.0f, 0.5f));
+    assert_equal(geometry::support(sphere, Vec3(0.0f, 0.0f, 0.0f)).mag(), 0.75f);
+
+    // Primitives plug into intersect_gjk like any other support mapping
+    auto at = [](const geometry::Primitive<Vec3>& shape, Vec3 position) {
+        return [shape, position](const Vec3& d) { return position + geometry::support(shape, d); };
+    };
+    assert(geometry::intersect_gjk<Vec3>(at(sphere, Vec3()), at(cone, Vec3(0.0f, 0.0f, 1.7f))));
+    assert(!geometry::intersect_gjk<Vec3>(at(sphere, Vec3()), at(cone, Vec3(0.0f, 0.0f, -1.8f))));
+    assert(geometry::intersect_gjk<Vec3>(at(box, Vec3()), at(capsule, Vec3(0.95f, 0.0f, 0.0f))));
+    assert(!geometry::intersect_gjk<Vec3>(at(box, Vec3()), at(capsule, Vec3(1.05f, 0.0f, 0.0f))));
+    assert(geometry::intersect_gjk<Vec3>(at(cylinder, Vec3()), at(cylinder, Vec3(2.9f, 0.0f, 0.9f))));
+    assert(!geometry::intersect_gjk<Vec3>(at(cylinder, Vec3()), at(cylinder, Vec3(2.9f, 0.0f, 1.1f))));
+}
+
+void test_margins()
+{
+    geometry::Primitive<Vec3> sphere = geometry::Sphere<Vec3>{0.5f};
+    geometry::Primitive<Vec3> capsule = geometry::Capsule<Vec3>{1.0f, 0.25f};
+    geometry::Primitive<Vec3> rounded_box = geometry::RoundedBox<Vec3>{Vec3(0.5f, 1.0f, 0.75f), 0.25f};
+    geometry::Primitive<Vec3> cone = geometry::Cone<Vec3>{1.0f, 0.5f};
+
+    // The cores and margins make up the whole shape
+    assert_equal(geometry::margin(sphere), 0.5f);
+    assert_equal(geometry::margin(cone), 0.0f);
+    assert_equal(geometry::core_support(capsule, Vec3(1.0f, 0.0f, -1.0f)), Vec3(0.0f, 0.0f, -1.0f));
+    assert_equal(geometry::core_support(rounded_box, Vec3(1.0f, 0.0f, 0.0f)) + Vec3(0.25f, 0.0f, 0.0f),
+                 geometry::support(rounded_box, Vec3(1.0f, 0.0f, 0.0f)));
+
+    auto core_at = [](const geometry::Primitive<Vec3>& shape, Vec3 position) {
+        return [shape, position](const Vec3& d) { return position + geometry::core_support(shape, d); };
+    };
+    auto at = [](const geometry::Primitive<Vec3>& shape, Vec3 position) {
+        return [shape, position](const Vec3& d) { return position + geometry::support(shape, d); };
+    };
+
+    // Just either side of contact, where the distances are known exactly
+    auto intersect = [&](const geometry::Primitive<Vec3>& shape1, const geometry::Primitive<Vec3>& shape2, Vec3 position) {
+        geometry::GjkCache<Vec3> cache;
+        return geometry::intersect_gjk_margins<Vec3>(core_at(shape1, Vec3()), geometry::margin(shape1),
+                                                     core_at(shape2, position), geometry::margin(shape2), cache);
+    };
+    assert(intersect(sphere, sphere, Vec3(0.6f, 0.0f, 0.79f)));
+    assert(!intersect(sphere, sphere, Vec3(0.6f, 0.0f, 0.81f)));
+    assert(intersect(capsule, capsule, Vec3(0.0f, 0.49f, 1.5f)));
+    assert(!intersect(capsule, capsule, Vec3(0.0f, 0.51f, 1.5f)));
+    assert(intersect(rounded_box, sphere, Vec3(1.249f, 0.5f, 0.0f)));
+    assert(!intersect(rounded_box, sphere, Vec3(1.251f, 0.5f, 0.0f)));
+    assert(intersect(cone, capsule, Vec3(0.0f, 0.0f, 2.24f)));
+    assert(!intersect(cone, capsule, Vec3(0.0f, 0.0f, 2.26f)));
+    assert(intersect(capsule, capsule, Vec3()));
+
+    // Agrees with GJK on the whole shapes, at random positions clear of contact
+    const geometry::Primitive<Vec3> shapes[] = {sphere, capsule, rounded_box, cone};
+    std::mt19937 rng(476);
+    std::uniform_real_distribution<float> coordinate(-2.5f, 2.5f);
+    int checked = 0;
+    for (int i = 0; i < 1000; ++i)
+    {
+        const geometry::Primitive<Vec3>& shape1 = shapes[i % 4];
+        const geometry::Primitive<Vec3>& shape2 = shapes[(i / 4) % 4];
+        Vec3 position(coordinate(rng), coordinate(rng), coordinate(rng));
+
+        geometry::GjkDistance<Vec3> distance = geometry::distance_gjk<Vec3>(at(shape1, Vec3()), at(shape2, position));
+        if (!distance.intersecting && distance.distance < 1e-2f)
+        {
+            continue;
+        }
+        ++checked;
+
+        geometry::GjkCache<Vec3> cache;
+        geometry::GjkStats stats;
+        bool result = geometry::intersect_gjk_margins<Vec3>(core_at(shape1, Vec3()), geometry::margin(shape1),
+                                                            core_at(shape2, position), geometry::margin(shape2),
+                                                            cache, 100, &stats);
+        assert(result == distance.intersecting);
+        assert(stats.converged && !stats.warm_started);
+
+        // The same query again is decided by the cached direction
+        result = geometry::intersect_gjk_margins<Vec3>(core_at(shape1, Vec3()), geometry::margin(shape1),
+                                                       core_at(shape2, position), geometry::margin(shape2),
+                                                       cache, 100, &stats);
+        assert(result == distance.intersecting);
+        assert(stats.warm_started && (stats.cache_hit || distance.intersecting));
+    }
+    assert(checked > 900);
+}
+
+void test_ray_cast()
+{
+    geometry::Primitive<Vec3> sphere = geometry::Sphere<Vec3>{1.0f};
+    geometry::Primitive<Vec3> box = geometry::Box<Vec3>{Vec3(1.0f, 2.0f, 3.0f)};
+    geometry::Primitive<Vec3> cylinder = geometry::Cylinder<Vec3>{1.0f, 0.5f};
+    auto at = [](const geometry::Primitive<Vec3>& shape, Vec3 position) {
+        return [shape, position](const Vec3& d) { return position + geometry::support(shape, d); };
+    };
+
+    // Straight at the shapes
+    geometry::GjkRayHit<Vec3> hit = geometry::ray_cast_gjk<Vec3>(at(sphere, Vec3(5.0f, 0.0f, 0.0f)), Vec3(), Vec3(10.0f, 0.0f, 0.0f));
+    assert(hit.hit);
+    assert_equal(hit.fraction, 0.4f);
+    assert_equal(hit.normal, Vec3(-1.0f, 0.0f, 0.0f));
+    hit = geometry::ray_cast_gjk<Vec3, float>(at(sphere, Vec3(5.0f, 0.0f, 0.0f)), Vec3(), Vec3(10.0f, 0.0f, 0.0f));
+    assert(hit.hit);
+    assert_equal(hit.fraction, 0.4f);
+    hit = geometry::ray_cast_gjk<Vec3>(at(box, Vec3()), Vec3(0.5f, -1.0f, 8.0f), Vec3(0.0f, 0.0f, -10.0f));
+    assert(hit.hit);
+    assert_equal(hit.fraction, 0.5f);
+    assert_equal(hit.normal, Vec3(0.0f, 0.0f, 1.0f));
+
+    // Misses: heading away, stopping short, and passing by
+    assert(!geometry::ray_cast_gjk<Vec3>(at(sphere, Vec3(5.0f, 0.0f, 0.0f)), Vec3(), Vec3(-10.0f, 0.0f, 0.0f)).hit);
+    assert(!geometry::ray_cast_gjk<Vec3>(at(sphere, Vec3(5.0f, 0.0f, 0.0f)), Vec3(), Vec3(10.0f, 0.0f, 0.0f), 0.39f).hit);
+    assert(!geometry::ray_cast_gjk<Vec3>(at(box, Vec3()), Vec3(-5.0f, 2.01f, 0.0f), Vec3(10.0f, 0.0f, 0.0f)).hit);
+    assert(geometry::ray_cast_gjk<Vec3>(at(box, Vec3()), Vec3(-5.0f, 1.99f, 0.0f), Vec3(10.0f, 0.0f, 0.0f)).hit);
+
+    // A cast which runs out of iterations is a miss, rather than a hit wherever it stopped
+    geometry::GjkStats stats;
+    hit = geometry::ray_cast_gjk<Vec3>(at(cylinder, Vec3(5.0f, 0.3f, 0.2f)), Vec3(), Vec3(10.0f, 0.0f, 0.0f), 1.0f, 1e-6f, 2, &stats);
+    assert(!hit.hit && !stats.converged);
+    hit = geometry::ray_cast_gjk<Vec3>(at(cylinder, Vec3(5.0f, 0.3f, 0.2f)), Vec3(), Vec3(10.0f, 0.0f, 0.0f), 1.0f, 1e-6f, 100, &stats);
+    assert(hit.hit && stats.converged);
+
+    // Starting inside
+    hit = geometry::ray_cast_gjk<Vec3>(at(box, Vec3()), Vec3(0.5f, 0.5f, 0.5f), Vec3(10.0f, 0.0f, 0.0f));
+    assert(hit.hit && hit.fraction == 0.0f);
+    assert(hit.normal.x == 0.0f && hit.normal.y == 0.0f && hit.normal.z == 0.0f);
+
+    // Random rays at a sphere and a cylinder, some way from the origin, against the exact answer
+    std::mt19937 rng(477);
+    std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f);
+    const Vec3 centre(20.0f, -10.0f, 5.0f);
+    int hit_count = 0;
+    for (int i = 0; i < 1000; ++i)
+    {
+        Vec3 origin = centre + 4.0f * Vec3(coordinate(rng), coordinate(rng), coordinate(rng));
+        Vec3 target = centre + 1.2f * Vec3(coordinate(rng), coordinate(rng), coordinate(rng));
+        Vec3 direction = 2.0f * (target - origin);
+        Vec3 offset = origin - centre;
+        if (dot(offset, offset) <= 1.0f)
+        {
+            continue;
+        }
+
+        // Solves |offset + t direction| = 1
+        float a = dot(direction, direction);
+        float b = dot(offset, direction);
+        float c = dot(offset, offset) - 1.0f;
+        float discriminant = b * b - a * c;
+        hit = geometry::ray_cast_gjk<Vec3>(at(sphere, centre), origin, direction);
+        if (std::abs(discriminant) < 1e-3f * a)
+        {
+            continue;
+        }
+        assert(hit.hit == (discriminant > 0.0f && b < 0.0f));
+        if (hit.hit)
+        {
+            ++hit_count;
+            float t = (-b - std::sqrt(discriminant)) / a;
+            assert(std::abs(hit.fraction - t) < 1e-4f);
+            Vec3 normal = offset + t * direction;
+            assert(dot(normal, hit.normal) > 0.9999f);
+        }
+
+        // The hit point is on the surface of the cylinder, and the ray doesn't reach it before
+        hit = geometry::ray_cast_gjk<Vec3>(at(cylinder, centre), origin, direction);
+        if (hit.hit && hit.fraction > 0.0f)
+        {
+            Vec3 point = origin + hit.fraction * direction - centre;
+            float radial = std::sqrt(point.x * point.x + point.y * point.y);
+            assert(std::abs(std::max(radial - 0.5f, std::abs(point.z) - 1.0f)) < 1e-4f);
+            assert(!geometry::intersect_gjk<Vec3>(at(cylinder, centre), [&](const Vec3&) { return origin + (hit.fraction - 1e-3f) * direction; }));
+        }
+    }
+    assert(hit_count > 200);
+}
+
+void test_time_of_impact()
+{
+    geometry::Primitive<Vec3> ball = geometry::Sphere<Vec3>{0.5f};
+    geometry::Primitive<Vec3> plate = geometry::Box<Vec3>{Vec3(0.01f, 2.0f, 2.0f)};
+    geometry::Primitive<Vec3> rod = geometry::Box<Vec3>{Vec3(2.0f, 0.05f, 0.05f)};
+    auto moving = [](const geometry::Primitive<Vec3>& shape, Vec3 start, Vec3 displacement, Vec3 rotation) {
+        return [shape, start, displacement, rotation](float t) {
+            Vec3 position = start + t * displacement;
+            Mat3 orientation = Mat3::AxisAngle(t * rotation);
+            return [shape, position, orientation](const Vec3& d) {
+                return position + orientation * geometry::support(shape, orientation.transpose() * d);
+            };
+        };
+    };
+    auto still = [](const geometry::Primitive<Vec3>& shape, Vec3 position) {
+        return [shape, position](float) {
+            return [shape, position](const Vec3& d) { return position + geometry::support(shape, d); };
+        };
+    };
+    const geometry::MotionBound<Vec3> at_rest{Vec3(), 0.0f};
+    const float tolerance = 1e-3f;
+
+    // A fast ball passes right through a thin plate between the start and the end of the step,
+    // so testing only those poses misses it
+    const Vec3 start(-10.0f, 0.0f, 0.0f);
+    const Vec3 displacement(20.0f, 0.0f, 0.0f);
+    auto ball_at = moving(ball, start, displacement, Vec3());
+    assert(!geometry::intersect_gjk<Vec3>(ball_at(0.0f), still(plate, Vec3())(0.0f)));
+    assert(!geometry::intersect_gjk<Vec3>(ball_at(1.0f), still(plate, Vec3())(1.0f)));
+
+    geometry::GjkStats stats;
+    geometry::TimeOfImpact<Vec3> impact = geometry::time_of_impact<Vec3>(
+        ball_at, geometry::MotionBound<Vec3>{displacement, 0.0f}, still(plate, Vec3()), at_rest, tolerance, 100, &stats);
+    assert(impact.hit && stats.converged);
+    assert(std::abs(impact.time - (10.0f - 0.51f) / 20.0f) <= tolerance / 20.0f);
+    assert_equal(impact.normal, Vec3(1.0f, 0.0f, 0.0f));
+    assert(impact.point2.x - impact.point1.x > 0.0f && impact.point2.x - impact.point1.x <= tolerance);
+
+    // Running out of distance queries gives a hit no later than the contact, not a miss
+    impact = geometry::time_of_impact<Vec3>(
+        ball_at, geometry::MotionBound<Vec3>{displacement, 0.0f}, still(plate, Vec3()), at_rest, tolerance, 1, &stats);
+    assert(impact.hit && !stats.converged);
+    assert(impact.time <= (10.0f - 0.51f) / 20.0f);
+
+    // Passing by, and heading away, which needs a single distance query
+    impact = geometry::time_of_impact<Vec3>(
+        moving(ball, Vec3(-10.0f, 2.6f, 0.0f), displacement, Vec3()), geometry::MotionBound<Vec3>{displacement, 0.0f},
+        still(plate, Vec3()), at_rest, tolerance);
+    assert(!impact.hit && impact.time == 1.0f);
+    impact = geometry::time_of_impact<Vec3>(
+        moving(ball, start, -1.0f * displacement, Vec3()), geometry::MotionBound<Vec3>{-1.0f * displacement, 0.0f},
+        still(plate, Vec3()), at_rest, tolerance, 100, &stats);
+    assert(!impact.hit && stats.iteration_count == 1);
+
+    // Already intersecting
+    impact = geometry::time_of_impact<Vec3>(
+        moving(ball, Vec3(0.2f, 0.0f, 0.0f), displacement, Vec3()), geometry::MotionBound<Vec3>{displacement, 0.0f},
+        still(plate, Vec3()), at_rest, tolerance);
+    assert(impact.hit && impact.time == 0.0f);
+
+    // A rod turning a quarter turn about z sweeps into a ball at distance 1.5 along y. Its side
+    // touches the ball once the ball's centre is 0.55 from its axis.
+    const float quarter_turn = 0.5f * 3.14159265f;
+    const Vec3 rotation(0.0f, 0.0f, quarter_turn);
+    const float reach = Vec3(2.0f, 0.05f, 0.05f).mag();
+    impact = geometry::time_of_impact<Vec3>(
+        moving(rod, Vec3(), Vec3(), rotation), geometry::MotionBound<Vec3>{Vec3(), quarter_turn * reach},
+        still(ball, Vec3(0.0f, 1.5f, 0.0f)), at_rest, tolerance, 100, &stats);
+    assert(impact.hit && stats.converged);
+    float contact_time = (quarter_turn - std::asin(0.55f / 1.5f)) / quarter_turn;
+    assert(impact.time <= contact_time && contact_time - impact.time < 0.01f);
+    assert(!geometry::intersect_gjk<Vec3>(moving(rod, Vec3(), Vec3(), rotation)(impact.time), still(ball, Vec3(0.0f, 1.5f, 0.0f))(0.0f)));
+}
+
+void test_mpr()
+{
+    // The same boxes and spheres as test_penetration_epa. Along the line between the centres of
+    // the boxes, the portal meets the face of least penetration.
+    auto box1 = box_support(Vec3(0.0f, 0.0f, 0.0f), Vec3(0.5f, 0.5f, 0.5f));
+    auto box2 = box_support(Vec3(0.8f, 0.1f, 0.0f), Vec3(0.5f, 0.5f, 0.5f));
+    geometry::EpaResult<Vec3> boxes;
+    assert(geometry::penetration_mpr<Vec3>(box1, Vec3(), box2, Vec3(0.8f, 0.1f, 0.0f), boxes));
+    assert(boxes.converged);
+    assert_equal(boxes.depth, 0.2f);
+    assert_equal(boxes.normal, Vec3(1.0f, 0.0f, 0.0f));
+    assert_equal(boxes.point1.x, 0.5f);
+    assert_equal(boxes.point2.x, 0.3f);
+
+    geometry::EpaResult<Vec3> spheres;
+    assert(geometry::penetration_mpr<Vec3>(
+        sphere_support(Vec3(0.0f, 0.0f, 0.0f), 1.0f), Vec3(0.0f, 0.0f, 0.0f),
+        sphere_support(Vec3(0.0f, 1.5f, 0.0f), 1.0f), Vec3(0.0f, 1.5f, 0.0f),
+        spheres));
+    assert(abs(spheres.depth - 0.5f) < 0.01f);
+    assert(abs(spheres.normal.y - 1.0f) < 0.01f);
+
+    assert(geometry::intersect_mpr<Vec3>(box1, Vec3(), box2, Vec3(0.8f, 0.1f, 0.0f)));
+    assert(!geometry::intersect_mpr<Vec3>(box1, Vec3(), box_support(Vec3(2.0f, 0.0f, 0.0f), Vec3(0.5f, 0.5f, 0.5f)), Vec3(2.0f, 0.0f, 0.0f)));
+
+    // Concentric shapes, where the interior point is the origin
+    assert(geometry::intersect_mpr<Vec3>(box1, Vec3(), sphere_support(Vec3(), 0.1f), Vec3()));
+
+    // Random poses of primitives, against GJK, leaving out those within rounding of touching
+    geometry::Primitive<Vec3> shapes[] = {
+        geometry::Box<Vec3>{Vec3(0.5f, 1.0f, 0.25f)},
+        geometry::Cylinder<Vec3>{0.5f, 0.75f},
+        geometry::Cone<Vec3>{1.0f, 0.5f},
+        geometry::Sphere<Vec3>{0.6f}};
+    std::mt19937 rng(25);
+    std::uniform_real_distribution<float> coordinate(-2.0f, 2.0f);
+    std::uniform_real_distribution<float> angle(-3.0f, 3.0f);
+    std::size_t hits = 0;
+    for (int i = 0; i < 2000; ++i)
+    {
+        const geometry::Primitive<Vec3>& shape1 = shapes[i % 4];
+        const geometry::Primitive<Vec3>& shape2 = shapes[(i / 4) % 4];
+        Vec3 position(coordinate(rng), coordinate(rng), coordinate(rng));
+        Mat3 orientation = Mat3::AxisAngle(Vec3(angle(rng), angle(rng), angle(rng)));
+        auto support1 = [&](const Vec3& d) { return geometry::support(shape1, d); };
+        auto support2 = [&](const Vec3& d) { return position + orientation * geometry::support(shape2, orientation.transpose() * d); };
+
+        geometry::EpaResult<Vec3> epa;
+        bool gjk = geometry::penetration_gjk_epa<Vec3>(support1, support2, epa);
+        if ((gjk && epa.depth < 1e-3f) || (!gjk && geometry::distance_gjk<Vec3>(support1, support2).distance < 1e-3f))
+        {
+            continue;
+        }
+        hits += gjk;
+
+        geometry::GjkStats stats;
+        assert(geometry::intersect_mpr<Vec3>(support1, Vec3(), support2, position, 100, &stats) == gjk);
+        assert(stats.converged);
+        assert(geometry::intersect_mpr<Vec3>(support1, support2) == gjk);
+
+        geometry::GjkCache<Vec3> cache;
+        assert(geometry::intersect_convex(geometry::IntersectionAlgorithm::Mpr, support1, Vec3(), support2, position, cache) == gjk);
+        assert(geometry::intersect_convex(geometry::IntersectionAlgorithm::Gjk, support1, Vec3(), support2, position, cache) == gjk);
+
+        // Moving shape 2 by slightly more than the depth along the normal separates the shapes.
+        // The normal needn't be the direction of least penetration, so moving it by less may
+        // separate them too, and MPR's depth is never less than EPA's.
+        geometry::EpaResult<Vec3> mpr;
+        assert(geometry::penetration_mpr<Vec3>(support1, Vec3(), support2, position, mpr) == gjk);
+        if (gjk)
+        {
+            assert(mpr.depth >= epa.depth - 1e-3f);
+            auto moved = [&](float distance) {
+                Vec3 moved_position = position + distance * mpr.normal;
+                return [&, moved_position](const Vec3& d) { return moved_position + orientation * geometry::support(shape2, orientation.transpose() * d); };
+            };
+            assert(mpr.converged);
+            assert(!geometry::intersect_gjk<Vec3>(support1, moved(mpr.depth + 2e-3f)));
+        }
+    }
+    assert(hits > 200);
+}
 
 int main()
 {
     test_gjk_internals();
+    test_distance_gjk();
+    test_warm_start();
+    test_precision_policy();
+    test_penetration_epa();
+    test_gjk_batch<4>();
+    test_gjk_batch<8>();
+    test_primitive_support();
+    test_margins();
+    test_ray_cast();
+    test_time_of_impact();
+    test_mpr();
 
     return 0;
 }
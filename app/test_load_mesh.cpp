@@ -1,41 +1,105 @@
 #include "load_mesh.hpp"
 #include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
 
 using namespace demo::mesh;
 
-void test_off_parse_counts()
+// Returns whether text parses, filling vertices and indices
+bool parse(const std::string& text, std::vector<demo::math::Vec3>& vertices, std::vector<std::uint32_t>& indices)
 {
-    std::size_t vertex_count;
-    std::size_t face_count;
+    return parse_off(text.data(), text.size(), vertices, indices);
+}
+
+// The counts line may follow comments and blank lines, and be indented with spaces and tabs
+void test_parse_off_counts()
+{
+    std::vector<demo::math::Vec3> vertices;
+    std::vector<std::uint32_t> indices;
+
+    const std::string triangle = "0 0 0\n1 0 0\n0 1 0\n3 0 1 2\n";
+    assert(parse("OFF\n3 1 0\n" + triangle, vertices, indices));
+    assert(vertices.size() == 3 && indices.size() == 3);
 
-    std::string test("5 10 0");
-    assert(off_parse_counts(test, vertex_count, face_count));
-    assert(vertex_count == 5);
-    assert(face_count == 10);
+    assert(parse("OFF\n \t\t   \n#this is a comment\n\t  #this is a comment\n  \t   3 1\t0\n" + triangle, vertices, indices));
+    assert(vertices.size() == 3 && indices.size() == 3);
 
+    // Counts which can't be read, or are zero, are invalid
+    assert(!parse("OFF\nthis is invalid\n" + triangle, vertices, indices));
+    assert(!parse("OFF\n3\n" + triangle, vertices, indices));
+    assert(!parse("OFF\n3 0 0\n" + triangle, vertices, indices));
+    assert(vertices.empty() && indices.empty());
+}
 
-    test = "  \t   4 6\t0";
-    assert(off_parse_counts(test, vertex_count, face_count));
-    assert(vertex_count == 4);
-    assert(face_count == 6);
+void test_parse_off()
+{
+    std::vector<demo::math::Vec3> vertices;
+    std::vector<std::uint32_t> indices;
 
-    test = " \t\t           ";
-    assert(!off_parse_counts(test, vertex_count, face_count));
+    // Comments, blank lines, Windows line breaks, a leading plus, and extra values such as
+    // colours after the coordinates and indices are all allowed
+    std::string text =
+        "OFF\r\n"
+        "# a tetrahedron\r\n"
+        "\r\n"
+        "4 4 6\r\n"
+        "0 0 0\r\n"
+        "  1.5 0 0 255 0 0\r\n"
+        "0 +2 0\r\n"
+        "\t# between vertices\r\n"
+        "0 0 -2.5e-1\r\n"
+        "3 0 2 1\r\n"
+        "3 0 1 3 0.5 0.5 0.5\r\n"
+        "3 1 2 3\r\n"
+        "3 2 0 3";
+    assert(parse(text, vertices, indices));
+    assert(vertices.size() == 4 && indices.size() == 12);
+    assert(vertices[1].x == 1.5f && vertices[2].y == 2.0f && vertices[3].z == -0.25f);
+    assert(indices[0] == 0 && indices[1] == 2 && indices[2] == 1 && indices[11] == 3);
 
-    test = "#this is a comment";
-    assert(!off_parse_counts(test, vertex_count, face_count));
+    // Each of these must fail, and leave the outputs empty
+    const char* invalid[] = {
+        "4 4 6\n0 0 0\n",                             // no OFF line
+        "OFF\n0 1 0\n",                               // no vertices
+        "OFF\n3 1 0\n0 0 0\n1 0 0\n0 1\n3 0 1 2\n", // missing coordinate
+        "OFF\n3 1 0\n0 0 0\n1 0 0\n0 1 0\n4 0 1 2 0\n", // not a triangle
+        "OFF\n3 1 0\n0 0 0\n1 0 0\n0 1 0\n3 0 1 3\n", // no vertex 3
+        "OFF\n3 2 0\n0 0 0\n1 0 0\n0 1 0\n3 0 1 2\n", // missing face
+    };
+    for (const char* file : invalid)
+    {
+        vertices.assign(1, demo::math::Vec3());
+        assert(!parse(file, vertices, indices));
+        assert(vertices.empty() && indices.empty());
+    }
+}
 
-    test = "\t  #this is a comment";
-    assert(!off_parse_counts(test, vertex_count, face_count));
+void test_face_normals()
+{
+    IndexedMesh mesh;
+    mesh.vertices = {demo::math::Vec3(0.0f, 0.0f, 0.0f), demo::math::Vec3(2.0f, 0.0f, 0.0f),
+                     demo::math::Vec3(0.0f, 3.0f, 0.0f), demo::math::Vec3(0.0f, 0.0f, 4.0f)};
+    mesh.indices = {0, 2, 1, 0, 1, 3, 1, 2, 3, 2, 0, 3};
+    assert(mesh.triangle_count() == 4);
+    assert(mesh.face_normals.empty());
 
-    test = "this is invalid";
-    assert(off_parse_counts(test, vertex_count, face_count));
-    assert(vertex_count == 0 || face_count == 0);
+    // One unit normal per triangle, facing the side from which it is counter-clockwise
+    compute_face_normals(mesh);
+    assert(mesh.face_normals.size() == 4);
+    assert(mesh.face_normals[0].z == -1.0f);
+    assert(mesh.face_normals[1].y == -1.0f);
+    assert(mesh.face_normals[3].x == -1.0f);
+    assert(std::abs(mesh.face_normals[2].mag() - 1.0f) < 1e-6f);
+    assert(mesh.face_normals[2].x > 0.0f && mesh.face_normals[2].y > 0.0f && mesh.face_normals[2].z > 0.0f);
 }
 
 int main()
 {
-    test_off_parse_counts();
+    test_parse_off();
+    test_parse_off_counts();
+    test_face_normals();
 
     return 0;
 }
@@ -41,6 +41,14 @@ bool are_equal(Mat3 a, Mat3 b)
         && abs(a[2][2] - b[2][2]) < epsilon;
 }
 
+// The arithmetic can be evaluated at compile time
+static_assert(dot(Vec3(1.0f, 2.0f, 3.0f), Vec3(4.0f, 5.0f, 6.0f)) == 32.0f);
+static_assert(cross(Vec3::X(1.0f), Vec3::Y(1.0f)).z == 1.0f);
+static_assert((Vec3(1.0f, 2.0f, 3.0f) - 2.0f * Vec3(1.0f, 1.0f, 1.0f)).x == -1.0f);
+static_assert((Mat3::FromColumns(Vec3::Y(1.0f), Vec3::X(1.0f), Vec3::Z(1.0f)) * Vec3(1.0f, 2.0f, 3.0f)).y == 1.0f);
+static_assert((Mat3() * Mat3::Zero()).row(1).y == 0.0f);
+static_assert(Mat3::Identity().transpose()[2][2] == 1.0f);
+
 int main()
 {
     // Vector constructors
@@ -193,6 +201,33 @@ int main()
         assert(are_equal(Rz*y, -x));
     }
 
+#if defined(__SSE2__)
+    // SIMD vectors and matrices give exactly the same results as Vec3 and Mat3
+    {
+        Vec3 a(1.3f, -2.7f, 0.35f);
+        Vec3 b(-4.1f, 0.6f, 2.25f);
+        Mat3 m = Mat3::AxisAngle(Vec3(0.3f, -1.2f, 0.5f));
+        Vec3A a_simd(a);
+        Vec3A b_simd(b);
+        Mat3A m_simd(m);
+
+        auto same = [](const Vec3A& simd, const Vec3& scalar) {
+            return simd.x == scalar.x && simd.y == scalar.y && simd.z == scalar.z && simd.w == 0.0f;
+        };
+
+        assert(same(a_simd + b_simd, a + b));
+        assert(same(a_simd - b_simd, a - b));
+        assert(same(-a_simd, -a));
+        assert(same(2.5f * a_simd, 2.5f * a));
+        assert(same(cross(a_simd, b_simd), cross(a, b)));
+        assert(dot(a_simd, b_simd) == dot(a, b));
+        assert(a_simd.mag() == a.mag());
+        assert(same(m_simd * a_simd, m * a));
+        assert(same(m_simd.transpose() * a_simd, m.transpose() * a));
+        assert(same((m_simd * m_simd).col(1), (m * m).col(1)));
+    }
+#endif
+
     cout << "All tests passed." << endl;
 
     return 0;
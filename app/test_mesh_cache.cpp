@@ -0,0 +1,126 @@
+#include "mesh_cache.hpp"
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+namespace fs = std::filesystem;
+
+void write_file(const fs::path& path, const std::string& contents)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << contents;
+}
+
+std::string read_file(const fs::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+// Overwrites the first element of an array in the cache file, found by its contents, with value
+void corrupt_array(const fs::path& cache_path, const std::uint32_t* array, std::size_t count, std::uint32_t value)
+{
+    std::string contents = read_file(cache_path);
+    std::size_t offset = contents.find(std::string(reinterpret_cast<const char*>(array), count * sizeof(std::uint32_t)));
+    assert(offset != std::string::npos);
+    std::memcpy(&contents[offset], &value, sizeof(value));
+    write_file(cache_path, contents);
+}
+
+// A tetrahedron, with an extra vertex inside it that is not on the hull
+const char* tetrahedron =
+    "OFF\n"
+    "5 4 0\n"
+    "0 0 0\n"
+    "2 0 0\n"
+    "0 2 0\n"
+    "0 0 2\n"
+    "0.25 0.25 0.25\n"
+    "3 0 2 1\n"
+    "3 0 1 3\n"
+    "3 1 2 3\n"
+    "3 2 0 3\n";
+
+void test_cache()
+{
+    fs::path directory = fs::temp_directory_path() / "test_mesh_cache";
+    fs::create_directories(directory);
+    fs::path off_path = directory / "tetrahedron.off";
+    fs::path cache_path = demo::mesh::mesh_cache_path(off_path);
+    fs::remove(cache_path);
+    write_file(off_path, tetrahedron);
+
+    // The first open builds the cache and writes it next to the OFF file
+    demo::mesh::MeshCache cache;
+    assert(cache.open(off_path));
+    assert(cache.rebuilt());
+    assert(fs::exists(cache_path));
+
+    assert(cache.render_vertex_count() == 5 && cache.render_index_count() == 12);
+    assert(cache.render_vertices()[1].x == 2.0f && cache.render_indices()[1] == 2);
+    assert(cache.hull_vertex_count() == 4);
+    assert(cache.hull_vertices()[3].z == 2.0f);
+    assert(cache.adjacency_offsets()[0] == 0 && cache.adjacency_offsets()[4] == 12);
+    assert(cache.adjacency_neighbour_count() == 12);
+    assert(cache.bounds().min.x == 0.0f && cache.bounds().max.y == 2.0f);
+    assert(cache.sphere().radius > 0.0f);
+
+    // The second uses the file as it is
+    assert(cache.open(off_path));
+    assert(!cache.rebuilt());
+    assert(cache.hull_vertex_count() == 4 && cache.render_vertex_count() == 5);
+
+    // Changing the OFF file makes the cache stale
+    write_file(off_path, std::string(tetrahedron, std::string(tetrahedron).find("0.25")) + "0.5 0.5 0.5\n3 0 2 1\n3 0 1 3\n3 1 2 3\n3 2 0 3\n");
+    fs::last_write_time(off_path, fs::last_write_time(cache_path) + std::chrono::seconds(1));
+    assert(cache.open(off_path));
+    assert(cache.rebuilt());
+    assert(cache.render_vertices()[4].x == 0.5f);
+    assert(cache.open(off_path));
+    assert(!cache.rebuilt());
+
+    // A truncated or foreign cache is rebuilt
+    fs::resize_file(cache_path, fs::file_size(cache_path) - 4);
+    assert(!cache.open_file(cache_path));
+    assert(cache.open(off_path));
+    assert(cache.rebuilt());
+    write_file(cache_path, std::string(200, 'x'));
+    assert(!cache.open_file(cache_path));
+    assert(cache.open(off_path));
+    assert(cache.rebuilt());
+    assert(cache.open_file(cache_path));
+
+    // So is one whose header is intact but whose indices are out of range, or whose adjacency
+    // doesn't add up
+    corrupt_array(cache_path, cache.adjacency_neighbours(), cache.adjacency_neighbour_count(), 4);
+    assert(!cache.open_file(cache_path));
+    assert(cache.open(off_path));
+    assert(cache.rebuilt());
+    corrupt_array(cache_path, cache.render_indices(), cache.render_index_count(), 5);
+    assert(!cache.open_file(cache_path));
+    assert(cache.open(off_path));
+    assert(cache.rebuilt());
+    corrupt_array(cache_path, cache.adjacency_offsets(), cache.hull_vertex_count() + 1, 1);
+    assert(!cache.open_file(cache_path));
+    assert(cache.open(off_path));
+    assert(cache.rebuilt());
+    assert(cache.open_file(cache_path));
+
+    // The OFF file is needed, even if there is a cache
+    fs::remove(off_path);
+    assert(!cache.open(off_path));
+
+    fs::remove_all(directory);
+}
+
+int main()
+{
+    test_cache();
+
+    return 0;
+}
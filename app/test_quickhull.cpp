@@ -0,0 +1,143 @@
+#include "quickhull.hpp"
+#include "mesh_tools.hpp"
+#include "math.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace demo::math;
+
+// Checks that the triangles form a closed, outward facing surface with every point on or
+// inside it
+void check_hull(const std::vector<Vec3>& points, const std::vector<Vec3>& vertices, const std::vector<std::uint32_t>& indices)
+{
+    assert(indices.size() % 3 == 0);
+
+    // Every edge of a closed surface appears once in each direction
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> edges;
+    for (std::size_t i = 0; i < indices.size(); i += 3)
+    {
+        for (std::size_t k = 0; k < 3; ++k)
+        {
+            edges.emplace_back(indices[i + k], indices[i + (k + 1) % 3]);
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    assert(std::adjacent_find(edges.begin(), edges.end()) == edges.end());
+    for (const auto& edge : edges)
+    {
+        assert(std::binary_search(edges.begin(), edges.end(), std::make_pair(edge.second, edge.first)));
+    }
+
+    // Euler's formula for a triangulated sphere
+    std::size_t face_count = indices.size() / 3;
+    assert(vertices.size() + face_count == edges.size() / 2 + 2);
+
+    for (std::size_t i = 0; i < indices.size(); i += 3)
+    {
+        const Vec3& a = vertices[indices[i]];
+        Vec3 normal = cross(vertices[indices[i + 1]] - a, vertices[indices[i + 2]] - a);
+        normal.normalize();
+        for (const Vec3& p : points)
+        {
+            assert(dot(normal, p - a) < 1e-4f);
+        }
+    }
+}
+
+void test_cube()
+{
+    // The corners of a cube, plus points in its middle and the middle of its faces, which
+    // must all be dropped
+    std::vector<Vec3> points;
+    for (int i = 0; i < 27; ++i)
+    {
+        points.push_back(Vec3(float(i % 3 - 1), float(i / 3 % 3 - 1), float(i / 9 - 1)));
+    }
+
+    std::vector<Vec3> vertices;
+    std::vector<std::uint32_t> indices;
+    assert(demo::mesh::compute_convex_hull(points, vertices, indices));
+    assert(vertices.size() == 8);
+    assert(indices.size() == 12 * 3);
+    for (const Vec3& v : vertices)
+    {
+        assert(std::abs(v.x) == 1.0f && std::abs(v.y) == 1.0f && std::abs(v.z) == 1.0f);
+    }
+    check_hull(points, vertices, indices);
+}
+
+void test_random_points()
+{
+    std::mt19937 rng(475);
+    std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f);
+
+    for (std::size_t count : {4, 10, 100, 5000})
+    {
+        std::vector<Vec3> points;
+        while (points.size() < count)
+        {
+            Vec3 p(coordinate(rng), coordinate(rng), coordinate(rng));
+            if (p.sq_mag() <= 1.0f)
+            {
+                points.push_back(p);
+            }
+        }
+
+        std::vector<Vec3> vertices;
+        std::vector<std::uint32_t> indices;
+        assert(demo::mesh::compute_convex_hull(points, vertices, indices));
+        assert(vertices.size() >= 4 && vertices.size() <= count);
+        check_hull(points, vertices, indices);
+    }
+}
+
+void test_icosphere()
+{
+    // Every vertex of a sphere is extreme
+    std::vector<Vec3> points;
+    std::vector<std::uint32_t> sphere_indices;
+    demo::mesh::make_icosphere(3, points, sphere_indices);
+
+    std::vector<Vec3> vertices;
+    std::vector<std::uint32_t> indices;
+    assert(demo::mesh::compute_convex_hull(points, vertices, indices));
+    assert(vertices.size() == points.size());
+    for (std::size_t i = 0; i < points.size(); ++i)
+    {
+        assert(vertices[i].x == points[i].x && vertices[i].y == points[i].y && vertices[i].z == points[i].z);
+    }
+    assert(indices.size() == sphere_indices.size());
+    check_hull(points, vertices, indices);
+}
+
+void test_degenerate()
+{
+    std::vector<Vec3> vertices;
+    std::vector<std::uint32_t> indices;
+
+    // Too few points
+    assert(!demo::mesh::compute_convex_hull({Vec3(0.0f, 0.0f, 0.0f), Vec3(1.0f, 0.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f)}, vertices, indices));
+
+    // Points on a plane
+    std::vector<Vec3> square;
+    for (int i = 0; i < 16; ++i)
+    {
+        square.push_back(Vec3(float(i % 4), float(i / 4), 2.0f));
+    }
+    assert(!demo::mesh::compute_convex_hull(square, vertices, indices));
+    assert(vertices.empty() && indices.empty());
+}
+
+int main()
+{
+    test_cube();
+    test_random_points();
+    test_icosphere();
+    test_degenerate();
+
+    return 0;
+}
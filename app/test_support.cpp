@@ -0,0 +1,362 @@
+#include "convex_hull.hpp"
+#include "dk_hierarchy.hpp"
+#include "quickhull.hpp"
+#include "mesh_tools.hpp"
+#include "math.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+using namespace demo::math;
+
+bool same_point(const Vec3& a, const Vec3& b)
+{
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+// A convex mesh's vertices and their adjacency, from the hull of some points
+struct HullMesh
+{
+    std::vector<Vec3> vertices;
+    demo::mesh::VertexAdjacency adjacency;
+};
+
+HullMesh make_hull(const std::vector<Vec3>& points)
+{
+    HullMesh mesh;
+    std::vector<std::uint32_t> indices;
+    bool hull = demo::mesh::compute_convex_hull(points, mesh.vertices, indices);
+    assert(hull);
+    demo::mesh::compute_adjacency(mesh.vertices.size(), indices, mesh.adjacency);
+    return mesh;
+}
+
+// The corners of a cube, with corner i at (+-1, +-1, +-1) from bits 0, 1 and 2 of i
+HullMesh make_cube()
+{
+    std::vector<Vec3> corners;
+    for (int i = 0; i < 8; ++i)
+    {
+        corners.push_back(Vec3(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f));
+    }
+    HullMesh cube = make_hull(corners);
+    assert(cube.vertices.size() == 8);
+    return cube;
+}
+
+// Points in the unit ball
+std::vector<Vec3> random_points(std::mt19937& rng, std::size_t count)
+{
+    std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f);
+    std::vector<Vec3> points;
+    while (points.size() < count)
+    {
+        Vec3 p(coordinate(rng), coordinate(rng), coordinate(rng));
+        if (p.sq_mag() <= 1.0f)
+        {
+            points.push_back(p);
+        }
+    }
+    return points;
+}
+
+Vec3 random_direction(std::mt19937& rng)
+{
+    std::normal_distribution<float> normal;
+    return Vec3(normal(rng), normal(rng), normal(rng));
+}
+
+ConvexHullInstance random_pose(std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> angle(-pi, pi);
+    Vec3 axis = random_direction(rng);
+    axis.normalize();
+    return ConvexHullInstance(random_direction(rng), Mat3::AxisAngle(angle(rng) * axis), 0);
+}
+
+// hill_climb_support must return exactly the point general_support does
+void test_hill_climb_support()
+{
+    std::mt19937 rng(475);
+
+    // Along an axis, a whole face of the cube is furthest. Starting from its last corner, every
+    // neighbour on the face is equally far, so the walk falls back to the scan, which finds the
+    // first corner of the face like general_support.
+    HullMesh cube = make_cube();
+    ConvexHullInstance identity(Vec3(0.0f, 0.0f, 0.0f), Mat3::Identity(), 0);
+    std::uint32_t start_vertex = 7;
+    Vec3 top = hill_climb_support(Vec3(0.0f, 0.0f, 1.0f), identity, cube.vertices, cube.adjacency, start_vertex);
+    assert(same_point(top, general_support(Vec3(0.0f, 0.0f, 1.0f), identity, cube.vertices)));
+    assert(start_vertex == 4);
+
+    // Along a diagonal of a face, an edge is furthest
+    start_vertex = 0;
+    Vec3 edge = hill_climb_support(Vec3(0.0f, 1.0f, 1.0f), identity, cube.vertices, cube.adjacency, start_vertex);
+    assert(same_point(edge, general_support(Vec3(0.0f, 1.0f, 1.0f), identity, cube.vertices)));
+    assert(start_vertex == 6);
+
+    // Random directions and poses, each walk starting where the last one ended
+    std::vector<HullMesh> meshes = {cube, make_hull(random_points(rng, 20)), make_hull(random_points(rng, 2000))};
+    for (const HullMesh& mesh : meshes)
+    {
+        start_vertex = 0;
+        for (int i = 0; i < 1000; ++i)
+        {
+            ConvexHullInstance pose = random_pose(rng);
+            Vec3 dir = random_direction(rng);
+            Vec3 point = hill_climb_support(dir, pose, mesh.vertices, mesh.adjacency, start_vertex);
+            assert(same_point(point, general_support(dir, pose, mesh.vertices)));
+            assert(start_vertex < mesh.vertices.size());
+        }
+    }
+
+    // A start vertex left over from a larger mesh is ignored
+    start_vertex = static_cast<std::uint32_t>(meshes[2].vertices.size() - 1);
+    Vec3 dir(0.3f, -0.5f, 0.8f);
+    assert(same_point(hill_climb_support(dir, identity, cube.vertices, cube.adjacency, start_vertex), general_support(dir, identity, cube.vertices)));
+    assert(start_vertex < cube.vertices.size());
+
+    // Adjacency which belongs to a different mesh falls back to the scan
+    start_vertex = 0;
+    assert(same_point(hill_climb_support(dir, identity, cube.vertices, meshes[1].adjacency, start_vertex), general_support(dir, identity, cube.vertices)));
+    assert(same_point(hill_climb_support(dir, identity, meshes[1].vertices, cube.adjacency, start_vertex), general_support(dir, identity, meshes[1].vertices)));
+}
+
+// simd_support must find the same vertex as general_support, including which of several equally
+// far vertices, whatever the number of vertices in the last, padded, block
+void test_simd_support()
+{
+    std::mt19937 rng(476);
+    std::uniform_int_distribution<int> coordinate(-2, 2);
+    ConvexHullInstance identity(Vec3(0.0f, 0.0f, 0.0f), Mat3::Identity(), 0);
+
+    for (std::size_t count = 1; count <= 17; ++count)
+    {
+        for (int i = 0; i < 200; ++i)
+        {
+            // Small whole numbers make many vertices equally far, or duplicates of each other along
+            // the direction. The direction has no z component, so the z coordinate of each vertex
+            // is its index, which tells which of them was found.
+            std::vector<Vec3> vertices;
+            for (std::size_t v = 0; v < count; ++v)
+            {
+                vertices.push_back(Vec3(float(coordinate(rng)), float(coordinate(rng)), float(v)));
+            }
+            SoaVertices soa = make_soa_vertices(vertices);
+            assert(soa.count == count && soa.blocks.size() == (count + 7) / 8);
+
+            Vec3 dir(float(coordinate(rng)), float(coordinate(rng)), 0.0f);
+            Vec3 point = simd_support(dir, identity, soa);
+            assert(same_point(point, general_support(dir, identity, vertices)));
+
+            // Any pose and direction
+            ConvexHullInstance pose = random_pose(rng);
+            dir = random_direction(rng);
+            assert(same_point(simd_support(dir, pose, soa), general_support(dir, pose, vertices)));
+        }
+    }
+
+    // The first vertex, which the last block is padded with, may itself be the furthest
+    std::vector<Vec3> vertices = {Vec3(5.0f, 0.0f, 0.0f), Vec3(1.0f, 0.0f, 1.0f), Vec3(5.0f, 0.0f, 2.0f)};
+    Vec3 point = simd_support(Vec3(1.0f, 0.0f, 0.0f), identity, make_soa_vertices(vertices));
+    assert(point.z == 0.0f);
+
+    // No vertices
+    assert(same_point(simd_support(Vec3(1.0f, 0.0f, 0.0f), identity, make_soa_vertices({})), Vec3(0.0f, 0.0f, 0.0f)));
+}
+
+// batch_support must find, for each object, the same point as general_support, including which
+// of several equally far vertices, whatever the number of objects
+void test_batch_support()
+{
+    std::mt19937 rng(478);
+    std::uniform_int_distribution<int> coordinate(-2, 2);
+
+    for (std::size_t count = 0; count <= 8; ++count)
+    {
+        for (int i = 0; i < 100; ++i)
+        {
+            // As in test_simd_support, the z coordinate of each vertex is its index, and the
+            // identity poses have directions with no z component, so ties are common
+            std::vector<Vec3> vertices;
+            for (std::size_t v = 0; v < std::size_t(1 + i % 20); ++v)
+            {
+                vertices.push_back(Vec3(float(coordinate(rng)), float(coordinate(rng)), float(v)));
+            }
+
+            std::vector<ConvexHullInstance> poses;
+            std::vector<Vec3> dirs;
+            for (std::size_t k = 0; k < count; ++k)
+            {
+                if (k % 2 == 0)
+                {
+                    poses.push_back(ConvexHullInstance(Vec3(0.0f, 0.0f, 0.0f), Mat3::Identity(), 0));
+                    dirs.push_back(Vec3(float(coordinate(rng)), float(coordinate(rng)), 0.0f));
+                }
+                else
+                {
+                    poses.push_back(random_pose(rng));
+                    dirs.push_back(random_direction(rng));
+                }
+            }
+
+            const ConvexHullInstance* data[8];
+            for (std::size_t k = 0; k < count; ++k)
+            {
+                data[k] = &poses[k];
+            }
+
+            // Points past count are left alone
+            Vec3 points[9];
+            points[count] = Vec3(7.0f, 7.0f, 7.0f);
+            batch_support(dirs.data(), data, count, vertices, points);
+            for (std::size_t k = 0; k < count; ++k)
+            {
+                assert(same_point(points[k], general_support(dirs[k], poses[k], vertices)));
+            }
+            assert(same_point(points[count], Vec3(7.0f, 7.0f, 7.0f)));
+        }
+    }
+
+    // No vertices
+    ConvexHullInstance identity(Vec3(0.0f, 0.0f, 0.0f), Mat3::Identity(), 0);
+    const ConvexHullInstance* data[1] = {&identity};
+    Vec3 dir(1.0f, 0.0f, 0.0f);
+    Vec3 point(7.0f, 7.0f, 7.0f);
+    batch_support(&dir, data, 1, {}, &point);
+    assert(same_point(point, Vec3(0.0f, 0.0f, 0.0f)));
+}
+
+// Walks from start to neighbours further along dir until none is, and returns the last vertex
+std::uint32_t climb(const std::vector<Vec3>& vertices, const demo::mesh::VertexAdjacency& level, const Vec3& dir, std::uint32_t start)
+{
+    std::uint32_t current = start;
+    for (;;)
+    {
+        std::uint32_t next = current;
+        for (const std::uint32_t* n = level.begin(current); n != level.end(current); ++n)
+        {
+            if (dot(dir, vertices[*n]) > dot(dir, vertices[next]))
+            {
+                next = *n;
+            }
+        }
+        if (next == current)
+        {
+            return current;
+        }
+        current = next;
+    }
+}
+
+// Checks the invariants of a hierarchy built from mesh, and that dk_support finds vertices as
+// far along random directions as general_support does
+void check_dk_hierarchy(const HullMesh& mesh, std::mt19937& rng)
+{
+    DkHierarchy hierarchy;
+    DkBuildReport report = build_dk_hierarchy(mesh.vertices, mesh.adjacency, hierarchy);
+    const std::size_t n = mesh.vertices.size();
+    assert(hierarchy.vertices.size() == n);
+    assert(report.level_count == hierarchy.levels.size());
+    assert(hierarchy.levels[0].vertex_count() == n);
+    assert(hierarchy.levels.back().vertex_count() == report.top_level_vertex_count);
+    assert(report.top_level_vertex_count <= 16);
+
+    // Each level keeps a constant fraction of the vertices of the one below, so there are
+    // logarithmically many
+    std::size_t log_n = 0;
+    while ((std::size_t(1) << log_n) < n)
+    {
+        ++log_n;
+    }
+    assert(hierarchy.levels.size() <= 2 * log_n);
+
+    for (std::size_t i = 0; i < hierarchy.levels.size(); ++i)
+    {
+        const demo::mesh::VertexAdjacency& level = hierarchy.levels[i];
+        const std::size_t level_count = level.vertex_count();
+
+        // Each edge joins two vertices of the level, and is listed from both ends
+        for (std::uint32_t v = 0; v < level_count; ++v)
+        {
+            for (const std::uint32_t* w = level.begin(v); w != level.end(v); ++w)
+            {
+                assert(*w < level_count && *w != v);
+                assert(std::find(level.begin(*w), level.end(*w), v) != level.end(*w));
+            }
+        }
+
+        // The vertices removed to make the next level are independent in this one
+        if (i + 1 < hierarchy.levels.size())
+        {
+            const std::size_t kept = hierarchy.levels[i + 1].vertex_count();
+            assert(kept < level_count);
+            for (std::uint32_t v = static_cast<std::uint32_t>(kept); v < level_count; ++v)
+            {
+                for (const std::uint32_t* w = level.begin(v); w != level.end(v); ++w)
+                {
+                    assert(*w < kept);
+                }
+            }
+        }
+
+        // The holes were closed so that the level stays convex: walking its edges from any
+        // vertex always ends at a vertex as far along the direction as any in the level
+        for (int k = 0; k < 50; ++k)
+        {
+            Vec3 dir = random_direction(rng);
+            std::uint32_t start = static_cast<std::uint32_t>(rng() % level_count);
+            float best = dot(dir, hierarchy.vertices[0]);
+            for (std::size_t v = 1; v < level_count; ++v)
+            {
+                best = std::max(best, dot(dir, hierarchy.vertices[v]));
+            }
+            assert(dot(dir, hierarchy.vertices[climb(hierarchy.vertices, level, dir, start)]) == best);
+        }
+    }
+
+    // dk_support needs no start, and finds a vertex as far as the exhaustive scan
+    ConvexHullInstance identity(Vec3(0.0f, 0.0f, 0.0f), Mat3::Identity(), 0);
+    for (int k = 0; k < 1000; ++k)
+    {
+        Vec3 dir = random_direction(rng);
+        assert(dot(dk_support(dir, identity, hierarchy), dir) == dot(general_support(dir, identity, mesh.vertices), dir));
+    }
+}
+
+void test_dk_hierarchy()
+{
+    std::mt19937 rng(477);
+
+    // Every vertex of an icosphere is extreme, and each has 5 or 6 neighbours
+    std::vector<Vec3> sphere_points;
+    std::vector<std::uint32_t> sphere_indices;
+    demo::mesh::make_icosphere(4, sphere_points, sphere_indices);
+    check_dk_hierarchy(make_hull(sphere_points), rng);
+
+    // Hulls of random points, whose vertices have irregular degrees
+    for (std::size_t count : {30, 500, 5000})
+    {
+        check_dk_hierarchy(make_hull(random_points(rng, count)), rng);
+    }
+
+    // A cube is too small to need more than one level
+    DkHierarchy cube_hierarchy;
+    HullMesh cube = make_cube();
+    build_dk_hierarchy(cube.vertices, cube.adjacency, cube_hierarchy);
+    assert(cube_hierarchy.levels.size() == 1);
+    ConvexHullInstance identity(Vec3(0.0f, 0.0f, 0.0f), Mat3::Identity(), 0);
+    assert(same_point(dk_support(Vec3(0.0f, 0.0f, 1.0f), identity, cube_hierarchy), general_support(Vec3(0.0f, 0.0f, 1.0f), identity, cube.vertices)));
+}
+
+int main()
+{
+    test_hill_climb_support();
+    test_simd_support();
+    test_batch_support();
+    test_dk_hierarchy();
+
+    return 0;
+}
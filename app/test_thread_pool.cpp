@@ -0,0 +1,61 @@
+#include "thread_pool.hpp"
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+// Every index must be visited exactly once, for any number of threads and chunk size
+void test_parallel_for()
+{
+    for (std::size_t thread_count : {1, 2, 3, 8})
+    {
+        WorkStealingPool pool(thread_count);
+        assert(pool.thread_count() == thread_count);
+
+        for (std::size_t count : {0, 1, 7, 1000})
+        {
+            for (std::size_t chunk_size : {1, 3, 64, 5000})
+            {
+                std::vector<std::atomic<int>> visits(count);
+                pool.parallel_for(count, chunk_size, [&visits, chunk_size](std::size_t begin, std::size_t end) {
+                    assert(begin < end && end - begin <= chunk_size);
+                    for (std::size_t i = begin; i < end; ++i)
+                    {
+                        ++visits[i];
+                    }
+                });
+
+                for (const auto& v : visits)
+                {
+                    assert(v == 1);
+                }
+            }
+        }
+    }
+}
+
+// Work concentrated in one thread's share gets stolen by the others
+void test_stealing()
+{
+    WorkStealingPool pool(4);
+    std::atomic<std::size_t> total{0};
+    pool.parallel_for(400, 1, [&total](std::size_t begin, std::size_t) {
+        // The first quarter of the chunks is much more expensive than the rest
+        std::size_t spins = begin < 100 ? 20000 : 10;
+        volatile std::size_t sink = 0;
+        for (std::size_t i = 0; i < spins; ++i)
+        {
+            sink = sink + i;
+        }
+        ++total;
+    });
+    assert(total == 400);
+}
+
+int main()
+{
+    test_parallel_for();
+    test_stealing();
+
+    return 0;
+}
@@ -0,0 +1,177 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cassert>
+
+static std::uint64_t pack_range(std::uint32_t begin, std::uint32_t end)
+{
+    return (static_cast<std::uint64_t>(begin) << 32) | end;
+}
+
+static std::uint32_t range_begin(std::uint64_t range)
+{
+    return static_cast<std::uint32_t>(range >> 32);
+}
+
+static std::uint32_t range_end(std::uint64_t range)
+{
+    return static_cast<std::uint32_t>(range);
+}
+
+WorkStealingPool::WorkStealingPool(std::size_t thread_count)
+    : threads(thread_count ? thread_count : std::max(1u, std::thread::hardware_concurrency()))
+{
+    ranges.reset(new WorkRange[threads]);
+    for (std::size_t i = 0; i + 1 < threads; ++i)
+    {
+        workers.emplace_back(&WorkStealingPool::worker_main, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::scoped_lock lock(mutex);
+        stopping = true;
+    }
+    start_cv.notify_all();
+
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+std::size_t WorkStealingPool::thread_count() const
+{
+    return threads;
+}
+
+std::size_t WorkStealingPool::steal_count() const
+{
+    return steals.load();
+}
+
+void WorkStealingPool::parallel_for(std::size_t count, std::size_t chunk_size, const std::function<void(std::size_t, std::size_t)>& body)
+{
+    assert(chunk_size > 0);
+    steals = 0;
+    if (count == 0)
+    {
+        return;
+    }
+
+    std::size_t chunk_count = (count + chunk_size - 1) / chunk_size;
+    assert(chunk_count < (std::uint64_t(1) << 32));
+
+    loop_body = &body;
+    loop_count = count;
+    loop_chunk_size = chunk_size;
+
+    // Give each thread an equal share of the chunks to start with
+    for (std::size_t i = 0; i < threads; ++i)
+    {
+        ranges[i].range.store(pack_range(
+            static_cast<std::uint32_t>(chunk_count * i / threads),
+            static_cast<std::uint32_t>(chunk_count * (i + 1) / threads)));
+    }
+
+    if (!workers.empty())
+    {
+        {
+            std::scoped_lock lock(mutex);
+            ++generation;
+            workers_busy = workers.size();
+        }
+        start_cv.notify_all();
+    }
+
+    // The calling thread takes the last share
+    run_chunks(threads - 1);
+
+    if (!workers.empty())
+    {
+        std::unique_lock lock(mutex);
+        done_cv.wait(lock, [this] { return workers_busy == 0; });
+    }
+
+    loop_body = nullptr;
+}
+
+void WorkStealingPool::worker_main(std::size_t index)
+{
+    std::uint64_t seen_generation = 0;
+    while (true)
+    {
+        {
+            std::unique_lock lock(mutex);
+            start_cv.wait(lock, [this, seen_generation] { return stopping || generation != seen_generation; });
+            if (stopping)
+            {
+                return;
+            }
+            seen_generation = generation;
+        }
+
+        run_chunks(index);
+
+        {
+            std::scoped_lock lock(mutex);
+            --workers_busy;
+        }
+        done_cv.notify_one();
+    }
+}
+
+void WorkStealingPool::run_chunks(std::size_t index)
+{
+    // A thread only stops once its own share is empty and there is nothing to steal. Its share
+    // is only refilled by its own steals, so every chunk is run by the thread which holds it.
+    do
+    {
+        std::uint32_t chunk;
+        while (take_chunk(index, chunk))
+        {
+            std::size_t begin = chunk * loop_chunk_size;
+            std::size_t end = std::min(begin + loop_chunk_size, loop_count);
+            (*loop_body)(begin, end);
+        }
+    } while (steal(index));
+}
+
+bool WorkStealingPool::take_chunk(std::size_t index, std::uint32_t& chunk)
+{
+    std::atomic<std::uint64_t>& range = ranges[index].range;
+    std::uint64_t current = range.load();
+    while (range_begin(current) < range_end(current))
+    {
+        if (range.compare_exchange_weak(current, pack_range(range_begin(current) + 1, range_end(current))))
+        {
+            chunk = range_begin(current);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool WorkStealingPool::steal(std::size_t index)
+{
+    for (std::size_t offset = 1; offset < threads; ++offset)
+    {
+        std::atomic<std::uint64_t>& victim = ranges[(index + offset) % threads].range;
+        std::uint64_t current = victim.load();
+        while (range_begin(current) < range_end(current))
+        {
+            // Take the back half, rounding up so that a single chunk can be stolen
+            std::uint32_t begin = range_begin(current);
+            std::uint32_t end = range_end(current);
+            std::uint32_t split = end - (end - begin + 1) / 2;
+            if (victim.compare_exchange_weak(current, pack_range(begin, split)))
+            {
+                ranges[index].range.store(pack_range(split, end));
+                steals += end - split;
+                return true;
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,75 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of threads which run loops in parallel. The iterations of a loop are split into
+// chunks, and each thread starts with an equal, contiguous share of the chunks. A thread which
+// runs out of work steals half of the remaining chunks of another thread, so uneven chunk costs
+// (such as GJK on mostly separated pairs) still balance out.
+//
+// Each thread's share is a single atomic range of chunk indices. The owner takes chunks from the
+// front, and thieves take them from the back, both by compare and swap, so no locks are held while
+// the loop runs.
+class WorkStealingPool
+{
+public:
+    // Starts thread_count - 1 worker threads. The thread which calls parallel_for is the last one.
+    // Zero means one thread per hardware thread.
+    explicit WorkStealingPool(std::size_t thread_count = 0);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    std::size_t thread_count() const;
+
+    // Calls body(begin, end) for consecutive ranges covering [0, count), each at most chunk_size
+    // long, and returns once they have all finished. Ranges may run on any thread, in any order.
+    void parallel_for(std::size_t count, std::size_t chunk_size, const std::function<void(std::size_t, std::size_t)>& body);
+
+    // Number of chunks which were stolen during the last parallel_for
+    std::size_t steal_count() const;
+
+private:
+    // Chunk indices [begin, end) packed as begin << 32 | end, on its own cache line
+    struct alignas(64) WorkRange
+    {
+        std::atomic<std::uint64_t> range{0};
+    };
+
+    void worker_main(std::size_t index);
+
+    // Runs chunks of the current loop until no thread has any left
+    void run_chunks(std::size_t index);
+    bool take_chunk(std::size_t index, std::uint32_t& chunk);
+    bool steal(std::size_t index);
+
+    std::vector<std::thread> workers;
+    std::unique_ptr<WorkRange[]> ranges;
+    std::size_t threads;
+
+    // The current loop
+    const std::function<void(std::size_t, std::size_t)>* loop_body = nullptr;
+    std::size_t loop_count = 0;
+    std::size_t loop_chunk_size = 0;
+    std::atomic<std::size_t> steals{0};
+
+    // Workers wait for generation to change, which signals a new loop
+    std::mutex mutex;
+    std::condition_variable start_cv;
+    std::condition_variable done_cv;
+    std::uint64_t generation = 0;
+    std::size_t workers_busy = 0;
+    bool stopping = false;
+};
+
+#endif
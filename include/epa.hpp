@@ -0,0 +1,300 @@
+#ifndef EPA_HPP
+#define EPA_HPP
+
+#include "gjk.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace geometry
+{
+    template <class Vec3>
+    struct EpaResult
+    {
+        using Real = decltype(Vec3::x);
+
+        // The distance shape 2 must be moved along normal to separate the shapes
+        Real depth = Real(0);
+
+        // Unit vector pointing from shape 1 towards shape 2
+        Vec3 normal;
+
+        // The deepest points of each shape inside the other
+        Vec3 point1;
+        Vec3 point2;
+
+        // False if the polytope ran out of space or the input simplex was degenerate.
+        // The other fields then hold the best estimate found.
+        bool converged = false;
+    };
+
+    // A triangle of the expanding polytope. Vertices are wound counter-clockwise when
+    // seen from outside, and normal points outwards.
+    template <class Vec3>
+    struct EpaFace
+    {
+        using Real = decltype(Vec3::x);
+
+        std::uint16_t indices[3];
+        Vec3 normal;
+
+        // Distance of the face's plane from the origin
+        Real distance;
+    };
+
+    template <class Vec3>
+    EpaFace<Vec3> make_epa_face(const SimplexVertex<Vec3>* vertices, std::uint16_t a, std::uint16_t b, std::uint16_t c)
+    {
+        using Real = decltype(Vec3::x);
+
+        EpaFace<Vec3> face;
+        face.indices[0] = a;
+        face.indices[1] = b;
+        face.indices[2] = c;
+
+        const Vec3& pa = vertices[a].point;
+        Vec3 n = cross(vertices[b].point - pa, vertices[c].point - pa);
+        Real length = std::sqrt(dot(n, n));
+        if (length > Real(0))
+        {
+            face.normal = (Real(1) / length) * n;
+            face.distance = dot(face.normal, pa);
+        }
+        else
+        {
+            // Sliver face, which must never be picked as the closest
+            face.normal = n;
+            face.distance = std::numeric_limits<Real>::max();
+        }
+        return face;
+    }
+
+    // Expanding Polytope Algorithm (van den Bergen, Proximity Queries and Penetration Depth
+    // Computation on 3D Game Objects, 2001). Starting from a tetrahedron on the Minkowski
+    // difference which contains the origin, such as the one intersect_gjk outputs, the
+    // polytope is expanded towards the boundary until the face closest to the origin is
+    // known to within relative_tolerance of its distance.
+    //
+    // The polytope lives in fixed size arrays on the stack, so no memory is allocated.
+    // MaxVertices limits how far the polytope can be refined, which matters for curved shapes.
+    template <class Vec3, std::size_t MaxVertices = 64, class Support1, class Support2>
+    EpaResult<Vec3> penetration_epa(
+        const Support1& support1,
+        const Support2& support2,
+        const Simplex<Vec3>& simplex,
+        const decltype(Vec3::x) relative_tolerance = default_relative_tolerance<decltype(Vec3::x)>(),
+        GjkStats* stats = nullptr)
+    {
+        static_assert(is_support_mapping_v<Support1, Vec3>, "support1 must be callable as Vec3(const Vec3&)");
+        static_assert(is_support_mapping_v<Support2, Vec3>, "support2 must be callable as Vec3(const Vec3&)");
+        static_assert(MaxVertices >= 4 && MaxVertices <= 0xffff, "MaxVertices must fit a uint16_t index");
+
+        using Real = decltype(Vec3::x);
+
+        // A closed triangulated polytope with V vertices has 2V - 4 faces, and a horizon
+        // can't have more edges than the polytope has vertices.
+        constexpr std::size_t MaxFaces = 2*MaxVertices;
+        struct Edge
+        {
+            std::uint16_t a;
+            std::uint16_t b;
+        };
+
+        SimplexVertex<Vec3> vertices[MaxVertices];
+        EpaFace<Vec3> faces[MaxFaces];
+        Edge horizon[MaxVertices];
+        std::size_t vertex_count = 4;
+        std::size_t face_count = 0;
+
+        EpaResult<Vec3> result;
+        if (stats)
+        {
+            stats->iteration_count = 0;
+        }
+
+        assert(simplex.size == 4);
+        for (std::size_t i = 0; i < 4; ++i)
+        {
+            vertices[i] = simplex.vertices[i];
+        }
+
+        // Wind the tetrahedron so that its faces point outwards
+        Real volume = dot(vertices[1].point - vertices[0].point,
+            cross(vertices[2].point - vertices[0].point, vertices[3].point - vertices[0].point));
+        if (volume == Real(0))
+        {
+            return result;
+        }
+        if (volume > Real(0))
+        {
+            std::swap(vertices[2], vertices[3]);
+        }
+        faces[face_count++] = make_epa_face(vertices, 0, 1, 2);
+        faces[face_count++] = make_epa_face(vertices, 0, 3, 1);
+        faces[face_count++] = make_epa_face(vertices, 0, 2, 3);
+        faces[face_count++] = make_epa_face(vertices, 1, 3, 2);
+
+        std::size_t closest = 0;
+        std::size_t iteration_count = 0;
+        while (true)
+        {
+            closest = 0;
+            for (std::size_t i = 1; i < face_count; ++i)
+            {
+                if (faces[i].distance < faces[closest].distance)
+                {
+                    closest = i;
+                }
+            }
+
+            ++iteration_count;
+
+            const EpaFace<Vec3> face = faces[closest];
+            SimplexVertex<Vec3> w;
+            w.support1 = support1(face.normal);
+            w.support2 = support2(-face.normal);
+            w.point = w.support1 - w.support2;
+
+            Real upper_bound = dot(face.normal, w.point);
+            if (upper_bound - face.distance <= relative_tolerance * upper_bound)
+            {
+                result.converged = true;
+                break;
+            }
+
+            // No progress can be made if the new vertex is already on the polytope
+            bool duplicate = false;
+            for (std::size_t i = 0; i < 3; ++i)
+            {
+                duplicate = duplicate || (vertices[face.indices[i]].point.x == w.point.x &&
+                                          vertices[face.indices[i]].point.y == w.point.y &&
+                                          vertices[face.indices[i]].point.z == w.point.z);
+            }
+            if (duplicate)
+            {
+                result.converged = true;
+                break;
+            }
+
+            if (vertex_count == MaxVertices)
+            {
+                break;
+            }
+
+            // Remove the faces which can see the new vertex, keeping the edges between
+            // them and the rest of the polytope. Edges shared by two removed faces appear
+            // once in each direction and cancel out.
+            // Faces which are coplanar with the new vertex must be removed too, since joining
+            // it to their edges would create faces pointing into the polytope. This happens
+            // whenever the shapes have flat faces.
+            const Real coplanar_tolerance = relative_tolerance * upper_bound;
+            std::size_t horizon_size = 0;
+            bool horizon_overflow = false;
+            for (std::size_t i = 0; i < face_count;)
+            {
+                const EpaFace<Vec3>& f = faces[i];
+                if (dot(f.normal, w.point - vertices[f.indices[0]].point) < -coplanar_tolerance)
+                {
+                    ++i;
+                    continue;
+                }
+
+                for (std::size_t e = 0; e < 3; ++e)
+                {
+                    Edge edge = {f.indices[e], f.indices[(e + 1) % 3]};
+                    std::size_t j = 0;
+                    while (j < horizon_size && !(horizon[j].a == edge.b && horizon[j].b == edge.a))
+                    {
+                        ++j;
+                    }
+                    if (j < horizon_size)
+                    {
+                        horizon[j] = horizon[--horizon_size];
+                    }
+                    else if (horizon_size < MaxVertices)
+                    {
+                        horizon[horizon_size++] = edge;
+                    }
+                    else
+                    {
+                        horizon_overflow = true;
+                    }
+                }
+
+                faces[i] = faces[--face_count];
+            }
+
+            if (horizon_overflow || face_count + horizon_size > MaxFaces)
+            {
+                // The polytope is no longer closed, so the faces can't be trusted. This is
+                // only possible with badly conditioned input.
+                faces[0] = face;
+                closest = 0;
+                break;
+            }
+
+            if (horizon_size == 0)
+            {
+                // Rounding hid the new vertex from every face, so the closest face is final
+                result.converged = true;
+                break;
+            }
+
+            std::uint16_t w_index = static_cast<std::uint16_t>(vertex_count);
+            vertices[vertex_count++] = w;
+            for (std::size_t i = 0; i < horizon_size; ++i)
+            {
+                faces[face_count++] = make_epa_face(vertices, horizon[i].a, horizon[i].b, w_index);
+            }
+        }
+
+        if (stats)
+        {
+            stats->iteration_count = iteration_count;
+        }
+
+        // The contact points are the same combination of support points as the projection of
+        // the origin onto the closest face is of its vertices.
+        const EpaFace<Vec3>& face = faces[closest];
+        const SimplexVertex<Vec3>& a = vertices[face.indices[0]];
+        const SimplexVertex<Vec3>& b = vertices[face.indices[1]];
+        const SimplexVertex<Vec3>& c = vertices[face.indices[2]];
+        Vec3 p = face.distance * face.normal;
+
+        Vec3 n = cross(b.point - a.point, c.point - a.point);
+        Real area = dot(n, n);
+        Real u = dot(n, cross(b.point - p, c.point - p)) / area;
+        Real v = dot(n, cross(c.point - p, a.point - p)) / area;
+        Real t = Real(1) - u - v;
+
+        result.depth = face.distance;
+        result.normal = face.normal;
+        result.point1 = u*a.support1 + v*b.support1 + t*c.support1;
+        result.point2 = u*a.support2 + v*b.support2 + t*c.support2;
+        return result;
+    }
+
+    // Computes the penetration depth of two convex shapes, or returns false if they don't
+    // intersect. This runs intersect_gjk, then penetration_epa on the simplex it finds.
+    template <class Vec3, class Support1, class Support2>
+    bool penetration_gjk_epa(
+        const Support1& support1,
+        const Support2& support2,
+        EpaResult<Vec3>& result,
+        GjkStats* gjk_stats = nullptr,
+        GjkStats* epa_stats = nullptr)
+    {
+        Simplex<Vec3> simplex;
+        if (!intersect_gjk<Vec3>(support1, support2, 100, gjk_stats, &simplex))
+        {
+            return false;
+        }
+        result = penetration_epa<Vec3>(support1, support2, simplex, default_relative_tolerance<decltype(Vec3::x)>(), epa_stats);
+        return true;
+    }
+}
+
+#endif
@@ -4,14 +4,105 @@
 #include <cstddef>
 #include <cassert>
 #include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <type_traits>
+#include <utility>
 
 namespace geometry
 {
     struct GjkStats
     {
         std::size_t iteration_count;
+
+        // Whether the query started from a cached direction, and whether that direction
+        // alone was enough to show that the shapes are separated
+        bool warm_started = false;
+        bool cache_hit = false;
+
+        // False if the query stopped without an answer, either at the iteration limit or
+        // because rounding stopped it from making progress (see GjkPolicy)
+        bool converged = true;
+
+        // Whether intersect_gjk_mixed had to repeat the query in its more precise policy.
+        // iteration_count then includes the iterations of both attempts.
+        bool precision_fallback = false;
+
+        // Set by callers which skipped GJK because a cheaper bounding volume test already
+        // showed that the shapes are separated. intersect_gjk never sets it.
+        bool bounds_rejected = false;
+    };
+
+    // Vec3 must have public x, y and z members, a constructor taking x, y and z, unary and
+    // binary + and -, and multiplication by a scalar on the left.
+
+    // A support mapping takes a direction and returns the point of a shape which
+    // is furthest in that direction. Any callable with the signature
+    // Vec3(const Vec3&) can be used, including lambdas and std::function.
+    template <class Support, class Vec3>
+    constexpr bool is_support_mapping_v = std::is_invocable_r_v<Vec3, const Support&, const Vec3&>;
+
+    // Numerical settings of intersect_gjk. Real is the type the simplex is computed in, which
+    // can be more precise than the Vec3 of the support mappings.
+    //
+    // Each new support point w must extend the simplex towards the origin by more than
+    // relative_tolerance * |w| + absolute_tolerance. Otherwise the origin is on the boundary of
+    // the Minkowski difference to within rounding error, and further iterations tend to cycle
+    // between the same simplices, so the query stops and reports that it did not converge.
+    // Other policies can be used in place of this one, as long as they have the same members.
+    template <class Real_>
+    struct GjkPolicy
+    {
+        using Real = Real_;
+        static constexpr Real relative_tolerance = Real(16) * std::numeric_limits<Real>::epsilon();
+        static constexpr Real absolute_tolerance = Real(0);
     };
 
+    // A minimal vector, which intersect_gjk uses to compute in a policy's Real when that is
+    // different from the scalar type of the support mappings' Vec3
+    template <class Real>
+    struct Vector3
+    {
+        Real x = Real(0);
+        Real y = Real(0);
+        Real z = Real(0);
+
+        Vector3() = default;
+        Vector3(Real x_, Real y_, Real z_)
+            : x(x_), y(y_), z(z_)
+        {}
+
+        Vector3 operator-() const
+        {
+            return Vector3(-x, -y, -z);
+        }
+
+        Vector3 operator+(const Vector3& rhs) const
+        {
+            return Vector3(x + rhs.x, y + rhs.y, z + rhs.z);
+        }
+
+        Vector3 operator-(const Vector3& rhs) const
+        {
+            return Vector3(x - rhs.x, y - rhs.y, z - rhs.z);
+        }
+    };
+
+    template <class Real>
+    Vector3<Real> operator*(Real lhs, const Vector3<Real>& rhs)
+    {
+        return Vector3<Real>(lhs*rhs.x, lhs*rhs.y, lhs*rhs.z);
+    }
+
+    // Converts between vector types with different scalar types
+    template <class To, class From>
+    To convert_vector(const From& v)
+    {
+        using Real = decltype(To::x);
+        return To(static_cast<Real>(v.x), static_cast<Real>(v.y), static_cast<Real>(v.z));
+    }
+
     template <class Vec3>
     decltype(Vec3::x) dot(const Vec3& l, const Vec3& r)
     {
@@ -28,15 +119,89 @@ namespace geometry
         );
     }
 
+    // A vertex of a simplex on the Minkowski difference of two shapes, along with the
+    // points on each shape which it is the difference of.
     template <class Vec3>
-    void simplex0_dir(Vec3* simplex, Vec3& d)
+    struct SimplexVertex
     {
-        // The simplex is a single point (0-dimensional)
-        d = -*simplex;
+        Vec3 point;
+        Vec3 support1;
+        Vec3 support2;
+    };
+
+    // A simplex of up to 4 vertices, and the barycentric coordinates of the point on it
+    // which is closest to the origin.
+    template <class Vec3>
+    struct Simplex
+    {
+        using Real = decltype(Vec3::x);
+
+        SimplexVertex<Vec3> vertices[4];
+        Real barycentric[4] = {};
+        std::size_t size = 0;
+
+        void set(std::size_t index, const SimplexVertex<Vec3>& vertex, Real weight)
+        {
+            vertices[index] = vertex;
+            barycentric[index] = weight;
+        }
+
+        // The point on the simplex closest to the origin
+        Vec3 closest_point() const
+        {
+            Vec3 result = barycentric[0] * vertices[0].point;
+            for (std::size_t i = 1; i < size; ++i)
+            {
+                result = result + barycentric[i] * vertices[i].point;
+            }
+            return result;
+        }
+
+        // The points on each shape corresponding to closest_point
+        Vec3 closest_point1() const
+        {
+            Vec3 result = barycentric[0] * vertices[0].support1;
+            for (std::size_t i = 1; i < size; ++i)
+            {
+                result = result + barycentric[i] * vertices[i].support1;
+            }
+            return result;
+        }
+
+        Vec3 closest_point2() const
+        {
+            Vec3 result = barycentric[0] * vertices[0].support2;
+            for (std::size_t i = 1; i < size; ++i)
+            {
+                result = result + barycentric[i] * vertices[i].support2;
+            }
+            return result;
+        }
+    };
+
+    // Returns the point of a simplex vertex, for simplex functions which work on both
+    // bare points and SimplexVertex.
+    template <class Vec3>
+    const Vec3& simplex_point(const Vec3& vertex)
+    {
+        return vertex;
     }
 
     template <class Vec3>
-    void simplex1_dir(Vec3* simplex, Vec3& d)
+    const Vec3& simplex_point(const SimplexVertex<Vec3>& vertex)
+    {
+        return vertex.point;
+    }
+
+    template <class Vertex, class Vec3>
+    void simplex0_dir(Vertex* simplex, Vec3& d)
+    {
+        // The simplex is a single point (0-dimensional)
+        d = -simplex_point(*simplex);
+    }
+
+    template <class Vertex, class Vec3>
+    void simplex1_dir(Vertex* simplex, Vec3& d)
     {
         // The simplex is 2 points.
         // The way this is called, the closest point to the simplex can only
@@ -46,11 +211,14 @@ namespace geometry
         // in the direction pointing "closest" to the origin while being normal to the simplex.
         // There are 2 directions normal to the simplex in this plane
 
-        d = cross(simplex[1] - simplex[0], cross(simplex[1] - simplex[0], simplex[0]));
+        const Vec3& a = simplex_point(simplex[0]);
+        const Vec3& b = simplex_point(simplex[1]);
+
+        d = cross(b - a, cross(b - a, a));
     }
 
-    template <class Vec3>
-    void simplex2_dir(Vec3* simplex, std::size_t& simplex_size, Vec3& d)
+    template <class Vertex, class Vec3>
+    void simplex2_dir(Vertex* simplex, std::size_t& simplex_size, Vec3& d)
     {
         /*  The simplex is 3 points, a triangle
 
@@ -72,21 +240,30 @@ namespace geometry
             GJK algorithm works imposes constraints on where the origin can be relative
             to these vertices. This allows several cases to be eliminated in this function.
             In particular, the only regions which can contain the origin are D, F, G and H.
+            Rounding can still put the origin just past edge AB (region B), in which case
+            the simplex is reduced to that edge.
         */
 
         using Real = decltype(Vec3::x);
 
+        // Copies, since the simplex is modified below
+        const Vec3 p[3] = {simplex_point(simplex[0]), simplex_point(simplex[1]), simplex_point(simplex[2])};
+
         // Looking down at counter-clockwise triangle, this is pointing up
-        Vec3 triangle_normal = cross(simplex[1] - simplex[0], simplex[2] - simplex[0]);
+        Vec3 triangle_normal = cross(p[1] - p[0], p[2] - p[0]);
 
-        Vec3 f_normal = cross(triangle_normal, simplex[2] - simplex[0]);
-        Vec3 d_normal = cross(triangle_normal, simplex[1] - simplex[2]);
+        Vec3 f_normal = cross(triangle_normal, p[2] - p[0]);
+        Vec3 d_normal = cross(triangle_normal, p[1] - p[2]);
+        Vec3 b_normal = cross(p[1] - p[0], triangle_normal);
 
         // Positive means the origin is in the negative side of the corresponding plane
-        Real f_plane(dot(f_normal, simplex[0]));
-        Real d_plane(dot(d_normal, simplex[2]));
+        Real f_plane(dot(f_normal, p[0]));
+        Real d_plane(dot(d_normal, p[2]));
 
-        // TODO: decide on < vs <=
+        // Each test uses <, so when the origin is exactly on one of the planes, the case which
+        // keeps more vertices is chosen. The choice doesn't matter in exact arithmetic. With
+        // rounding, either choice can make the search cycle when the origin is on the boundary of
+        // the Minkowski difference, which intersect_gjk detects with its progress test.
 
         // Note: When adjusting simplex vertices for the 2-simplex case, the winding of
         // the triangle needs to be reversed, so that the 3-simplex generated in the
@@ -96,12 +273,12 @@ namespace geometry
         {
             // Now just check FE plane
             // The normal in the dot points from F to E
-            if (dot(cross(f_normal, triangle_normal), simplex[2]) < Real(0))
+            if (dot(cross(f_normal, triangle_normal), p[2]) < Real(0))
             {
                 // This means the origin is on the E side
                 simplex_size = 1;
                 simplex[0] = simplex[2];
-                d = -simplex[0];
+                d = -simplex_point(simplex[0]);
             }
             else
             {
@@ -115,12 +292,12 @@ namespace geometry
         {
             // Now just check DE plane
             // The normal in the dot points from D to E
-            if (dot(cross(triangle_normal, d_normal), simplex[2]) < Real(0))
+            if (dot(cross(triangle_normal, d_normal), p[2]) < Real(0))
             {
                 // This means the origin is on the E side
                 simplex_size = 1;
                 simplex[0] = simplex[2];
-                d = -simplex[0];
+                d = -simplex_point(simplex[0]);
             }
             else
             {
@@ -131,12 +308,18 @@ namespace geometry
                 simplex1_dir(simplex, d);
             }
         }
+        else if (dot(b_normal, p[0]) < Real(0))
+        {
+            // This means the origin is on the B side
+            simplex_size = 2;
+            simplex1_dir(simplex, d);
+        }
         else
         {
             // Origin is in region G or H
             simplex_size = 3;
 
-            if (dot(triangle_normal, simplex[0]) < Real(0))
+            if (dot(triangle_normal, p[0]) < Real(0))
             {
                 // Origin is above the triangle
                 d = triangle_normal;
@@ -153,8 +336,8 @@ namespace geometry
         }
     }
 
-    template <class Vec3>
-    bool simplex3_dir(Vec3* simplex, std::size_t& simplex_size, Vec3& d)
+    template <class Vertex, class Vec3>
+    bool simplex3_dir(Vertex* simplex, std::size_t& simplex_size, Vec3& d)
     {
         using Real = decltype(Vec3::x);
 
@@ -171,30 +354,33 @@ namespace geometry
            can be eliminated, but I have not figured out which ones yet.
         */
 
+        // Copies, since the simplex is modified below
+        const Vec3 p[4] = {simplex_point(simplex[0]), simplex_point(simplex[1]), simplex_point(simplex[2]), simplex_point(simplex[3])};
+
         //Vec3 triangle0_normal = cross(simplex[1] - simplex[0], simplex[2] - simplex[0]);
-        Vec3 triangle1_normal = cross(simplex[0] - simplex[1], simplex[3] - simplex[1]);
-        Vec3 triangle2_normal = cross(simplex[3] - simplex[2], simplex[0] - simplex[2]);
-        Vec3 triangle3_normal = cross(simplex[2] - simplex[3], simplex[1] - simplex[3]);
+        Vec3 triangle1_normal = cross(p[0] - p[1], p[3] - p[1]);
+        Vec3 triangle2_normal = cross(p[3] - p[2], p[0] - p[2]);
+        Vec3 triangle3_normal = cross(p[2] - p[3], p[1] - p[3]);
 
         // Pointing toward face, away from edge
-        Vec3 triangle1_edge12_boundary_normal = cross(triangle1_normal, simplex[3] - simplex[0]);
-        Vec3 triangle1_edge13_boundary_normal = cross(triangle1_normal, simplex[1] - simplex[3]);
-        Vec3 triangle2_edge21_boundary_normal = cross(triangle2_normal, simplex[0] - simplex[3]);
-        Vec3 triangle2_edge23_boundary_normal = cross(triangle2_normal, simplex[3] - simplex[2]);
-        Vec3 triangle3_edge31_boundary_normal = cross(triangle3_normal, simplex[3] - simplex[1]);
-        Vec3 triangle3_edge32_boundary_normal = cross(triangle3_normal, simplex[2] - simplex[3]);
+        Vec3 triangle1_edge12_boundary_normal = cross(triangle1_normal, p[3] - p[0]);
+        Vec3 triangle1_edge13_boundary_normal = cross(triangle1_normal, p[1] - p[3]);
+        Vec3 triangle2_edge21_boundary_normal = cross(triangle2_normal, p[0] - p[3]);
+        Vec3 triangle2_edge23_boundary_normal = cross(triangle2_normal, p[3] - p[2]);
+        Vec3 triangle3_edge31_boundary_normal = cross(triangle3_normal, p[3] - p[1]);
+        Vec3 triangle3_edge32_boundary_normal = cross(triangle3_normal, p[2] - p[3]);
 
         // If positive, the origin is on the negative side of the plane
-        Real side_of_triangle1 = dot(triangle1_normal, simplex[0]);
-        Real side_of_triangle2 = dot(triangle2_normal, simplex[3]);
-        Real side_of_triangle3 = dot(triangle3_normal, simplex[2]);
+        Real side_of_triangle1 = dot(triangle1_normal, p[0]);
+        Real side_of_triangle2 = dot(triangle2_normal, p[3]);
+        Real side_of_triangle3 = dot(triangle3_normal, p[2]);
 
-        Real  side_of_triangle1_edge12_boundary = dot(triangle1_edge12_boundary_normal, simplex[0]);
-        Real  side_of_triangle1_edge13_boundary = dot(triangle1_edge13_boundary_normal, simplex[3]);
-        Real  side_of_triangle2_edge21_boundary = dot(triangle2_edge21_boundary_normal, simplex[3]);
-        Real  side_of_triangle2_edge23_boundary = dot(triangle2_edge23_boundary_normal, simplex[2]);
-        Real  side_of_triangle3_edge31_boundary = dot(triangle3_edge31_boundary_normal, simplex[1]);
-        Real  side_of_triangle3_edge32_boundary = dot(triangle3_edge32_boundary_normal, simplex[3]);
+        Real  side_of_triangle1_edge12_boundary = dot(triangle1_edge12_boundary_normal, p[0]);
+        Real  side_of_triangle1_edge13_boundary = dot(triangle1_edge13_boundary_normal, p[3]);
+        Real  side_of_triangle2_edge21_boundary = dot(triangle2_edge21_boundary_normal, p[3]);
+        Real  side_of_triangle2_edge23_boundary = dot(triangle2_edge23_boundary_normal, p[2]);
+        Real  side_of_triangle3_edge31_boundary = dot(triangle3_edge31_boundary_normal, p[1]);
+        Real  side_of_triangle3_edge32_boundary = dot(triangle3_edge32_boundary_normal, p[3]);
 
         if (side_of_triangle1 < Real(0))
         {
@@ -320,32 +506,62 @@ namespace geometry
         return false;
     }
 
+    // State which intersect_gjk carries between queries on the same pair of shapes.
+    // When the shapes were separated, direction is the axis which separated them. If they
+    // have only moved a little, it is likely to still separate them, and the next query
+    // finishes in one iteration. Otherwise it is the last search direction.
     template <class Vec3>
-    bool intersect_gjk(
-        std::function<Vec3(const Vec3&)> support1,
-        std::function<Vec3(const Vec3&)> support2,
-        const std::size_t max_iterations = 100,
-        GjkStats* stats = nullptr)
+    struct GjkCache
+    {
+        Vec3 direction;
+        bool valid = false;
+    };
+
+    // The main loop of intersect_gjk, for support mappings whose Vec3 has the policy's Real
+    template <class Vec3, class Policy, class Support1, class Support2>
+    bool run_intersect_gjk(
+        const Support1& support1,
+        const Support2& support2,
+        GjkCache<Vec3>& cache,
+        const std::size_t max_iterations,
+        GjkStats* stats,
+        Simplex<Vec3>* simplex)
     {
         using Real = decltype(Vec3::x);
+        static_assert(std::is_same_v<Real, typename Policy::Real>, "the policy must compute in the scalar type of Vec3");
 
-        // Starting direction is arbitrary
-        Vec3 d = Vec3(1.0, 0.0, 0.0);
+        // Without a cached direction, the starting direction is arbitrary
+        const bool warm_start = cache.valid && dot(cache.direction, cache.direction) > Real(0);
+        Vec3 d = warm_start ? cache.direction : Vec3(Real(1), Real(0), Real(0));
 
-        Vec3 simplex_points[4] = {};
+        SimplexVertex<Vec3> simplex_points[4] = {};
         std::size_t simplex_size = 0;
 
         bool intersection = false;
+        bool stalled = false;
         std::size_t iteration_count = 0;
         do
         {
-            Vec3 point = support1(d) - support2(-d);
-            if (dot(point, d) < Real(0))
+            SimplexVertex<Vec3>& vertex = simplex_points[simplex_size];
+            vertex.support1 = support1(d);
+            vertex.support2 = support2(-d);
+            vertex.point = vertex.support1 - vertex.support2;
+            const Real progress = dot(vertex.point, d);
+            if (progress < Real(0))
             {
                 // Furthest point along d is not past the origin, so there is no intersection
                 break;
             }
-            simplex_points[simplex_size++] = point;
+
+            // The vertices kept in the simplex are all equally far along d, so this is how far
+            // past them the new vertex reaches
+            if (simplex_size > 0 && progress - dot(simplex_point(simplex_points[0]), d)
+                <= (Policy::relative_tolerance * std::sqrt(dot(vertex.point, vertex.point)) + Policy::absolute_tolerance) * std::sqrt(dot(d, d)))
+            {
+                stalled = true;
+                break;
+            }
+            ++simplex_size;
 
             switch (simplex_size)
             {
@@ -369,14 +585,866 @@ namespace geometry
             ++iteration_count;
         } while (!intersection && iteration_count < max_iterations);
 
+        cache.direction = d;
+        cache.valid = true;
+
+        if (stats)
+        {
+            stats->iteration_count = iteration_count;
+            stats->warm_started = warm_start;
+            stats->cache_hit = warm_start && !intersection && iteration_count == 0;
+            stats->converged = !stalled && (intersection || iteration_count < max_iterations);
+            stats->precision_fallback = false;
+        }
+
+        if (simplex && intersection)
+        {
+            simplex->size = 4;
+            for (std::size_t i = 0; i < 4; ++i)
+            {
+                simplex->set(i, simplex_points[i], Real(0.25));
+            }
+        }
+
+        return intersection;
+    }
+
+    // The support mappings are template parameters so that the compiler can inline
+    // them into the main loop. This is the overload that should normally be used.
+    // The search starts from the direction in cache, if it is valid, and the final
+    // direction is stored back into it.
+    // If simplex is given and the shapes intersect, it is set to the final tetrahedron,
+    // which contains the origin. This can be used to seed penetration_epa.
+    // If the query doesn't converge (see GjkStats), the shapes are reported as separated.
+    template <class Vec3, class Policy = GjkPolicy<decltype(Vec3::x)>, class Support1, class Support2>
+    bool intersect_gjk(
+        const Support1& support1,
+        const Support2& support2,
+        GjkCache<Vec3>& cache,
+        const std::size_t max_iterations = 100,
+        GjkStats* stats = nullptr,
+        Simplex<Vec3>* simplex = nullptr)
+    {
+        static_assert(is_support_mapping_v<Support1, Vec3>, "support1 must be callable as Vec3(const Vec3&)");
+        static_assert(is_support_mapping_v<Support2, Vec3>, "support2 must be callable as Vec3(const Vec3&)");
+
+        using Real = typename Policy::Real;
+        if constexpr (std::is_same_v<Real, decltype(Vec3::x)>)
+        {
+            return run_intersect_gjk<Vec3, Policy>(support1, support2, cache, max_iterations, stats, simplex);
+        }
+        else
+        {
+            // Compute the simplex in the policy's precision. Only the directions passed to the
+            // support mappings are rounded to Vec3; the points they return are exact in Real.
+            using Vec = Vector3<Real>;
+            auto precise_support1 = [&support1](const Vec& d) { return convert_vector<Vec>(support1(convert_vector<Vec3>(d))); };
+            auto precise_support2 = [&support2](const Vec& d) { return convert_vector<Vec>(support2(convert_vector<Vec3>(d))); };
+
+            GjkCache<Vec> precise_cache;
+            precise_cache.direction = convert_vector<Vec>(cache.direction);
+            precise_cache.valid = cache.valid;
+
+            Simplex<Vec> precise_simplex;
+            bool intersection = run_intersect_gjk<Vec, Policy>(precise_support1, precise_support2, precise_cache, max_iterations, stats, simplex ? &precise_simplex : nullptr);
+
+            cache.direction = convert_vector<Vec3>(precise_cache.direction);
+            cache.valid = true;
+
+            if (simplex && intersection)
+            {
+                simplex->size = precise_simplex.size;
+                for (std::size_t i = 0; i < precise_simplex.size; ++i)
+                {
+                    const SimplexVertex<Vec>& vertex = precise_simplex.vertices[i];
+                    simplex->set(i, SimplexVertex<Vec3>{convert_vector<Vec3>(vertex.point), convert_vector<Vec3>(vertex.support1), convert_vector<Vec3>(vertex.support2)},
+                                 static_cast<decltype(Vec3::x)>(precise_simplex.barycentric[i]));
+                }
+            }
+
+            return intersection;
+        }
+    }
+
+    // Runs intersect_gjk without carrying anything over from previous queries
+    template <class Vec3, class Policy = GjkPolicy<decltype(Vec3::x)>, class Support1, class Support2>
+    bool intersect_gjk(
+        const Support1& support1,
+        const Support2& support2,
+        const std::size_t max_iterations = 100,
+        GjkStats* stats = nullptr,
+        Simplex<Vec3>* simplex = nullptr)
+    {
+        GjkCache<Vec3> cache;
+        return intersect_gjk<Vec3, Policy>(support1, support2, cache, max_iterations, stats, simplex);
+    }
+
+    // Runs intersect_gjk with Policy, which is normally the fast one, and if that doesn't
+    // converge, runs it again from the same starting direction with PrecisePolicy. Since
+    // queries only fail to converge when the shapes are almost touching, the precise query is
+    // rarely needed.
+    template <class Vec3, class Policy = GjkPolicy<decltype(Vec3::x)>, class PrecisePolicy = GjkPolicy<double>,
+              class Support1, class Support2>
+    bool intersect_gjk_mixed(
+        const Support1& support1,
+        const Support2& support2,
+        GjkCache<Vec3>& cache,
+        const std::size_t max_iterations = 100,
+        GjkStats* stats = nullptr,
+        Simplex<Vec3>* simplex = nullptr)
+    {
+        GjkStats local_stats;
+        GjkStats& result_stats = stats ? *stats : local_stats;
+
+        const GjkCache<Vec3> initial_cache = cache;
+        bool intersection = intersect_gjk<Vec3, Policy>(support1, support2, cache, max_iterations, &result_stats, simplex);
+        if (result_stats.converged)
+        {
+            return intersection;
+        }
+
+        std::size_t fast_iteration_count = result_stats.iteration_count;
+        cache = initial_cache;
+        intersection = intersect_gjk<Vec3, PrecisePolicy>(support1, support2, cache, max_iterations, &result_stats, simplex);
+        result_stats.iteration_count += fast_iteration_count;
+        result_stats.precision_fallback = true;
+        return intersection;
+    }
+
+    // Type-erased entry point, for when the support mappings are only known at run time.
+    // Every support evaluation is an indirect call, so this is slower than the overload above.
+    template <class Vec3>
+    bool intersect_gjk(
+        const std::function<Vec3(const Vec3&)>& support1,
+        const std::function<Vec3(const Vec3&)>& support2,
+        const std::size_t max_iterations = 100,
+        GjkStats* stats = nullptr,
+        Simplex<Vec3>* simplex = nullptr)
+    {
+        using Support = std::function<Vec3(const Vec3&)>;
+        return intersect_gjk<Vec3, GjkPolicy<decltype(Vec3::x)>, Support, Support>(support1, support2, max_iterations, stats, simplex);
+    }
+
+    // The simplexN_closest functions find the point on an N-dimensional simplex closest
+    // to the origin. Unlike the simplexN_dir functions, they make no assumptions about
+    // which regions the origin can be in, since in the distance query the new vertex isn't
+    // necessarily past the origin. The result is the smallest sub-simplex containing the
+    // closest point, with its barycentric coordinates.
+
+    template <class Vec3>
+    void simplex1_closest(const SimplexVertex<Vec3>& a, const SimplexVertex<Vec3>& b, Simplex<Vec3>& result)
+    {
+        using Real = decltype(Vec3::x);
+
+        Vec3 ab = b.point - a.point;
+        Real t = -dot(a.point, ab);
+        Real length_sq = dot(ab, ab);
+
+        if (t <= Real(0) || length_sq <= Real(0))
+        {
+            result.size = 1;
+            result.set(0, a, Real(1));
+        }
+        else if (t >= length_sq)
+        {
+            result.size = 1;
+            result.set(0, b, Real(1));
+        }
+        else
+        {
+            t /= length_sq;
+            result.size = 2;
+            result.set(0, a, Real(1) - t);
+            result.set(1, b, t);
+        }
+    }
+
+    template <class Vec3>
+    void simplex2_closest(const SimplexVertex<Vec3>& a, const SimplexVertex<Vec3>& b, const SimplexVertex<Vec3>& c, Simplex<Vec3>& result)
+    {
+        using Real = decltype(Vec3::x);
+
+        // This follows the Voronoi region tests in Ericson, Real-Time Collision Detection, 5.1.5
+        Vec3 ab = b.point - a.point;
+        Vec3 ac = c.point - a.point;
+
+        Real d1 = -dot(ab, a.point);
+        Real d2 = -dot(ac, a.point);
+        if (d1 <= Real(0) && d2 <= Real(0))
+        {
+            result.size = 1;
+            result.set(0, a, Real(1));
+            return;
+        }
+
+        Real d3 = -dot(ab, b.point);
+        Real d4 = -dot(ac, b.point);
+        if (d3 >= Real(0) && d4 <= d3)
+        {
+            result.size = 1;
+            result.set(0, b, Real(1));
+            return;
+        }
+
+        Real vc = d1*d4 - d3*d2;
+        if (vc <= Real(0) && d1 >= Real(0) && d3 <= Real(0))
+        {
+            simplex1_closest(a, b, result);
+            return;
+        }
+
+        Real d5 = -dot(ab, c.point);
+        Real d6 = -dot(ac, c.point);
+        if (d6 >= Real(0) && d5 <= d6)
+        {
+            result.size = 1;
+            result.set(0, c, Real(1));
+            return;
+        }
+
+        Real vb = d5*d2 - d1*d6;
+        if (vb <= Real(0) && d2 >= Real(0) && d6 <= Real(0))
+        {
+            simplex1_closest(a, c, result);
+            return;
+        }
+
+        Real va = d3*d6 - d5*d4;
+        if (va <= Real(0) && d4 - d3 >= Real(0) && d5 - d6 >= Real(0))
+        {
+            simplex1_closest(b, c, result);
+            return;
+        }
+
+        Real sum = va + vb + vc;
+        if (sum <= Real(0))
+        {
+            // The triangle is degenerate, so the closest point is on one of its edges
+            Simplex<Vec3> edge;
+            simplex1_closest(a, b, result);
+            for (const auto& [v1, v2] : {std::make_pair(&a, &c), std::make_pair(&b, &c)})
+            {
+                simplex1_closest(*v1, *v2, edge);
+                Vec3 p = edge.closest_point();
+                Vec3 q = result.closest_point();
+                if (dot(p, p) < dot(q, q))
+                {
+                    result = edge;
+                }
+            }
+            return;
+        }
+
+        result.size = 3;
+        result.set(0, a, va / sum);
+        result.set(1, b, vb / sum);
+        result.set(2, c, vc / sum);
+    }
+
+    // Returns true if the origin is inside the tetrahedron, in which case result is the whole tetrahedron.
+    template <class Vec3>
+    bool simplex3_closest(const SimplexVertex<Vec3>& a, const SimplexVertex<Vec3>& b,
+                          const SimplexVertex<Vec3>& c, const SimplexVertex<Vec3>& d,
+                          Simplex<Vec3>& result)
+    {
+        using Real = decltype(Vec3::x);
+
+        // Each face, followed by the vertex opposite it
+        const SimplexVertex<Vec3>* faces[4][4] = {
+            {&a, &b, &c, &d},
+            {&a, &c, &d, &b},
+            {&a, &d, &b, &c},
+            {&b, &d, &c, &a}
+        };
+
+        bool inside = true;
+        Real best_distance_sq = std::numeric_limits<Real>::infinity();
+        Simplex<Vec3> face_result;
+
+        for (const auto& face : faces)
+        {
+            Vec3 normal = cross(face[1]->point - face[0]->point, face[2]->point - face[0]->point);
+            Real origin_side = -dot(normal, face[0]->point);
+            Real opposite_side = dot(normal, face[3]->point - face[0]->point);
+
+            // The face is only a candidate if the origin is on the other side of it from the
+            // opposite vertex. A flat tetrahedron has no inside, so every face is a candidate.
+            if (origin_side * opposite_side < Real(0) || opposite_side == Real(0))
+            {
+                inside = false;
+
+                simplex2_closest(*face[0], *face[1], *face[2], face_result);
+                Vec3 p = face_result.closest_point();
+                Real distance_sq = dot(p, p);
+                if (distance_sq < best_distance_sq)
+                {
+                    best_distance_sq = distance_sq;
+                    result = face_result;
+                }
+            }
+        }
+
+        if (inside)
+        {
+            result.size = 4;
+            result.set(0, a, Real(0.25));
+            result.set(1, b, Real(0.25));
+            result.set(2, c, Real(0.25));
+            result.set(3, d, Real(0.25));
+        }
+
+        return inside;
+    }
+
+    template <class Vec3>
+    struct GjkDistance
+    {
+        using Real = decltype(Vec3::x);
+
+        // Zero if the shapes intersect
+        Real distance = Real(0);
+
+        // The closest points on the first and second shapes. When the shapes intersect,
+        // these are not meaningful.
+        Vec3 point1;
+        Vec3 point2;
+
+        bool intersecting = false;
+
+        // The simplex when the algorithm terminated. When the shapes intersect,
+        // this is a tetrahedron containing the origin (or smaller, if the shapes are touching).
+        Simplex<Vec3> simplex;
+    };
+
+    // Default tolerance for distance_gjk, relative to the distance
+    template <class Real>
+    constexpr Real default_relative_tolerance()
+    {
+        return Real(100) * std::numeric_limits<Real>::epsilon();
+    }
+
+    // Finds the distance between two convex shapes, and the closest points on each.
+    // The query terminates once the distance is known to within relative_tolerance of itself
+    // (see van den Bergen, Collision Detection in Interactive 3D Environments, 4.3.4), or when
+    // no more progress can be made due to rounding. max_iterations is only a safeguard. stats,
+    // if given, reports the iterations, and converged is false only if the query ran out of them,
+    // when the distance is just an upper bound.
+    template <class Vec3, class Support1, class Support2>
+    GjkDistance<Vec3> distance_gjk(
+        const Support1& support1,
+        const Support2& support2,
+        const decltype(Vec3::x) relative_tolerance = default_relative_tolerance<decltype(Vec3::x)>(),
+        const std::size_t max_iterations = 100,
+        GjkStats* stats = nullptr)
+    {
+        static_assert(is_support_mapping_v<Support1, Vec3>, "support1 must be callable as Vec3(const Vec3&)");
+        static_assert(is_support_mapping_v<Support2, Vec3>, "support2 must be callable as Vec3(const Vec3&)");
+
+        using Real = decltype(Vec3::x);
+
+        auto support = [&support1, &support2](const Vec3& d) {
+            SimplexVertex<Vec3> vertex;
+            vertex.support1 = support1(d);
+            vertex.support2 = support2(-d);
+            vertex.point = vertex.support1 - vertex.support2;
+            return vertex;
+        };
+
+        GjkDistance<Vec3> result;
+        Simplex<Vec3>& simplex = result.simplex;
+
+        // Starting direction is arbitrary
+        simplex.size = 1;
+        simplex.set(0, support(Vec3(Real(1), Real(0), Real(0))), Real(1));
+
+        Vec3 v = simplex.vertices[0].point;
+        Real v_sq = dot(v, v);
+
+        std::size_t iteration_count = 0;
+        bool converged = false;
+        while (iteration_count < max_iterations)
+        {
+            ++iteration_count;
+
+            // The closest point is the origin (to within rounding of the simplex's size)
+            Real max_vertex_sq = Real(0);
+            for (std::size_t i = 0; i < simplex.size; ++i)
+            {
+                max_vertex_sq = std::max(max_vertex_sq, dot(simplex.vertices[i].point, simplex.vertices[i].point));
+            }
+            if (v_sq <= std::numeric_limits<Real>::epsilon() * max_vertex_sq)
+            {
+                result.intersecting = true;
+                converged = true;
+                break;
+            }
+
+            SimplexVertex<Vec3> w = support(-v);
+
+            // v.v - v.w is an upper bound on how much closer the shapes can be
+            if (v_sq - dot(v, w.point) <= relative_tolerance * v_sq)
+            {
+                converged = true;
+                break;
+            }
+
+            // If w is already in the simplex, no more progress can be made
+            bool duplicate = false;
+            for (std::size_t i = 0; i < simplex.size; ++i)
+            {
+                duplicate |= simplex.vertices[i].point.x == w.point.x
+                          && simplex.vertices[i].point.y == w.point.y
+                          && simplex.vertices[i].point.z == w.point.z;
+            }
+            if (duplicate)
+            {
+                converged = true;
+                break;
+            }
+
+            Simplex<Vec3> next;
+            switch (simplex.size)
+            {
+            case 1:
+                simplex1_closest(simplex.vertices[0], w, next);
+                break;
+            case 2:
+                simplex2_closest(simplex.vertices[0], simplex.vertices[1], w, next);
+                break;
+            case 3:
+                result.intersecting = simplex3_closest(simplex.vertices[0], simplex.vertices[1], simplex.vertices[2], w, next);
+                break;
+            default:
+                // Impossible case
+                assert(false);
+            }
+
+            if (result.intersecting)
+            {
+                simplex = next;
+                converged = true;
+                break;
+            }
+
+            Vec3 next_v = next.closest_point();
+            Real next_v_sq = dot(next_v, next_v);
+            if (next_v_sq >= v_sq)
+            {
+                // Rounding prevents any more progress
+                converged = true;
+                break;
+            }
+
+            simplex = next;
+            v = next_v;
+            v_sq = next_v_sq;
+        }
+
+        if (stats)
+        {
+            stats->iteration_count = iteration_count;
+            stats->converged = converged;
+        }
+
+        if (result.intersecting)
+        {
+            result.distance = Real(0);
+        }
+        else
+        {
+            result.distance = std::sqrt(v_sq);
+        }
+        result.point1 = simplex.closest_point1();
+        result.point2 = simplex.closest_point2();
+
+        return result;
+    }
+
+    // Tests whether two rounded shapes intersect, where each is a convex core swept by a ball
+    // of radius margin: a capsule is a segment with a margin, and a rounded box a box with one.
+    // The cores are often far simpler than the rounded shapes, and GJK only runs on them,
+    // stopping as soon as the distance between them is known to be above or below the sum of
+    // the margins. Rounded shapes in contact have cores a margin apart rather than touching, so
+    // queries near contact converge in a few iterations, unlike intersect_gjk on polytopes.
+    // The distance is bounded above by |v|, the closest point of the simplex, and below by
+    // v.w / |v|, where w is the support point along -v (van den Bergen, Collision Detection in
+    // Interactive 3D Environments, 4.3.4). If neither bound decides the query before they are
+    // within relative_tolerance of each other, the shapes are reported as separated.
+    // The cache and stats work as in intersect_gjk, with the cached direction pointing from
+    // the closest point of the cores' Minkowski difference towards the origin.
+    template <class Vec3, class Support1, class Support2>
+    bool intersect_gjk_margins(
+        const Support1& support1,
+        const decltype(Vec3::x) margin1,
+        const Support2& support2,
+        const decltype(Vec3::x) margin2,
+        GjkCache<Vec3>& cache,
+        const std::size_t max_iterations = 100,
+        GjkStats* stats = nullptr,
+        const decltype(Vec3::x) relative_tolerance = default_relative_tolerance<decltype(Vec3::x)>())
+    {
+        static_assert(is_support_mapping_v<Support1, Vec3>, "support1 must be callable as Vec3(const Vec3&)");
+        static_assert(is_support_mapping_v<Support2, Vec3>, "support2 must be callable as Vec3(const Vec3&)");
+
+        using Real = decltype(Vec3::x);
+
+        auto support = [&support1, &support2](const Vec3& d) {
+            SimplexVertex<Vec3> vertex;
+            vertex.support1 = support1(d);
+            vertex.support2 = support2(-d);
+            vertex.point = vertex.support1 - vertex.support2;
+            return vertex;
+        };
+
+        const Real margin = margin1 + margin2;
+        const Real margin_sq = margin * margin;
+
+        // Without a cached direction, the starting direction is arbitrary
+        const bool warm_start = cache.valid && dot(cache.direction, cache.direction) > Real(0);
+        const Vec3 d = warm_start ? cache.direction : Vec3(Real(1), Real(0), Real(0));
+        Simplex<Vec3> simplex;
+        simplex.size = 1;
+        simplex.set(0, support(d), Real(1));
+
+        Vec3 v = simplex.vertices[0].point;
+        Real v_sq = dot(v, v);
+
+        // The cores are closer than the margins
+        bool intersection = v_sq <= margin_sq;
+        bool decided = intersection;
+
+        // The cached direction, from the closest point of the last query towards the origin,
+        // usually still separates the cores by more than the margins, and then the first
+        // support point is enough
+        const Real dv = dot(d, v);
+        const bool separated_by_cache = !decided && warm_start && dv < Real(0) && dv * dv > margin_sq * dot(d, d);
+        decided |= separated_by_cache;
+
+        std::size_t iteration_count = 1;
+        while (!decided && iteration_count < max_iterations)
+        {
+            ++iteration_count;
+
+            SimplexVertex<Vec3> w = support(-v);
+            Real vw = dot(v, w.point);
+
+            // The cores are further apart than the margins
+            if (vw > Real(0) && vw * vw > margin_sq * v_sq)
+            {
+                decided = true;
+                break;
+            }
+
+            // The distance is |v| to within the tolerance, which is more than the margins
+            if (v_sq - vw <= relative_tolerance * v_sq)
+            {
+                decided = true;
+                break;
+            }
+
+            // If w is already in the simplex, no more progress can be made
+            bool duplicate = false;
+            for (std::size_t i = 0; i < simplex.size; ++i)
+            {
+                duplicate |= simplex.vertices[i].point.x == w.point.x
+                          && simplex.vertices[i].point.y == w.point.y
+                          && simplex.vertices[i].point.z == w.point.z;
+            }
+            if (duplicate)
+            {
+                decided = true;
+                break;
+            }
+
+            Simplex<Vec3> next;
+            switch (simplex.size)
+            {
+            case 1:
+                simplex1_closest(simplex.vertices[0], w, next);
+                break;
+            case 2:
+                simplex2_closest(simplex.vertices[0], simplex.vertices[1], w, next);
+                break;
+            case 3:
+                intersection = simplex3_closest(simplex.vertices[0], simplex.vertices[1], simplex.vertices[2], w, next);
+                break;
+            default:
+                // Impossible case
+                assert(false);
+            }
+
+            // The cores themselves intersect. The last closest point is kept for the cache.
+            if (intersection)
+            {
+                decided = true;
+                break;
+            }
+
+            Vec3 next_v = next.closest_point();
+            Real next_v_sq = dot(next_v, next_v);
+            if (next_v_sq >= v_sq)
+            {
+                // Rounding prevents any more progress
+                decided = true;
+                break;
+            }
+
+            simplex = next;
+            v = next_v;
+            v_sq = next_v_sq;
+
+            if (v_sq <= margin_sq)
+            {
+                intersection = true;
+                decided = true;
+            }
+        }
+
+        cache.direction = separated_by_cache ? d : -v;
+        cache.valid = true;
+
         if (stats)
         {
             stats->iteration_count = iteration_count;
+            stats->warm_started = warm_start;
+            stats->cache_hit = separated_by_cache;
+            stats->converged = decided;
+            stats->precision_fallback = false;
         }
 
         return intersection;
     }
 
+    template <class Vec3>
+    struct GjkRayHit
+    {
+        using Real = decltype(Vec3::x);
+
+        // The ray first meets the shape at origin + fraction * direction
+        Real fraction = Real(0);
+
+        // The unit normal of the shape there, or zero if the ray starts inside the shape
+        Vec3 normal;
+
+        bool hit = false;
+    };
+
+    // ray_cast_gjk, computing in the scalar type of Vec3
+    template <class Vec3, class Support>
+    GjkRayHit<Vec3> run_ray_cast_gjk(
+        const Support& support,
+        const Vec3& origin,
+        const Vec3& direction,
+        const decltype(Vec3::x) max_fraction,
+        const decltype(Vec3::x) relative_tolerance,
+        const std::size_t max_iterations,
+        GjkStats* stats)
+    {
+        using Real = decltype(Vec3::x);
+
+        GjkRayHit<Vec3> result;
+        result.normal = Vec3(Real(0), Real(0), Real(0));
+        Vec3 x = origin;
+        Vec3 normal(Real(0), Real(0), Real(0));
+
+        // Each vertex is x - p for a support point p, which is kept in support2 so that the
+        // vertices can be recomputed when x moves
+        Simplex<Vec3> simplex;
+        Vec3 v = x - support(direction);
+        Real v_sq = dot(v, v);
+        const Real tolerance_sq = relative_tolerance * relative_tolerance;
+        Real scale_sq = v_sq;
+
+        bool hit = false;
+        bool missed = false;
+        std::size_t iteration_count = 0;
+        while (iteration_count < max_iterations)
+        {
+            // x is on the shape, to within the tolerance
+            if (v_sq <= tolerance_sq * scale_sq)
+            {
+                hit = true;
+                break;
+            }
+            ++iteration_count;
+
+            SimplexVertex<Vec3> w;
+            w.support1 = x;
+            w.support2 = support(v);
+            w.point = x - w.support2;
+            scale_sq = std::max(scale_sq, dot(w.point, w.point));
+
+            const Real vw = dot(v, w.point);
+            bool moved = false;
+            if (vw > Real(0))
+            {
+                // v separates x from the shape, so x moves up to the plane through the support
+                // point, unless the ray is heading away from it or stops short of it
+                const Real vr = dot(v, direction);
+                if (vr >= Real(0))
+                {
+                    missed = true;
+                    break;
+                }
+                const Real fraction = result.fraction - vw / vr;
+                if (fraction > max_fraction)
+                {
+                    missed = true;
+                    break;
+                }
+
+                // Otherwise x is on the plane already, to within rounding
+                moved = fraction > result.fraction;
+                if (moved)
+                {
+                    result.fraction = fraction;
+                    x = origin + result.fraction * direction;
+                    w.support1 = x;
+                    w.point = x - w.support2;
+                    normal = v;
+                    for (std::size_t i = 0; i < simplex.size; ++i)
+                    {
+                        simplex.vertices[i].support1 = x;
+                        simplex.vertices[i].point = x - simplex.vertices[i].support2;
+                    }
+                }
+            }
+
+            // If w is already in the simplex and x has not moved, no more progress can be made
+            bool duplicate = false;
+            for (std::size_t i = 0; i < simplex.size && !moved; ++i)
+            {
+                duplicate |= simplex.vertices[i].point.x == w.point.x
+                          && simplex.vertices[i].point.y == w.point.y
+                          && simplex.vertices[i].point.z == w.point.z;
+            }
+            if (duplicate)
+            {
+                hit = true;
+                break;
+            }
+
+            Simplex<Vec3> next;
+            bool inside = false;
+            switch (simplex.size)
+            {
+            case 0:
+                next.size = 1;
+                next.set(0, w, Real(1));
+                break;
+            case 1:
+                simplex1_closest(simplex.vertices[0], w, next);
+                break;
+            case 2:
+                simplex2_closest(simplex.vertices[0], simplex.vertices[1], w, next);
+                break;
+            case 3:
+                inside = simplex3_closest(simplex.vertices[0], simplex.vertices[1], simplex.vertices[2], w, next);
+                break;
+            default:
+                // Impossible case
+                assert(false);
+            }
+
+            // x is inside the shape
+            if (inside)
+            {
+                hit = true;
+                break;
+            }
+
+            Vec3 next_v = next.closest_point();
+            Real next_v_sq = dot(next_v, next_v);
+            if (!moved && next_v_sq >= v_sq)
+            {
+                // Rounding in a thin simplex can stop it from getting closer even though w is
+                // past it, and then the simplex starts again from w. Otherwise no more progress
+                // can be made.
+                if (vw >= Real(0) || simplex.size == 1)
+                {
+                    hit = true;
+                    break;
+                }
+                next.size = 1;
+                next.set(0, w, Real(1));
+                next_v = w.point;
+                next_v_sq = dot(next_v, next_v);
+            }
+
+            simplex = next;
+            v = next_v;
+            v_sq = next_v_sq;
+        }
+
+        // Running out of iterations is reported as a miss, like intersect_gjk reports
+        // separation, so a cast which didn't converge never gives a hit at an arbitrary fraction
+        result.hit = hit;
+        if (!result.hit)
+        {
+            result.fraction = Real(0);
+        }
+        else
+        {
+            Real normal_sq = dot(normal, normal);
+            if (normal_sq > Real(0))
+            {
+                result.normal = (Real(1) / std::sqrt(normal_sq)) * normal;
+            }
+        }
+
+        if (stats)
+        {
+            stats->iteration_count = iteration_count;
+            stats->converged = hit || missed;
+        }
+
+        return result;
+    }
+
+    // Casts the ray origin + t * direction, for 0 <= t <= max_fraction, against a convex shape,
+    // and finds where it first meets the shape (van den Bergen, Ray Casting against General
+    // Convex Objects with Application to Continuous Collision Detection, 2004). This is GJK on
+    // the difference between the point x = origin + t * direction and the shape, where t only
+    // ever increases: whenever the support point w along v shows that v separates x from the
+    // shape, x moves along the ray up to the plane through w, and the normal is v. The query
+    // ends when x is closer to the shape than relative_tolerance times the largest distance
+    // seen between x and a support point, or when no more progress can be made due to
+    // rounding. max_iterations is only a safeguard. If the cast runs out of iterations, it is
+    // reported as a miss, and stats->converged is false.
+    //
+    // The simplex is computed in Real. Its vertices close in on x from points of the shape
+    // around it, and in float, a thin simplex on a curved shape often stops making progress
+    // well before x is on the surface, so Real is double unless Vec3 is more precise.
+    template <class Vec3, class Real = double, class Support>
+    GjkRayHit<Vec3> ray_cast_gjk(
+        const Support& support,
+        const Vec3& origin,
+        const Vec3& direction,
+        const decltype(Vec3::x) max_fraction = decltype(Vec3::x)(1),
+        const decltype(Vec3::x) relative_tolerance = decltype(Vec3::x)(1e-6),
+        const std::size_t max_iterations = 100,
+        GjkStats* stats = nullptr)
+    {
+        static_assert(is_support_mapping_v<Support, Vec3>, "support must be callable as Vec3(const Vec3&)");
+
+        if constexpr (std::is_same_v<Real, decltype(Vec3::x)>)
+        {
+            return run_ray_cast_gjk<Vec3>(support, origin, direction, max_fraction, relative_tolerance, max_iterations, stats);
+        }
+        else
+        {
+            using Vec = Vector3<Real>;
+            auto precise_support = [&support](const Vec& d) { return convert_vector<Vec>(support(convert_vector<Vec3>(d))); };
+            GjkRayHit<Vec> precise = run_ray_cast_gjk<Vec>(precise_support, convert_vector<Vec>(origin), convert_vector<Vec>(direction),
+                                                           Real(max_fraction), Real(relative_tolerance), max_iterations, stats);
+
+            GjkRayHit<Vec3> result;
+            result.fraction = static_cast<decltype(Vec3::x)>(precise.fraction);
+            result.normal = convert_vector<Vec3>(precise.normal);
+            result.hit = precise.hit;
+            return result;
+        }
+    }
 }
 
 #endif
@@ -0,0 +1,677 @@
+#ifndef GJK_BATCH_HPP
+#define GJK_BATCH_HPP
+
+#include "gjk.hpp"
+
+#include <cstddef>
+#include <cassert>
+#include <cmath>
+#include <type_traits>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace geometry
+{
+    // Number of pairs intersect_gjk_batch runs side by side. This matches the number of
+    // floats in a vector register: 8 with AVX2, or 4 with SSE or NEON.
+#if defined(__AVX2__)
+    constexpr std::size_t default_gjk_batch_width = 8;
+#else
+    constexpr std::size_t default_gjk_batch_width = 4;
+#endif
+
+    // Lanes with no pair in them, in the pair indices passed to a lane support mapping
+    constexpr std::size_t gjk_batch_idle_lane = ~std::size_t(0);
+
+    // Width points, stored as structure of arrays so that the same coordinate of every lane
+    // is contiguous, and can be loaded into a vector register at once
+    template <class Real, std::size_t Width>
+    struct alignas(Width * sizeof(Real) <= 64 ? Width * sizeof(Real) : 64) LaneVec3
+    {
+        Real x[Width];
+        Real y[Width];
+        Real z[Width];
+    };
+
+    // One value for each lane, held in a vector register where the instruction set has one of
+    // the right width. The generic version, which is also the scalar fallback, holds an array,
+    // and the loops over it are left to the compiler.
+    template <class Real, std::size_t Width>
+    struct LaneRegister
+    {
+        Real v[Width];
+
+        static LaneRegister load(const Real* p)
+        {
+            LaneRegister r;
+            for (std::size_t i = 0; i < Width; ++i)
+            {
+                r.v[i] = p[i];
+            }
+            return r;
+        }
+
+        void store(Real* p) const
+        {
+            for (std::size_t i = 0; i < Width; ++i)
+            {
+                p[i] = v[i];
+            }
+        }
+
+        friend LaneRegister operator+(const LaneRegister& l, const LaneRegister& r)
+        {
+            LaneRegister result;
+            for (std::size_t i = 0; i < Width; ++i)
+            {
+                result.v[i] = l.v[i] + r.v[i];
+            }
+            return result;
+        }
+
+        friend LaneRegister operator-(const LaneRegister& l, const LaneRegister& r)
+        {
+            LaneRegister result;
+            for (std::size_t i = 0; i < Width; ++i)
+            {
+                result.v[i] = l.v[i] - r.v[i];
+            }
+            return result;
+        }
+
+        friend LaneRegister operator*(const LaneRegister& l, const LaneRegister& r)
+        {
+            LaneRegister result;
+            for (std::size_t i = 0; i < Width; ++i)
+            {
+                result.v[i] = l.v[i] * r.v[i];
+            }
+            return result;
+        }
+
+        LaneRegister operator-() const
+        {
+            LaneRegister result;
+            for (std::size_t i = 0; i < Width; ++i)
+            {
+                result.v[i] = -v[i];
+            }
+            return result;
+        }
+    };
+
+#if defined(__SSE2__)
+    template <>
+    struct LaneRegister<float, 4>
+    {
+        __m128 v;
+
+        static LaneRegister load(const float* p) { return {_mm_loadu_ps(p)}; }
+        void store(float* p) const { _mm_storeu_ps(p, v); }
+
+        friend LaneRegister operator+(const LaneRegister& l, const LaneRegister& r) { return {_mm_add_ps(l.v, r.v)}; }
+        friend LaneRegister operator-(const LaneRegister& l, const LaneRegister& r) { return {_mm_sub_ps(l.v, r.v)}; }
+        friend LaneRegister operator*(const LaneRegister& l, const LaneRegister& r) { return {_mm_mul_ps(l.v, r.v)}; }
+
+        // Flipping the sign bit is exactly what scalar negation does, including for zeros
+        LaneRegister operator-() const { return {_mm_xor_ps(v, _mm_set1_ps(-0.0f))}; }
+    };
+#elif defined(__ARM_NEON)
+    template <>
+    struct LaneRegister<float, 4>
+    {
+        float32x4_t v;
+
+        static LaneRegister load(const float* p) { return {vld1q_f32(p)}; }
+        void store(float* p) const { vst1q_f32(p, v); }
+
+        friend LaneRegister operator+(const LaneRegister& l, const LaneRegister& r) { return {vaddq_f32(l.v, r.v)}; }
+        friend LaneRegister operator-(const LaneRegister& l, const LaneRegister& r) { return {vsubq_f32(l.v, r.v)}; }
+        friend LaneRegister operator*(const LaneRegister& l, const LaneRegister& r) { return {vmulq_f32(l.v, r.v)}; }
+        LaneRegister operator-() const { return {vnegq_f32(v)}; }
+    };
+#endif
+
+#if defined(__AVX__)
+    template <>
+    struct LaneRegister<float, 8>
+    {
+        __m256 v;
+
+        static LaneRegister load(const float* p) { return {_mm256_loadu_ps(p)}; }
+        void store(float* p) const { _mm256_storeu_ps(p, v); }
+
+        friend LaneRegister operator+(const LaneRegister& l, const LaneRegister& r) { return {_mm256_add_ps(l.v, r.v)}; }
+        friend LaneRegister operator-(const LaneRegister& l, const LaneRegister& r) { return {_mm256_sub_ps(l.v, r.v)}; }
+        friend LaneRegister operator*(const LaneRegister& l, const LaneRegister& r) { return {_mm256_mul_ps(l.v, r.v)}; }
+        LaneRegister operator-() const { return {_mm256_xor_ps(v, _mm256_set1_ps(-0.0f))}; }
+    };
+#endif
+
+    // The lane functions below evaluate the same expressions, in the same order, as dot, cross
+    // and Vec3 arithmetic, with separate multiplies and adds, so every lane gets exactly the
+    // result the scalar code would. This only holds if the compiler doesn't fuse multiplies and
+    // adds into FMA instructions in the scalar code. Build with -ffp-contract=off when FMA is
+    // enabled, as ENABLE_AVX2 does.
+
+    template <class Real, std::size_t Width>
+    void lane_sub(const LaneVec3<Real, Width>& l, const LaneVec3<Real, Width>& r, LaneVec3<Real, Width>& result)
+    {
+        using Register = LaneRegister<Real, Width>;
+        (Register::load(l.x) - Register::load(r.x)).store(result.x);
+        (Register::load(l.y) - Register::load(r.y)).store(result.y);
+        (Register::load(l.z) - Register::load(r.z)).store(result.z);
+    }
+
+    template <class Real, std::size_t Width>
+    void lane_negate(const LaneVec3<Real, Width>& v, LaneVec3<Real, Width>& result)
+    {
+        using Register = LaneRegister<Real, Width>;
+        (-Register::load(v.x)).store(result.x);
+        (-Register::load(v.y)).store(result.y);
+        (-Register::load(v.z)).store(result.z);
+    }
+
+    template <class Real, std::size_t Width>
+    void lane_cross(const LaneVec3<Real, Width>& l, const LaneVec3<Real, Width>& r, LaneVec3<Real, Width>& result)
+    {
+        using Register = LaneRegister<Real, Width>;
+        Register lx = Register::load(l.x), ly = Register::load(l.y), lz = Register::load(l.z);
+        Register rx = Register::load(r.x), ry = Register::load(r.y), rz = Register::load(r.z);
+        (ly*rz - lz*ry).store(result.x);
+        (lz*rx - lx*rz).store(result.y);
+        (lx*ry - ly*rx).store(result.z);
+    }
+
+    template <class Real, std::size_t Width>
+    void lane_dot(const LaneVec3<Real, Width>& l, const LaneVec3<Real, Width>& r, Real* result)
+    {
+        using Register = LaneRegister<Real, Width>;
+        (Register::load(l.x)*Register::load(r.x) + Register::load(l.y)*Register::load(r.y) + Register::load(l.z)*Register::load(r.z)).store(result);
+    }
+
+    // How a lane's next search direction is found, once its simplex has been reduced
+    enum class LaneDirection
+    {
+        // Towards the origin from the only vertex
+        Point,
+
+        // Normal to the edge, towards the origin, as in simplex1_dir
+        Line,
+
+        // Along a normal picked by the triangle or tetrahedron case
+        Normal,
+
+        // Unchanged, since the simplex contains the origin
+        Keep
+    };
+
+    // The reduction of one lane's simplex: vertex order[k] becomes vertex k, for k < size
+    struct LaneReduction
+    {
+        unsigned char order[4];
+        unsigned char size;
+        LaneDirection direction;
+
+        // Index into the candidate normals, for LaneDirection::Normal
+        unsigned char normal;
+    };
+
+    // The triangle case of simplex2_dir, for every lane. The normals are the triangle normal
+    // and its negation.
+    template <class Real, std::size_t Width>
+    void lane_triangle_cases(const LaneVec3<Real, Width>* p, LaneReduction* reductions, LaneVec3<Real, Width>* normals)
+    {
+        LaneVec3<Real, Width> edge01, edge02, edge21;
+        lane_sub(p[1], p[0], edge01);
+        lane_sub(p[2], p[0], edge02);
+        lane_sub(p[1], p[2], edge21);
+
+        LaneVec3<Real, Width>& triangle_normal = normals[0];
+        LaneVec3<Real, Width> f_normal, d_normal, b_normal, fe_normal, de_normal;
+        lane_cross(edge01, edge02, triangle_normal);
+        lane_cross(triangle_normal, edge02, f_normal);
+        lane_cross(triangle_normal, edge21, d_normal);
+        lane_cross(edge01, triangle_normal, b_normal);
+        lane_cross(f_normal, triangle_normal, fe_normal);
+        lane_cross(triangle_normal, d_normal, de_normal);
+        lane_negate(triangle_normal, normals[1]);
+
+        Real f_plane[Width], d_plane[Width], fe_plane[Width], de_plane[Width], b_plane[Width], above[Width];
+        lane_dot(f_normal, p[0], f_plane);
+        lane_dot(d_normal, p[2], d_plane);
+        lane_dot(fe_normal, p[2], fe_plane);
+        lane_dot(de_normal, p[2], de_plane);
+        lane_dot(b_normal, p[0], b_plane);
+        lane_dot(triangle_normal, p[0], above);
+
+        for (std::size_t i = 0; i < Width; ++i)
+        {
+            LaneReduction& r = reductions[i];
+            if (f_plane[i] < Real(0))
+            {
+                r = fe_plane[i] < Real(0)
+                    ? LaneReduction{{2}, 1, LaneDirection::Point, 0}
+                    : LaneReduction{{0, 2}, 2, LaneDirection::Line, 0};
+            }
+            else if (d_plane[i] < Real(0))
+            {
+                r = de_plane[i] < Real(0)
+                    ? LaneReduction{{2}, 1, LaneDirection::Point, 0}
+                    : LaneReduction{{1, 2}, 2, LaneDirection::Line, 0};
+            }
+            else if (b_plane[i] < Real(0))
+            {
+                r = LaneReduction{{0, 1}, 2, LaneDirection::Line, 0};
+            }
+            else
+            {
+                r = above[i] < Real(0)
+                    ? LaneReduction{{0, 2, 1}, 3, LaneDirection::Normal, 0}
+                    : LaneReduction{{0, 1, 2}, 3, LaneDirection::Normal, 1};
+            }
+        }
+    }
+
+    // The tetrahedron case of simplex3_dir, for every lane. The normals are those of
+    // triangles 1, 2 and 3. intersections is set for the lanes whose tetrahedron contains
+    // the origin.
+    template <class Real, std::size_t Width>
+    void lane_tetrahedron_cases(const LaneVec3<Real, Width>* p, LaneReduction* reductions, LaneVec3<Real, Width>* normals, bool* intersections)
+    {
+        LaneVec3<Real, Width> e01, e31, e32, e02, e23, e13, e30, e03;
+        lane_sub(p[0], p[1], e01);
+        lane_sub(p[3], p[1], e31);
+        lane_sub(p[3], p[2], e32);
+        lane_sub(p[0], p[2], e02);
+        lane_sub(p[2], p[3], e23);
+        lane_sub(p[1], p[3], e13);
+        lane_sub(p[3], p[0], e30);
+        lane_sub(p[0], p[3], e03);
+
+        LaneVec3<Real, Width>& triangle1_normal = normals[0];
+        LaneVec3<Real, Width>& triangle2_normal = normals[1];
+        LaneVec3<Real, Width>& triangle3_normal = normals[2];
+        lane_cross(e01, e31, triangle1_normal);
+        lane_cross(e32, e02, triangle2_normal);
+        lane_cross(e23, e13, triangle3_normal);
+
+        LaneVec3<Real, Width> boundary_normal;
+        Real side_of_triangle1[Width], side_of_triangle2[Width], side_of_triangle3[Width];
+        Real edge12_1[Width], edge13_1[Width], edge21_2[Width], edge23_2[Width], edge31_3[Width], edge32_3[Width];
+        lane_dot(triangle1_normal, p[0], side_of_triangle1);
+        lane_dot(triangle2_normal, p[3], side_of_triangle2);
+        lane_dot(triangle3_normal, p[2], side_of_triangle3);
+        lane_cross(triangle1_normal, e30, boundary_normal);
+        lane_dot(boundary_normal, p[0], edge12_1);
+        lane_cross(triangle1_normal, e13, boundary_normal);
+        lane_dot(boundary_normal, p[3], edge13_1);
+        lane_cross(triangle2_normal, e03, boundary_normal);
+        lane_dot(boundary_normal, p[3], edge21_2);
+        lane_cross(triangle2_normal, e32, boundary_normal);
+        lane_dot(boundary_normal, p[2], edge23_2);
+        lane_cross(triangle3_normal, e31, boundary_normal);
+        lane_dot(boundary_normal, p[1], edge31_3);
+        lane_cross(triangle3_normal, e23, boundary_normal);
+        lane_dot(boundary_normal, p[3], edge32_3);
+
+        const LaneReduction triangle1{{0, 1, 3}, 3, LaneDirection::Normal, 0};
+        const LaneReduction triangle2{{0, 3, 2}, 3, LaneDirection::Normal, 1};
+        const LaneReduction triangle3{{1, 2, 3}, 3, LaneDirection::Normal, 2};
+        const LaneReduction edge12{{0, 3}, 2, LaneDirection::Line, 0};
+        const LaneReduction edge13{{1, 3}, 2, LaneDirection::Line, 0};
+        const LaneReduction edge23{{2, 3}, 2, LaneDirection::Line, 0};
+
+        for (std::size_t i = 0; i < Width; ++i)
+        {
+            LaneReduction& r = reductions[i];
+            intersections[i] = false;
+            if (side_of_triangle1[i] < Real(0))
+            {
+                if (edge12_1[i] >= Real(0))
+                {
+                    r = edge21_2[i] < Real(0) ? triangle2 : edge12;
+                }
+                else if (edge13_1[i] >= Real(0))
+                {
+                    r = edge31_3[i] < Real(0) ? triangle3 : edge13;
+                }
+                else
+                {
+                    r = triangle1;
+                }
+            }
+            else if (side_of_triangle2[i] < Real(0))
+            {
+                if (edge23_2[i] >= Real(0))
+                {
+                    r = edge32_3[i] < Real(0) ? triangle3 : edge23;
+                }
+                else if (edge21_2[i] >= Real(0))
+                {
+                    r = edge12;
+                }
+                else
+                {
+                    r = triangle2;
+                }
+            }
+            else if (side_of_triangle3[i] < Real(0))
+            {
+                if (edge32_3[i] >= Real(0))
+                {
+                    r = edge23;
+                }
+                else if (edge31_3[i] >= Real(0))
+                {
+                    r = edge13;
+                }
+                else
+                {
+                    r = triangle3;
+                }
+            }
+            else
+            {
+                intersections[i] = true;
+                r = LaneReduction{{0, 1, 2, 3}, 4, LaneDirection::Keep, 0};
+            }
+        }
+    }
+
+    // Whether support is a lane support mapping, callable as
+    // void(const std::size_t* pairs, const LaneVec3<Real, Width>& d, LaneVec3<Real, Width>& points)
+    template <class Support, class Real, std::size_t Width>
+    constexpr bool is_lane_support_mapping_v
+        = std::is_invocable_v<const Support&, const std::size_t*, const LaneVec3<Real, Width>&, LaneVec3<Real, Width>&>;
+
+    // Finds the support point of the pair in each lane along that lane's direction, with one
+    // call of a lane support mapping, or one call per busy lane of a per pair support mapping
+    template <class Vec3, std::size_t Width, class Support>
+    void lane_support_points(const Support& support, const std::size_t* pairs,
+                             const LaneVec3<decltype(Vec3::x), Width>& d, LaneVec3<decltype(Vec3::x), Width>& points)
+    {
+        if constexpr (is_lane_support_mapping_v<Support, decltype(Vec3::x), Width>)
+        {
+            support(pairs, d, points);
+        }
+        else
+        {
+            for (std::size_t lane = 0; lane < Width; ++lane)
+            {
+                if (pairs[lane] != gjk_batch_idle_lane)
+                {
+                    Vec3 point = support(pairs[lane], Vec3(d.x[lane], d.y[lane], d.z[lane]));
+                    points.x[lane] = point.x;
+                    points.y[lane] = point.y;
+                    points.z[lane] = point.z;
+                }
+            }
+        }
+    }
+
+    // Runs intersect_gjk on pair_count pairs of shapes, several at a time. The pairs in flight
+    // each occupy a lane, and every step of the simplex update is done for all lanes at once
+    // on structure of arrays data, in vector registers. Lanes whose pair has finished are
+    // masked out of the support calls and refilled with the next pair, so a slow pair doesn't
+    // hold up the others.
+    //
+    // support1 and support2 are the support mappings of the two shapes of each pair. Either may
+    // be a per pair support mapping, callable as Vec3(std::size_t pair, const Vec3& d), or a
+    // lane support mapping, which is called once per step for every lane, and must set
+    // points to the support points of pairs[lane] along d for each lane whose pair isn't
+    // gjk_batch_idle_lane. A lane support mapping can scan a mesh for all lanes at once, and
+    // the support points must be exactly those of the scalar support mapping.
+    //
+    // Each pair's result is written to intersections[pair], and is the same as intersect_gjk
+    // would return, as is the iteration count. If caches is given, caches[pair] is used and
+    // updated as the cache of intersect_gjk is, and stats likewise. Policy must compute in the
+    // scalar type of Vec3.
+    template <class Vec3, std::size_t Width = default_gjk_batch_width, class Policy = GjkPolicy<decltype(Vec3::x)>,
+              class Support1, class Support2>
+    void intersect_gjk_batch(
+        std::size_t pair_count,
+        const Support1& support1,
+        const Support2& support2,
+        bool* intersections,
+        GjkCache<Vec3>* caches = nullptr,
+        const std::size_t max_iterations = 100,
+        GjkStats* stats = nullptr)
+    {
+        static_assert(std::is_invocable_r_v<Vec3, const Support1&, std::size_t, const Vec3&> || is_lane_support_mapping_v<Support1, decltype(Vec3::x), Width>,
+                      "support1 must be callable as Vec3(std::size_t, const Vec3&), or be a lane support mapping");
+        static_assert(std::is_invocable_r_v<Vec3, const Support2&, std::size_t, const Vec3&> || is_lane_support_mapping_v<Support2, decltype(Vec3::x), Width>,
+                      "support2 must be callable as Vec3(std::size_t, const Vec3&), or be a lane support mapping");
+
+        using Real = decltype(Vec3::x);
+        static_assert(std::is_same_v<Real, typename Policy::Real>, "the policy must compute in the scalar type of Vec3");
+        using Lanes = LaneVec3<Real, Width>;
+
+        // The state of the pair in each lane
+        std::size_t pair[Width];
+        std::size_t simplex_size[Width];
+        std::size_t iteration_count[Width];
+        bool warm_start[Width];
+        Lanes d = {};
+        Lanes simplex[4] = {};
+
+        // Scratch space for each step
+        Lanes w = {};
+        Lanes support_points1 = {};
+        Lanes support_points2 = {};
+        Lanes negated_d;
+        Lanes reordered[4] = {};
+        Lanes normals[3] = {};
+        Lanes line_direction;
+        Real progress[Width];
+        Real simplex_progress[Width];
+        Real w_squared[Width];
+        Real d_squared[Width];
+        LaneReduction reductions[Width];
+        bool contains_origin[Width];
+
+        // Lanes which added a vertex to their simplex in this step. A lane whose pair finished
+        // is refilled straight away, but its new pair waits for the next step.
+        bool stepping[Width];
+
+        std::size_t next_pair = 0;
+        std::size_t active_lanes = 0;
+        auto start_pair = [&](std::size_t lane) {
+            if (next_pair == pair_count)
+            {
+                pair[lane] = gjk_batch_idle_lane;
+                return;
+            }
+
+            std::size_t p = next_pair++;
+            ++active_lanes;
+            pair[lane] = p;
+            simplex_size[lane] = 0;
+            iteration_count[lane] = 0;
+
+            warm_start[lane] = caches && caches[p].valid && dot(caches[p].direction, caches[p].direction) > Real(0);
+            Vec3 start = warm_start[lane] ? caches[p].direction : Vec3(Real(1), Real(0), Real(0));
+            d.x[lane] = start.x;
+            d.y[lane] = start.y;
+            d.z[lane] = start.z;
+        };
+
+        auto finish_pair = [&](std::size_t lane, bool intersection, bool converged) {
+            std::size_t p = pair[lane];
+            intersections[p] = intersection;
+            if (caches)
+            {
+                caches[p].direction = Vec3(d.x[lane], d.y[lane], d.z[lane]);
+                caches[p].valid = true;
+            }
+            if (stats)
+            {
+                stats[p].iteration_count = iteration_count[lane];
+                stats[p].warm_started = warm_start[lane];
+                stats[p].cache_hit = warm_start[lane] && !intersection && iteration_count[lane] == 0;
+                stats[p].converged = converged;
+                stats[p].precision_fallback = false;
+            }
+
+            --active_lanes;
+            start_pair(lane);
+        };
+
+        for (std::size_t lane = 0; lane < Width; ++lane)
+        {
+            start_pair(lane);
+        }
+
+        while (active_lanes > 0)
+        {
+            // Support points of the active lanes. Idle lanes are computed on below like the
+            // others, but their values are never used.
+            lane_support_points<Vec3, Width>(support1, pair, d, support_points1);
+            lane_negate(d, negated_d);
+            lane_support_points<Vec3, Width>(support2, pair, negated_d, support_points2);
+            lane_sub(support_points1, support_points2, w);
+            lane_dot(w, d, progress);
+            lane_dot(simplex[0], d, simplex_progress);
+            lane_dot(w, w, w_squared);
+            lane_dot(d, d, d_squared);
+
+            bool any_triangle = false;
+            bool any_tetrahedron = false;
+            for (std::size_t lane = 0; lane < Width; ++lane)
+            {
+                stepping[lane] = false;
+                if (pair[lane] == gjk_batch_idle_lane)
+                {
+                    continue;
+                }
+
+                if (progress[lane] < Real(0))
+                {
+                    // Furthest point along d is not past the origin, so there is no intersection
+                    finish_pair(lane, false, true);
+                    continue;
+                }
+
+                // The same progress test as intersect_gjk
+                if (simplex_size[lane] > 0 && progress[lane] - simplex_progress[lane]
+                    <= (Policy::relative_tolerance * std::sqrt(w_squared[lane]) + Policy::absolute_tolerance) * std::sqrt(d_squared[lane]))
+                {
+                    finish_pair(lane, false, false);
+                    continue;
+                }
+
+                stepping[lane] = true;
+                std::size_t k = simplex_size[lane]++;
+                simplex[k].x[lane] = w.x[lane];
+                simplex[k].y[lane] = w.y[lane];
+                simplex[k].z[lane] = w.z[lane];
+
+                any_triangle |= simplex_size[lane] == 3;
+                any_tetrahedron |= simplex_size[lane] == 4;
+            }
+
+            // Each case is computed for every lane if any lane needs it, and each lane then
+            // picks out the one for its own simplex size
+            LaneReduction triangle_reductions[Width];
+            LaneVec3<Real, Width> triangle_normals[2];
+            if (any_triangle)
+            {
+                lane_triangle_cases(simplex, triangle_reductions, triangle_normals);
+            }
+            if (any_tetrahedron)
+            {
+                lane_tetrahedron_cases(simplex, reductions, normals, contains_origin);
+            }
+
+            for (std::size_t lane = 0; lane < Width; ++lane)
+            {
+                if (!stepping[lane])
+                {
+                    continue;
+                }
+
+                const LaneVec3<Real, Width>* lane_normals = normals;
+                switch (simplex_size[lane])
+                {
+                case 1:
+                    reductions[lane] = LaneReduction{{0}, 1, LaneDirection::Point, 0};
+                    break;
+                case 2:
+                    reductions[lane] = LaneReduction{{0, 1}, 2, LaneDirection::Line, 0};
+                    break;
+                case 3:
+                    reductions[lane] = triangle_reductions[lane];
+                    lane_normals = triangle_normals;
+                    break;
+                case 4:
+                    break;
+                default:
+                    // Impossible case
+                    assert(false);
+                }
+
+                const LaneReduction& r = reductions[lane];
+                for (std::size_t k = 0; k < r.size; ++k)
+                {
+                    reordered[k].x[lane] = simplex[r.order[k]].x[lane];
+                    reordered[k].y[lane] = simplex[r.order[k]].y[lane];
+                    reordered[k].z[lane] = simplex[r.order[k]].z[lane];
+                }
+                for (std::size_t k = 0; k < r.size; ++k)
+                {
+                    simplex[k].x[lane] = reordered[k].x[lane];
+                    simplex[k].y[lane] = reordered[k].y[lane];
+                    simplex[k].z[lane] = reordered[k].z[lane];
+                }
+                simplex_size[lane] = r.size;
+
+                if (r.direction == LaneDirection::Normal)
+                {
+                    d.x[lane] = lane_normals[r.normal].x[lane];
+                    d.y[lane] = lane_normals[r.normal].y[lane];
+                    d.z[lane] = lane_normals[r.normal].z[lane];
+                }
+                else if (r.direction == LaneDirection::Point)
+                {
+                    d.x[lane] = -simplex[0].x[lane];
+                    d.y[lane] = -simplex[0].y[lane];
+                    d.z[lane] = -simplex[0].z[lane];
+                }
+            }
+
+            // simplex1_dir for the lanes which were reduced to an edge
+            LaneVec3<Real, Width> edge, edge_cross_a;
+            lane_sub(simplex[1], simplex[0], edge);
+            lane_cross(edge, simplex[0], edge_cross_a);
+            lane_cross(edge, edge_cross_a, line_direction);
+
+            for (std::size_t lane = 0; lane < Width; ++lane)
+            {
+                if (!stepping[lane])
+                {
+                    continue;
+                }
+
+                if (reductions[lane].direction == LaneDirection::Line)
+                {
+                    d.x[lane] = line_direction.x[lane];
+                    d.y[lane] = line_direction.y[lane];
+                    d.z[lane] = line_direction.z[lane];
+                }
+
+                ++iteration_count[lane];
+                bool intersection = simplex_size[lane] == 4 && contains_origin[lane];
+                if (intersection || iteration_count[lane] >= max_iterations)
+                {
+                    finish_pair(lane, intersection, intersection || iteration_count[lane] < max_iterations);
+                }
+            }
+        }
+    }
+}
+
+#endif
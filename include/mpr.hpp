@@ -0,0 +1,351 @@
+#ifndef MPR_HPP
+#define MPR_HPP
+
+#include "gjk.hpp"
+#include "epa.hpp"
+
+#include <cstddef>
+#include <cmath>
+#include <utility>
+
+namespace geometry
+{
+    // The main loop of the MPR queries. v0 is a point inside the Minkowski difference. If
+    // result is null, this returns as soon as the origin is known to be inside. Otherwise the
+    // portal is refined until it lies on the boundary to within relative_tolerance, and result
+    // is set to the penetration along its normal.
+    template <class Vec3, class Support1, class Support2>
+    bool run_mpr(
+        const Support1& support1,
+        const Support2& support2,
+        const SimplexVertex<Vec3>& interior,
+        const decltype(Vec3::x) relative_tolerance,
+        const std::size_t max_iterations,
+        GjkStats* stats,
+        EpaResult<Vec3>* result)
+    {
+        using Real = decltype(Vec3::x);
+
+        std::size_t iteration_count = 0;
+        auto support = [&support1, &support2, &iteration_count](const Vec3& d) {
+            ++iteration_count;
+            SimplexVertex<Vec3> vertex;
+            vertex.support1 = support1(d);
+            vertex.support2 = support2(-d);
+            vertex.point = vertex.support1 - vertex.support2;
+            return vertex;
+        };
+
+        auto finish = [&](bool intersection, bool converged) {
+            if (stats)
+            {
+                stats->iteration_count = iteration_count;
+                stats->warm_started = false;
+                stats->cache_hit = false;
+                stats->converged = converged;
+                stats->precision_fallback = false;
+            }
+            return intersection;
+        };
+
+        // The origin is on the far side of the portal from v0 until the portal is found. If v0
+        // is the origin, the shapes intersect, but the portal still needs a direction.
+        SimplexVertex<Vec3> v0 = interior;
+        if (dot(v0.point, v0.point) == Real(0))
+        {
+            v0.point = Vec3(Real(1e-5), Real(0), Real(0));
+        }
+
+        // Portal discovery: find a triangle (v1, v2, v3) which the ray from v0 through the
+        // origin passes through
+        Vec3 n = -v0.point;
+        SimplexVertex<Vec3> v1 = support(n);
+        if (dot(v1.point, n) <= Real(0))
+        {
+            return finish(false, true);
+        }
+
+        n = cross(v1.point, v0.point);
+        if (dot(n, n) == Real(0))
+        {
+            // The origin is on the segment from v0 to v1, which are both in the difference
+            if (result)
+            {
+                Real length = std::sqrt(dot(v1.point, v1.point));
+                result->depth = length;
+                result->normal = (Real(1) / length) * v1.point;
+                result->point1 = v1.support1;
+                result->point2 = v1.support2;
+                result->converged = true;
+            }
+            return finish(true, true);
+        }
+
+        SimplexVertex<Vec3> v2 = support(n);
+        if (dot(v2.point, n) <= Real(0))
+        {
+            return finish(false, true);
+        }
+
+        n = cross(v1.point - v0.point, v2.point - v0.point);
+        if (dot(n, v0.point) > Real(0))
+        {
+            std::swap(v1, v2);
+            n = -n;
+        }
+
+        SimplexVertex<Vec3> v3;
+        while (true)
+        {
+            if (iteration_count >= max_iterations)
+            {
+                return finish(false, false);
+            }
+
+            v3 = support(n);
+            if (dot(v3.point, n) <= Real(0))
+            {
+                return finish(false, true);
+            }
+
+            // If the origin is outside the side (v0, v1, v3) of the wedge, v2 is replaced
+            if (dot(cross(v1.point, v3.point), v0.point) < Real(0))
+            {
+                v2 = v3;
+                n = cross(v1.point - v0.point, v3.point - v0.point);
+                continue;
+            }
+
+            // Likewise for the side (v0, v3, v2) and v1
+            if (dot(cross(v3.point, v2.point), v0.point) < Real(0))
+            {
+                v1 = v3;
+                n = cross(v3.point - v0.point, v2.point - v0.point);
+                continue;
+            }
+
+            break;
+        }
+
+        // Portal refinement: replace a vertex of the portal with the support point along its
+        // normal, keeping the ray through the origin inside the portal, until the portal is
+        // known to be on the boundary or the origin is past the support plane
+        bool intersection = false;
+        Vec3 normal;
+        while (true)
+        {
+            n = cross(v2.point - v1.point, v3.point - v1.point);
+            Real length_sq = dot(n, n);
+            if (length_sq == Real(0))
+            {
+                // The portal collapsed, which only happens when the difference is flat
+                break;
+            }
+            n = (Real(1) / std::sqrt(length_sq)) * n;
+            normal = n;
+
+            // The origin is inside the tetrahedron (v0, v1, v2, v3)
+            if (dot(n, v1.point) >= Real(0) && !intersection)
+            {
+                intersection = true;
+                if (!result)
+                {
+                    return finish(true, true);
+                }
+            }
+
+            if (iteration_count >= max_iterations)
+            {
+                break;
+            }
+
+            SimplexVertex<Vec3> v4 = support(n);
+            Real progress = dot(v4.point - v3.point, n);
+            if (progress <= relative_tolerance * std::sqrt(dot(v4.point, v4.point)) || dot(v4.point, n) < Real(0))
+            {
+                if (result && intersection)
+                {
+                    // The depth is the distance from the origin to the plane of the portal, and
+                    // the contact points are those of the origin's projection onto it
+                    Real depth = dot(n, v1.point);
+                    Vec3 p = depth * n;
+                    Real area = dot(n, cross(v2.point - v1.point, v3.point - v1.point));
+                    Real u = dot(n, cross(v2.point - p, v3.point - p)) / area;
+                    Real v = dot(n, cross(v3.point - p, v1.point - p)) / area;
+                    Real t = Real(1) - u - v;
+
+                    result->depth = depth;
+                    result->normal = n;
+                    result->point1 = u*v1.support1 + v*v2.support1 + t*v3.support1;
+                    result->point2 = u*v1.support2 + v*v2.support2 + t*v3.support2;
+                    result->converged = true;
+                }
+                return finish(intersection, true);
+            }
+
+            // The plane through v0, v4 and the origin splits the portal. The new portal is the
+            // one of the three triangles around v4 which the ray still passes through.
+            Vec3 side = cross(v4.point, v0.point);
+            if (dot(v1.point, side) > Real(0))
+            {
+                if (dot(v2.point, side) > Real(0))
+                {
+                    v1 = v4;
+                }
+                else
+                {
+                    v3 = v4;
+                }
+            }
+            else
+            {
+                if (dot(v3.point, side) > Real(0))
+                {
+                    v2 = v4;
+                }
+                else
+                {
+                    v1 = v4;
+                }
+            }
+        }
+
+        // Out of iterations, so the best estimate is the last portal
+        if (result && intersection)
+        {
+            result->depth = dot(normal, v1.point);
+            result->normal = normal;
+            result->point1 = v1.support1;
+            result->point2 = v1.support2;
+            result->converged = false;
+        }
+        return finish(intersection, false);
+    }
+
+    // Returns a point inside the Minkowski difference of two shapes, for when no interior
+    // points of the shapes are known: the average of the supports of each shape along the
+    // directions to the corners of a tetrahedron. These are four points of the shape, spread
+    // around it, so their average is inside it unless the shape is flat.
+    template <class Vec3, class Support1, class Support2>
+    SimplexVertex<Vec3> interior_point(const Support1& support1, const Support2& support2)
+    {
+        using Real = decltype(Vec3::x);
+
+        const Vec3 directions[4] = {
+            Vec3(Real(1), Real(1), Real(1)),
+            Vec3(Real(1), Real(-1), Real(-1)),
+            Vec3(Real(-1), Real(1), Real(-1)),
+            Vec3(Real(-1), Real(-1), Real(1))};
+
+        SimplexVertex<Vec3> interior;
+        interior.support1 = Vec3(Real(0), Real(0), Real(0));
+        interior.support2 = Vec3(Real(0), Real(0), Real(0));
+        for (const Vec3& d : directions)
+        {
+            interior.support1 = interior.support1 + Real(0.25) * support1(d);
+            interior.support2 = interior.support2 + Real(0.25) * support2(d);
+        }
+        interior.point = interior.support1 - interior.support2;
+        return interior;
+    }
+
+    // Minkowski Portal Refinement (Snethen, XenoCollide: Complex Collision Made Simple, Game
+    // Programming Gems 7, 2008). Starting from a point inside the Minkowski difference, this
+    // finds a triangle on its boundary which the ray from that point through the origin passes
+    // through, then moves the triangle out along the ray until the origin is known to be on
+    // one side of it. The shapes intersect iff the origin is inside the difference.
+    //
+    // interior1 and interior2 must be points strictly inside each shape, such as their centres.
+    // The support mappings are the same as for intersect_gjk. stats->iteration_count is the
+    // number of support points taken, which is comparable to the iterations of intersect_gjk.
+    // If the query doesn't converge, the shapes are reported as separated.
+    template <class Vec3, class Support1, class Support2>
+    bool intersect_mpr(
+        const Support1& support1,
+        const Vec3& interior1,
+        const Support2& support2,
+        const Vec3& interior2,
+        const std::size_t max_iterations = 100,
+        GjkStats* stats = nullptr)
+    {
+        static_assert(is_support_mapping_v<Support1, Vec3>, "support1 must be callable as Vec3(const Vec3&)");
+        static_assert(is_support_mapping_v<Support2, Vec3>, "support2 must be callable as Vec3(const Vec3&)");
+
+        SimplexVertex<Vec3> interior{interior1 - interior2, interior1, interior2};
+        return run_mpr<Vec3>(support1, support2, interior, default_relative_tolerance<decltype(Vec3::x)>(), max_iterations, stats, nullptr);
+    }
+
+    // Runs intersect_mpr from an interior point found with interior_point, which takes four
+    // more support points of each shape
+    template <class Vec3, class Support1, class Support2>
+    bool intersect_mpr(
+        const Support1& support1,
+        const Support2& support2,
+        const std::size_t max_iterations = 100,
+        GjkStats* stats = nullptr)
+    {
+        static_assert(is_support_mapping_v<Support1, Vec3>, "support1 must be callable as Vec3(const Vec3&)");
+        static_assert(is_support_mapping_v<Support2, Vec3>, "support2 must be callable as Vec3(const Vec3&)");
+
+        SimplexVertex<Vec3> interior = interior_point<Vec3>(support1, support2);
+        return run_mpr<Vec3>(support1, support2, interior, default_relative_tolerance<decltype(Vec3::x)>(), max_iterations, stats, nullptr);
+    }
+
+    // Finds whether two convex shapes intersect as intersect_mpr does, and if they do, keeps
+    // refining the portal until it is on the boundary of the Minkowski difference, and sets
+    // result to the penetration along its normal. Moving shape 2 by depth along normal
+    // separates the shapes, but unlike penetration_epa, the normal is where the ray from the
+    // interior points crosses the boundary rather than the direction of least penetration, so
+    // depth is only an upper bound on the penetration depth.
+    template <class Vec3, class Support1, class Support2>
+    bool penetration_mpr(
+        const Support1& support1,
+        const Vec3& interior1,
+        const Support2& support2,
+        const Vec3& interior2,
+        EpaResult<Vec3>& result,
+        const decltype(Vec3::x) relative_tolerance = default_relative_tolerance<decltype(Vec3::x)>(),
+        const std::size_t max_iterations = 100,
+        GjkStats* stats = nullptr)
+    {
+        static_assert(is_support_mapping_v<Support1, Vec3>, "support1 must be callable as Vec3(const Vec3&)");
+        static_assert(is_support_mapping_v<Support2, Vec3>, "support2 must be callable as Vec3(const Vec3&)");
+
+        SimplexVertex<Vec3> interior{interior1 - interior2, interior1, interior2};
+        return run_mpr<Vec3>(support1, support2, interior, relative_tolerance, max_iterations, stats, &result);
+    }
+
+    // The algorithms which can answer whether a pair of shapes intersect. Either can be chosen
+    // for each pair, since they take the same support mappings and report the same stats.
+    enum class IntersectionAlgorithm
+    {
+        // intersect_gjk_mixed, which can start from the direction cached for the pair
+        Gjk,
+
+        // intersect_mpr, which needs points inside both shapes and keeps no state between
+        // queries, but tends to take fewer support points from a cold start
+        Mpr
+    };
+
+    // Runs whichever algorithm is chosen for the pair. The interior points are only used by
+    // MPR, and the cache only by GJK.
+    template <class Vec3, class Support1, class Support2>
+    bool intersect_convex(
+        const IntersectionAlgorithm algorithm,
+        const Support1& support1,
+        const Vec3& interior1,
+        const Support2& support2,
+        const Vec3& interior2,
+        GjkCache<Vec3>& cache,
+        const std::size_t max_iterations = 100,
+        GjkStats* stats = nullptr)
+    {
+        if (algorithm == IntersectionAlgorithm::Mpr)
+        {
+            return intersect_mpr<Vec3>(support1, interior1, support2, interior2, max_iterations, stats);
+        }
+        return intersect_gjk_mixed<Vec3>(support1, support2, cache, max_iterations, stats);
+    }
+}
+
+#endif
@@ -0,0 +1,212 @@
+#ifndef SHAPES_HPP
+#define SHAPES_HPP
+
+#include <cmath>
+#include <variant>
+
+namespace geometry
+{
+    // Primitive shapes with closed form support mappings, which take O(1) time however
+    // accurately the shape would otherwise need to be tessellated. Each is centred on the
+    // origin of its own frame, and the round ones are symmetric about the z axis (the axis of
+    // the cone in demo_meshes/cone.off). To use one with intersect_gjk, transform the direction
+    // into the shape's frame, and the support point back out of it.
+    //
+    // Vec3 has the same requirements as in gjk.hpp. For directions of zero length, the
+    // support functions return some point of the shape.
+    //
+    // The rounded shapes, the sphere, capsule and rounded box, are each a simpler core shape
+    // swept by a ball. core_support and margin give the two parts, for intersect_gjk_margins.
+
+    template <class Vec3>
+    struct Sphere
+    {
+        using Real = decltype(Vec3::x);
+        Real radius = Real(1);
+    };
+
+    template <class Vec3>
+    struct Box
+    {
+        // Half the size of the box along each axis
+        Vec3 half_extents;
+    };
+
+    // A box swept by a sphere, so its edges and corners are rounded. The overall half extents
+    // are half_extents + radius.
+    template <class Vec3>
+    struct RoundedBox
+    {
+        using Real = decltype(Vec3::x);
+        Vec3 half_extents;
+        Real radius = Real(0);
+    };
+
+    // A line segment from -half_height to half_height along z, swept by a sphere
+    template <class Vec3>
+    struct Capsule
+    {
+        using Real = decltype(Vec3::x);
+        Real half_height = Real(1);
+        Real radius = Real(1);
+    };
+
+    // Its flat ends are at -half_height and half_height along z
+    template <class Vec3>
+    struct Cylinder
+    {
+        using Real = decltype(Vec3::x);
+        Real half_height = Real(1);
+        Real radius = Real(1);
+    };
+
+    // Its apex is at half_height along z, and its base at -half_height
+    template <class Vec3>
+    struct Cone
+    {
+        using Real = decltype(Vec3::x);
+        Real half_height = Real(1);
+        Real radius = Real(1);
+    };
+
+    template <class Vec3>
+    using Primitive = std::variant<Sphere<Vec3>, Box<Vec3>, RoundedBox<Vec3>, Capsule<Vec3>, Cylinder<Vec3>, Cone<Vec3>>;
+
+    // Returns the point at distance radius from the origin along d
+    template <class Vec3>
+    Vec3 support_point_at(const Vec3& d, decltype(Vec3::x) radius)
+    {
+        using Real = decltype(Vec3::x);
+
+        Real length = std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+        if (length > Real(0))
+        {
+            return (radius / length) * d;
+        }
+        return Vec3(radius, Real(0), Real(0));
+    }
+
+    // Returns the point of the disc of the given radius at height z which is furthest along the
+    // x and y components of d
+    template <class Vec3>
+    Vec3 support_disc(const Vec3& d, decltype(Vec3::x) radius, decltype(Vec3::x) z)
+    {
+        using Real = decltype(Vec3::x);
+
+        Real length = std::sqrt(d.x * d.x + d.y * d.y);
+        if (length > Real(0))
+        {
+            Real scale = radius / length;
+            return Vec3(scale * d.x, scale * d.y, z);
+        }
+        return Vec3(Real(0), Real(0), z);
+    }
+
+    template <class Vec3>
+    Vec3 support(const Sphere<Vec3>& sphere, const Vec3& d)
+    {
+        return support_point_at(d, sphere.radius);
+    }
+
+    template <class Vec3>
+    Vec3 support(const Box<Vec3>& box, const Vec3& d)
+    {
+        using Real = decltype(Vec3::x);
+
+        const Vec3& h = box.half_extents;
+        return Vec3(d.x < Real(0) ? -h.x : h.x, d.y < Real(0) ? -h.y : h.y, d.z < Real(0) ? -h.z : h.z);
+    }
+
+    template <class Vec3>
+    Vec3 support(const RoundedBox<Vec3>& box, const Vec3& d)
+    {
+        return support(Box<Vec3>{box.half_extents}, d) + support_point_at(d, box.radius);
+    }
+
+    template <class Vec3>
+    Vec3 support(const Capsule<Vec3>& capsule, const Vec3& d)
+    {
+        using Real = decltype(Vec3::x);
+
+        Vec3 end(Real(0), Real(0), d.z < Real(0) ? -capsule.half_height : capsule.half_height);
+        return end + support_point_at(d, capsule.radius);
+    }
+
+    template <class Vec3>
+    Vec3 support(const Cylinder<Vec3>& cylinder, const Vec3& d)
+    {
+        using Real = decltype(Vec3::x);
+
+        return support_disc(d, cylinder.radius, d.z < Real(0) ? -cylinder.half_height : cylinder.half_height);
+    }
+
+    // The apex is furthest when d is within the cone's half angle of its axis, and otherwise a
+    // point on the rim of the base (van den Bergen, Collision Detection in Interactive 3D
+    // Environments, 2003, section 4.3.3).
+    template <class Vec3>
+    Vec3 support(const Cone<Vec3>& cone, const Vec3& d)
+    {
+        using Real = decltype(Vec3::x);
+
+        Real h = cone.half_height;
+        Real r = cone.radius;
+
+        // d.z > |d| sin(half angle), with both sides squared
+        if (d.z > Real(0) && d.z * d.z * (Real(4) * h * h) > (d.x * d.x + d.y * d.y) * (r * r))
+        {
+            return Vec3(Real(0), Real(0), h);
+        }
+        return support_disc(d, r, -h);
+    }
+
+    template <class Vec3>
+    Vec3 support(const Primitive<Vec3>& primitive, const Vec3& d)
+    {
+        return std::visit([&d](const auto& shape) { return support(shape, d); }, primitive);
+    }
+
+    // The support mapping of the core of a shape: the centre of a sphere, the box of a rounded
+    // box, and the segment of a capsule. Shapes with sharp edges are their own core.
+    template <class Vec3>
+    Vec3 core_support(const Primitive<Vec3>& primitive, const Vec3& d)
+    {
+        using Real = decltype(Vec3::x);
+
+        if (std::holds_alternative<Sphere<Vec3>>(primitive))
+        {
+            return Vec3(Real(0), Real(0), Real(0));
+        }
+        if (const RoundedBox<Vec3>* box = std::get_if<RoundedBox<Vec3>>(&primitive))
+        {
+            return support(Box<Vec3>{box->half_extents}, d);
+        }
+        if (const Capsule<Vec3>* capsule = std::get_if<Capsule<Vec3>>(&primitive))
+        {
+            return Vec3(Real(0), Real(0), d.z < Real(0) ? -capsule->half_height : capsule->half_height);
+        }
+        return support(primitive, d);
+    }
+
+    // The radius of the ball the core of a shape is swept by, or zero if it is its own core
+    template <class Vec3>
+    decltype(Vec3::x) margin(const Primitive<Vec3>& primitive)
+    {
+        using Real = decltype(Vec3::x);
+
+        if (const Sphere<Vec3>* sphere = std::get_if<Sphere<Vec3>>(&primitive))
+        {
+            return sphere->radius;
+        }
+        if (const RoundedBox<Vec3>* box = std::get_if<RoundedBox<Vec3>>(&primitive))
+        {
+            return box->radius;
+        }
+        if (const Capsule<Vec3>* capsule = std::get_if<Capsule<Vec3>>(&primitive))
+        {
+            return capsule->radius;
+        }
+        return Real(0);
+    }
+}
+
+#endif
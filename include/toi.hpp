@@ -0,0 +1,145 @@
+#ifndef TOI_HPP
+#define TOI_HPP
+
+#include "gjk.hpp"
+
+#include <cstddef>
+#include <cmath>
+
+namespace geometry
+{
+    // How fast a moving shape can approach anything over a step: its linear velocity, and a
+    // bound on the speed of any of its points due to its rotation, which is its angular speed
+    // times the largest distance of a point of the shape from the centre of rotation. Both are
+    // per step, so they are the distances covered between time 0 and time 1.
+    template <class Vec3>
+    struct MotionBound
+    {
+        using Real = decltype(Vec3::x);
+
+        Vec3 linear_velocity;
+        Real angular_bound = Real(0);
+    };
+
+    template <class Vec3>
+    struct TimeOfImpact
+    {
+        using Real = decltype(Vec3::x);
+
+        // The time in [0, 1] at which the shapes first come within the tolerance of each other
+        Real time = Real(1);
+
+        // Unit vector pointing from shape 1 towards shape 2 at that time, or zero if the shapes
+        // already intersect at time 0
+        Vec3 normal;
+
+        // The closest points of each shape at that time
+        Vec3 point1;
+        Vec3 point2;
+
+        bool hit = false;
+    };
+
+    // Finds the first time in [0, 1] at which two moving convex shapes come within tolerance
+    // of each other, by conservative advancement (Mirtich, Impulse-based Dynamic Simulation of
+    // Rigid Body Systems, 1996). distance_gjk gives the distance d between the shapes and the
+    // normal n between their closest points. No point of either shape can approach the other
+    // along n faster than the relative linear velocity along n plus both angular bounds, so
+    // the shapes can't touch before d divided by that speed has passed, and time advances by
+    // that much. Objects which never come within reach of each other are rejected without
+    // sampling the step, and thin objects can't be skipped over, however fast they move.
+    //
+    // support1_at(t) returns the support mapping of the first shape in its pose at time t, as
+    // a callable Vec3(const Vec3&), and likewise for support2_at. The poses must not move any
+    // point faster than motion1 and motion2 allow. stats, if given, counts the distance
+    // queries, and reports whether the query ended within max_iterations of them. If it
+    // didn't, the shapes are reported as hitting at the time reached so far, which is before
+    // any contact, rather than as missing each other. With a small tolerance, the advancement
+    // only approaches contact gradually, and a miss would let the shapes tunnel.
+    template <class Vec3, class SupportAt1, class SupportAt2>
+    TimeOfImpact<Vec3> time_of_impact(
+        const SupportAt1& support1_at,
+        const MotionBound<Vec3>& motion1,
+        const SupportAt2& support2_at,
+        const MotionBound<Vec3>& motion2,
+        const decltype(Vec3::x) tolerance,
+        const std::size_t max_iterations = 100,
+        GjkStats* stats = nullptr)
+    {
+        using Real = decltype(Vec3::x);
+
+        const Vec3 relative_velocity = motion2.linear_velocity - motion1.linear_velocity;
+        const Real angular_bound = motion1.angular_bound + motion2.angular_bound;
+
+        TimeOfImpact<Vec3> result;
+        result.normal = Vec3(Real(0), Real(0), Real(0));
+
+        Real t = Real(0);
+        bool converged = false;
+        std::size_t iteration_count = 0;
+        while (iteration_count < max_iterations)
+        {
+            ++iteration_count;
+
+            GjkDistance<Vec3> distance = distance_gjk<Vec3>(support1_at(t), support2_at(t));
+            result.point1 = distance.point1;
+            result.point2 = distance.point2;
+            if (distance.intersecting)
+            {
+                // The shapes only intersect at the start, since time stops short of contact
+                result.time = t;
+                result.hit = true;
+                converged = true;
+                break;
+            }
+
+            Vec3 normal = (Real(1) / distance.distance) * (distance.point2 - distance.point1);
+            result.normal = normal;
+            if (distance.distance <= tolerance)
+            {
+                result.time = t;
+                result.hit = true;
+                converged = true;
+                break;
+            }
+
+            // The fastest the distance can shrink
+            Real approach_speed = angular_bound - dot(relative_velocity, normal);
+            if (approach_speed <= Real(0))
+            {
+                converged = true;
+                break;
+            }
+
+            // Stops half a tolerance short of contact, so that the shapes never overlap at t
+            t += (distance.distance - Real(0.5) * tolerance) / approach_speed;
+            if (t > Real(1))
+            {
+                converged = true;
+                break;
+            }
+        }
+
+        if (!converged)
+        {
+            // The shapes are still apart at t, so reporting t never misses the contact
+            result.time = t;
+            result.hit = true;
+        }
+        else if (!result.hit)
+        {
+            result.time = Real(1);
+            result.normal = Vec3(Real(0), Real(0), Real(0));
+        }
+
+        if (stats)
+        {
+            stats->iteration_count = iteration_count;
+            stats->converged = converged;
+        }
+
+        return result;
+    }
+}
+
+#endif